@@ -0,0 +1,483 @@
+/*
+    alsaplay.c - plays audio out of a memory buffer through ALSA.  It replaces system("aplay ... &") followed by pidof("aplay") and
+        polling kill(pid,0).
+
+        The PCM device is opened once at startup by alsaplay_open().  A playback thread waits for alsaplay_start() and then writes the
+        buffer to the device one period at a time.  When the last sample has been played (snd_pcm_drain()) the thread writes to an
+        eventfd.  The caller either waits on it with alsaplay_wait() or puts alsaplay_eventFd() in its own poll()/select().
+
+        The hardware parameters are only set again if the rate or number of channels changes between buffers.  The device stays open.
+
+        If alsaplay_start() is given a start time the leading silence of the buffer is thrown away and the thread pre-rolls silence of its
+        own instead.  Once the device is running snd_pcm_delay() says when the next frame written will come out, so the thread writes
+        exactly enough silence for the first non-silent frame to leave at the start time.  alsaplay_startError() reports how close it got.
+
+    To test without a sound card use the ALSA "null" device:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o alsaplay alsaplay.c -lm -lasound -pthread
+            ./alsaplay null
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <alsa/asoundlib.h>
+#include "alsaplay.h"
+
+#define LATENCY_US      500000          // ALSA buffer, 0.5 sec.  Only the start and end of a burst care about it, see alsaplay_wait().
+
+int alsaplay_open( const char *device );
+void alsaplay_close( void );
+int alsaplay_start( const short *samples, int numFrames, int rate, int channels, const struct timespec *startTime );
+int alsaplay_eventFd( void );
+int alsaplay_wait( int timeoutMs );
+void alsaplay_stop( void );
+long alsaplay_framesWritten( void );
+int alsaplay_startError( double *errorSec );
+
+static void *playbackThread( void *arg );
+static int playOneBuffer( void );
+static int preRoll( void );
+static int measureStart( long justWritten );
+static int nextFrameLate( long backFrames, double *late );
+static int writeFrames( const short *buf, long frames, int repeat );
+static int setParams( int rate, int channels );
+
+static snd_pcm_t *pcm = (snd_pcm_t *)NULL;
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int eventFd = -1;
+
+//  The job handed from alsaplay_start() to the playback thread.  Everything below is protected by lock.
+static const short *jobSamples;
+static int jobFrames, jobRate, jobChannels;
+static int jobAligned = 0;              // 1 if jobStartTime is used
+static struct timespec jobStartTime;
+static int jobPending = 0;
+static int playing = 0;
+static int stopRequested = 0;
+static int quitThread = 0;
+static int lastResult = 0;
+static long framesWritten = 0;
+static int startErrorValid = 0;
+static double startError = 0.0;         // sec, positive is late
+
+static int currentRate = 0, currentChannels = 0;
+static snd_pcm_uframes_t periodFrames = 0, bufferFrames = 0;
+static short *silence = (short *)NULL;  // one period of zeros for the pre-roll
+
+
+//  Open the PCM device and start the playback thread.  Returns 0 or -1 on error.
+int alsaplay_open( const char *device ) {
+    int err;
+
+    err = snd_pcm_open( &pcm, device, SND_PCM_STREAM_PLAYBACK, 0 );
+    if (err < 0) {
+        printf("alsaplay_open() - cannot open %s: %s\n", device, snd_strerror(err));
+        return -1;
+    }
+    eventFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if (eventFd == -1) {
+        printf("alsaplay_open() - eventfd() failed\n");
+        snd_pcm_close( pcm );
+        return -1;
+    }
+    quitThread = 0;
+    if (pthread_create( &thread, NULL, playbackThread, NULL )) {
+        printf("alsaplay_open() - pthread_create() failed\n");
+        close( eventFd );
+        snd_pcm_close( pcm );
+        return -1;
+    }
+    return 0;
+}
+
+
+void alsaplay_close( void ) {
+    if (pcm == (snd_pcm_t *)NULL) {
+        return;
+    }
+    pthread_mutex_lock( &lock );
+    quitThread = 1;
+    stopRequested = 1;
+    pthread_cond_signal( &cond );
+    pthread_mutex_unlock( &lock );
+    pthread_join( thread, NULL );
+
+    snd_pcm_close( pcm );
+    pcm = (snd_pcm_t *)NULL;
+    close( eventFd );
+    eventFd = -1;
+    currentRate = currentChannels = 0;
+    free( silence );
+    silence = (short *)NULL;
+}
+
+
+//  Hand a buffer to the playback thread and return immediately.  samples[] must stay valid until the completion event.
+//      numFrames is the number of samples per channel.  Returns -1 if the device isn't open or something is already playing.
+//      If startTime isn't NULL the first non-silent frame leaves the device at *startTime (CLOCK_REALTIME).  Call this at least
+//      LATENCY_US plus a little before then, the pre-roll has to fill the device buffer first.
+int alsaplay_start( const short *samples, int numFrames, int rate, int channels, const struct timespec *startTime ) {
+    uint64_t discard;
+
+    if (pcm == (snd_pcm_t *)NULL) {
+        return -1;
+    }
+    pthread_mutex_lock( &lock );
+    if (jobPending || playing) {
+        pthread_mutex_unlock( &lock );
+        return -1;
+    }
+    while (read( eventFd, &discard, sizeof(discard) ) > 0) { }     // clear any stale completion
+    jobSamples = samples;
+    jobFrames = numFrames;
+    jobRate = rate;
+    jobChannels = channels;
+    jobAligned = (startTime != (const struct timespec *)NULL);
+    if (jobAligned) {
+        jobStartTime = *startTime;
+    }
+    startErrorValid = 0;
+    jobPending = 1;
+    stopRequested = 0;
+    framesWritten = 0;
+    pthread_cond_signal( &cond );
+    pthread_mutex_unlock( &lock );
+    return 0;
+}
+
+
+//  Becomes readable when a buffer finishes playing (or fails).  Read 8 bytes from it to clear it, or call alsaplay_wait().
+int alsaplay_eventFd( void ) {
+    return eventFd;
+}
+
+
+//  Wait up to timeoutMs for the completion event.  Returns 1 when playing is done, 0 on timeout, -1 if playback failed.
+int alsaplay_wait( int timeoutMs ) {
+    struct pollfd pfd;
+    uint64_t value;
+    int result;
+
+    pfd.fd = eventFd;
+    pfd.events = POLLIN;
+    if (poll( &pfd, 1, timeoutMs ) <= 0) {
+        return 0;               // timeout or a signal (terminate), either way not done
+    }
+    if (read( eventFd, &value, sizeof(value) ) != sizeof(value)) {
+        return 0;
+    }
+    pthread_mutex_lock( &lock );
+    result = lastResult;
+    pthread_mutex_unlock( &lock );
+    return (result == 0) ? 1 : -1;
+}
+
+
+//  Abort whatever is playing.  The playback thread notices within one period and still sends the completion event.  A buffer the
+//      thread hasn't taken yet is dropped here and the completion event is sent here, so alsaplay_wait() always returns.
+void alsaplay_stop( void ) {
+    uint64_t one = 1;
+
+    pthread_mutex_lock( &lock );
+    stopRequested = 1;
+    if (jobPending) {
+        jobPending = 0;
+        lastResult = 0;
+        if (write( eventFd, &one, sizeof(one) ) != sizeof(one)) {
+            printf("alsaplay - unable to post completion event\n");
+        }
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+
+long alsaplay_framesWritten( void ) {
+    long frames;
+    pthread_mutex_lock( &lock );
+    frames = framesWritten;
+    pthread_mutex_unlock( &lock );
+    return frames;
+}
+
+
+//  When the last buffer started playing compared to the time handed to alsaplay_start(), as measured through snd_pcm_delay().
+//      Returns -1 if there is no measurement (no start time given, or stopped before the signal started).
+int alsaplay_startError( double *errorSec ) {
+    int valid;
+    pthread_mutex_lock( &lock );
+    valid = startErrorValid;
+    *errorSec = startError;
+    pthread_mutex_unlock( &lock );
+    return valid ? 0 : -1;
+}
+
+
+static void *playbackThread( void *arg ) {
+    uint64_t one = 1;
+    int result;
+
+    pthread_mutex_lock( &lock );
+    while (1) {
+        while (!jobPending && !quitThread) {
+            pthread_cond_wait( &cond, &lock );
+        }
+        if (quitThread) {
+            break;
+        }
+        jobPending = 0;
+        playing = 1;
+        pthread_mutex_unlock( &lock );
+
+        result = playOneBuffer();
+
+        pthread_mutex_lock( &lock );
+        playing = 0;
+        lastResult = result;
+        if (write( eventFd, &one, sizeof(one) ) != sizeof(one)) {
+            printf("alsaplay - unable to post completion event\n");
+        }
+    }
+    pthread_mutex_unlock( &lock );
+    return NULL;
+}
+
+
+//  Runs in the playback thread.  Returns 0 if the whole buffer was played (or stopped on request) and -1 on a device error.
+static int playOneBuffer( void ) {
+    const short *next = jobSamples;
+    long framesLeft = jobFrames;
+    long chunk;
+    int err;
+
+    if ((jobRate != currentRate) || (jobChannels != currentChannels)) {
+        if (setParams( jobRate, jobChannels )) {
+            return -1;
+        }
+    } else {
+        err = snd_pcm_prepare( pcm );
+        if (err < 0) {
+            printf("alsaplay - snd_pcm_prepare() failed: %s\n", snd_strerror(err));
+            return -1;
+        }
+    }
+
+    if (jobAligned) {
+        while ((framesLeft > 0) && !memcmp( next, silence, jobChannels*sizeof(short) )) {
+            next += jobChannels;            // drop the leading silence, preRoll() writes its own
+            framesLeft--;
+        }
+        pthread_mutex_lock( &lock );
+        framesWritten = jobFrames - framesLeft;
+        pthread_mutex_unlock( &lock );
+
+        err = preRoll();
+        if (err == 0) {                     // write the first period of sound and see when its first frame comes out
+            chunk = (framesLeft < (long)periodFrames) ? framesLeft : (long)periodFrames;
+            err = writeFrames( next, chunk, 0 );
+            if (err == 0) {
+                err = measureStart( chunk );
+            }
+            next += chunk*jobChannels;
+            framesLeft -= chunk;
+        }
+        if (err) {
+            snd_pcm_drop( pcm );
+            return (err > 0) ? 0 : -1;
+        }
+    }
+
+    err = writeFrames( next, framesLeft, 0 );
+    if (err) {
+        snd_pcm_drop( pcm );
+        return (err > 0) ? 0 : -1;
+    }
+    snd_pcm_drain( pcm );           // returns after the last sample has left the device
+    return 0;
+}
+
+
+//  Writes silence until the device is running, then as much more silence as it takes for the next frame written to come out at
+//      jobStartTime.  If that time has already gone by nothing more is written, measureStart() will show how late it is.
+//      Returns 0, 1 if stopped on request and -1 on a device error.
+static int preRoll( void ) {
+    long frames = 0;
+    double late;
+    int err;
+
+    while (snd_pcm_state( pcm ) != SND_PCM_STATE_RUNNING) {         // the device starts by itself once its buffer is full
+        if (frames > (long)(bufferFrames + periodFrames)) {
+            printf("alsaplay - device did not start during pre-roll\n");
+            return -1;
+        }
+        err = writeFrames( silence, periodFrames, 1 );
+        if (err) {
+            return err;
+        }
+        frames += periodFrames;
+    }
+    if (nextFrameLate( 0, &late )) {
+        return -1;
+    }
+    if (late < 0.0) {
+        return writeFrames( silence, lround( -late*jobRate ), 1 );
+    }
+    return 0;
+}
+
+
+//  Called right after the first justWritten frames of sound went into the device.  Records how late the first of them is.
+static int measureStart( long justWritten ) {
+    double late;
+
+    if (nextFrameLate( justWritten, &late )) {
+        return -1;
+    }
+    pthread_mutex_lock( &lock );
+    startError = late;
+    startErrorValid = 1;
+    pthread_mutex_unlock( &lock );
+    return 0;
+}
+
+
+//  How late (sec) the frame written backFrames ago will be compared to jobStartTime.  backFrames == 0 is the next frame to be written.
+static int nextFrameLate( long backFrames, double *late ) {
+    snd_pcm_sframes_t delay;
+    struct timespec now;
+    int err;
+
+    err = snd_pcm_delay( pcm, &delay );             // frames between the next one written and the one coming out now
+    clock_gettime( CLOCK_REALTIME, &now );
+    if (err < 0) {
+        printf("alsaplay - snd_pcm_delay() failed: %s\n", snd_strerror(err));
+        return -1;
+    }
+    *late = (now.tv_sec - jobStartTime.tv_sec) + (now.tv_nsec - jobStartTime.tv_nsec)*1e-9 + (double)(delay - backFrames)/jobRate;
+    return 0;
+}
+
+
+//  Writes frames from buf to the device, one period at a time.  With repeat set buf is a single period (silence) written over and over
+//      and not counted in framesWritten.  Returns 0, 1 if stopped on request and -1 on a device error.
+static int writeFrames( const short *buf, long frames, int repeat ) {
+    const short *next = buf;
+    int stop;
+
+    while (frames > 0) {
+        snd_pcm_sframes_t written;
+        snd_pcm_uframes_t chunk = (frames < (long)periodFrames) ? (snd_pcm_uframes_t)frames : periodFrames;
+
+        pthread_mutex_lock( &lock );
+        stop = stopRequested;
+        pthread_mutex_unlock( &lock );
+        if (stop) {
+            return 1;
+        }
+
+        written = snd_pcm_writei( pcm, next, chunk );           // blocks until there is room for one period
+        if (written < 0) {
+            written = snd_pcm_recover( pcm, (int)written, 0 );  // underrun or suspend, try once to recover
+            if (written < 0) {
+                printf("alsaplay - snd_pcm_writei() failed: %s\n", snd_strerror((int)written));
+                return -1;
+            }
+            continue;
+        }
+        frames -= written;
+        if (!repeat) {
+            next += written*jobChannels;
+            pthread_mutex_lock( &lock );
+            framesWritten += written;
+            pthread_mutex_unlock( &lock );
+        }
+    }
+    return 0;
+}
+
+
+static int setParams( int rate, int channels ) {
+    int err;
+
+    err = snd_pcm_set_params( pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, channels, rate, 1, LATENCY_US );
+    if (err < 0) {
+        printf("alsaplay - snd_pcm_set_params(%d Hz, %d ch) failed: %s\n", rate, channels, snd_strerror(err));
+        currentRate = currentChannels = 0;
+        return -1;
+    }
+    if ((snd_pcm_get_params( pcm, &bufferFrames, &periodFrames ) < 0) || (periodFrames == 0)) {
+        periodFrames = rate/20;     // 50 ms
+        bufferFrames = (snd_pcm_uframes_t)((double)rate*LATENCY_US/1000000);
+    }
+    free( silence );
+    silence = (short *)calloc( periodFrames*channels, sizeof(short) );
+    if (silence == (short *)NULL) {
+        currentRate = currentChannels = 0;
+        return -1;
+    }
+    currentRate = rate;
+    currentChannels = channels;
+    return 0;
+}
+
+
+
+//  Plays a two second tone to the device named on the command line ("null" if none) and checks the completion event arrives.  The
+//      second pass starts the tone (after 0.3 sec of silence in the buffer) at a set time one second out and prints the start error.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+int main( int argc, char **argv ) {
+    const char *device = (argc > 1) ? argv[1] : "null";
+    int rate = 12000, numFrames = 2*rate, leadIn = 3*rate/10, result;
+    short *samples = (short *)calloc( numFrames, sizeof(short) );
+    struct timespec t0, t1, startTime;
+    double error;
+
+    for (int iii = leadIn; iii < numFrames; iii++) {
+        samples[iii] = (short)(16000.0*sin(2.0*M_PI*1500.0*iii/rate));
+    }
+    if (alsaplay_open( device )) { return 1; }
+
+    for (int pass = 0; pass < 2; pass++) {          // second pass checks the device can be reused without reopening
+        clock_gettime( CLOCK_REALTIME, &t0 );
+        startTime = t0;
+        startTime.tv_sec += 1;
+        if (alsaplay_start( samples, numFrames, rate, 1, (pass == 1) ? &startTime : (struct timespec *)NULL )) { printf("alsaplay_start() failed\n"); return 1; }
+        if (alsaplay_start( samples, numFrames, rate, 1, (struct timespec *)NULL ) == 0) { printf("second alsaplay_start() should have failed\n"); return 1; }
+        do {
+            result = alsaplay_wait( 1000 );
+            printf("  %ld frames written\n", alsaplay_framesWritten());
+        } while (result == 0);
+        clock_gettime( CLOCK_REALTIME, &t1 );
+        printf("Pass %d on %s: %s, %ld of %d frames, %.3lf sec\n", pass, device, (result == 1) ? "done" : "error",
+               alsaplay_framesWritten(), numFrames, (t1.tv_sec-t0.tv_sec) + (t1.tv_nsec-t0.tv_nsec)*1e-9);
+        if ((result != 1) || (alsaplay_framesWritten() != numFrames)) { return 1; }
+        if (pass == 1) {
+            if (alsaplay_startError( &error )) { printf("no start error measured\n"); return 1; }
+            printf("  start error %+.3lf ms\n", error*1000.0);
+            if (fabs( error ) > 0.005) { return 1; }
+        }
+    }
+
+    //  stopped straight after the start, maybe before the thread took the buffer, still has to complete
+    for (int pass = 0; pass < 20; pass++) {
+        if (alsaplay_start( samples, numFrames, rate, 1, (struct timespec *)NULL )) { printf("alsaplay_start() failed\n"); return 1; }
+        alsaplay_stop();
+        if (alsaplay_wait( 2000 ) != 1) { printf("no completion after alsaplay_stop()\n"); return 1; }
+    }
+    printf("Stop before playing: done\n");
+    alsaplay_close();
+    free( samples );
+    return 0;
+}
+
+#endif
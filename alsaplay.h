@@ -0,0 +1,17 @@
+#ifndef _ALSAPLAY_H_
+#define _ALSAPLAY_H_
+
+#include <time.h>
+
+#define ALSAPLAY_DEFAULT_DEVICE     "pulse"     // same device aplay used.  "null" plays into nothing, for testing without a sound card.
+
+extern int alsaplay_open( const char *device );
+extern void alsaplay_close( void );
+extern int alsaplay_start( const short *samples, int numFrames, int rate, int channels, const struct timespec *startTime );
+extern int alsaplay_eventFd( void );
+extern int alsaplay_wait( int timeoutMs );
+extern void alsaplay_stop( void );
+extern long alsaplay_framesWritten( void );
+extern int alsaplay_startError( double *errorSec );
+
+#endif
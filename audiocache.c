@@ -0,0 +1,373 @@
+/*
+    audiocache.c - holds the transmit audio.  When the beacon audio came from the 1470.wav - 1530.wav and TST_NQ6B_DM12_*.wav files, each
+        burst opened its file again through aplay and nothing checked the file until the radio was already keyed.  Now the audio is
+        synthesized (wspr.c, ft8.c) and converted to the device format (resample.c) into one slot per mode.  The slots are mapped once at
+        startup by audiocache_open(), touched (MAP_POPULATE) and locked in memory (mlock(), if RLIMIT_MEMLOCK allows) so no page fault ever
+        lands in the Tx window, and re-used every burst.
+
+        audiocache_commit() checks what was written - the length is right for the mode, it isn't silent and it isn't clipped - and only
+        then hands out a view.  wav_output3.c commits well before it keys the radio, so bad audio is reported without going on the air.
+        alsaplay.c plays the view in place, nothing is copied.
+
+        audiocache_mapWav() does the same for a wav file: it is mapped read only, the RIFF header, format (16 bit PCM, mono or stereo),
+        sample rate and duration are checked and the view points straight into the mapping.
+
+    To test:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o audiocache audiocache.c wspr.c -lm
+        - run it from the directory containing the wav files.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wspr.h"
+#include "ft8.h"
+#include "audiocache.h"
+
+#define MIN_PEAK            32          // -60 dBFS, anything quieter is taken as silence
+#define MAX_CLIPPED         0.001       // fraction of the samples allowed to be flat at full scale
+#define WAV_MIN_RATE        8000
+#define WAV_MAX_RATE        192000
+
+struct Slot {
+    short *buffer;              // mmap()ed
+    size_t bytes;
+    long capacity;              // frames
+    double minSeconds;          // a committed buffer has to be this long
+    double maxSeconds;
+    int valid;
+    struct AudioView view;
+};
+
+static struct Slot slots[AUDIOCACHE_NUM_SLOTS];
+static int cacheRate = 0;
+static int cacheChannels = 0;
+static int lockWarned = 0;
+
+//  The shortest and longest audio for each slot.  WSPR is the one second lead in plus the 162 symbols, FT8 the 79 symbols.
+static const double slotSeconds[AUDIOCACHE_NUM_SLOTS][2] = {
+    { (double)WSPR_BUFFER_SAMPLES/WSPR_SAMPLE_RATE - 0.01, (double)WSPR_BUFFER_SAMPLES/WSPR_SAMPLE_RATE + 0.01 },
+    { (double)FT8_NUM_SAMPLES/FT8_SAMPLE_RATE - 0.01, (double)FT8_NUM_SAMPLES/FT8_SAMPLE_RATE + 0.01 } };
+
+int audiocache_open( int rate, int channels );
+void audiocache_close( void );
+short *audiocache_buffer( int slot, long *capacityFrames );
+int audiocache_commit( int slot, long numFrames, struct AudioView *view );
+void audiocache_invalidate( int slot );
+int audiocache_view( int slot, struct AudioView *view );
+int audiocache_mapWav( const char *filename, double minSec, double maxSec, struct AudioView *view );
+void audiocache_unmapWav( struct AudioView *view );
+
+static int checkSamples( const char *what, const short *samples, long numSamples, int channels );
+static uint32_t readLE( const unsigned char *buf, int numBytes );
+
+
+//  Maps the slots for audio at rate and channels.  Calling it again with the same format does nothing, with a different one the slots are
+//      mapped again (and anything in them is gone).  Returns -1 if the memory can't be had.
+int audiocache_open( int rate, int channels ) {
+    if ((rate == cacheRate) && (channels == cacheChannels)) {
+        return 0;
+    }
+    audiocache_close();
+    for (int slot = 0; slot < AUDIOCACHE_NUM_SLOTS; slot++) {
+        struct Slot *sp = &slots[slot];
+        sp->minSeconds = slotSeconds[slot][0];
+        sp->maxSeconds = slotSeconds[slot][1];
+        sp->capacity = (long)ceil( sp->maxSeconds*rate );
+        sp->bytes = (size_t)sp->capacity*channels*sizeof(short);
+        sp->buffer = (short *)mmap( NULL, sp->bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0 );
+        if (sp->buffer == (short *)MAP_FAILED) {
+            perror("audiocache_open() - mmap()");
+            sp->buffer = (short *)NULL;
+            audiocache_close();
+            return -1;
+        }
+        if (mlock( sp->buffer, sp->bytes ) && !lockWarned) {
+            printf("audiocache_open() - unable to lock %zu bytes in memory, continuing without (raise RLIMIT_MEMLOCK)\n",sp->bytes);
+            lockWarned = 1;
+        }
+        sp->valid = 0;
+    }
+    cacheRate = rate;
+    cacheChannels = channels;
+    return 0;
+}
+
+
+void audiocache_close( void ) {
+    for (int slot = 0; slot < AUDIOCACHE_NUM_SLOTS; slot++) {
+        if (slots[slot].buffer != (short *)NULL) {
+            munmap( slots[slot].buffer, slots[slot].bytes );
+        }
+        slots[slot].buffer = (short *)NULL;
+        slots[slot].valid = 0;
+    }
+    cacheRate = 0;
+    cacheChannels = 0;
+}
+
+
+//  Where to write the audio for slot, up to *capacityFrames frames at the rate and channels given to audiocache_open().  Writing to it
+//      takes back any view of the slot.
+short *audiocache_buffer( int slot, long *capacityFrames ) {
+    if ((slot < 0) || (slot >= AUDIOCACHE_NUM_SLOTS) || (slots[slot].buffer == (short *)NULL)) {
+        *capacityFrames = 0;
+        return (short *)NULL;
+    }
+    slots[slot].valid = 0;
+    *capacityFrames = slots[slot].capacity;
+    return slots[slot].buffer;
+}
+
+
+//  Checks the numFrames just written to the slot's buffer and makes them the slot's audio.  Returns -1 (and prints why) if the slot isn't
+//      open or the audio is the wrong length, silent or clipped.
+int audiocache_commit( int slot, long numFrames, struct AudioView *view ) {
+    static const char *names[AUDIOCACHE_NUM_SLOTS] = { "WSPR", "FT8" };
+    struct Slot *sp;
+    double seconds;
+
+    if ((slot < 0) || (slot >= AUDIOCACHE_NUM_SLOTS) || (slots[slot].buffer == (short *)NULL)) {
+        printf("audiocache_commit() - slot %d not open\n",slot);
+        return -1;
+    }
+    sp = &slots[slot];
+    seconds = (double)numFrames/cacheRate;
+    if ((numFrames > sp->capacity) || (seconds < sp->minSeconds) || (seconds > sp->maxSeconds)) {
+        printf("%s audio is %.2lf sec, should be %.2lf\n",names[slot],seconds,(sp->minSeconds + sp->maxSeconds)/2.0);
+        return -1;
+    }
+    if (checkSamples( names[slot], sp->buffer, numFrames*cacheChannels, cacheChannels )) {
+        return -1;
+    }
+    sp->view.samples = sp->buffer;
+    sp->view.numFrames = numFrames;
+    sp->view.rate = cacheRate;
+    sp->view.channels = cacheChannels;
+    sp->view.map = NULL;
+    sp->view.mapBytes = 0;
+    sp->valid = 1;
+    if (view != (struct AudioView *)NULL) {
+        *view = sp->view;
+    }
+    return 0;
+}
+
+
+void audiocache_invalidate( int slot ) {
+    if ((slot >= 0) && (slot < AUDIOCACHE_NUM_SLOTS)) {
+        slots[slot].valid = 0;
+    }
+}
+
+
+//  The last audio committed to slot.  Returns -1 if there isn't any.
+int audiocache_view( int slot, struct AudioView *view ) {
+    if ((slot < 0) || (slot >= AUDIOCACHE_NUM_SLOTS) || !slots[slot].valid) {
+        return -1;
+    }
+    *view = slots[slot].view;
+    return 0;
+}
+
+
+//  Maps a 16 bit PCM wav file read only and checks it is minSec to maxSec long (maxSec 0 for any length).  Returns -1 (and prints why) if
+//      the file is missing, corrupt or the wrong format.  Release it with audiocache_unmapWav().
+int audiocache_mapWav( const char *filename, double minSec, double maxSec, struct AudioView *view ) {
+    const unsigned char *base, *pos, *end;
+    struct stat st;
+    int fd, bits = 0, format = 0;
+    double seconds;
+
+    memset( view, 0, sizeof(struct AudioView) );
+    fd = open( filename, O_RDONLY );
+    if (fd < 0) {
+        printf("Unable to open %s\n",filename);
+        return -1;
+    }
+    if (fstat( fd, &st ) || (st.st_size < 44)) {
+        printf("%s is too short to be a wav file\n",filename);
+        close( fd );
+        return -1;
+    }
+    base = (const unsigned char *)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 );
+    close( fd );                        // the mapping keeps the file
+    if (base == (const unsigned char *)MAP_FAILED) {
+        printf("Unable to map %s\n",filename);
+        return -1;
+    }
+    view->map = (void *)base;
+    view->mapBytes = st.st_size;
+    end = base + st.st_size;
+
+    if (memcmp( base, "RIFF", 4 ) || memcmp( &base[8], "WAVE", 4 )) {
+        printf("%s is not a wav file\n",filename);
+        audiocache_unmapWav( view );
+        return -1;
+    }
+    for (pos = &base[12]; pos + 8 <= end; ) {
+        uint32_t size = readLE( &pos[4], 4 );
+        if ((uint64_t)size > (uint64_t)(end - pos - 8)) {
+            if (!memcmp( pos, "data", 4 )) {
+                size = (uint32_t)(end - pos - 8);           // a recorder that was stopped before it fixed up the header, use what's there
+            } else {
+                break;
+            }
+        }
+        if (!memcmp( pos, "fmt ", 4 ) && (size >= 16)) {
+            format = readLE( &pos[8], 2 );
+            view->channels = readLE( &pos[10], 2 );
+            view->rate = readLE( &pos[12], 4 );
+            bits = readLE( &pos[22], 2 );
+        } else if (!memcmp( pos, "data", 4 ) && (format != 0)) {
+            view->samples = (const short *)&pos[8];         // chunks start on even offsets, so the samples are aligned
+            view->numFrames = (view->channels > 0) ? size/(2*view->channels) : 0;
+            break;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    if ((format != 1) || (bits != 16) || (view->channels < 1) || (view->channels > 2)) {
+        printf("%s is not 16 bit PCM mono or stereo\n",filename);
+    } else if ((view->rate < WAV_MIN_RATE) || (view->rate > WAV_MAX_RATE)) {
+        printf("%s has a sample rate of %d Hz\n",filename,view->rate);
+    } else if (view->samples == (const short *)NULL) {
+        printf("%s has no data\n",filename);
+    } else {
+        seconds = (double)view->numFrames/view->rate;
+        if ((seconds < minSec) || ((maxSec > 0.0) && (seconds > maxSec))) {
+            printf("%s is %.2lf sec long\n",filename,seconds);
+        } else {
+            return 0;
+        }
+    }
+    audiocache_unmapWav( view );
+    return -1;
+}
+
+
+void audiocache_unmapWav( struct AudioView *view ) {
+    if (view->map != NULL) {
+        munmap( view->map, view->mapBytes );
+    }
+    memset( view, 0, sizeof(struct AudioView) );
+}
+
+
+static int checkSamples( const char *what, const short *samples, long numSamples, int channels ) {
+    long clipped = 0;
+    int peak = 0;
+
+    for (long iii = 0; iii < numSamples; iii++) {
+        int value = abs( samples[iii] );
+        if (value > peak) { peak = value; }
+        if ((iii >= channels) && (value >= 32767) && (samples[iii] == samples[iii-channels])) { clipped++; }   // flat top, a peak can touch
+    }
+    if (peak < MIN_PEAK) {
+        printf("%s audio is silent\n",what);
+        return -1;
+    }
+    if (clipped > MAX_CLIPPED*numSamples) {
+        printf("%s audio is clipped (%ld samples)\n",what,clipped);
+        return -1;
+    }
+    return 0;
+}
+
+
+static uint32_t readLE( const unsigned char *buf, int numBytes ) {
+    uint32_t value = 0;
+    for (int iii = numBytes - 1; iii >= 0; iii--) {
+        value = (value << 8) | buf[iii];
+    }
+    return value;
+}
+
+
+
+//  Test - the repository's wav files must map and check, damaged copies of 1500.wav must be turned down, and a slot must take a beacon
+//      and turn down one that is silent, clipped or short.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+//  Writes bytes to filename, maps it and removes it again.  Returns what audiocache_mapWav() did.
+static int mapCopy( const char *filename, const unsigned char *bytes, long numBytes, double minSec ) {
+    struct AudioView view;
+    FILE *fptr = fopen( filename, "wb" );
+    int result;
+
+    fwrite( bytes, 1, numBytes, fptr );
+    fclose( fptr );
+    result = audiocache_mapWav( filename, minSec, 0.0, &view );
+    if (result == 0) {
+        audiocache_unmapWav( &view );
+    }
+    remove( filename );
+    return result;
+}
+
+int main() {
+    static const char *files[] = { "1470.wav", "1480.wav", "1490.wav", "1500.wav", "1510.wav", "1520.wav", "1530.wav",
+                                   "TST_NQ6B_DM12_900Hz.wav", "TST_NQ6B_DM12_1400Hz.wav", "TST_NQ6B_DM12_2040Hz.wav" };
+    struct AudioView view;
+    unsigned char *copy;
+    long numBytes, capacity;
+    int errors = 0, numSamples;
+    short *buffer, *beacon;
+
+    for (int fff = 0; fff < (int)(sizeof(files)/sizeof(files[0])); fff++) {
+        if (audiocache_mapWav( files[fff], 12.0, 121.0, &view )) {
+            errors++;
+            continue;
+        }
+        printf("%-26s %6d Hz %d ch %8ld frames %6.2lf sec\n", files[fff], view.rate, view.channels, view.numFrames,
+               (double)view.numFrames/view.rate);
+        audiocache_unmapWav( &view );
+    }
+
+    //  Damaged copies of 1500.wav
+    if (audiocache_mapWav( "1500.wav", 0.0, 0.0, &view )) { return 1; }
+    numBytes = (const unsigned char *)view.samples - (const unsigned char *)view.map + 2*view.numFrames;
+    copy = (unsigned char *)malloc( numBytes );
+    memcpy( copy, view.map, numBytes );
+    audiocache_unmapWav( &view );
+    errors += (mapCopy( "bad_truncated.wav", copy, 30, 0.0 ) == 0);
+    copy[0] = 'X';
+    errors += (mapCopy( "bad_riff.wav", copy, numBytes, 0.0 ) == 0);
+    copy[0] = 'R';
+    copy[34] = 8;                                                   // 8 bit
+    errors += (mapCopy( "bad_bits.wav", copy, numBytes, 0.0 ) == 0);
+    copy[34] = 16;
+    errors += (mapCopy( "bad_short.wav", copy, numBytes/2, 100.0 ) == 0);
+    errors += (mapCopy( "good.wav", copy, numBytes, 100.0 ) != 0);
+    free( copy );
+
+    //  Slots
+    if (audiocache_open( 12000, 1 )) { return 1; }
+    beacon = wspr_generate( "NQ6B", "DM12", 37, 1500.0, &numSamples );
+    buffer = audiocache_buffer( AUDIOCACHE_WSPR, &capacity );
+    memcpy( buffer, beacon, numSamples*sizeof(short) );
+    if (audiocache_commit( AUDIOCACHE_WSPR, numSamples, &view ) || (view.samples != buffer)) { printf("beacon turned down\n"); errors++; }
+    if (audiocache_commit( AUDIOCACHE_WSPR, numSamples - 12000, &view ) == 0) { printf("short beacon accepted\n"); errors++; }
+    memset( buffer, 0, numSamples*sizeof(short) );
+    if (audiocache_commit( AUDIOCACHE_WSPR, numSamples, &view ) == 0) { printf("silence accepted\n"); errors++; }
+    for (int iii = 0; iii < numSamples; iii++) { buffer[iii] = (beacon[iii] > 0) ? 32767 : -32768; }
+    if (audiocache_commit( AUDIOCACHE_WSPR, numSamples, &view ) == 0) { printf("clipped beacon accepted\n"); errors++; }
+    if (audiocache_view( AUDIOCACHE_FT8, &view ) == 0) { printf("empty FT8 slot has a view\n"); errors++; }
+    if (audiocache_open( 44100, 2 ) || (audiocache_buffer( AUDIOCACHE_WSPR, &capacity ) == (short *)NULL) || (capacity < 44100L*111)) {
+        printf("reopen at 44.1 kHz stereo failed\n");
+        errors++;
+    }
+    audiocache_close();
+    free( beacon );
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
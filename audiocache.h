@@ -0,0 +1,28 @@
+#ifndef _AUDIOCACHE_H_
+#define _AUDIOCACHE_H_
+
+#include <stddef.h>
+
+#define AUDIOCACHE_WSPR         0
+#define AUDIOCACHE_FT8          1
+#define AUDIOCACHE_NUM_SLOTS    2
+
+struct AudioView {              // read only, interleaved.  Good until the slot is written again or the file unmapped.
+    const short *samples;
+    long numFrames;
+    int rate;
+    int channels;
+    void *map;                  // the wav file's mapping for audiocache_unmapWav(), NULL for a slot
+    size_t mapBytes;
+};
+
+extern int audiocache_open( int rate, int channels );
+extern void audiocache_close( void );
+extern short *audiocache_buffer( int slot, long *capacityFrames );
+extern int audiocache_commit( int slot, long numFrames, struct AudioView *view );
+extern void audiocache_invalidate( int slot );
+extern int audiocache_view( int slot, struct AudioView *view );
+extern int audiocache_mapWav( const char *filename, double minSec, double maxSec, struct AudioView *view );
+extern void audiocache_unmapWav( struct AudioView *view );
+
+#endif
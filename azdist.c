@@ -4,24 +4,28 @@
 #include <string.h>
 #include <math.h>
 
-void grid2deg_( char *grid, double *dlong, double *dlat );
+void grid2deg_( const char *grid, double *dlong, double *dlat );
 void geodist_( double *dlat1, double *dlong1, double *dlat2, double *dlong2, double *Az, double *Baz, double *Dkm );
 
 
-void azdist_( char *myGrid, char *hisGrid, int* nAz,
+void azdist_( const char *myGrid0, const char *hisGrid0, int* nAz,
                int* nDmiles, int* nDkm) {
-    // nAz, nDmiles, and nDkm are the only parameters that need to be filled in
+    // nAz, nDmiles, and nDkm are the only parameters that need to be filled in.  gridcache.c does this once for each grid square now.
     double dlong1,dlat1,dlong2,dlat2;
     double Az,Baz,Dkm;
     double temp,temp2,fract;
+    char myGrid[7],hisGrid[7];
 
-    if (strcmp(myGrid,hisGrid) == 0) {
+    if (strcmp(myGrid0,hisGrid0) == 0) {
         *nAz = 0;
         *nDmiles = 0;
         *nDkm = 0;
         return;
     }
 
+    //  Copies, a 4 character grid square (or spaces for the subsquare) is the middle of the square
+    snprintf( myGrid, sizeof(myGrid), "%-6.6s", myGrid0 );
+    snprintf( hisGrid, sizeof(hisGrid), "%-6.6s", hisGrid0 );
     if (myGrid[4] == ' ') { myGrid[4] = 'm'; }
     if (myGrid[5] == ' ') { myGrid[5] = 'm'; }
     if (hisGrid[4] == ' ') { hisGrid[4] = 'm'; }
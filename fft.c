@@ -0,0 +1,289 @@
+/*
+    fft.c - in place radix 2 complex FFT for the decoders.  Nothing fancy, but the twiddles and the bit reversal table are worked out once
+        per length (fft_plan()) so the transforms themselves are just multiply-adds.  A plan is not modified by fft_forward()/fft_inverse(),
+        so one plan can be used by several threads at the same time as long as each has its own data.
+
+        fft_forward() is X[k] = sum x[n] exp(-2 pi i n k/N).  fft_inverse() uses exp(+...) and does not divide by N.
+
+        The passes are done two at a time (radix 4), so a big transform goes through memory half as often, with a single radix 2 pass first
+        if log2(n) is odd.  A struct Complex is two doubles, exactly one SSE2 (x86-64) or NEON (64 bit ARM) register, so the butterflies
+        do the real and imaginary parts together.  32 bit ARM has no double precision NEON and uses plain C.
+
+    To test (compares against a direct DFT and times a 2^21 point transform):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o fft fft.c -lm
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#if defined(__aarch64__)
+#include <arm_neon.h>
+typedef float64x2_t cplx;
+#define LOAD(ptr)       vld1q_f64( &(ptr)->re )
+#define STORE(ptr,vv)   vst1q_f64( &(ptr)->re, vv )
+#define ADD(aa,bb)      vaddq_f64( aa, bb )
+#define SUB(aa,bb)      vsubq_f64( aa, bb )
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128d cplx;
+#define LOAD(ptr)       _mm_loadu_pd( &(ptr)->re )
+#define STORE(ptr,vv)   _mm_storeu_pd( &(ptr)->re, vv )
+#define ADD(aa,bb)      _mm_add_pd( aa, bb )
+#define SUB(aa,bb)      _mm_sub_pd( aa, bb )
+#else
+typedef struct Complex cplx;
+#define LOAD(ptr)       (*(ptr))
+#define STORE(ptr,vv)   (*(ptr) = (vv))
+#define ADD(aa,bb)      add( aa, bb )
+#define SUB(aa,bb)      sub( aa, bb )
+#endif
+#include "fft.h"
+
+struct FFTPlan {
+    int n;
+    int log2n;
+    int *bitReverse;            // n entries
+    struct Complex *twiddle;    // n/2 entries, exp(-2 pi i k/n)
+};
+
+struct FFTPlan *fft_plan( int n );
+void fft_freePlan( struct FFTPlan *plan );
+int fft_size( const struct FFTPlan *plan );
+void fft_forward( const struct FFTPlan *plan, struct Complex *data );
+void fft_inverse( const struct FFTPlan *plan, struct Complex *data );
+
+static void transform( const struct FFTPlan *plan, struct Complex *data, int inverse );
+static cplx twiddleAt( const struct Complex *twiddle, int index, double sign );
+static cplx multiply( cplx aa, cplx ww );
+static cplx timesI( cplx aa, double sign );
+#if !defined(__aarch64__) && !defined(__SSE2__)
+static struct Complex add( struct Complex aa, struct Complex bb );
+static struct Complex sub( struct Complex aa, struct Complex bb );
+#endif
+
+
+//  Returns a plan for an n point transform or NULL if n is not a power of 2 (or malloc() fails).  Free it with fft_freePlan().
+struct FFTPlan *fft_plan( int n ) {
+    struct FFTPlan *plan;
+    int log2n = 0;
+
+    while ((1 << log2n) < n) { log2n++; }
+    if ((n < 2) || ((1 << log2n) != n)) {
+        printf("fft_plan() - %d is not a power of 2\n",n);
+        return (struct FFTPlan *)NULL;
+    }
+    plan = (struct FFTPlan *)malloc( sizeof(struct FFTPlan) );
+    if (plan == (struct FFTPlan *)NULL) {
+        return (struct FFTPlan *)NULL;
+    }
+    plan->n = n;
+    plan->log2n = log2n;
+    plan->bitReverse = (int *)malloc( n*sizeof(int) );
+    plan->twiddle = (struct Complex *)malloc( (n/2)*sizeof(struct Complex) );
+    if ((plan->bitReverse == (int *)NULL) || (plan->twiddle == (struct Complex *)NULL)) {
+        printf("fft_plan() - Error in malloc()\n");
+        fft_freePlan( plan );
+        return (struct FFTPlan *)NULL;
+    }
+    for (int iii = 0; iii < n; iii++) {
+        int rev = 0;
+        for (int bit = 0; bit < log2n; bit++) {
+            if (iii & (1 << bit)) { rev |= 1 << (log2n - 1 - bit); }
+        }
+        plan->bitReverse[iii] = rev;
+    }
+    for (int iii = 0; iii < n/2; iii++) {
+        plan->twiddle[iii].re = cos( 2.0*M_PI*iii/n );
+        plan->twiddle[iii].im = -sin( 2.0*M_PI*iii/n );
+    }
+    return plan;
+}
+
+
+void fft_freePlan( struct FFTPlan *plan ) {
+    if (plan == (struct FFTPlan *)NULL) {
+        return;
+    }
+    free( plan->bitReverse );
+    free( plan->twiddle );
+    free( plan );
+}
+
+
+int fft_size( const struct FFTPlan *plan ) {
+    return plan->n;
+}
+
+
+void fft_forward( const struct FFTPlan *plan, struct Complex *data ) {
+    transform( plan, data, 0 );
+}
+
+
+void fft_inverse( const struct FFTPlan *plan, struct Complex *data ) {
+    transform( plan, data, 1 );
+}
+
+
+//  Decimation in time.  Reorder, then log2(n) passes of butterflies.  The twiddle for a span of len is every (n/len)th entry of the table.
+//      Two passes at a time: the spans of 2q and 4q for the four points k, k+q, k+2q, k+3q of each block of 4q.  The twiddle of the second
+//      pass for k+q is the one for k times -i (+i for the inverse).
+static void transform( const struct FFTPlan *plan, struct Complex *data, int inverse ) {
+    int n = plan->n;
+    double sign = inverse ? -1.0 : 1.0;
+    int quarter = 1;
+
+    for (int iii = 0; iii < n; iii++) {
+        int jjj = plan->bitReverse[iii];
+        if (jjj > iii) {
+            struct Complex temp = data[iii];
+            data[iii] = data[jjj];
+            data[jjj] = temp;
+        }
+    }
+    if (plan->log2n & 1) {
+        for (int start = 0; start < n; start += 2) {        // span of 2, the twiddle is 1
+            cplx aa = LOAD( &data[start] ), bb = LOAD( &data[start + 1] );
+            STORE( &data[start], ADD( aa, bb ) );
+            STORE( &data[start + 1], SUB( aa, bb ) );
+        }
+        quarter = 2;
+    }
+    for ( ; 4*quarter <= n; quarter <<= 2) {
+        int step1 = n/(2*quarter), step2 = n/(4*quarter);
+        for (int start = 0; start < n; start += 4*quarter) {
+            struct Complex *xx = &data[start];
+            for (int kkk = 0; kkk < quarter; kkk++) {
+                cplx w1 = twiddleAt( plan->twiddle, kkk*step1, sign );
+                cplx w2 = twiddleAt( plan->twiddle, kkk*step2, sign );
+                cplx aa = LOAD( &xx[kkk] ), bb = multiply( LOAD( &xx[kkk + quarter] ), w1 );
+                cplx cc = LOAD( &xx[kkk + 2*quarter] ), dd = multiply( LOAD( &xx[kkk + 3*quarter] ), w1 );
+                cplx a1 = ADD( aa, bb ), b1 = SUB( aa, bb );
+                cplx c1 = multiply( ADD( cc, dd ), w2 ), d1 = timesI( multiply( SUB( cc, dd ), w2 ), -sign );
+                STORE( &xx[kkk], ADD( a1, c1 ) );
+                STORE( &xx[kkk + 2*quarter], SUB( a1, c1 ) );
+                STORE( &xx[kkk + quarter], ADD( b1, d1 ) );
+                STORE( &xx[kkk + 3*quarter], SUB( b1, d1 ) );
+            }
+        }
+    }
+}
+
+
+//  twiddle[index], conjugated for the inverse (sign -1).
+static cplx twiddleAt( const struct Complex *twiddle, int index, double sign ) {
+#if defined(__aarch64__)
+    const float64x2_t conj = { 1.0, sign };
+    return vmulq_f64( vld1q_f64( &twiddle[index].re ), conj );
+#elif defined(__SSE2__)
+    return _mm_mul_pd( _mm_loadu_pd( &twiddle[index].re ), _mm_set_pd( sign, 1.0 ) );
+#else
+    struct Complex ww = { twiddle[index].re, sign*twiddle[index].im };
+    return ww;
+#endif
+}
+
+
+static cplx multiply( cplx aa, cplx ww ) {
+#if defined(__aarch64__)
+    const float64x2_t negRe = { -1.0, 1.0 };
+    return vfmaq_f64( vmulq_laneq_f64( aa, ww, 0 ), vmulq_laneq_f64( vextq_f64( aa, aa, 1 ), ww, 1 ), negRe );
+#elif defined(__SSE2__)
+    __m128d swapped = _mm_shuffle_pd( aa, aa, 1 );                              // (im, re)
+    __m128d real = _mm_mul_pd( aa, _mm_unpacklo_pd( ww, ww ) );                // (re wr, im wr)
+    __m128d imag = _mm_mul_pd( swapped, _mm_unpackhi_pd( ww, ww ) );           // (im wi, re wi)
+    return _mm_add_pd( real, _mm_mul_pd( imag, _mm_set_pd( 1.0, -1.0 ) ) );
+#else
+    struct Complex product = { aa.re*ww.re - aa.im*ww.im, aa.re*ww.im + aa.im*ww.re };
+    return product;
+#endif
+}
+
+
+//  aa times i (sign 1) or -i (sign -1).
+static cplx timesI( cplx aa, double sign ) {
+#if defined(__aarch64__)
+    const float64x2_t signs = { -sign, sign };
+    return vmulq_f64( vextq_f64( aa, aa, 1 ), signs );
+#elif defined(__SSE2__)
+    return _mm_mul_pd( _mm_shuffle_pd( aa, aa, 1 ), _mm_set_pd( sign, -sign ) );
+#else
+    struct Complex rotated = { -sign*aa.im, sign*aa.re };
+    return rotated;
+#endif
+}
+
+
+#if !defined(__aarch64__) && !defined(__SSE2__)
+static struct Complex add( struct Complex aa, struct Complex bb ) {
+    struct Complex sum = { aa.re + bb.re, aa.im + bb.im };
+    return sum;
+}
+
+
+static struct Complex sub( struct Complex aa, struct Complex bb ) {
+    struct Complex difference = { aa.re - bb.re, aa.im - bb.im };
+    return difference;
+}
+#endif
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <time.h>
+
+int main() {
+    struct FFTPlan *plan;
+    struct Complex *data, *copy;
+    struct timespec t0, t1;
+    double worst = 0.0;
+    int errors = 0;
+
+    //  64 and 128 points of noise against a direct DFT, then back again.  128 has the odd radix 2 pass.
+    for (int size = 64; size <= 128; size *= 2) {
+        int roundTrip = 0;
+        worst = 0.0;
+        plan = fft_plan( size );
+        data = (struct Complex *)malloc( size*sizeof(struct Complex) );
+        copy = (struct Complex *)malloc( size*sizeof(struct Complex) );
+        srand( 1 );
+        for (int iii = 0; iii < size; iii++) {
+            copy[iii].re = data[iii].re = rand()/(double)RAND_MAX - 0.5;
+            copy[iii].im = data[iii].im = rand()/(double)RAND_MAX - 0.5;
+        }
+        fft_forward( plan, data );
+        for (int kkk = 0; kkk < size; kkk++) {
+            double re = 0.0, im = 0.0;
+            for (int nnn = 0; nnn < size; nnn++) {
+                re += copy[nnn].re*cos( 2.0*M_PI*nnn*kkk/size ) + copy[nnn].im*sin( 2.0*M_PI*nnn*kkk/size );
+                im += copy[nnn].im*cos( 2.0*M_PI*nnn*kkk/size ) - copy[nnn].re*sin( 2.0*M_PI*nnn*kkk/size );
+            }
+            if (hypot( re - data[kkk].re, im - data[kkk].im ) > worst) { worst = hypot( re - data[kkk].re, im - data[kkk].im ); }
+        }
+        fft_inverse( plan, data );
+        for (int iii = 0; iii < size; iii++) {
+            if (hypot( data[iii].re/size - copy[iii].re, data[iii].im/size - copy[iii].im ) > 1e-12) { roundTrip++; }
+        }
+        if ((worst > 1e-9) || roundTrip) { errors++; }
+        printf("%d points: worst error against the DFT %.3le, %d round trip errors\n",size,worst,roundTrip);
+        fft_freePlan( plan );
+        free( data );
+        free( copy );
+    }
+    if (fft_plan( 100 ) != (struct FFTPlan *)NULL) { errors++; }
+
+    plan = fft_plan( 1 << 21 );
+    data = (struct Complex *)calloc( 1 << 21, sizeof(struct Complex) );
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    fft_forward( plan, data );
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("2^21 points: %.1lf ms\n", ((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)/1e9)*1e3);
+    fft_freePlan( plan );
+    free( data );
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
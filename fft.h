@@ -0,0 +1,17 @@
+#ifndef _FFT_H_
+#define _FFT_H_
+
+struct Complex {
+    double re;
+    double im;
+};
+
+struct FFTPlan;                 // twiddles and bit reversal for one length, read only once made so threads can share it
+
+extern struct FFTPlan *fft_plan( int n );
+extern void fft_freePlan( struct FFTPlan *plan );
+extern int fft_size( const struct FFTPlan *plan );
+extern void fft_forward( const struct FFTPlan *plan, struct Complex *data );
+extern void fft_inverse( const struct FFTPlan *plan, struct Complex *data );
+
+#endif
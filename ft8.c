@@ -0,0 +1,875 @@
+/*
+    ft8.c - generates FT8 audio in memory.  It replaces the three TST_NQ6B_DM12_*.wav files (44.1 kHz stereo, 2.3 MB each) that could only
+        ever send one message at one of three audio frequencies.
+
+        ft8_pack() packs a message into the 77 bit payload.  Two kinds of messages are handled:
+            - standard messages (i3 = 1): "CQ NQ6B DM12", "CQ DX NQ6B DM12", "K1ABC NQ6B -12", "NQ6B K1ABC R-07", "K1ABC NQ6B RR73", ...
+              Only standard callsigns, no /P, /R or hashed calls.
+            - free text (i3 = 0, n3 = 0), up to 13 characters of " 0-9A-Z+-./?".  "TST NQ6B DM12" is free text because TST isn't a
+              callsign.
+        ft8_encode() adds the CRC-14, runs the 91 bits through the LDPC(174,91) generator, Gray codes the 174 bits three at a time into
+            58 8-FSK symbols and inserts the 7x7 Costas array at symbols 0, 36 and 72.
+        ft8_synthesize() turns the 79 tones into Gaussian smoothed FSK (BT = 2) with the 1/8 symbol raised cosine ramp at each end, the
+            same waveform WSJT-X sends.  Any sample rate that is a multiple of 25 works (0.16 sec symbols), 12000 is the usual one.
+
+    The tables (LDPC generator, CRC) are constants, worked out ahead of time.  The CRC table was made from the polynomial 0x2757.  The
+        encoding follows the FT8 protocol paper (Franke, Somerville, Taylor, QEX 2020) and the WSJT-X sources.
+
+    To run the round trip test against the TST_NQ6B_DM12_*.wav files and the timing benchmark:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o ft8 ft8.c -lm
+        - run it from the directory containing the wav files.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <math.h>
+#include "ft8.h"
+
+#define LDPC_N          174                 // codeword bits
+#define LDPC_K          91                  // payload + CRC
+#define LDPC_M          83                  // parity bits
+#define LDPC_K_BYTES    12
+#define CRC_BITS        14
+#define NUM_DATA_SYMBOLS 58
+#define GFSK_BT         2.0
+#define AMPLITUDE       21528.0             // peak of the old WSJT-X wav files, so the txGainDb FT8 levels still give the same drive
+
+#define NTOKENS         2063592             // c28 values below this are DE, QRZ, CQ, CQ nnn and CQ ABCD
+#define MAX22           4194304             // hashed callsigns, not sent and unpacked as <...>
+#define MAXGRID4        32400
+
+int ft8_pack( const char *message, unsigned char *payload );
+int ft8_encode( const char *message, unsigned char *tones );
+int ft8_encodePayload( const unsigned char *payload, unsigned char *tones );
+int ft8_unpack( const unsigned char *payload, char *message );
+int ft8_crc( const unsigned char *payload );
+int ft8_synthesize( const unsigned char *tones, double toneHz, int sampleRate, short *samples, int numSamples );
+short *ft8_generate( const char *message, double toneHz, int *numSamples );
+
+static int packStandard( char words[][16], int numWords, unsigned char *payload );
+static int packFreeText( const char *message, unsigned char *payload );
+static int32_t pack28( const char *word );
+static int32_t packCQModifier( const char *word );
+static int packGrid( const char *word, int *ir );
+static void writeBits( unsigned char *buf, int *pos, uint32_t value, int numBits );
+static int unpack28( uint32_t n28, char *call );
+static uint32_t readBits( const unsigned char *buf, int *pos, int numBits );
+static uint16_t crc14( const unsigned char *bytes, int numBits );
+static const double *gfskPulse( int samplesPerSymbol );
+
+const unsigned char ft8_costas[7] = { 3, 1, 4, 0, 6, 5, 2 };          // also used by ft8decode.c
+const unsigned char ft8_grayMap[8] = { 0, 1, 3, 2, 5, 6, 4, 7 };
+
+//  Row i gives parity bit i as the XOR of the payload+CRC bits where the row has a 1.  The 91 bits are MSB first, the last 5 bits are 0.
+static const unsigned char ldpcGenerator[LDPC_M][LDPC_K_BYTES] = {
+    { 0x83, 0x29, 0xce, 0x11, 0xbf, 0x31, 0xea, 0xf5, 0x09, 0xf2, 0x7f, 0xc0 },
+    { 0x76, 0x1c, 0x26, 0x4e, 0x25, 0xc2, 0x59, 0x33, 0x54, 0x93, 0x13, 0x20 },
+    { 0xdc, 0x26, 0x59, 0x02, 0xfb, 0x27, 0x7c, 0x64, 0x10, 0xa1, 0xbd, 0xc0 },
+    { 0x1b, 0x3f, 0x41, 0x78, 0x58, 0xcd, 0x2d, 0xd3, 0x3e, 0xc7, 0xf6, 0x20 },
+    { 0x09, 0xfd, 0xa4, 0xfe, 0xe0, 0x41, 0x95, 0xfd, 0x03, 0x47, 0x83, 0xa0 },
+    { 0x07, 0x7c, 0xcc, 0xc1, 0x1b, 0x88, 0x73, 0xed, 0x5c, 0x3d, 0x48, 0xa0 },
+    { 0x29, 0xb6, 0x2a, 0xfe, 0x3c, 0xa0, 0x36, 0xf4, 0xfe, 0x1a, 0x9d, 0xa0 },
+    { 0x60, 0x54, 0xfa, 0xf5, 0xf3, 0x5d, 0x96, 0xd3, 0xb0, 0xc8, 0xc3, 0xe0 },
+    { 0xe2, 0x07, 0x98, 0xe4, 0x31, 0x0e, 0xed, 0x27, 0x88, 0x4a, 0xe9, 0x00 },
+    { 0x77, 0x5c, 0x9c, 0x08, 0xe8, 0x0e, 0x26, 0xdd, 0xae, 0x56, 0x31, 0x80 },
+    { 0xb0, 0xb8, 0x11, 0x02, 0x8c, 0x2b, 0xf9, 0x97, 0x21, 0x34, 0x87, 0xc0 },
+    { 0x18, 0xa0, 0xc9, 0x23, 0x1f, 0xc6, 0x0a, 0xdf, 0x5c, 0x5e, 0xa3, 0x20 },
+    { 0x76, 0x47, 0x1e, 0x83, 0x02, 0xa0, 0x72, 0x1e, 0x01, 0xb1, 0x2b, 0x80 },
+    { 0xff, 0xbc, 0xcb, 0x80, 0xca, 0x83, 0x41, 0xfa, 0xfb, 0x47, 0xb2, 0xe0 },
+    { 0x66, 0xa7, 0x2a, 0x15, 0x8f, 0x93, 0x25, 0xa2, 0xbf, 0x67, 0x17, 0x00 },
+    { 0xc4, 0x24, 0x36, 0x89, 0xfe, 0x85, 0xb1, 0xc5, 0x13, 0x63, 0xa1, 0x80 },
+    { 0x0d, 0xff, 0x73, 0x94, 0x14, 0xd1, 0xa1, 0xb3, 0x4b, 0x1c, 0x27, 0x00 },
+    { 0x15, 0xb4, 0x88, 0x30, 0x63, 0x6c, 0x8b, 0x99, 0x89, 0x49, 0x72, 0xe0 },
+    { 0x29, 0xa8, 0x9c, 0x0d, 0x3d, 0xe8, 0x1d, 0x66, 0x54, 0x89, 0xb0, 0xe0 },
+    { 0x4f, 0x12, 0x6f, 0x37, 0xfa, 0x51, 0xcb, 0xe6, 0x1b, 0xd6, 0xb9, 0x40 },
+    { 0x99, 0xc4, 0x72, 0x39, 0xd0, 0xd9, 0x7d, 0x3c, 0x84, 0xe0, 0x94, 0x00 },
+    { 0x19, 0x19, 0xb7, 0x51, 0x19, 0x76, 0x56, 0x21, 0xbb, 0x4f, 0x1e, 0x80 },
+    { 0x09, 0xdb, 0x12, 0xd7, 0x31, 0xfa, 0xee, 0x0b, 0x86, 0xdf, 0x6b, 0x80 },
+    { 0x48, 0x8f, 0xc3, 0x3d, 0xf4, 0x3f, 0xbd, 0xee, 0xa4, 0xea, 0xfb, 0x40 },
+    { 0x82, 0x74, 0x23, 0xee, 0x40, 0xb6, 0x75, 0xf7, 0x56, 0xeb, 0x5f, 0xe0 },
+    { 0xab, 0xe1, 0x97, 0xc4, 0x84, 0xcb, 0x74, 0x75, 0x71, 0x44, 0xa9, 0xa0 },
+    { 0x2b, 0x50, 0x0e, 0x4b, 0xc0, 0xec, 0x5a, 0x6d, 0x2b, 0xdb, 0xdd, 0x00 },
+    { 0xc4, 0x74, 0xaa, 0x53, 0xd7, 0x02, 0x18, 0x76, 0x16, 0x69, 0x36, 0x00 },
+    { 0x8e, 0xba, 0x1a, 0x13, 0xdb, 0x33, 0x90, 0xbd, 0x67, 0x18, 0xce, 0xc0 },
+    { 0x75, 0x38, 0x44, 0x67, 0x3a, 0x27, 0x78, 0x2c, 0xc4, 0x20, 0x12, 0xe0 },
+    { 0x06, 0xff, 0x83, 0xa1, 0x45, 0xc3, 0x70, 0x35, 0xa5, 0xc1, 0x26, 0x80 },
+    { 0x3b, 0x37, 0x41, 0x78, 0x58, 0xcc, 0x2d, 0xd3, 0x3e, 0xc3, 0xf6, 0x20 },
+    { 0x9a, 0x4a, 0x5a, 0x28, 0xee, 0x17, 0xca, 0x9c, 0x32, 0x48, 0x42, 0xc0 },
+    { 0xbc, 0x29, 0xf4, 0x65, 0x30, 0x9c, 0x97, 0x7e, 0x89, 0x61, 0x0a, 0x40 },
+    { 0x26, 0x63, 0xae, 0x6d, 0xdf, 0x8b, 0x5c, 0xe2, 0xbb, 0x29, 0x48, 0x80 },
+    { 0x46, 0xf2, 0x31, 0xef, 0xe4, 0x57, 0x03, 0x4c, 0x18, 0x14, 0x41, 0x80 },
+    { 0x3f, 0xb2, 0xce, 0x85, 0xab, 0xe9, 0xb0, 0xc7, 0x2e, 0x06, 0xfb, 0xe0 },
+    { 0xde, 0x87, 0x48, 0x1f, 0x28, 0x2c, 0x15, 0x39, 0x71, 0xa0, 0xa2, 0xe0 },
+    { 0xfc, 0xd7, 0xcc, 0xf2, 0x3c, 0x69, 0xfa, 0x99, 0xbb, 0xa1, 0x41, 0x20 },
+    { 0xf0, 0x26, 0x14, 0x47, 0xe9, 0x49, 0x0c, 0xa8, 0xe4, 0x74, 0xce, 0xc0 },
+    { 0x44, 0x10, 0x11, 0x58, 0x18, 0x19, 0x6f, 0x95, 0xcd, 0xd7, 0x01, 0x20 },
+    { 0x08, 0x8f, 0xc3, 0x1d, 0xf4, 0xbf, 0xbd, 0xe2, 0xa4, 0xea, 0xfb, 0x40 },
+    { 0xb8, 0xfe, 0xf1, 0xb6, 0x30, 0x77, 0x29, 0xfb, 0x0a, 0x07, 0x8c, 0x00 },
+    { 0x5a, 0xfe, 0xa7, 0xac, 0xcc, 0xb7, 0x7b, 0xbc, 0x9d, 0x99, 0xa9, 0x00 },
+    { 0x49, 0xa7, 0x01, 0x6a, 0xc6, 0x53, 0xf6, 0x5e, 0xcd, 0xc9, 0x07, 0x60 },
+    { 0x19, 0x44, 0xd0, 0x85, 0xbe, 0x4e, 0x7d, 0xa8, 0xd6, 0xcc, 0x7d, 0x00 },
+    { 0x25, 0x1f, 0x62, 0xad, 0xc4, 0x03, 0x2f, 0x0e, 0xe7, 0x14, 0x00, 0x20 },
+    { 0x56, 0x47, 0x1f, 0x87, 0x02, 0xa0, 0x72, 0x1e, 0x00, 0xb1, 0x2b, 0x80 },
+    { 0x2b, 0x8e, 0x49, 0x23, 0xf2, 0xdd, 0x51, 0xe2, 0xd5, 0x37, 0xfa, 0x00 },
+    { 0x6b, 0x55, 0x0a, 0x40, 0xa6, 0x6f, 0x47, 0x55, 0xde, 0x95, 0xc2, 0x60 },
+    { 0xa1, 0x8a, 0xd2, 0x8d, 0x4e, 0x27, 0xfe, 0x92, 0xa4, 0xf6, 0xc8, 0x40 },
+    { 0x10, 0xc2, 0xe5, 0x86, 0x38, 0x8c, 0xb8, 0x2a, 0x3d, 0x80, 0x75, 0x80 },
+    { 0xef, 0x34, 0xa4, 0x18, 0x17, 0xee, 0x02, 0x13, 0x3d, 0xb2, 0xeb, 0x00 },
+    { 0x7e, 0x9c, 0x0c, 0x54, 0x32, 0x5a, 0x9c, 0x15, 0x83, 0x6e, 0x00, 0x00 },
+    { 0x36, 0x93, 0xe5, 0x72, 0xd1, 0xfd, 0xe4, 0xcd, 0xf0, 0x79, 0xe8, 0x60 },
+    { 0xbf, 0xb2, 0xce, 0xc5, 0xab, 0xe1, 0xb0, 0xc7, 0x2e, 0x07, 0xfb, 0xe0 },
+    { 0x7e, 0xe1, 0x82, 0x30, 0xc5, 0x83, 0xcc, 0xcc, 0x57, 0xd4, 0xb0, 0x80 },
+    { 0xa0, 0x66, 0xcb, 0x2f, 0xed, 0xaf, 0xc9, 0xf5, 0x26, 0x64, 0x12, 0x60 },
+    { 0xbb, 0x23, 0x72, 0x5a, 0xbc, 0x47, 0xcc, 0x5f, 0x4c, 0xc4, 0xcd, 0x20 },
+    { 0xde, 0xd9, 0xdb, 0xa3, 0xbe, 0xe4, 0x0c, 0x59, 0xb5, 0x60, 0x9b, 0x40 },
+    { 0xd9, 0xa7, 0x01, 0x6a, 0xc6, 0x53, 0xe6, 0xde, 0xcd, 0xc9, 0x03, 0x60 },
+    { 0x9a, 0xd4, 0x6a, 0xed, 0x5f, 0x70, 0x7f, 0x28, 0x0a, 0xb5, 0xfc, 0x40 },
+    { 0xe5, 0x92, 0x1c, 0x77, 0x82, 0x25, 0x87, 0x31, 0x6d, 0x7d, 0x3c, 0x20 },
+    { 0x4f, 0x14, 0xda, 0x82, 0x42, 0xa8, 0xb8, 0x6d, 0xca, 0x73, 0x35, 0x20 },
+    { 0x8b, 0x8b, 0x50, 0x7a, 0xd4, 0x67, 0xd4, 0x44, 0x1d, 0xf7, 0x70, 0xe0 },
+    { 0x22, 0x83, 0x1c, 0x9c, 0xf1, 0x16, 0x94, 0x67, 0xad, 0x04, 0xb6, 0x80 },
+    { 0x21, 0x3b, 0x83, 0x8f, 0xe2, 0xae, 0x54, 0xc3, 0x8e, 0xe7, 0x18, 0x00 },
+    { 0x5d, 0x92, 0x6b, 0x6d, 0xd7, 0x1f, 0x08, 0x51, 0x81, 0xa4, 0xe1, 0x20 },
+    { 0x66, 0xab, 0x79, 0xd4, 0xb2, 0x9e, 0xe6, 0xe6, 0x95, 0x09, 0xe5, 0x60 },
+    { 0x95, 0x81, 0x48, 0x68, 0x2d, 0x74, 0x8a, 0x38, 0xdd, 0x68, 0xba, 0xa0 },
+    { 0xb8, 0xce, 0x02, 0x0c, 0xf0, 0x69, 0xc3, 0x2a, 0x72, 0x3a, 0xb1, 0x40 },
+    { 0xf4, 0x33, 0x1d, 0x6d, 0x46, 0x16, 0x07, 0xe9, 0x57, 0x52, 0x74, 0x60 },
+    { 0x6d, 0xa2, 0x3b, 0xa4, 0x24, 0xb9, 0x59, 0x61, 0x33, 0xcf, 0x9c, 0x80 },
+    { 0xa6, 0x36, 0xbc, 0xbc, 0x7b, 0x30, 0xc5, 0xfb, 0xea, 0xe6, 0x7f, 0xe0 },
+    { 0x5c, 0xb0, 0xd8, 0x6a, 0x07, 0xdf, 0x65, 0x4a, 0x90, 0x89, 0xa2, 0x00 },
+    { 0xf1, 0x1f, 0x10, 0x68, 0x48, 0x78, 0x0f, 0xc9, 0xec, 0xdd, 0x80, 0xa0 },
+    { 0x1f, 0xbb, 0x53, 0x64, 0xfb, 0x8d, 0x2c, 0x9d, 0x73, 0x0d, 0x5b, 0xa0 },
+    { 0xfc, 0xb8, 0x6b, 0xc7, 0x0a, 0x50, 0xc9, 0xd0, 0x2a, 0x5d, 0x03, 0x40 },
+    { 0xa5, 0x34, 0x43, 0x30, 0x29, 0xea, 0xc1, 0x5f, 0x32, 0x2e, 0x34, 0xc0 },
+    { 0xc9, 0x89, 0xd9, 0xc7, 0xc3, 0xd3, 0xb8, 0xc5, 0x5d, 0x75, 0x13, 0x00 },
+    { 0x7b, 0xb3, 0x8b, 0x2f, 0x01, 0x86, 0xd4, 0x66, 0x43, 0xae, 0x96, 0x20 },
+    { 0x26, 0x44, 0xeb, 0xad, 0xeb, 0x44, 0xb9, 0x46, 0x7d, 0x1f, 0x42, 0xc0 },
+    { 0x60, 0x8c, 0xc8, 0x57, 0x59, 0x4b, 0xfb, 0xb5, 0x5d, 0x69, 0x60, 0x00 }
+};
+
+//  CRC-14, polynomial 0x2757, one byte at a time.
+static const uint16_t crcTable[256] = {
+    0x0000, 0x2757, 0x29f9, 0x0eae, 0x34a5, 0x13f2, 0x1d5c, 0x3a0b,
+    0x0e1d, 0x294a, 0x27e4, 0x00b3, 0x3ab8, 0x1def, 0x1341, 0x3416,
+    0x1c3a, 0x3b6d, 0x35c3, 0x1294, 0x289f, 0x0fc8, 0x0166, 0x2631,
+    0x1227, 0x3570, 0x3bde, 0x1c89, 0x2682, 0x01d5, 0x0f7b, 0x282c,
+    0x3874, 0x1f23, 0x118d, 0x36da, 0x0cd1, 0x2b86, 0x2528, 0x027f,
+    0x3669, 0x113e, 0x1f90, 0x38c7, 0x02cc, 0x259b, 0x2b35, 0x0c62,
+    0x244e, 0x0319, 0x0db7, 0x2ae0, 0x10eb, 0x37bc, 0x3912, 0x1e45,
+    0x2a53, 0x0d04, 0x03aa, 0x24fd, 0x1ef6, 0x39a1, 0x370f, 0x1058,
+    0x17bf, 0x30e8, 0x3e46, 0x1911, 0x231a, 0x044d, 0x0ae3, 0x2db4,
+    0x19a2, 0x3ef5, 0x305b, 0x170c, 0x2d07, 0x0a50, 0x04fe, 0x23a9,
+    0x0b85, 0x2cd2, 0x227c, 0x052b, 0x3f20, 0x1877, 0x16d9, 0x318e,
+    0x0598, 0x22cf, 0x2c61, 0x0b36, 0x313d, 0x166a, 0x18c4, 0x3f93,
+    0x2fcb, 0x089c, 0x0632, 0x2165, 0x1b6e, 0x3c39, 0x3297, 0x15c0,
+    0x21d6, 0x0681, 0x082f, 0x2f78, 0x1573, 0x3224, 0x3c8a, 0x1bdd,
+    0x33f1, 0x14a6, 0x1a08, 0x3d5f, 0x0754, 0x2003, 0x2ead, 0x09fa,
+    0x3dec, 0x1abb, 0x1415, 0x3342, 0x0949, 0x2e1e, 0x20b0, 0x07e7,
+    0x2f7e, 0x0829, 0x0687, 0x21d0, 0x1bdb, 0x3c8c, 0x3222, 0x1575,
+    0x2163, 0x0634, 0x089a, 0x2fcd, 0x15c6, 0x3291, 0x3c3f, 0x1b68,
+    0x3344, 0x1413, 0x1abd, 0x3dea, 0x07e1, 0x20b6, 0x2e18, 0x094f,
+    0x3d59, 0x1a0e, 0x14a0, 0x33f7, 0x09fc, 0x2eab, 0x2005, 0x0752,
+    0x170a, 0x305d, 0x3ef3, 0x19a4, 0x23af, 0x04f8, 0x0a56, 0x2d01,
+    0x1917, 0x3e40, 0x30ee, 0x17b9, 0x2db2, 0x0ae5, 0x044b, 0x231c,
+    0x0b30, 0x2c67, 0x22c9, 0x059e, 0x3f95, 0x18c2, 0x166c, 0x313b,
+    0x052d, 0x227a, 0x2cd4, 0x0b83, 0x3188, 0x16df, 0x1871, 0x3f26,
+    0x38c1, 0x1f96, 0x1138, 0x366f, 0x0c64, 0x2b33, 0x259d, 0x02ca,
+    0x36dc, 0x118b, 0x1f25, 0x3872, 0x0279, 0x252e, 0x2b80, 0x0cd7,
+    0x24fb, 0x03ac, 0x0d02, 0x2a55, 0x105e, 0x3709, 0x39a7, 0x1ef0,
+    0x2ae6, 0x0db1, 0x031f, 0x2448, 0x1e43, 0x3914, 0x37ba, 0x10ed,
+    0x00b5, 0x27e2, 0x294c, 0x0e1b, 0x3410, 0x1347, 0x1de9, 0x3abe,
+    0x0ea8, 0x29ff, 0x2751, 0x0006, 0x3a0d, 0x1d5a, 0x13f4, 0x34a3,
+    0x1c8f, 0x3bd8, 0x3576, 0x1221, 0x282a, 0x0f7d, 0x01d3, 0x2684,
+    0x1292, 0x35c5, 0x3b6b, 0x1c3c, 0x2637, 0x0160, 0x0fce, 0x2899
+};
+
+static const char textChars[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ+-./?";
+
+
+//  Packs message into FT8_PAYLOAD_BYTES bytes (77 bits, MSB first, last 3 bits 0).  Returns 0 on success, -1 if it can't be sent.
+int ft8_pack( const char *message, unsigned char *payload ) {
+    char words[4][16];
+    int numWords = 0, len = 0;
+    const char *cc;
+
+    if (strlen(message) > FT8_MAX_MESSAGE) {
+        return -1;
+    }
+    for (cc = message; ; cc++) {            // split into upper case words
+        if ((*cc == ' ') || (*cc == 0)) {
+            if (len > 0) {
+                words[numWords++][len] = 0;
+                len = 0;
+            }
+            if (*cc == 0) { break; }
+            continue;
+        }
+        if ((numWords == 4) || (len == 15)) {
+            numWords = 5;                   // too many or too long for a standard message
+            break;
+        }
+        words[numWords][len++] = toupper((unsigned char)*cc);
+    }
+
+    if ((numWords <= 4) && (packStandard( words, numWords, payload ) == 0)) {
+        return 0;
+    }
+    return packFreeText( message, payload );
+}
+
+
+//  Fills tones[] (FT8_NUM_SYMBOLS long, 0-7) for message.  Returns 0 or -1 if the message can't be packed.
+int ft8_encode( const char *message, unsigned char *tones ) {
+    unsigned char payload[FT8_PAYLOAD_BYTES];
+
+    if (ft8_pack( message, payload )) {
+        return -1;
+    }
+    return ft8_encodePayload( payload, tones );
+}
+
+
+int ft8_encodePayload( const unsigned char *payload, unsigned char *tones ) {
+    unsigned char a91[LDPC_K_BYTES];
+    unsigned char codeword[LDPC_N];
+    uint16_t crc;
+    int iii, jjj, kkk;
+
+    //  payload + CRC.
+    memset( a91, 0, sizeof(a91) );
+    memcpy( a91, payload, FT8_PAYLOAD_BYTES );
+    a91[9] &= 0xF8;
+    crc = ft8_crc( a91 );
+    a91[9] |= (crc >> 11) & 0x07;
+    a91[10] = (crc >> 3) & 0xFF;
+    a91[11] = (crc << 5) & 0xE0;
+
+    for (iii = 0; iii < LDPC_K; iii++) {
+        codeword[iii] = (a91[iii/8] >> (7 - iii%8)) & 1;
+    }
+    for (iii = 0; iii < LDPC_M; iii++) {
+        unsigned char sum = 0;
+        for (jjj = 0; jjj < LDPC_K_BYTES; jjj++) {
+            sum ^= ldpcGenerator[iii][jjj] & a91[jjj];
+        }
+        sum ^= sum >> 4;                    // parity of the byte
+        sum ^= sum >> 2;
+        sum ^= sum >> 1;
+        codeword[LDPC_K + iii] = sum & 1;
+    }
+
+    kkk = 0;
+    for (iii = 0; iii < FT8_NUM_SYMBOLS; iii++) {
+        if ((iii < 7) || ((iii >= 36) && (iii < 43)) || (iii >= 72)) {
+            tones[iii] = ft8_costas[iii % 36 % 7];      // 0-6, 36-42, 72-78
+        } else {
+            tones[iii] = ft8_grayMap[ (codeword[kkk] << 2) | (codeword[kkk+1] << 1) | codeword[kkk+2] ];
+            kkk += 3;
+        }
+    }
+    return 0;
+}
+
+
+//  The reverse of ft8_pack().  message must hold FT8_MAX_MESSAGE+1.  Returns 0, or -1 for message types ft8_pack() can't make (telemetry,
+//      contest exchanges, nonstandard callsigns) and nonsense.  i3 = 2 is the same as i3 = 1 with /P instead of /R.
+int ft8_unpack( const unsigned char *payload, char *message ) {
+    char call1[16], call2[16];
+    int pos = 74;
+    int i3 = readBits( payload, &pos, 3 );
+
+    message[0] = 0;
+    if (i3 == 0) {
+        uint32_t limb[3];
+        char text[14];
+
+        pos = 71;
+        if (readBits( payload, &pos, 3 ) != 0) {
+            return -1;                      // n3 other than free text
+        }
+        pos = 0;
+        limb[0] = readBits( payload, &pos, 7 );
+        limb[1] = readBits( payload, &pos, 32 );
+        limb[2] = readBits( payload, &pos, 32 );
+        for (int iii = 12; iii >= 0; iii--) {       // limb /= 42, the remainder is the last character
+            uint64_t rem = 0;
+            for (int jjj = 0; jjj < 3; jjj++) {
+                uint64_t value = (rem << 32) | limb[jjj];
+                limb[jjj] = (uint32_t)(value/42);
+                rem = value % 42;
+            }
+            text[iii] = textChars[rem];
+        }
+        text[13] = 0;
+        if (limb[0] | limb[1] | limb[2]) {
+            return -1;                      // more than 42^13
+        }
+        for (int iii = 12; (iii >= 0) && (text[iii] == ' '); iii--) { text[iii] = 0; }
+        strcpy( message, &text[strspn( text, " " )] );
+        return 0;
+    }
+
+    if ((i3 == 1) || (i3 == 2)) {
+        const char *suffix = (i3 == 1) ? "/R" : "/P";
+        uint32_t n28a, n28b, g15;
+        int r1a, r1b, ir;
+
+        pos = 0;
+        n28a = readBits( payload, &pos, 28 );
+        r1a = readBits( payload, &pos, 1 );
+        n28b = readBits( payload, &pos, 28 );
+        r1b = readBits( payload, &pos, 1 );
+        ir = readBits( payload, &pos, 1 );
+        g15 = readBits( payload, &pos, 15 );
+        if (unpack28( n28a, call1 ) || unpack28( n28b, call2 ) || (n28b < NTOKENS)) {
+            return -1;
+        }
+        if (r1a && (n28a >= NTOKENS)) { strcat( call1, suffix ); }
+        if (r1b) { strcat( call2, suffix ); }
+        sprintf( message, "%s %s", call1, call2 );
+
+        if (g15 < MAXGRID4) {
+            sprintf( &message[strlen(message)], " %s%c%c%d%d", ir ? "R " : "", 'A' + g15/1800, 'A' + (g15/100) % 18, (g15/10) % 10, g15 % 10 );
+        } else {
+            int report = g15 - MAXGRID4;
+            if (report == 2) {
+                strcat( message, " RRR" );
+            } else if (report == 3) {
+                strcat( message, " RR73" );
+            } else if (report == 4) {
+                strcat( message, " 73" );
+            } else if (report >= 5) {
+                report -= 35;
+                if (report > 50) {
+                    report -= 101;
+                }
+                sprintf( &message[strlen(message)], " %s%+03d", ir ? "R" : "", report );
+            }
+        }
+        return 0;
+    }
+    return -1;
+}
+
+
+//  CRC-14 of the 77 bit payload (followed by 5 zero bits, which is how FT8 defines it).
+int ft8_crc( const unsigned char *payload ) {
+    unsigned char buf[11];
+
+    memcpy( buf, payload, FT8_PAYLOAD_BYTES );
+    buf[9] &= 0xF8;
+    buf[10] = 0;
+    return crc14( buf, 82 );
+}
+
+
+//  Writes the FT8 signal for tones[] to samples[].  toneHz is the frequency of tone 0.  The signal fills FT8_NUM_SYMBOLS symbols of
+//      sampleRate/6.25 samples.  Returns the number of samples written or -1 if the rate is not a multiple of 25 or numSamples is too short.
+int ft8_synthesize( const unsigned char *tones, double toneHz, int sampleRate, short *samples, int numSamples ) {
+    int samplesPerSymbol = sampleRate*FT8_SYMBOL_PERIOD_MS/1000;
+    int total = FT8_NUM_SYMBOLS*samplesPerSymbol;
+    int ramp = samplesPerSymbol/8;
+    double carrier = 2.0*M_PI*toneHz/sampleRate;
+    double peak = 2.0*M_PI/samplesPerSymbol;          // one tone spacing (modulation index 1)
+    double phase = 0.0;
+    const double *pulse;
+
+    if ((sampleRate % 25) || (numSamples < total)) {
+        return -1;
+    }
+    pulse = gfskPulse( samplesPerSymbol );
+    if (pulse == (const double *)NULL) {
+        return -1;
+    }
+
+    //  The frequency at sample kkk is the sum of the Gaussian pulses (three symbols long) of the symbols around it.  The first and last
+    //      tones are extended by one symbol so the ends are smoothed the same as the middle.
+    for (int kkk = 0; kkk < total; kkk++) {
+        int mmm = kkk + samplesPerSymbol;       // the pulse of symbol sym covers mmm from sym to sym+3 symbols
+        int last = mmm/samplesPerSymbol;
+        double dphi = carrier;
+        double value;
+
+        for (int sym = last - 2; sym <= last; sym++) {
+            int tone;
+            if (sym < -1) { continue; }
+            if (sym > FT8_NUM_SYMBOLS) { break; }
+            tone = tones[ (sym < 0) ? 0 : ((sym >= FT8_NUM_SYMBOLS) ? FT8_NUM_SYMBOLS-1 : sym) ];
+            dphi += peak*tone*pulse[ mmm - sym*samplesPerSymbol ];
+        }
+
+        value = AMPLITUDE*sin( phase );
+        if (kkk < ramp) {
+            value *= (1.0 - cos( M_PI*kkk/ramp ))/2.0;
+        } else if (kkk >= total - ramp) {
+            value *= (1.0 + cos( M_PI*(kkk - (total - ramp))/ramp ))/2.0;
+        }
+        samples[kkk] = (short)lround( value );
+        phase = fmod( phase + dphi, 2.0*M_PI );
+    }
+    return total;
+}
+
+
+//  Encodes message and synthesizes it at FT8_SAMPLE_RATE into a malloc()ed buffer of FT8_NUM_SAMPLES (caller frees).
+//      Returns NULL if the message can't be sent.
+short *ft8_generate( const char *message, double toneHz, int *numSamples ) {
+    unsigned char tones[FT8_NUM_SYMBOLS];
+    short *samples;
+
+    *numSamples = 0;
+    if (ft8_encode( message, tones )) {
+        printf("ft8_generate() - can't encode \"%s\"\n",message);
+        return (short *)NULL;
+    }
+    samples = (short *)malloc( FT8_NUM_SAMPLES*sizeof(short) );
+    if (samples == (short *)NULL) {
+        return (short *)NULL;
+    }
+    *numSamples = ft8_synthesize( tones, toneHz, FT8_SAMPLE_RATE, samples, FT8_NUM_SAMPLES );
+    return samples;
+}
+
+
+//  i3 = 1: c28 r1 c28 r1 R1 g15 i3.  Returns -1 if the words don't make a standard message.
+static int packStandard( char words[][16], int numWords, unsigned char *payload ) {
+    int32_t n28a, n28b;
+    int next = 1, ir = 0, g15;
+    int pos = 0;
+
+    if (numWords < 2) {
+        return -1;
+    }
+    if (!strcmp(words[0], "CQ") && (numWords >= 3) && ((n28a = packCQModifier( words[1] )) >= 0)) {
+        next = 2;                           // "CQ DX NQ6B DM12"
+    } else {
+        n28a = pack28( words[0] );
+    }
+    if ((n28a < 0) || (next >= numWords)) {
+        return -1;
+    }
+    n28b = pack28( words[next++] );
+    if ((n28b < 0) || (n28b < NTOKENS)) {   // the second call must be a real callsign
+        return -1;
+    }
+    if (next == numWords) {
+        g15 = MAXGRID4 + 1;                 // no grid or report
+    } else if (next == numWords-1) {
+        g15 = packGrid( words[next], &ir );
+        if (g15 < 0) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+
+    memset( payload, 0, FT8_PAYLOAD_BYTES );
+    writeBits( payload, &pos, n28a, 28 );
+    writeBits( payload, &pos, 0, 1 );       // no /R
+    writeBits( payload, &pos, n28b, 28 );
+    writeBits( payload, &pos, 0, 1 );
+    writeBits( payload, &pos, ir, 1 );
+    writeBits( payload, &pos, g15, 15 );
+    writeBits( payload, &pos, 1, 3 );       // i3
+    return 0;
+}
+
+
+//  i3 = 0, n3 = 0: 13 characters as a base 42 number in 71 bits.  Shorter messages are padded with spaces on the right.
+static int packFreeText( const char *message, unsigned char *payload ) {
+    uint32_t limb[3] = { 0, 0, 0 };         // 96 bit number, limb[0] is the most significant
+    const char *cc;
+    int len, pos = 0;
+
+    while (*message == ' ') { message++; }
+    len = strlen(message);
+    while ((len > 0) && (message[len-1] == ' ')) { len--; }
+    if (len > 13) {
+        return -1;
+    }
+    for (int iii = 0; iii < 13; iii++) {
+        uint64_t carry = 0;
+        int value = 0;
+        if (iii < len) {
+            cc = strchr( textChars, toupper((unsigned char)message[iii]) );
+            if ((cc == (const char *)NULL) || (message[iii] == 0)) {
+                return -1;
+            }
+            value = cc - textChars;
+        }
+        carry = value;
+        for (int jjj = 2; jjj >= 0; jjj--) {        // limb = limb*42 + value
+            uint64_t product = (uint64_t)limb[jjj]*42 + carry;
+            limb[jjj] = (uint32_t)product;
+            carry = product >> 32;
+        }
+    }
+
+    memset( payload, 0, FT8_PAYLOAD_BYTES );
+    writeBits( payload, &pos, limb[0], 7 );         // 42^13 < 2^71
+    writeBits( payload, &pos, limb[1], 32 );
+    writeBits( payload, &pos, limb[2], 32 );
+    writeBits( payload, &pos, 0, 6 );               // n3 = 0, i3 = 0
+    return 0;
+}
+
+
+//  28 bit callsign field.  DE, QRZ and CQ are tokens.  Standard callsigns are 1-2 characters, a digit and 1-3 letters, same as WSPR.
+static int32_t pack28( const char *word ) {
+    static const char *firstChars = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char call[7];
+    int len = strlen(word);
+    int32_t nnn;
+
+    if (!strcmp(word, "DE"))  { return 0; }
+    if (!strcmp(word, "QRZ")) { return 1; }
+    if (!strcmp(word, "CQ"))  { return 2; }
+
+    if ((len < 3) || (len > 6)) {
+        return -1;
+    }
+    memset( call, ' ', 6 );
+    call[6] = 0;
+    if (isdigit((unsigned char)word[2])) {
+        memcpy( call, word, len );
+    } else if (isdigit((unsigned char)word[1]) && (len <= 5)) {
+        memcpy( &call[1], word, len );      // "K1ABC" -> " K1ABC"
+    } else {
+        return -1;
+    }
+    if ((strchr( firstChars, call[0] ) == (char *)NULL) || !isalnum((unsigned char)call[1]) || !isdigit((unsigned char)call[2])) {
+        return -1;
+    }
+    for (int iii = 3; iii < 6; iii++) {
+        if ((call[iii] != ' ') && !isupper((unsigned char)call[iii])) { return -1; }
+        if ((call[iii] == ' ') && (iii < 5) && (call[iii+1] != ' ')) { return -1; }
+    }
+
+    nnn = strchr( firstChars, call[0] ) - firstChars;
+    nnn = nnn*36 + (isdigit((unsigned char)call[1]) ? call[1] - '0' : call[1] - 'A' + 10);
+    nnn = nnn*10 + (call[2] - '0');
+    for (int iii = 3; iii < 6; iii++) {
+        nnn = nnn*27 + ((call[iii] == ' ') ? 0 : call[iii] - 'A' + 1);
+    }
+    return NTOKENS + MAX22 + nnn;
+}
+
+
+//  "CQ nnn" (3 digits) or "CQ ABCD" (1-4 letters).  Returns -1 if word is neither.
+static int32_t packCQModifier( const char *word ) {
+    int len = strlen(word);
+    int32_t mmm = 0;
+
+    if ((len == 3) && isdigit((unsigned char)word[0]) && isdigit((unsigned char)word[1]) && isdigit((unsigned char)word[2])) {
+        return 3 + atoi(word);
+    }
+    if ((len < 1) || (len > 4)) {
+        return -1;
+    }
+    for (int iii = 0; iii < len; iii++) {
+        if (!isupper((unsigned char)word[iii])) { return -1; }
+        mmm = mmm*27 + (word[iii] - 'A' + 1);   // right justified in 4 characters, leading spaces are 0
+    }
+    return 3 + 1000 + mmm;
+}
+
+
+//  15 bit grid field.  A 4 character grid, a report (-50 to +49) with or without a leading R (sets *ir), RRR, RR73 or 73.
+static int packGrid( const char *word, int *ir ) {
+    int report;
+
+    *ir = 0;
+    if (!strcmp(word, "RRR"))  { return MAXGRID4 + 2; }
+    if (!strcmp(word, "RR73")) { return MAXGRID4 + 3; }
+    if (!strcmp(word, "73"))   { return MAXGRID4 + 4; }
+    if ((strlen(word) == 4) && (word[0] >= 'A') && (word[0] <= 'R') && (word[1] >= 'A') && (word[1] <= 'R') &&
+        isdigit((unsigned char)word[2]) && isdigit((unsigned char)word[3])) {
+        return ((word[0] - 'A')*18 + (word[1] - 'A'))*100 + (word[2] - '0')*10 + (word[3] - '0');
+    }
+    if (word[0] == 'R') {
+        *ir = 1;
+        word++;
+    }
+    if (((word[0] != '+') && (word[0] != '-')) || !isdigit((unsigned char)word[1]) || ((word[2] != 0) && (!isdigit((unsigned char)word[2]) || (word[3] != 0)))) {
+        return -1;
+    }
+    report = atoi(word);
+    if ((report < -50) || (report > 49)) {
+        return -1;
+    }
+    if (report <= -31) {
+        report += 101;
+    }
+    return MAXGRID4 + 35 + report;
+}
+
+
+//  28 bit callsign field back to text.  Returns -1 if it's not a valid value.
+static int unpack28( uint32_t n28, char *call ) {
+    static const char *firstChars = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char buf[8];
+    uint32_t nnn;
+
+    if (n28 < NTOKENS) {
+        if (n28 == 0) { strcpy( call, "DE" ); return 0; }
+        if (n28 == 1) { strcpy( call, "QRZ" ); return 0; }
+        if (n28 == 2) { strcpy( call, "CQ" ); return 0; }
+        if (n28 < 1003) { sprintf( call, "CQ %03d", n28 - 3 ); return 0; }
+        nnn = n28 - 1003;
+        if (nnn >= 27*27*27*27) {
+            return -1;
+        }
+        strcpy( call, "CQ " );
+        for (int iii = 3; iii >= 0; iii--) {
+            buf[iii] = (nnn % 27) ? 'A' + nnn % 27 - 1 : ' ';
+            nnn /= 27;
+        }
+        buf[4] = 0;
+        strcat( call, &buf[strspn( buf, " " )] );
+        return 0;
+    }
+    if (n28 < NTOKENS + MAX22) {
+        strcpy( call, "<...>" );            // hashed, we don't keep a table of calls heard
+        return 0;
+    }
+    nnn = n28 - NTOKENS - MAX22;
+    if (nnn >= 37*36*10*27*27*27) {
+        return -1;
+    }
+    for (int iii = 5; iii >= 3; iii--) {
+        buf[iii] = (nnn % 27) ? 'A' + nnn % 27 - 1 : ' ';
+        nnn /= 27;
+    }
+    buf[2] = '0' + nnn % 10;
+    nnn /= 10;
+    buf[1] = (nnn % 36 < 10) ? '0' + nnn % 36 : 'A' + nnn % 36 - 10;
+    buf[0] = firstChars[ nnn/36 ];
+    buf[6] = 0;
+    for (int iii = 5; (iii >= 3) && (buf[iii] == ' '); iii--) { buf[iii] = 0; }
+    if (strchr( &buf[3], ' ' ) != (char *)NULL) {
+        return -1;
+    }
+    strcpy( call, &buf[ (buf[0] == ' ') ? 1 : 0 ] );
+    return 0;
+}
+
+
+//  Appends the low numBits of value to buf, MSB first, starting at bit *pos.
+static void writeBits( unsigned char *buf, int *pos, uint32_t value, int numBits ) {
+    for (int iii = numBits-1; iii >= 0; iii--) {
+        if ((value >> iii) & 1) {
+            buf[*pos/8] |= 0x80 >> (*pos % 8);
+        }
+        (*pos)++;
+    }
+}
+
+
+//  Reads numBits from buf, MSB first, starting at bit *pos.
+static uint32_t readBits( const unsigned char *buf, int *pos, int numBits ) {
+    uint32_t value = 0;
+    for (int iii = 0; iii < numBits; iii++) {
+        value = (value << 1) | ((buf[*pos/8] >> (7 - *pos % 8)) & 1);
+        (*pos)++;
+    }
+    return value;
+}
+
+
+//  CRC of the first numBits of bytes (MSB first).
+static uint16_t crc14( const unsigned char *bytes, int numBits ) {
+    uint16_t reg = 0;
+    int iii;
+
+    for (iii = 0; iii < numBits/8; iii++) {
+        reg = ((reg << 8) & 0x3FFF) ^ crcTable[ ((reg >> 6) ^ bytes[iii]) & 0xFF ];
+    }
+    for (int bit = 0; bit < numBits%8; bit++) {
+        int top = (reg >> 13) & 1;
+        reg = (reg << 1) & 0x3FFF;
+        if (top ^ ((bytes[iii] >> (7 - bit)) & 1)) {
+            reg ^= 0x2757;
+        }
+    }
+    return reg;
+}
+
+
+//  The frequency pulse for one symbol, 3 symbols long.  It only depends on the sample rate, so it is worked out once and kept.
+static const double *gfskPulse( int samplesPerSymbol ) {
+    static double *pulse = (double *)NULL;
+    static int pulseSamples = 0;
+    double ccc = M_PI*sqrt( 2.0/log( 2.0 ) );
+
+    if (pulseSamples == samplesPerSymbol) {
+        return pulse;
+    }
+    free( pulse );
+    pulse = (double *)malloc( 3*samplesPerSymbol*sizeof(double) );
+    if (pulse == (double *)NULL) {
+        pulseSamples = 0;
+        return (double *)NULL;
+    }
+    for (int iii = 0; iii < 3*samplesPerSymbol; iii++) {
+        double ttt = (iii - 1.5*samplesPerSymbol)/samplesPerSymbol;
+        pulse[iii] = 0.5*(erf( ccc*GFSK_BT*(ttt + 0.5) ) - erf( ccc*GFSK_BT*(ttt - 0.5) ));
+    }
+    pulseSamples = samplesPerSymbol;
+    return pulse;
+}
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+//  The old wav files were made by WSJT-X at 44.1 kHz.  The 2040Hz one is really 2042 Hz.
+#define GOLDEN_RATE         44100
+#define GOLDEN_SPS          (GOLDEN_RATE*FT8_SYMBOL_PERIOD_MS/1000)
+#define GOLDEN_MESSAGE      "TST NQ6B DM12"
+#define GOLDEN_PAYLOAD      "01100100010011110111100001001110110111001001011100111011001000101000011000000"
+#define GOLDEN_EDGE         400         // skip this many samples at each end of a symbol, that's where the Gaussian smoothing is
+
+#include <time.h>
+
+static const struct { const char *file; double toneHz; } goldenFiles[] = {
+    { "TST_NQ6B_DM12_900Hz.wav", 900.0 }, { "TST_NQ6B_DM12_1400Hz.wav", 1400.0 }, { "TST_NQ6B_DM12_2040Hz.wav", 2040.0 } };
+
+static double tonePower( const short *samples, double freq ) {
+    double re = 0.0, im = 0.0;
+    for (int nnn = GOLDEN_EDGE; nnn < GOLDEN_SPS-GOLDEN_EDGE; nnn++) {
+        double phase = 2.0*M_PI*freq*nnn/GOLDEN_RATE;
+        re += samples[nnn]*cos(phase);
+        im -= samples[nnn]*sin(phase);
+    }
+    return re*re + im*im;
+}
+
+//  Sum of the Costas tone powers for a signal starting at start with tone 0 at freq.
+static double costasPower( const short *samples, int start, double freq ) {
+    double sum = 0.0;
+    for (int iii = 0; iii < 3; iii++) {
+        for (int jjj = 0; jjj < 7; jjj++) {
+            sum += tonePower( &samples[ start + (36*iii + jjj)*GOLDEN_SPS ], freq + ft8_costas[jjj]*FT8_TONE_SPACING );
+        }
+    }
+    return sum;
+}
+
+static double elapsed( const struct timespec *t0 ) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec)/1e9;
+}
+
+int main() {
+    unsigned char payload[FT8_PAYLOAD_BYTES];
+    unsigned char tones[FT8_NUM_SYMBOLS];
+    int errors = 0;
+    struct timespec t0;
+
+    if (ft8_pack( GOLDEN_MESSAGE, payload )) { printf("Pack failed\n"); return 1; }
+    for (int iii = 0; iii < FT8_PAYLOAD_BITS; iii++) {
+        if (((payload[iii/8] >> (7 - iii%8)) & 1) != (GOLDEN_PAYLOAD[iii] - '0')) { printf("Payload bit %d wrong\n",iii); errors++; break; }
+    }
+    ft8_encode( GOLDEN_MESSAGE, tones );
+
+    const char *standard[] = { "CQ NQ6B DM12", "CQ DX NQ6B DM12", "CQ 123 NQ6B DM12", "K1ABC NQ6B -12", "NQ6B K1ABC R-07",
+                               "K1ABC NQ6B RR73", "K1ABC NQ6B 73", "QRZ NQ6B", "K1ABC NQ6B RRR" };
+    for (int iii = 0; iii < (int)(sizeof(standard)/sizeof(standard[0])); iii++) {
+        char unpacked[FT8_MAX_MESSAGE+1];
+        if (ft8_pack( standard[iii], payload ) || ((payload[9] & 0x38) != 0x08)) { printf("\"%s\" not a standard message\n",standard[iii]); errors++; }
+        if (ft8_unpack( payload, unpacked ) || strcmp( unpacked, standard[iii] )) { printf("\"%s\" unpacked as \"%s\"\n",standard[iii],unpacked); errors++; }
+    }
+    {
+        char unpacked[FT8_MAX_MESSAGE+1];
+        ft8_pack( GOLDEN_MESSAGE, payload );
+        if (ft8_unpack( payload, unpacked ) || strcmp( unpacked, GOLDEN_MESSAGE )) { printf("Free text unpacked as \"%s\"\n",unpacked); errors++; }
+        if (ft8_crc( payload ) != 839) { printf("CRC %d\n",ft8_crc( payload )); errors++; }
+    }
+    if (ft8_pack( "THIS IS TOO LONG FOR FT8", payload ) == 0) { printf("Long message accepted\n"); errors++; }
+
+    for (int fff = 0; fff < 3; fff++) {
+        FILE *fptr;
+        long fileSize;
+        short *stereo, *golden, *synth;
+        int numFrames, bestStart = 0, bestLag = 0, toneErrors = 0;
+        double bestFreq = 0.0, bestPower = 0.0, bestCorr = 0.0, synthEnergy = 0.0;
+
+        fptr = fopen(goldenFiles[fff].file,"rb");
+        if (fptr == (FILE *)NULL) { printf("Unable to open %s\n",goldenFiles[fff].file); return 1; }
+        fseek(fptr, 0, SEEK_END);
+        fileSize = ftell(fptr);
+        fseek(fptr, 44, SEEK_SET);
+        stereo = (short *)malloc(fileSize);
+        if (fread(stereo, 1, fileSize-44, fptr) != fileSize-44) { printf("Error reading %s\n",goldenFiles[fff].file); return 1; }
+        fclose(fptr);
+        numFrames = (fileSize-44)/4;
+        golden = (short *)calloc(numFrames + 2*GOLDEN_SPS, sizeof(short));
+        for (int nnn = 0; nnn < numFrames; nnn++) { golden[nnn] = stereo[2*nnn]; }
+        free(stereo);
+
+        //  Find the start (coarse then fine) and tone 0 from the Costas arrays.
+        for (int start = 0; start < 2000; start += 50) {
+            for (double freq = goldenFiles[fff].toneHz - 3.0; freq <= goldenFiles[fff].toneHz + 3.0; freq += 0.5) {
+                double power = costasPower( golden, start, freq );
+                if (power > bestPower) { bestPower = power; bestStart = start; bestFreq = freq; }
+            }
+        }
+        for (int start = (bestStart > 50 ? bestStart-50 : 0), end = bestStart+50; start <= end; start++) {
+            double power = costasPower( golden, start, bestFreq );
+            if (power > bestPower) { bestPower = power; bestStart = start; }
+        }
+
+        for (int iii = 0; iii < FT8_NUM_SYMBOLS; iii++) {
+            int best = 0;
+            double power[8];
+            for (int ttt = 0; ttt < 8; ttt++) {
+                power[ttt] = tonePower( &golden[ bestStart + iii*GOLDEN_SPS ], bestFreq + ttt*FT8_TONE_SPACING );
+                if (power[ttt] > power[best]) { best = ttt; }
+            }
+            if (best != tones[iii]) { toneErrors++; }
+        }
+        if (toneErrors) { printf("%s: %d tones differ\n",goldenFiles[fff].file,toneErrors); errors++; }
+
+        //  Synthesize at the same rate and line it up.  Searching a few samples of lag either side also lines up the carrier phase.
+        synth = (short *)malloc(FT8_NUM_SYMBOLS*GOLDEN_SPS*sizeof(short));
+        if (ft8_synthesize( tones, bestFreq, GOLDEN_RATE, synth, FT8_NUM_SYMBOLS*GOLDEN_SPS ) != FT8_NUM_SYMBOLS*GOLDEN_SPS) {
+            printf("Synthesize failed\n"); return 1;
+        }
+        for (int nnn = 0; nnn < FT8_NUM_SYMBOLS*GOLDEN_SPS; nnn++) { synthEnergy += (double)synth[nnn]*synth[nnn]; }
+        for (int lag = -60; lag <= 60; lag++) {
+            double sum = 0.0, energy = 0.0;
+            if (bestStart + lag < 0) { continue; }
+            for (int nnn = 0; nnn < FT8_NUM_SYMBOLS*GOLDEN_SPS; nnn++) {
+                double gg = golden[ bestStart + lag + nnn ];
+                sum += gg*synth[nnn];
+                energy += gg*gg;
+            }
+            if (sum/sqrt(energy*synthEnergy) > bestCorr) { bestCorr = sum/sqrt(energy*synthEnergy); bestLag = lag; }
+        }
+        if (bestCorr < 0.99) { errors++; }
+        printf("%s: tone 0 %.1lf Hz, start %d, %d tones differ, correlation %.5lf (lag %d) - %s\n", goldenFiles[fff].file, bestFreq,
+               bestStart + bestLag, toneErrors, bestCorr, bestLag, ((bestCorr < 0.99) || toneErrors) ? "FAIL" : "PASS");
+        free(golden);
+        free(synth);
+    }
+
+    //  Timing.  One transmission is encoded and synthesized every 15 seconds at most.
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int iii = 0; iii < 10000; iii++) { ft8_encode( GOLDEN_MESSAGE, tones ); }
+    printf("ft8_encode: %.2lf us\n", elapsed(&t0)*1e6/10000);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int iii = 0; iii < 10; iii++) {
+        int numSamples;
+        free( ft8_generate( GOLDEN_MESSAGE, 1400.0, &numSamples ) );
+    }
+    printf("ft8_generate at %d Hz: %.2lf ms\n", FT8_SAMPLE_RATE, elapsed(&t0)*1e3/10);
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
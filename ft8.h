@@ -0,0 +1,25 @@
+#ifndef _FT8_H_
+#define _FT8_H_
+
+#define FT8_SAMPLE_RATE         12000
+#define FT8_NUM_SYMBOLS         79                                          // 7x7 Costas at 0, 36 and 72 plus 58 data symbols
+#define FT8_SYMBOL_PERIOD_MS    160
+#define FT8_SAMPLES_PER_SYMBOL  (FT8_SAMPLE_RATE*FT8_SYMBOL_PERIOD_MS/1000) // 1920
+#define FT8_NUM_SAMPLES         (FT8_NUM_SYMBOLS*FT8_SAMPLES_PER_SYMBOL)    // 151680, 12.64 sec
+#define FT8_TONE_SPACING        6.25                                        // Hz, the tone frequency passed in is tone 0, the lowest
+#define FT8_PAYLOAD_BITS        77
+#define FT8_PAYLOAD_BYTES       10
+#define FT8_MAX_MESSAGE         40
+
+extern const unsigned char ft8_costas[7];
+extern const unsigned char ft8_grayMap[8];
+
+extern int ft8_pack( const char *message, unsigned char *payload );
+extern int ft8_encode( const char *message, unsigned char *tones );
+extern int ft8_encodePayload( const unsigned char *payload, unsigned char *tones );
+extern int ft8_unpack( const unsigned char *payload, char *message );
+extern int ft8_crc( const unsigned char *payload );
+extern int ft8_synthesize( const unsigned char *tones, double toneHz, int sampleRate, short *samples, int numSamples );
+extern short *ft8_generate( const char *message, double toneHz, int *numSamples );
+
+#endif
@@ -18,6 +18,7 @@ int ft847_close( void );
 int ft847_FETMOXOn( void );
 int ft847_FETMOXOff( void );
 int ft847_writeFreqHz( int freq );
+int ft847_dialFreqHz( int freq );
 
 //#define BUFFER_SIZE   64
 
@@ -113,6 +114,13 @@ int ft847_writeFreqHz( int freq ) {
 }
 
 
+//  The FT847 tunes in 10 Hz steps.  This returns the nearest frequency it can be set to.  ft847_writeFreqHz() itself just drops the
+//    units digit, so pass it this value to get rounding instead of truncation.
+int ft847_dialFreqHz( int freq ) {
+  return ((freq + 5) / 10) * 10;
+}
+
+
 int ft847_setUSBMode( void ) {
   unsigned char msg[5] = { 0x01, 0x00, 0x00, 0x00, 0x07 };
   int returnValue = 0;
@@ -0,0 +1,790 @@
+/*
+    ft8decode.c - decodes FT8 from one 15 second slot of receiver audio.  The FT8 side of wsprdecode.c, and the reverse of ft8.c.  The steps
+        are the ones in the FT8 protocol paper (Franke, Somerville, Taylor, QEX 2020) and ft8_lib:
+
+        1. Resample.  Any rate, mono or stereo (the TST_NQ6B_DM12_*.wav files are 44.1 kHz stereo) is mixed to mono and resampled to
+           12800 Hz with resample.c's polyphase filter.  12800 makes a symbol 2048 samples, so the FFTs are powers of 2.
+        2. Waterfall.  4096 point FFTs (two symbols with a Hann window, 3.125 Hz bins, half the tone spacing) every half symbol, in dB.
+        3. Sync.  Every half symbol from -1.3 to +2.3 sec and every bin from 100 to 3100 Hz is scored by how far the three 7x7 Costas
+           arrays stand above the bins and symbols next to them.  The local peaks are the candidates, best first.
+        4. Soft bits.  For each candidate the 58 data symbols' eight tone powers are turned into three log likelihoods each (best tone with
+           the bit set less best tone without, through the Gray map), scaled to a variance of 24.
+        5. LDPC.  Belief propagation (sum-product) on the (174,91) code for up to LDPC_ITERATIONS.  When all 83 parity checks pass the
+           CRC-14 has to match too.
+        6. Unpack (ft8_unpack()) and keep the best of any duplicates.  The SNR comes from the power in the decoded tones.
+
+        Steps 2, 3 and 4-6 are spread over threadpool.c's workers, call threadpool_open() first.  ft8decode_decode() fills in how long each
+        step took.
+
+    To run the test and the benchmark:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o ft8decode ft8decode.c ft8.c fft.c resample.c threadpool.c -lm -pthread
+        - run it from the directory containing the TST_NQ6B_DM12_*.wav files.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "ft8.h"
+#include "fft.h"
+#include "resample.h"
+#include "threadpool.h"
+#include "ft8decode.h"
+
+#define DECODE_RATE         12800
+#define DECODE_SPS          (DECODE_RATE*FT8_SYMBOL_PERIOD_MS/1000)     // 2048
+#define WF_FFT_SIZE         (2*DECODE_SPS)                              // 3.125 Hz bins
+#define WF_STEP             (DECODE_SPS/2)
+#define WF_BINS             (WF_FFT_SIZE/2)                             // 0 to 6400 Hz
+#define WF_BIN_HZ           ((double)DECODE_RATE/WF_FFT_SIZE)
+#define MIN_FREQ_HZ         100.0
+#define MAX_FREQ_HZ         3100.0                                      // tone 0
+#define MIN_LAG             (-10)                                       // half symbols, -1.3 sec
+#define MAX_LAG             18                                          // +2.3 sec
+#define MIN_SYNC            2.5                                         // dB
+#define MAX_CANDIDATES      200
+#define NOMINAL_START_SEC   0.5
+
+#define LDPC_N              174
+#define LDPC_K              91
+#define LDPC_M              83
+#define LDPC_ITERATIONS     30
+#define LLR_VARIANCE        24.0
+#define SNR_OFFSET_DB       (-27.3)     // Hann ENBW (1.5 bins of 3.125 Hz) to 2500 Hz
+#define MAX_SNR_DB          49.0        // a clean recording has no noise to speak of
+
+
+struct Candidate {
+    int lag;            // waterfall column of symbol 0
+    int bin;            // waterfall bin of tone 0
+    double score;
+};
+
+struct DecodeJob {
+    const float *audio;             // DECODE_RATE mono
+    int numSamples;
+    float *waterfall;               // [column][WF_BINS], dB
+    int numColumns;
+    double noise;                   // median power in the band, linear
+    float *scores;                  // [lag - MIN_LAG][bin]
+    struct Candidate *candidates;
+    struct FT8Decode *results;      // one per candidate
+    int *decoded;
+};
+
+int ft8decode_decode( const short *samples, int numFrames, int rate, int channels, struct FT8Decode *decodes, int maxDecodes,
+                      struct FT8DecodeTiming *timing );
+
+static float *resample( const short *samples, int numFrames, int rate, int channels, int *numOut );
+static void waterfallColumns( void *arg, int pair );
+static void syncRow( void *arg, int row );
+static double syncScore( const struct DecodeJob *job, int lag, int bin );
+static int findCandidates( struct DecodeJob *job );
+static double peakOffset( const struct DecodeJob *job, int lag, int bin, int dLag, int dBin );
+static void decodeCandidate( void *arg, int index );
+static int ldpcDecode( const float *llr, unsigned char *plain, int *iterations );
+static void initTables( void );
+static float fastTanh( float xx );
+static float fastAtanh( float xx );
+static double msSince( const struct timespec *t0 );
+static int compareFloat( const void *aaa, const void *bbb );
+
+//  Parity check matrix, the (1 based) codeword bits in each of the 83 checks.  0 is unused, 11 checks have 6 bits, the rest 7.
+static const unsigned char ldpcNm[LDPC_M][7] = {
+    {   4,  31,  59,  91,  92,  96, 153 },
+    {   5,  32,  60,  93, 115, 146,   0 },
+    {   6,  24,  61,  94, 122, 151,   0 },
+    {   7,  33,  62,  95,  96, 143,   0 },
+    {   8,  25,  63,  83,  93,  96, 148 },
+    {   6,  32,  64,  97, 126, 138,   0 },
+    {   5,  34,  65,  78,  98, 107, 154 },
+    {   9,  35,  66,  99, 139, 146,   0 },
+    {  10,  36,  67, 100, 107, 126,   0 },
+    {  11,  37,  67,  87, 101, 139, 158 },
+    {  12,  38,  68, 102, 105, 155,   0 },
+    {  13,  39,  69, 103, 149, 162,   0 },
+    {   8,  40,  70,  82, 104, 114, 145 },
+    {  14,  41,  71,  88, 102, 123, 156 },
+    {  15,  42,  59, 106, 123, 159,   0 },
+    {   1,  33,  72, 106, 107, 157,   0 },
+    {  16,  43,  73, 108, 141, 160,   0 },
+    {  17,  37,  74,  81, 109, 131, 154 },
+    {  11,  44,  75, 110, 121, 166,   0 },
+    {  45,  55,  64, 111, 130, 161, 173 },
+    {   8,  46,  71, 112, 119, 166,   0 },
+    {  18,  36,  76,  89, 113, 114, 143 },
+    {  19,  38,  77, 104, 116, 163,   0 },
+    {  20,  47,  70,  92, 138, 165,   0 },
+    {   2,  48,  74, 113, 128, 160,   0 },
+    {  21,  45,  78,  83, 117, 121, 151 },
+    {  22,  47,  58, 118, 127, 164,   0 },
+    {  16,  39,  62, 112, 134, 158,   0 },
+    {  23,  43,  79, 120, 131, 145,   0 },
+    {  19,  35,  59,  73, 110, 125, 161 },
+    {  20,  36,  63,  94, 136, 161,   0 },
+    {  14,  31,  79,  98, 132, 164,   0 },
+    {   3,  44,  80, 124, 127, 169,   0 },
+    {  19,  46,  81, 117, 135, 167,   0 },
+    {   7,  49,  58,  90, 100, 105, 168 },
+    {  12,  50,  61, 118, 119, 144,   0 },
+    {  13,  51,  64, 114, 118, 157,   0 },
+    {  24,  52,  76, 129, 148, 149,   0 },
+    {  25,  53,  69,  90, 101, 130, 156 },
+    {  20,  46,  65,  80, 120, 140, 170 },
+    {  21,  54,  77, 100, 140, 171,   0 },
+    {  35,  82, 133, 142, 171, 174,   0 },
+    {  14,  30,  83, 113, 125, 170,   0 },
+    {   4,  29,  68, 120, 134, 173,   0 },
+    {   1,   4,  52,  57,  86, 136, 152 },
+    {  26,  51,  56,  91, 122, 137, 168 },
+    {  52,  84, 110, 115, 145, 168,   0 },
+    {   7,  50,  81,  99, 132, 173,   0 },
+    {  23,  55,  67,  95, 172, 174,   0 },
+    {  26,  41,  77, 109, 141, 148,   0 },
+    {   2,  27,  41,  61,  62, 115, 133 },
+    {  27,  40,  56, 124, 125, 126,   0 },
+    {  18,  49,  55, 124, 141, 167,   0 },
+    {   6,  33,  85, 108, 116, 156,   0 },
+    {  28,  48,  70,  85, 105, 129, 158 },
+    {   9,  54,  63, 131, 147, 155,   0 },
+    {  22,  53,  68, 109, 121, 174,   0 },
+    {   3,  13,  48,  78,  95, 123,   0 },
+    {  31,  69, 133, 150, 155, 169,   0 },
+    {  12,  43,  66,  89,  97, 135, 159 },
+    {   5,  39,  75, 102, 136, 167,   0 },
+    {   2,  54,  86, 101, 135, 164,   0 },
+    {  15,  56,  87, 108, 119, 171,   0 },
+    {  10,  44,  82,  91, 111, 144, 149 },
+    {  23,  34,  71,  94, 127, 153,   0 },
+    {  11,  49,  88,  92, 142, 157,   0 },
+    {  29,  34,  87,  97, 147, 162,   0 },
+    {  30,  50,  60,  86, 137, 142, 162 },
+    {  10,  53,  66,  84, 112, 128, 165 },
+    {  22,  57,  85,  93, 140, 159,   0 },
+    {  28,  32,  72, 103, 132, 166,   0 },
+    {  28,  29,  84,  88, 117, 143, 150 },
+    {   1,  26,  45,  80, 128, 147,   0 },
+    {  17,  27,  89, 103, 116, 153,   0 },
+    {  51,  57,  98, 163, 165, 172,   0 },
+    {  21,  37,  73, 138, 152, 169,   0 },
+    {  16,  47,  76, 130, 137, 154,   0 },
+    {   3,  24,  30,  72, 104, 139,   0 },
+    {   9,  40,  90, 106, 134, 151,   0 },
+    {  15,  58,  60,  74, 111, 150, 163 },
+    {  18,  42,  79, 144, 146, 152,   0 },
+    {  25,  38,  65,  99, 122, 160,   0 },
+    {  17,  42,  75, 129, 170, 172,   0 }
+};
+static unsigned char ldpcNumBits[LDPC_M];       // bits in each check
+static unsigned char ldpcMn[LDPC_N][3];         // the 3 checks each bit is in, made from ldpcNm by initTables()
+static float hannWindow[WF_FFT_SIZE];
+static struct FFTPlan *wfPlan = (struct FFTPlan *)NULL;
+
+
+//  Decodes numFrames of audio that start at the top of an FT8 slot.  Fills decodes[] and returns the number found (best sync first) or -1
+//      on error.  timing can be NULL.
+int ft8decode_decode( const short *samples, int numFrames, int rate, int channels, struct FT8Decode *decodes, int maxDecodes,
+                      struct FT8DecodeTiming *timing ) {
+    struct FT8DecodeTiming dummy;
+    struct timespec start, t0;
+    struct DecodeJob job;
+    float *audio, *sorted;
+    int numSamples, numCandidates, numDecodes = 0, binLo, binHi, count = 0;
+
+    if (timing == (struct FT8DecodeTiming *)NULL) {
+        timing = &dummy;
+    }
+    memset( timing, 0, sizeof(struct FT8DecodeTiming) );
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    initTables();
+    if (wfPlan == (struct FFTPlan *)NULL) {
+        return -1;
+    }
+
+    //  1. Resample, at most one slot.
+    if (numFrames > FT8DECODE_SLOT_SECONDS*rate) {
+        numFrames = FT8DECODE_SLOT_SECONDS*rate;
+    }
+    audio = resample( samples, numFrames, rate, channels, &numSamples );
+    if (audio == (float *)NULL) {
+        return -1;
+    }
+    timing->resample = msSince( &start );
+
+    //  2. Waterfall
+    memset( &job, 0, sizeof(job) );
+    job.audio = audio;
+    job.numSamples = numSamples;
+    job.numColumns = (numSamples - WF_FFT_SIZE)/WF_STEP + 1;
+    if (job.numColumns < 2*FT8_NUM_SYMBOLS/3) {
+        printf("ft8decode_decode() - %d samples is too short\n",numFrames);
+        free( audio );
+        return -1;
+    }
+    job.waterfall = (float *)malloc( (long)job.numColumns*WF_BINS*sizeof(float) );
+    job.scores = (float *)malloc( (MAX_LAG - MIN_LAG + 1)*WF_BINS*sizeof(float) );
+    job.candidates = (struct Candidate *)malloc( MAX_CANDIDATES*sizeof(struct Candidate) );
+    job.results = (struct FT8Decode *)malloc( MAX_CANDIDATES*sizeof(struct FT8Decode) );
+    job.decoded = (int *)calloc( MAX_CANDIDATES, sizeof(int) );
+    binLo = (int)(MIN_FREQ_HZ/WF_BIN_HZ);
+    binHi = (int)(MAX_FREQ_HZ/WF_BIN_HZ) + 2*7;
+    sorted = (float *)malloc( (long)job.numColumns*(binHi - binLo + 1)*sizeof(float) );
+    if ((job.waterfall == (float *)NULL) || (job.scores == (float *)NULL) || (job.candidates == (struct Candidate *)NULL) ||
+        (job.results == (struct FT8Decode *)NULL) || (job.decoded == (int *)NULL) || (sorted == (float *)NULL)) {
+        printf("ft8decode_decode() - Error in malloc()\n");
+        numDecodes = -1;
+        goto done;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    threadpool_run( waterfallColumns, &job, (job.numColumns + 1)/2 );
+
+    //  The noise is the median power in the band, most of the waterfall is noise even on a busy band.
+    for (int col = 0; col < job.numColumns; col++) {
+        for (int bin = binLo; bin <= binHi; bin++) {
+            sorted[count++] = job.waterfall[col*WF_BINS + bin];
+        }
+    }
+    qsort( sorted, count, sizeof(float), compareFloat );
+    job.noise = pow( 10.0, sorted[count/2]/10.0 );
+    timing->waterfall = msSince( &t0 );
+
+    //  3. Sync
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    threadpool_run( syncRow, &job, MAX_LAG - MIN_LAG + 1 );
+    numCandidates = findCandidates( &job );
+    timing->sync = msSince( &t0 );
+    timing->numCandidates = numCandidates;
+
+    //  4-6. Soft bits, LDPC, CRC and unpack
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    threadpool_run( decodeCandidate, &job, numCandidates );
+    for (int iii = 0; iii < numCandidates; iii++) {
+        int dup = 0;
+        if (!job.decoded[iii]) {
+            continue;
+        }
+        for (int jjj = 0; jjj < numDecodes; jjj++) {
+            if (!strcmp( decodes[jjj].message, job.results[iii].message )) {
+                dup = 1;
+                break;
+            }
+        }
+        if (!dup && (numDecodes < maxDecodes)) {
+            decodes[numDecodes++] = job.results[iii];
+        }
+    }
+    timing->ldpc = msSince( &t0 );
+    timing->numDecodes = numDecodes;
+
+done:
+    free( audio );
+    free( job.waterfall );
+    free( job.scores );
+    free( job.candidates );
+    free( job.results );
+    free( job.decoded );
+    free( sorted );
+    timing->total = msSince( &start );
+    return numDecodes;
+}
+
+
+//  Mixes the channels and resamples to DECODE_RATE with resample.c.  Returns a malloc()ed buffer (caller frees) or NULL.
+static float *resample( const short *samples, int numFrames, int rate, int channels, int *numOut ) {
+    struct Resampler *rs = resample_create( rate, DECODE_RATE );
+    float *mono, *out;
+
+    if ((channels < 1) || (rs == (struct Resampler *)NULL)) {
+        printf("ft8decode_decode() - can't resample %d Hz, %d channels\n",rate,channels);
+        resample_free( rs );
+        return (float *)NULL;
+    }
+    *numOut = (int)resample_outputFrames( rs, numFrames );
+    mono = (float *)malloc( numFrames*sizeof(float) );
+    out = (float *)malloc( *numOut*sizeof(float) );
+    if ((mono == (float *)NULL) || (out == (float *)NULL)) {
+        printf("ft8decode_decode() - Error in malloc()\n");
+        free( mono );
+        free( out );
+        resample_free( rs );
+        return (float *)NULL;
+    }
+    for (int iii = 0; iii < numFrames; iii++) {
+        int sum = 0;
+        for (int ccc = 0; ccc < channels; ccc++) {
+            sum += samples[iii*channels + ccc];
+        }
+        mono[iii] = sum/(32768.0f*channels);
+    }
+    resample_process( rs, mono, numFrames, out );
+    free( mono );
+    resample_free( rs );
+    return out;
+}
+
+
+//  threadpool_run() callback, columns 2*pair and 2*pair+1 of the waterfall.  The audio is real, so one goes in the real part of the FFT and
+//      the other in the imaginary part, and they are pulled apart afterwards: X1[k] = (Z[k] + Z*[N-k])/2, X2[k] = (Z[k] - Z*[N-k])/2i.
+static void waterfallColumns( void *arg, int pair ) {
+    struct DecodeJob *job = (struct DecodeJob *)arg;
+    int col1 = 2*pair, col2 = 2*pair + 1;
+    const float *audio1 = &job->audio[col1*WF_STEP];
+    const float *audio2 = &job->audio[((col2 < job->numColumns) ? col2 : col1)*WF_STEP];
+    struct Complex *buf = (struct Complex *)malloc( WF_FFT_SIZE*sizeof(struct Complex) );
+
+    if (buf == (struct Complex *)NULL) {
+        for (int bin = 0; bin < WF_BINS; bin++) {
+            job->waterfall[col1*WF_BINS + bin] = -120.0f;
+            if (col2 < job->numColumns) { job->waterfall[col2*WF_BINS + bin] = -120.0f; }
+        }
+        return;
+    }
+    for (int iii = 0; iii < WF_FFT_SIZE; iii++) {
+        buf[iii].re = audio1[iii]*hannWindow[iii];
+        buf[iii].im = audio2[iii]*hannWindow[iii];
+    }
+    fft_forward( wfPlan, buf );
+    for (int bin = 0; bin < WF_BINS; bin++) {
+        const struct Complex *zk = &buf[bin], *zn = &buf[(WF_FFT_SIZE - bin) % WF_FFT_SIZE];
+        double r1 = 0.5*(zk->re + zn->re), i1 = 0.5*(zk->im - zn->im);
+        double r2 = 0.5*(zk->im + zn->im), i2 = 0.5*(zn->re - zk->re);
+        job->waterfall[col1*WF_BINS + bin] = 10.0f*log10f( (float)(r1*r1 + i1*i1) + 1e-12f );
+        if (col2 < job->numColumns) {
+            job->waterfall[col2*WF_BINS + bin] = 10.0f*log10f( (float)(r2*r2 + i2*i2) + 1e-12f );
+        }
+    }
+    free( buf );
+}
+
+
+//  threadpool_run() callback, sync scores for every bin at one lag.
+static void syncRow( void *arg, int row ) {
+    struct DecodeJob *job = (struct DecodeJob *)arg;
+    int binLo = (int)(MIN_FREQ_HZ/WF_BIN_HZ), binHi = (int)(MAX_FREQ_HZ/WF_BIN_HZ);
+
+    for (int bin = 0; bin < WF_BINS; bin++) {
+        job->scores[row*WF_BINS + bin] = ((bin >= binLo) && (bin <= binHi)) ? syncScore( job, row + MIN_LAG, bin ) : 0.0f;
+    }
+}
+
+
+//  Average of how much each Costas tone stands above the tone bins either side of it and the same bin in the symbols before and after.
+static double syncScore( const struct DecodeJob *job, int lag, int bin ) {
+    double score = 0.0;
+    int count = 0;
+
+    for (int block = 0; block < 3; block++) {
+        for (int kkk = 0; kkk < 7; kkk++) {
+            int col = lag + 2*(36*block + kkk);
+            int tbin = bin + 2*ft8_costas[kkk];
+            const float *wf;
+            if ((col < 0) || (col >= job->numColumns)) {
+                continue;
+            }
+            wf = &job->waterfall[col*WF_BINS + tbin];
+            if (ft8_costas[kkk] > 0) { score += wf[0] - wf[-2]; count++; }
+            if (ft8_costas[kkk] < 7) { score += wf[0] - wf[2]; count++; }
+            if ((kkk > 0) && (col >= 2)) { score += wf[0] - wf[-2*WF_BINS]; count++; }
+            if ((kkk < 6) && (col + 2 < job->numColumns)) { score += wf[0] - wf[2*WF_BINS]; count++; }
+        }
+    }
+    return count ? score/count : 0.0;
+}
+
+
+//  Scores that beat their eight neighbours and MIN_SYNC, best first.  Returns how many.
+static int findCandidates( struct DecodeJob *job ) {
+    int rows = MAX_LAG - MIN_LAG + 1;
+    int numCandidates = 0;
+
+    for (int row = 0; row < rows; row++) {
+        for (int bin = 1; bin < WF_BINS - 1; bin++) {
+            float score = job->scores[row*WF_BINS + bin];
+            int peak = (score >= MIN_SYNC);
+            for (int dr = -1; peak && (dr <= 1); dr++) {
+                for (int db = -1; peak && (db <= 1); db++) {
+                    if (((dr == 0) && (db == 0)) || (row + dr < 0) || (row + dr >= rows)) {
+                        continue;
+                    }
+                    float other = job->scores[(row + dr)*WF_BINS + bin + db];
+                    if ((other > score) || ((other == score) && ((dr < 0) || ((dr == 0) && (db < 0))))) {
+                        peak = 0;               // ties go to the first one
+                    }
+                }
+            }
+            if (!peak) {
+                continue;
+            }
+            if (numCandidates < MAX_CANDIDATES) {
+                numCandidates++;
+            } else if (score <= job->candidates[numCandidates-1].score) {
+                continue;
+            }
+            //  insert in order, dropping the weakest if the list is full
+            int iii = numCandidates - 1;
+            while ((iii > 0) && (job->candidates[iii-1].score < score)) {
+                job->candidates[iii] = job->candidates[iii-1];
+                iii--;
+            }
+            job->candidates[iii].lag = row + MIN_LAG;
+            job->candidates[iii].bin = bin;
+            job->candidates[iii].score = score;
+        }
+    }
+    return numCandidates;
+}
+
+
+//  Where the peak of the parabola through the sync scores at (lag, bin) and either side of it (in the direction dLag, dBin) is, -0.5 to 0.5.
+static double peakOffset( const struct DecodeJob *job, int lag, int bin, int dLag, int dBin ) {
+    int row = lag - MIN_LAG;
+    double before, here, after, curve;
+
+    if ((row - dLag < 0) || (row + dLag > MAX_LAG - MIN_LAG)) {
+        return 0.0;
+    }
+    before = job->scores[(row - dLag)*WF_BINS + bin - dBin];
+    here = job->scores[row*WF_BINS + bin];
+    after = job->scores[(row + dLag)*WF_BINS + bin + dBin];
+    curve = before - 2.0*here + after;
+    if (curve >= 0.0) {
+        return 0.0;
+    }
+    curve = 0.5*(before - after)/curve;
+    return (curve > 0.5) ? 0.5 : ((curve < -0.5) ? -0.5 : curve);
+}
+
+
+//  threadpool_run() callback, steps 4 to 6 for candidates[index].
+static void decodeCandidate( void *arg, int index ) {
+    struct DecodeJob *job = (struct DecodeJob *)arg;
+    struct Candidate *cand = &job->candidates[index];
+    struct FT8Decode *result = &job->results[index];
+    unsigned char plain[LDPC_N], payload[FT8_PAYLOAD_BYTES], tones[FT8_NUM_SYMBOLS];
+    float llr[LDPC_N];
+    double sum = 0.0, sumSquares = 0.0, signal = 0.0, scale;
+    int kkk = 0, crc = 0, numSignal = 0, nonZero = 0;
+
+    job->decoded[index] = 0;
+    for (int sym = 0; sym < FT8_NUM_SYMBOLS; sym++) {
+        int col = cand->lag + 2*sym;
+        float s2[8];
+        if ((sym < 7) || ((sym >= 36) && (sym < 43)) || (sym >= 72)) {
+            continue;
+        }
+        if ((col < 0) || (col >= job->numColumns)) {
+            llr[kkk] = llr[kkk+1] = llr[kkk+2] = 0.0f;         // off the end of the recording, no information
+            kkk += 3;
+            continue;
+        }
+        for (int jjj = 0; jjj < 8; jjj++) {
+            s2[jjj] = job->waterfall[col*WF_BINS + cand->bin + 2*ft8_grayMap[jjj]];
+        }
+        llr[kkk++] = fmaxf( fmaxf( s2[4], s2[5] ), fmaxf( s2[6], s2[7] ) ) - fmaxf( fmaxf( s2[0], s2[1] ), fmaxf( s2[2], s2[3] ) );
+        llr[kkk++] = fmaxf( fmaxf( s2[2], s2[3] ), fmaxf( s2[6], s2[7] ) ) - fmaxf( fmaxf( s2[0], s2[1] ), fmaxf( s2[4], s2[5] ) );
+        llr[kkk++] = fmaxf( fmaxf( s2[1], s2[3] ), fmaxf( s2[5], s2[7] ) ) - fmaxf( fmaxf( s2[0], s2[2] ), fmaxf( s2[4], s2[6] ) );
+    }
+    for (int iii = 0; iii < LDPC_N; iii++) {
+        sum += llr[iii];
+        sumSquares += llr[iii]*llr[iii];
+    }
+    if (sumSquares/LDPC_N - (sum/LDPC_N)*(sum/LDPC_N) <= 0.0) {
+        return;
+    }
+    scale = sqrt( LLR_VARIANCE/(sumSquares/LDPC_N - (sum/LDPC_N)*(sum/LDPC_N)) );
+    for (int iii = 0; iii < LDPC_N; iii++) {
+        llr[iii] *= scale;
+    }
+
+    if (ldpcDecode( llr, plain, &result->iterations )) {
+        return;
+    }
+
+    //  The first 91 bits are the payload and CRC.  An all zero payload passes every check, it's not a message.
+    memset( payload, 0, sizeof(payload) );
+    for (int iii = 0; iii < FT8_PAYLOAD_BITS; iii++) {
+        payload[iii/8] |= plain[iii] << (7 - iii%8);
+        nonZero |= plain[iii];
+    }
+    for (int iii = FT8_PAYLOAD_BITS; iii < LDPC_K; iii++) {
+        crc = (crc << 1) | plain[iii];
+    }
+    if (!nonZero || (crc != ft8_crc( payload )) || ft8_unpack( payload, result->message )) {
+        return;
+    }
+
+    //  SNR from the power in the tones actually sent, against the median noise.
+    ft8_encodePayload( payload, tones );
+    for (int sym = 0; sym < FT8_NUM_SYMBOLS; sym++) {
+        int col = cand->lag + 2*sym;
+        if ((col >= 0) && (col < job->numColumns)) {
+            signal += pow( 10.0, job->waterfall[col*WF_BINS + cand->bin + 2*tones[sym]]/10.0 );
+            numSignal++;
+        }
+    }
+    signal = signal/numSignal/job->noise - 1.0;
+    result->snr = 10.0*log10( (signal > 1e-3) ? signal : 1e-3 ) + SNR_OFFSET_DB;
+    if (result->snr > MAX_SNR_DB) {
+        result->snr = MAX_SNR_DB;
+    }
+
+    //  The grid is half a symbol and half a tone, a parabola through the sync scores either side gets closer for the report.
+    result->freqHz = (cand->bin + peakOffset( job, cand->lag, cand->bin, 0, 1 ))*WF_BIN_HZ;
+    result->dt = (cand->lag + 1 + peakOffset( job, cand->lag, cand->bin, 1, 0 ))*WF_STEP/(double)DECODE_RATE - NOMINAL_START_SEC;
+    result->sync = cand->score;
+    job->decoded[index] = 1;
+}
+
+
+//  Sum-product belief propagation.  llr[] is positive for a 1.  Fills plain[] with the codeword and returns 0 once every parity check
+//      passes, -1 if it never does.
+static int ldpcDecode( const float *llr, unsigned char *plain, int *iterations ) {
+    float toCheck[LDPC_M][7];       // bit to check messages, as tanh(-x/2)
+    float toBit[LDPC_N][3];         // check to bit messages, log likelihood
+    float zn;
+
+    memset( toBit, 0, sizeof(toBit) );
+    for (int iter = 0; iter < LDPC_ITERATIONS; iter++) {
+        int errors = 0;
+
+        for (int nnn = 0; nnn < LDPC_N; nnn++) {
+            zn = llr[nnn] + toBit[nnn][0] + toBit[nnn][1] + toBit[nnn][2];
+            plain[nnn] = (zn > 0.0f) ? 1 : 0;
+        }
+        for (int mmm = 0; mmm < LDPC_M; mmm++) {
+            int sum = 0;
+            for (int jjj = 0; jjj < ldpcNumBits[mmm]; jjj++) {
+                sum ^= plain[ ldpcNm[mmm][jjj] - 1 ];
+            }
+            errors += sum;
+        }
+        if (errors == 0) {
+            *iterations = iter;
+            return 0;
+        }
+
+        //  Bits to checks, leaving out what the check itself said.
+        for (int mmm = 0; mmm < LDPC_M; mmm++) {
+            for (int jjj = 0; jjj < ldpcNumBits[mmm]; jjj++) {
+                int nnn = ldpcNm[mmm][jjj] - 1;
+                float tnm = llr[nnn];
+                for (int kkk = 0; kkk < 3; kkk++) {
+                    if (ldpcMn[nnn][kkk] != mmm) {
+                        tnm += toBit[nnn][kkk];
+                    }
+                }
+                toCheck[mmm][jjj] = fastTanh( -tnm/2.0f );
+            }
+        }
+        //  Checks to bits, leaving out what the bit itself said.
+        for (int nnn = 0; nnn < LDPC_N; nnn++) {
+            for (int kkk = 0; kkk < 3; kkk++) {
+                int mmm = ldpcMn[nnn][kkk];
+                float tmn = 1.0f;
+                for (int jjj = 0; jjj < ldpcNumBits[mmm]; jjj++) {
+                    if (ldpcNm[mmm][jjj] - 1 != nnn) {
+                        tmn *= toCheck[mmm][jjj];
+                    }
+                }
+                toBit[nnn][kkk] = -2.0f*fastAtanh( tmn );
+            }
+        }
+    }
+    *iterations = LDPC_ITERATIONS;
+    return -1;
+}
+
+
+//  Bit to check table, Hann window and the waterfall FFT plan, once.  Called from ft8decode_decode() before any threads are given work.
+static void initTables( void ) {
+    static int done = 0;
+    int count[LDPC_N];
+
+    if (done) {
+        return;
+    }
+    memset( count, 0, sizeof(count) );
+    for (int mmm = 0; mmm < LDPC_M; mmm++) {
+        ldpcNumBits[mmm] = 0;
+        for (int jjj = 0; (jjj < 7) && ldpcNm[mmm][jjj]; jjj++) {
+            int nnn = ldpcNm[mmm][jjj] - 1;
+            ldpcMn[nnn][ count[nnn]++ ] = mmm;
+            ldpcNumBits[mmm]++;
+        }
+    }
+    for (int iii = 0; iii < WF_FFT_SIZE; iii++) {
+        hannWindow[iii] = 0.5 - 0.5*cos( 2.0*M_PI*iii/WF_FFT_SIZE );
+    }
+    wfPlan = fft_plan( WF_FFT_SIZE );
+    done = 1;
+}
+
+
+//  Pade approximations, plenty good enough for belief propagation and a lot faster than tanhf()/atanhf().
+static float fastTanh( float xx ) {
+    float x2;
+    if (xx < -4.97f) { return -1.0f; }
+    if (xx > 4.97f) { return 1.0f; }
+    x2 = xx*xx;
+    return xx*(945.0f + x2*(105.0f + x2))/(945.0f + x2*(420.0f + x2*15.0f));
+}
+
+
+static float fastAtanh( float xx ) {
+    float x2 = xx*xx;
+    return xx*(945.0f + x2*(-735.0f + x2*64.0f))/(945.0f + x2*(-1050.0f + x2*225.0f));
+}
+
+
+static double msSince( const struct timespec *t0 ) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec)/1e9)*1e3;
+}
+
+
+static int compareFloat( const void *aaa, const void *bbb ) {
+    float fa = *(const float *)aaa, fb = *(const float *)bbb;
+    return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+}
+
+
+
+//  Test and benchmark.
+//      - The three TST_NQ6B_DM12_*.wav files (44.1 kHz stereo, from WSJT-X) must each decode to "TST NQ6B DM12" once, near their tone.
+//      - A 12 kHz slot made with ft8.c holding eight signals from -4 to -19 dB in Gaussian noise.  Everything down to -16 dB must decode
+//        with the right frequency, DT within 40 ms and SNR within 3 dB, and nothing false may show up.
+//      - Per stage timing, averaged over BENCH_RUNS decodes of that slot.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#define BENCH_RUNS      10
+#define NOISE_SIGMA     1000.0
+
+static const struct { const char *file; double toneHz; } tstFiles[] = {
+    { "TST_NQ6B_DM12_900Hz.wav", 900.0 }, { "TST_NQ6B_DM12_1400Hz.wav", 1400.0 }, { "TST_NQ6B_DM12_2040Hz.wav", 2042.0 } };
+
+static const struct { const char *message; double toneHz; double dt; double snr; } slotSignals[] = {
+    { "CQ NQ6B DM12",     503.1,  0.00,  -4.0 },
+    { "K1ABC NQ6B -12",   811.7,  0.21, -10.0 },
+    { "NQ6B K1ABC R-07", 1102.4, -0.33, -14.0 },
+    { "K1ABC NQ6B RR73", 1357.0,  0.95, -16.0 },
+    { "CQ DX W1AW FN31", 1701.9,  0.40, -18.0 },
+    { "TST NQ6B DM12",   2000.0,  0.10, -12.0 },
+    { "QRZ NQ6B",        2311.3, -0.05,  -8.0 },
+    { "K9XYZ AA1AA 73",  2604.6,  0.62, -19.0 } };
+#define NUM_SLOT_SIGNALS    ((int)(sizeof(slotSignals)/sizeof(slotSignals[0])))
+
+static double gaussian( void ) {
+    double u1 = (rand() + 1.0)/(RAND_MAX + 2.0), u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    return sqrt( -2.0*log( u1 ) )*cos( 2.0*M_PI*u2 );
+}
+
+static void printTiming( const char *what, const struct FT8DecodeTiming *tt ) {
+    printf("%s: resample %.1lf, waterfall %.1lf, sync %.1lf, ldpc %.1lf (%d candidates), total %.1lf ms\n", what, tt->resample, tt->waterfall,
+           tt->sync, tt->ldpc, tt->numCandidates, tt->total);
+}
+
+int main() {
+    struct FT8Decode decodes[FT8DECODE_MAX_DECODES];
+    struct FT8DecodeTiming timing, sum;
+    double *slot;
+    short *samples;
+    int numDecodes, errors = 0, slotSamples = FT8DECODE_SLOT_SECONDS*FT8_SAMPLE_RATE;
+
+    threadpool_open( 0 );
+    printf("%d threads\n", threadpool_numThreads());
+
+    for (int fff = 0; fff < 3; fff++) {
+        FILE *fptr;
+        long fileSize;
+        int found = 0;
+
+        fptr = fopen(tstFiles[fff].file,"rb");
+        if (fptr == (FILE *)NULL) { printf("Unable to open %s\n",tstFiles[fff].file); return 1; }
+        fseek(fptr, 0, SEEK_END);
+        fileSize = ftell(fptr);
+        fseek(fptr, 44, SEEK_SET);
+        samples = (short *)malloc(fileSize);
+        if (fread(samples, 1, fileSize-44, fptr) != fileSize-44) { printf("Error reading %s\n",tstFiles[fff].file); return 1; }
+        fclose(fptr);
+
+        numDecodes = ft8decode_decode( samples, (fileSize-44)/4, 44100, 2, decodes, FT8DECODE_MAX_DECODES, &timing );
+        for (int iii = 0; iii < numDecodes; iii++) {
+            printf("%s: %-20s %7.1lf Hz  snr %+5.1lf  dt %+5.2lf  sync %4.1lf  iterations %d\n", tstFiles[fff].file, decodes[iii].message,
+                   decodes[iii].freqHz, decodes[iii].snr, decodes[iii].dt, decodes[iii].sync, decodes[iii].iterations);
+            if (!strcmp( decodes[iii].message, "TST NQ6B DM12" ) && (fabs( decodes[iii].freqHz - tstFiles[fff].toneHz ) < 3.2)) { found++; }
+        }
+        if ((numDecodes != 1) || (found != 1)) { printf("%s: FAIL\n",tstFiles[fff].file); errors++; }
+        printTiming( tstFiles[fff].file, &timing );
+        free(samples);
+    }
+
+    //  The slot.  Noise power over 6 kHz is NOISE_SIGMA^2, so in 2500 Hz it is NOISE_SIGMA^2*2500/6000.
+    slot = (double *)calloc( slotSamples, sizeof(double) );
+    samples = (short *)malloc( slotSamples*sizeof(short) );
+    srand( 2024 );
+    for (int iii = 0; iii < slotSamples; iii++) { slot[iii] = NOISE_SIGMA*gaussian(); }
+    for (int sss = 0; sss < NUM_SLOT_SIGNALS; sss++) {
+        int numSamples, start = (int)lround( (NOMINAL_START_SEC + slotSignals[sss].dt)*FT8_SAMPLE_RATE );
+        short *signal = ft8_generate( slotSignals[sss].message, slotSignals[sss].toneHz, &numSamples );
+        double amplitude = sqrt( 2.0*NOISE_SIGMA*NOISE_SIGMA*2500.0/6000.0*pow( 10.0, slotSignals[sss].snr/10.0 ) );
+        if (signal == (short *)NULL) { return 1; }
+        for (int iii = 0; (iii < numSamples) && (start + iii < slotSamples); iii++) {
+            slot[start + iii] += amplitude*signal[iii]/21528.0;        // ft8.c's peak
+        }
+        free(signal);
+    }
+    for (int iii = 0; iii < slotSamples; iii++) {
+        samples[iii] = (short)((slot[iii] > 32767.0) ? 32767 : ((slot[iii] < -32768.0) ? -32768 : lround( slot[iii] )));
+    }
+
+    numDecodes = ft8decode_decode( samples, slotSamples, FT8_SAMPLE_RATE, 1, decodes, FT8DECODE_MAX_DECODES, &timing );
+    for (int sss = 0; sss < NUM_SLOT_SIGNALS; sss++) {
+        int found = -1;
+        for (int iii = 0; iii < numDecodes; iii++) {
+            if (!strcmp( decodes[iii].message, slotSignals[sss].message )) { found = iii; }
+        }
+        if (found < 0) {
+            printf("slot: %-20s %7.1lf Hz  snr %+5.1lf  not decoded%s\n", slotSignals[sss].message, slotSignals[sss].toneHz, slotSignals[sss].snr,
+                   (slotSignals[sss].snr >= -16.0) ? " - FAIL" : "");
+            if (slotSignals[sss].snr >= -16.0) { errors++; }
+            continue;
+        }
+        printf("slot: %-20s %7.1lf Hz  snr %+5.1lf  dt %+5.2lf  sync %4.1lf  iterations %2d  (sent %7.1lf Hz, %+5.1lf dB, dt %+5.2lf)\n",
+               decodes[found].message, decodes[found].freqHz, decodes[found].snr, decodes[found].dt, decodes[found].sync,
+               decodes[found].iterations, slotSignals[sss].toneHz, slotSignals[sss].snr, slotSignals[sss].dt);
+        if ((fabs( decodes[found].freqHz - slotSignals[sss].toneHz ) > 3.2) || (fabs( decodes[found].dt - slotSignals[sss].dt ) > 0.04) ||
+            (fabs( decodes[found].snr - slotSignals[sss].snr ) > 3.0)) {
+            printf("        - FAIL\n");
+            errors++;
+        }
+    }
+    for (int iii = 0; iii < numDecodes; iii++) {
+        int known = 0;
+        for (int sss = 0; sss < NUM_SLOT_SIGNALS; sss++) {
+            if (!strcmp( decodes[iii].message, slotSignals[sss].message )) { known = 1; }
+        }
+        if (!known) { printf("slot: false decode \"%s\" - FAIL\n",decodes[iii].message); errors++; }
+    }
+
+    memset( &sum, 0, sizeof(sum) );
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        ft8decode_decode( samples, slotSamples, FT8_SAMPLE_RATE, 1, decodes, FT8DECODE_MAX_DECODES, &timing );
+        sum.resample += timing.resample/BENCH_RUNS;
+        sum.waterfall += timing.waterfall/BENCH_RUNS;
+        sum.sync += timing.sync/BENCH_RUNS;
+        sum.ldpc += timing.ldpc/BENCH_RUNS;
+        sum.total += timing.total/BENCH_RUNS;
+        sum.numCandidates = timing.numCandidates;
+    }
+    printTiming( "12 kHz slot, average", &sum );
+    free(slot);
+    free(samples);
+    threadpool_close();
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
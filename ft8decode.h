@@ -0,0 +1,31 @@
+#ifndef _FT8DECODE_H_
+#define _FT8DECODE_H_
+
+#include "ft8.h"
+
+#define FT8DECODE_MAX_DECODES   64
+#define FT8DECODE_SLOT_SECONDS  15
+
+struct FT8Decode {
+    char message[FT8_MAX_MESSAGE+1];
+    double freqHz;      // audio frequency of tone 0, add the dial frequency for the RF frequency
+    double snr;         // dB in 2500 Hz, same as WSJT-X
+    double dt;          // seconds, 0 is a signal starting 0.5 seconds after the start of the slot
+    double sync;        // Costas score, dB above the tones around it
+    int iterations;     // LDPC iterations it took
+};
+
+struct FT8DecodeTiming {    // milliseconds spent in each stage of the last decode, wall clock
+    double resample;
+    double waterfall;
+    double sync;
+    double ldpc;        // soft bits, LDPC, CRC and unpack for all the candidates, spread over the threads
+    double total;
+    int numCandidates;
+    int numDecodes;
+};
+
+extern int ft8decode_decode( const short *samples, int numFrames, int rate, int channels, struct FT8Decode *decodes, int maxDecodes,
+                             struct FT8DecodeTiming *timing );
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _GEOBATCH_H_
+#define _GEOBATCH_H_
+
+extern void geobatch_geodist( const float *lat1, const float *lon1, const float *lat2, const float *lon2, long count,
+                              float *distKm, float *az, float *baz );
+extern const char *geobatch_simd( void );
+
+#endif
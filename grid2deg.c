@@ -4,7 +4,7 @@
 #include <assert.h>
 #include <math.h>
 
-void grid2deg_( char *grid, double *dlong, double *dlat) {
+void grid2deg_( const char *grid, double *dlong, double *dlat) {
 
     //! Converts Maidenhead grid locator to degrees of West longitude
     //! and North latitude.
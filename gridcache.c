@@ -0,0 +1,371 @@
+/*
+    gridcache.c - the azimuth and distance from the home grid square to a reporter's.  Every spot from wsprnet.org and pskreporter.info
+        went through doOneGrid() -> azdist_(), which converted both grid squares to degrees with grid2deg_() and ran the whole of Thomas'
+        spheroidal geodesic, geodist_(), a dozen trig calls, each time.  The home grid "DM12qu" was written out in both wsprnet.c and
+        pskreporter.c and converted again for every spot, and azdist_() wrote 'm' over a space in the caller's strings.  Most spots come
+        from the same few hundred reporters cycle after cycle, so almost all of that was the same answer again.
+
+        Now the home grid square (the locator line in WSPRConfig, or MY_LOCATOR in twsprRPI.h) is converted once, and each reporter's
+        grid square is worked out the first time it is seen and kept in an open addressing hash table.  The key is the grid square packed
+        into a number (field, square and subsquare), so "DM13", "DM13  ", "dm13MM" and "DM13mm" are all the same entry: the letters may
+        be either case and a 4 character grid square (or spaces for the subsquare) is the middle of the square, which is what azdist_()
+        did with spaces.  The results are rounded the way azdist_() rounded them.  Nothing passed in is written to.
+
+        There is no lock.  Everything, gridcache_setHome() too, is called from the reports thread (reports.c): runJob() sets the home
+        grid square from the ReportJob (the locator line in WSPRConfig), then doCurl() and doCurlFT8() look the reporters up.
+
+    To test and benchmark (cold and warm lookups against azdist_(), over a made up mix of reporters):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o gridcache gridcache.c azdist.c geodist.c grid2deg.c -lm
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "twsprRPI.h"
+#include "gridcache.h"
+
+#define MIN_SLOTS       1024            // hash table size, a power of 2.  Doubled when it gets half full.
+
+extern void grid2deg_( const char *grid, double *dlong, double *dlat );
+extern void geodist_( double *Eplat, double *Eplon, double *Stlat, double *Stlon, double *Az, double *Baz, double *Dist );
+
+struct Slot {
+    uint32_t key;                       // packGrid()'s, 0 is empty
+    struct GridPath path;
+};
+
+int gridcache_setHome( const char *grid );
+int gridcache_lookup( const char *grid, struct GridPath *path );
+void gridcache_clear( void );
+void gridcache_stats( long *hits, long *misses, int *numGrids );
+
+static int packGrid( const char *grid, char *normal, uint32_t *key );
+static int roundHalfUp( double value );
+static unsigned int hashKey( uint32_t key );
+static int growSlots( void );
+
+//  The home grid square, in degrees (West longitude)
+static uint32_t homeKey = 0;            // 0 until it has been set
+static double homeLong = 0.0;
+static double homeLat = 0.0;
+
+//  The reporters' grid squares
+static struct Slot *slots = (struct Slot *)NULL;
+static unsigned int numSlots = 0;
+static int numGrids = 0;
+static long hits = 0;
+static long misses = 0;
+
+
+//  Where the azimuths and distances are measured from.  A different grid square forgets the ones worked out from the last one.
+//      -1 (and the home grid square unchanged) if grid isn't a grid square.
+int gridcache_setHome( const char *grid ) {
+    char normal[8];
+    uint32_t key;
+
+    if (packGrid( grid, normal, &key ) == -1) {
+        printf("Not a grid square: \"%s\"\n",grid);
+        return -1;
+    }
+    if (key != homeKey) {
+        grid2deg_( normal, &homeLong, &homeLat );
+        homeKey = key;
+        gridcache_clear();
+    }
+    return 0;
+}
+
+
+//  The azimuth and distance from the home grid square to grid (4 or 6 characters, more are ignored).  -1 if it isn't a grid square or
+//      there is no memory for it, path is all 0 then.
+int gridcache_lookup( const char *grid, struct GridPath *path ) {
+    char normal[8];
+    uint32_t key;
+    unsigned int iii;
+    double dlong, dlat, Az, Baz, Dkm;
+
+    memset( path, 0, sizeof(struct GridPath) );
+    if ((homeKey == 0) && (gridcache_setHome( MY_LOCATOR ) == -1)) {
+        return -1;
+    }
+    if (packGrid( grid, normal, &key ) == -1) {
+        return -1;
+    }
+    if (numSlots != 0) {
+        for (iii = hashKey( key ) & (numSlots - 1); slots[iii].key != 0; iii = (iii + 1) & (numSlots - 1)) {
+            if (slots[iii].key == key) {
+                hits++;
+                *path = slots[iii].path;
+                return 0;
+            }
+        }
+    }
+
+    //  Not there, work it out.  The home grid square itself is 0 (geodist_() divides by 0 for no distance).
+    misses++;
+    if (key != homeKey) {
+        grid2deg_( normal, &dlong, &dlat );
+        geodist_( &homeLat, &homeLong, &dlat, &dlong, &Az, &Baz, &Dkm );
+        path->azimuth = roundHalfUp( Az );
+        path->miles = roundHalfUp( Dkm/1.609344 );
+        path->km = roundHalfUp( Dkm );
+    }
+
+    if ((2*(numGrids + 1) > (int)numSlots) && (growSlots() == -1)) {
+        return 0;                       // right, just not kept
+    }
+    for (iii = hashKey( key ) & (numSlots - 1); slots[iii].key != 0; iii = (iii + 1) & (numSlots - 1)) {
+    }
+    slots[iii].key = key;
+    slots[iii].path = *path;
+    numGrids++;
+    return 0;
+}
+
+
+//  Forgets the reporters' grid squares (the home grid square is kept), the memory is kept.
+void gridcache_clear( void ) {
+    if (slots != (struct Slot *)NULL) {
+        memset( slots, 0, numSlots*sizeof(struct Slot) );
+    }
+    numGrids = 0;
+}
+
+
+void gridcache_stats( long *hitsReturned, long *missesReturned, int *numGridsReturned ) {
+    *hitsReturned = hits;
+    *missesReturned = misses;
+    *numGridsReturned = numGrids;
+}
+
+
+
+//  Checks grid and writes it to normal[7] the way grid2deg_() wants it ("DM12qu"), and packs it into *key, never 0.  -1 if it isn't a
+//      grid square.
+static int packGrid( const char *grid, char *normal, uint32_t *key ) {
+    static const char low[6] = { 'A', 'A', '0', '0', 'a', 'a' };
+    static const int count[6] = { 18, 18, 10, 10, 24, 24 };
+    uint32_t packed = 0;
+    int end = 0;                        // the grid square stopped after 4 characters
+
+    for (int iii = 0; iii < 6; iii++) {
+        char c = (end) ? 0 : grid[iii];
+
+        if ((iii >= 4) && ((c == 0) || (c == ' '))) {
+            c = 'm';                    // the middle of the square
+        } else if (iii < 2) {
+            c = ((c >= 'a') && (c <= 'z')) ? c - 'a' + 'A' : c;
+        } else if (iii >= 4) {
+            c = ((c >= 'A') && (c <= 'Z')) ? c - 'A' + 'a' : c;
+        }
+        if ((c < low[iii]) || (c >= low[iii] + count[iii])) {
+            return -1;
+        }
+        if ((iii == 4) && (grid[iii] == 0)) {
+            end = 1;
+        }
+        normal[iii] = c;
+        packed = packed*count[iii] + (c - low[iii]);
+    }
+    normal[6] = 0;
+    *key = packed + 1;
+    return 0;
+}
+
+
+//  azdist_()'s rounding, 0.5 and up is rounded up
+static int roundHalfUp( double value ) {
+    double whole;
+    double fract = modf( value, &whole );
+
+    return (int)value + ((fract >= 0.5) ? 1 : 0);
+}
+
+
+static unsigned int hashKey( uint32_t key ) {
+    unsigned int hash = key * 2654435761u;
+    return hash ^ (hash >> 15);
+}
+
+
+//  Doubles the hash table (or makes the first one) and puts the grid squares back in.
+static int growSlots( void ) {
+    unsigned int newNumSlots = (numSlots == 0) ? MIN_SLOTS : 2*numSlots;
+    struct Slot *newSlots = calloc( newNumSlots, sizeof(struct Slot) );
+
+    if (newSlots == (struct Slot *)NULL) {
+        printf("Error in calloc()\n");
+        return -1;
+    }
+    for (unsigned int iii = 0; iii < numSlots; iii++) {
+        unsigned int jjj;
+        if (slots[iii].key == 0) {
+            continue;
+        }
+        for (jjj = hashKey( slots[iii].key ) & (newNumSlots - 1); newSlots[jjj].key != 0; jjj = (jjj + 1) & (newNumSlots - 1)) {
+        }
+        newSlots[jjj] = slots[iii];
+    }
+    free( slots );
+    slots = newSlots;
+    numSlots = newNumSlots;
+    return 0;
+}
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <time.h>
+
+#define NUM_REPORTERS   2000            // grid squares heard over a day or so
+#define NUM_SPOTS       200000          // spots, most from a few hundred of them
+#define CYCLE_SPOTS     600             // one cycle's worth
+
+extern void azdist_( const char *myGrid, const char *hisGrid, int *nAz, int *nDmiles, int *nDkm );
+
+static char grids[NUM_REPORTERS][8];
+static int spots[NUM_SPOTS];
+
+static double secondsSince( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)*1e-9;
+}
+
+static int sameAsAzdist( const char *mine, const char *his ) {
+    struct GridPath path;
+    int nAz, nDmiles, nDkm;
+
+    azdist_( mine, his, &nAz, &nDmiles, &nDkm );
+    if ((gridcache_lookup( his, &path ) != 0) || (path.azimuth != nAz) || (path.miles != nDmiles) || (path.km != nDkm)) {
+        printf("%s to %s: %d %d %d, azdist_() %d %d %d\n",mine,his,path.azimuth,path.miles,path.km,nAz,nDmiles,nDkm);
+        return 0;
+    }
+    return 1;
+}
+
+int main() {
+    //  Reporters are mostly in North America and Europe
+    const char *fields[] = { "DM", "DM", "DM", "CM", "CM", "DN", "EM", "EM", "EN", "FN", "FN", "FM", "JO", "JO", "JN", "IO", "KP", "QF", "PM", "BL" };
+    const char *bad[] = { "", "D", "DM1", "SM12qu", "DM1Aqu", "DM12yu", "DM12q!", "12DMqu" };
+    const char *same[] = { "DM13", "DM13  ", "dm13MM", "DM13mm", "DM13mm56" };
+    char copy[8], *home = MY_LOCATOR;
+    struct GridPath path, first;
+    struct timespec start;
+    double seconds, zipf[NUM_REPORTERS], total = 0.0;
+    long numHits, numMisses;
+    int errors = 0, numKept, nAz, nDmiles, nDkm;
+    volatile int sink = 0;
+
+    srand( 1 );
+    for (int iii = 0; iii < NUM_REPORTERS; iii++) {
+        const char *field = fields[ rand() % (sizeof(fields)/sizeof(fields[0])) ];
+        sprintf( grids[iii], "%s%d%d%c%c", field, rand() % 10, rand() % 10, 'a' + rand() % 24, 'a' + rand() % 24 );
+        zipf[iii] = 1.0/pow( iii + 1, 1.1 );
+        total += zipf[iii];
+    }
+    for (int iii = 0; iii < NUM_SPOTS; iii++) {
+        double pick = total * rand() / ((double)RAND_MAX + 1.0);
+        int jjj;
+        for (jjj = 0; (jjj < NUM_REPORTERS - 1) && (pick >= zipf[jjj]); jjj++) {
+            pick -= zipf[jjj];
+        }
+        spots[iii] = jjj;
+    }
+
+    //  The same as azdist_() for every grid square, the home grid square is 0, and the ones that aren't grid squares are -1
+    for (int iii = 0; iii < NUM_REPORTERS; iii++) {
+        errors += !sameAsAzdist( home, grids[iii] );
+        errors += !sameAsAzdist( home, grids[iii] );        // from the table this time
+    }
+    if ((gridcache_lookup( home, &path ) != 0) || (path.azimuth != 0) || (path.miles != 0) || (path.km != 0)
+            || (gridcache_lookup( "DM12QU", &path ) != 0) || (path.miles != 0)) {
+        printf("the home grid square isn't 0\n");
+        errors++;
+    }
+    for (int iii = 0; iii < (int)(sizeof(bad)/sizeof(bad[0])); iii++) {
+        if ((gridcache_lookup( bad[iii], &path ) != -1) || (path.azimuth != 0) || (path.miles != 0) || (path.km != 0)) {
+            printf("\"%s\" taken for a grid square\n",bad[iii]);
+            errors++;
+        }
+    }
+    errors += !sameAsAzdist( home, "DM13  " );
+    gridcache_lookup( same[0], &first );
+    for (int iii = 1; iii < (int)(sizeof(same)/sizeof(same[0])); iii++) {
+        if ((gridcache_lookup( same[iii], &path ) != 0) || (memcmp( &path, &first, sizeof(path) ))) {
+            printf("\"%s\" isn't \"%s\"\n",same[iii],same[0]);
+            errors++;
+        }
+    }
+
+    //  Another home grid square, and azdist_() doesn't write to its strings any more
+    strcpy( copy, "DM13  " );
+    azdist_( copy, "FN42", &nAz, &nDmiles, &nDkm );
+    if (strcmp( copy, "DM13  " )) {
+        printf("azdist_() changed \"DM13  \" to \"%s\"\n",copy);
+        errors++;
+    }
+    if ((gridcache_setHome( "XX99" ) != -1) || (gridcache_setHome( "FN42" ) != 0)) {
+        printf("gridcache_setHome() wrong\n");
+        errors++;
+    }
+    for (int iii = 0; iii < NUM_REPORTERS; iii += 13) {
+        errors += !sameAsAzdist( "FN42mm", grids[iii] );
+    }
+    gridcache_setHome( home );
+
+    //  Cold: every grid square looked up for the first time.  Warm: all of them in the table.
+    printf("%d spots from %d grid squares\n",NUM_SPOTS,NUM_REPORTERS);
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < NUM_SPOTS; iii++) {
+        azdist_( home, grids[ spots[iii] ], &nAz, &nDmiles, &nDkm );
+        sink += nAz;
+    }
+    seconds = secondsSince( &start );
+    printf("    azdist_() every spot         %8.1f ns a spot\n",seconds*1e9/NUM_SPOTS);
+
+    gridcache_clear();
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < NUM_REPORTERS; iii++) {
+        gridcache_lookup( grids[iii], &path );
+        sink += path.azimuth;
+    }
+    seconds = secondsSince( &start );
+    printf("    cold, not in the table       %8.1f ns a lookup\n",seconds*1e9/NUM_REPORTERS);
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < NUM_SPOTS; iii++) {
+        gridcache_lookup( grids[ spots[iii] ], &path );
+        sink += path.azimuth;
+    }
+    seconds = secondsSince( &start );
+    printf("    warm, all in the table       %8.1f ns a lookup\n",seconds*1e9/NUM_SPOTS);
+
+    //  The first cycle after starting, and the day from an empty table
+    gridcache_clear();
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < CYCLE_SPOTS; iii++) {
+        gridcache_lookup( grids[ spots[iii] ], &path );
+        sink += path.azimuth;
+    }
+    seconds = secondsSince( &start );
+    printf("    first cycle, %d spots       %8.1f ns a lookup\n",CYCLE_SPOTS,seconds*1e9/CYCLE_SPOTS);
+
+    gridcache_clear();
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < NUM_SPOTS; iii++) {
+        gridcache_lookup( grids[ spots[iii] ], &path );
+        sink += path.azimuth;
+    }
+    seconds = secondsSince( &start );
+    gridcache_stats( &numHits, &numMisses, &numKept );
+    printf("    all spots, empty to start    %8.1f ns a lookup, %d grid squares kept\n",seconds*1e9/NUM_SPOTS,numKept);
+    printf("    %ld hits %ld misses\n",numHits,numMisses);
+
+    printf("%s\n",(errors) ? "FAIL" : "PASS");
+    return (errors) ? 1 : 0;
+}
+#endif
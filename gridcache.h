@@ -0,0 +1,15 @@
+#ifndef _GRIDCACHE_H_
+#define _GRIDCACHE_H_
+
+struct GridPath {               // from the home grid square to a reporter's, rounded the way azdist_() did
+    int azimuth;                // degrees
+    int miles;
+    int km;
+};
+
+extern int gridcache_setHome( const char *grid );
+extern int gridcache_lookup( const char *grid, struct GridPath *path );
+extern void gridcache_clear( void );
+extern void gridcache_stats( long *hits, long *misses, int *numGrids );
+
+#endif
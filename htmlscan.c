@@ -0,0 +1,429 @@
+/*
+    htmlscan.c - finds the rows and cells of wsprnet.org's olddb response in one pass, without copying anything.  doCurl() used to read
+        x.txt with fgets() into a 4096 byte line, strstr() every line for the start of a row and then parseHTMLTag() each of the 13 cells
+        with three more strstr()s and two strcpy()s.  A response that came as one long line was cut every 4096 bytes and the rows across
+        a cut were lost.
+
+        The response is mapped (htmlscan_mapFile()) and htmlscan_nextRow() walks it from one '<' to the next with memchr(), so each byte
+        is looked at about once and line breaks don't matter.  A row starts at <tr id="evenrow"> or <tr id="oddrow"> and ends at </tr>, the
+        next row or the end.  Each <td ...>...</td> is a cell, a view (pointer and length) into the response with the &nbsp;s and spaces
+        around it taken off:
+            <td align=left>&nbsp;2022-01-18 23:22&nbsp;</td>        "2022-01-18 23:22", 16
+        The views are good until the response is unmapped.  htmlscan_equals(), htmlscan_int() and htmlscan_copy() work on them, copying is
+        left to whoever keeps a cell.  htmlscan_decimal() reads a frequency in MHz as Hz.
+
+    To test and benchmark (a made up 10,000 row response, against the old fgets()/strstr()/strcpy() parse):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o htmlscan htmlscan.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "htmlscan.h"
+
+#define ROW_START1      "<tr id=\"evenrow\">"
+#define ROW_START2      "<tr id=\"oddrow\">"
+#define NBSP            "&nbsp;"
+
+void htmlscan_begin( struct HtmlScan *scan, const char *text, size_t length );
+int htmlscan_nextRow( struct HtmlScan *scan, struct HtmlRow *row );
+int htmlscan_equals( const struct HtmlView *view, const char *string );
+int htmlscan_copy( const struct HtmlView *view, char *string, int size );
+int htmlscan_int( const struct HtmlView *view, int *value );
+int htmlscan_decimal( const struct HtmlView *view, int decimals, long long *value );
+const void *htmlscan_mapFile( const char *filename, size_t *length );
+void htmlscan_unmapFile( const void *map, size_t length );
+
+static int startsWith( const char *cc, const char *end, const char *string, int length );
+static void trim( const char *begin, const char *end, struct HtmlView *view );
+
+
+void htmlscan_begin( struct HtmlScan *scan, const char *text, size_t length ) {
+    scan->next = text;
+    scan->end = text + length;
+}
+
+
+//  The next row.  Returns 1 and the cells in *row, or 0 at the end of the response.  A row cut off by the end of the response has the
+//      cells up to the cut.
+int htmlscan_nextRow( struct HtmlScan *scan, struct HtmlRow *row ) {
+    const char *cc = scan->next;
+    const char *end = scan->end;
+
+    //  Find the start of a row
+    while (1) {
+        cc = memchr( cc, '<', end - cc );
+        if (cc == (const char *)NULL) {
+            scan->next = end;
+            return 0;
+        }
+        if (startsWith( cc, end, ROW_START1, sizeof(ROW_START1)-1 )) {
+            cc += sizeof(ROW_START1)-1;
+            break;
+        }
+        if (startsWith( cc, end, ROW_START2, sizeof(ROW_START2)-1 )) {
+            cc += sizeof(ROW_START2)-1;
+            break;
+        }
+        cc++;
+    }
+
+    //  The cells, up to </tr> or the next row
+    row->numCells = 0;
+    while (1) {
+        const char *content, *close;
+
+        cc = memchr( cc, '<', end - cc );
+        if (cc == (const char *)NULL) {
+            cc = end;
+            break;
+        }
+        if (startsWith( cc, end, "</tr", 4 )) {
+            cc += 4;
+            break;
+        }
+        if (startsWith( cc, end, "<tr", 3 )) {
+            break;
+        }
+        if (!startsWith( cc, end, "<td", 3 )) {       // </td>, or anything else
+            cc++;
+            continue;
+        }
+        content = memchr( cc, '>', end - cc );
+        if (content == (const char *)NULL) {
+            cc = end;
+            break;
+        }
+        content++;
+        close = memchr( content, '<', end - content );
+        if (close == (const char *)NULL) {
+            close = end;
+        }
+        if (row->numCells < HTMLSCAN_MAX_CELLS) {
+            trim( content, close, &row->cell[ row->numCells++ ] );
+        }
+        cc = close;
+    }
+    scan->next = cc;
+    return 1;
+}
+
+
+//  1 if the view is exactly string.
+int htmlscan_equals( const struct HtmlView *view, const char *string ) {
+    return (strncmp( view->text, string, view->length ) == 0) && (string[ view->length ] == 0);
+}
+
+
+//  Copies the view into string[size] and null terminates it.  Returns the length, or -1 if it didn't fit (what fit is copied).
+int htmlscan_copy( const struct HtmlView *view, char *string, int size ) {
+    int length = (view->length < size) ? view->length : size - 1;
+
+    memcpy( string, view->text, length );
+    string[length] = 0;
+    return (length == view->length) ? length : -1;
+}
+
+
+//  An optionally signed decimal integer, the whole view.  Returns 0 or -1.
+int htmlscan_int( const struct HtmlView *view, int *value ) {
+    int iii = 0, sign = 1, result = 0;
+
+    if ((view->length > 0) && ((view->text[0] == '-') || (view->text[0] == '+'))) {
+        sign = (view->text[0] == '-') ? -1 : 1;
+        iii = 1;
+    }
+    if (iii == view->length) {
+        return -1;
+    }
+    for ( ; iii < view->length; iii++) {
+        if ((view->text[iii] < '0') || (view->text[iii] > '9')) {
+            return -1;
+        }
+        result = result*10 + (view->text[iii] - '0');
+    }
+    *value = sign*result;
+    return 0;
+}
+
+
+//  A decimal number scaled by 10^decimals, "28.126084" with 6 decimals is 28126084 and "28.1261" is 28126100.  Digits past decimals are
+//      dropped.  Returns 0 or -1.
+int htmlscan_decimal( const struct HtmlView *view, int decimals, long long *value ) {
+    long long result = 0;
+    int iii, digits = 0, places = -1;
+
+    for (iii = 0; iii < view->length; iii++) {
+        char cc = view->text[iii];
+        if ((cc == '.') && (places == -1)) {
+            places = 0;
+        } else if ((cc >= '0') && (cc <= '9')) {
+            digits++;
+            if (places == -1) {
+                result = result*10 + (cc - '0');
+            } else if (places < decimals) {
+                result = result*10 + (cc - '0');
+                places++;
+            }
+        } else {
+            return -1;
+        }
+    }
+    if (digits == 0) {
+        return -1;
+    }
+    for (places = (places == -1) ? 0 : places; places < decimals; places++) {
+        result *= 10;
+    }
+    *value = result;
+    return 0;
+}
+
+
+//  Maps a file read only.  Returns the mapping and its length, or NULL on error.  An empty file is "", length 0.
+const void *htmlscan_mapFile( const char *filename, size_t *length ) {
+    struct stat statbuf;
+    void *map;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat( fd, &statbuf ) == -1) {
+        close( fd );
+        return NULL;
+    }
+    *length = (size_t)statbuf.st_size;
+    if (*length == 0) {
+        close( fd );
+        return "";
+    }
+    map = mmap( NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    return map;
+}
+
+
+void htmlscan_unmapFile( const void *map, size_t length ) {
+    if ((map != NULL) && (length > 0)) {
+        munmap( (void *)map, length );
+    }
+}
+
+
+static int startsWith( const char *cc, const char *end, const char *string, int length ) {
+    return (end - cc >= length) && (memcmp( cc, string, length ) == 0);
+}
+
+
+//  The view of begin to end without the spaces and &nbsp;s at either end.
+static void trim( const char *begin, const char *end, struct HtmlView *view ) {
+    while (1) {
+        if ((begin < end) && ((*begin == ' ') || (*begin == '\n') || (*begin == '\r') || (*begin == '\t'))) {
+            begin++;
+        } else if (startsWith( begin, end, NBSP, sizeof(NBSP)-1 )) {
+            begin += sizeof(NBSP)-1;
+        } else {
+            break;
+        }
+    }
+    while (1) {
+        if ((end > begin) && ((end[-1] == ' ') || (end[-1] == '\n') || (end[-1] == '\r') || (end[-1] == '\t'))) {
+            end--;
+        } else if ((end - begin >= (int)sizeof(NBSP)-1) && (memcmp( end - (sizeof(NBSP)-1), NBSP, sizeof(NBSP)-1 ) == 0)) {
+            end -= sizeof(NBSP)-1;
+        } else {
+            break;
+        }
+    }
+    view->text = begin;
+    view->length = (int)(end - begin);
+}
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <time.h>
+
+#define TEST_ROWS       10000
+#define TEST_REPEATS    20
+
+//  One olddb row, the way wsprnet.org sends it (a line per row) or without the line break, so the whole table is one line.
+static int makeRow( char *string, int iii, int oneLine ) {
+    return sprintf(string,
+            "<tr id=\"%s\">"
+            "<td align=left>&nbsp;2026-06-21 %02d:%02d&nbsp;</td><td align=left>&nbsp;NQ6B&nbsp;</td>"
+            "<td align=right>&nbsp;28.126%03d&nbsp;</td><td align=right>&nbsp;%d&nbsp;</td><td align=right>&nbsp;0&nbsp;</td>"
+            "<td align=left>&nbsp;DM12mr&nbsp;</td><td align=right>&nbsp;+37&nbsp;</td><td align=right>&nbsp;5.012&nbsp;</td>"
+            "<td align=left>&nbsp;K%dABC&nbsp;</td><td align=left>&nbsp;DM13ji&nbsp;</td><td align=right>&nbsp;73&nbsp;</td>"
+            "<td align=right>&nbsp;%d&nbsp;</td><td align=right>&nbsp;WSPR-2&nbsp;</td></tr>%s",
+            (iii & 1) ? "oddrow" : "evenrow", 23 - (iii/600)%24, 58 - 2*((iii/20)%30), iii % 1000, -(iii % 30), iii,
+            45 + iii % 3000, oneLine ? "" : "\n" );
+}
+
+static char *makeResponse( int numRows, int oneLine, size_t *length ) {
+    char *text = malloc( (size_t)numRows*1024 + 1024 );
+    size_t used = 0;
+
+    used += sprintf( &text[used], "<html><body><table>\n<tr><th>Date</th><th>Call</th></tr>\n" );
+    for (int iii = 0; iii < numRows; iii++) {
+        used += makeRow( &text[used], iii, oneLine );
+    }
+    used += sprintf( &text[used], "</table></body></html>\n" );
+    *length = used;
+    return text;
+}
+
+//  The old way, from wsprnet.c before this file: fgets(), strstr() for the row, parseHTMLTag() and strcpy() for each of 13 cells
+static char* oldParseHTMLTag( char *string, char *field ) {
+    char *returnValue, *fieldBegin, *cc;
+
+    cc = strstr(string,"</td>");            if (cc == (char *)NULL) { return (char *)-1; }
+    returnValue = &cc[5];
+    cc = strstr(string,"&nbsp;");           if (cc == (char *)NULL) { return (char *)-1; }
+    fieldBegin = &cc[6];
+    cc = strstr(fieldBegin,"&nbsp;");       if (cc == (char *)NULL) { return (char *)-1; }
+    *cc = 0;
+    strcpy(field,fieldBegin);
+    return returnValue;
+}
+
+static int oldParse( char *text, size_t length, int *snrSum ) {
+    FILE *fptr = fmemopen( text, length, "r" );
+    char string[4096], field[128], locals[13][64];
+    int rows = 0;
+
+    while (fgets( string, 4096, fptr )) {
+        if (strstr( string, ROW_START1 ) || strstr( string, ROW_START2 )) {
+            char *cc = strstr(string,"<td align=");
+            int jjj;
+            for (jjj = 0; (cc != (char *)NULL) && (jjj < 13); jjj++) {
+                cc = oldParseHTMLTag( cc, field );
+                if (cc == (char *)-1) { break; }
+                strcpy( locals[jjj], field );
+            }
+            if (jjj == 13) {
+                rows++;
+                *snrSum += atoi( locals[3] );
+            }
+        }
+    }
+    fclose(fptr);
+    return rows;
+}
+
+static int newParse( const char *text, size_t length, int *snrSum ) {
+    struct HtmlScan scan;
+    struct HtmlRow row;
+    int rows = 0, snr;
+
+    htmlscan_begin( &scan, text, length );
+    while (htmlscan_nextRow( &scan, &row )) {
+        if ((row.numCells == 13) && (htmlscan_int( &row.cell[3], &snr ) == 0)) {
+            rows++;
+            *snrSum += snr;
+        }
+    }
+    return rows;
+}
+
+static double secondsSince( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)*1e-9;
+}
+
+int main() {
+    char *lines, *oneLine;
+    size_t linesLength, oneLineLength;
+    struct timespec start;
+    struct HtmlScan scan;
+    struct HtmlRow row;
+    int errors = 0, rows, snrOld = 0, snrNew = 0, value;
+    double oldSec, newSec;
+
+    lines = makeResponse( TEST_ROWS, 0, &linesLength );
+    oneLine = makeResponse( TEST_ROWS, 1, &oneLineLength );
+    printf("%d rows, %zu bytes with a line per row, %zu bytes on one line\n",TEST_ROWS,linesLength,oneLineLength);
+
+    //  The cells of the first row
+    htmlscan_begin( &scan, lines, linesLength );
+    if ((!htmlscan_nextRow( &scan, &row )) || (row.numCells != 13) || (!htmlscan_equals( &row.cell[0], "2026-06-21 23:58" ))
+            || (!htmlscan_equals( &row.cell[2], "28.126000" )) || (!htmlscan_equals( &row.cell[8], "K0ABC" ))
+            || (htmlscan_int( &row.cell[6], &value )) || (value != 37) || (!htmlscan_equals( &row.cell[12], "WSPR-2" ))) {
+        printf("first row parsed wrong, %d cells\n",row.numCells);
+        errors++;
+    }
+
+    {
+        struct HtmlView mhz = { "28.1261", 7 }, hz = { "50.294526", 9 }, bad = { "28.1.2", 6 };
+        long long mhzValue, hzValue;
+        if ((htmlscan_decimal( &mhz, 6, &mhzValue )) || (mhzValue != 28126100) || (htmlscan_decimal( &hz, 6, &hzValue ))
+                || (hzValue != 50294526) || (htmlscan_decimal( &bad, 6, &hzValue ) == 0)) {
+            printf("decimal wrong\n");
+            errors++;
+        }
+    }
+
+    //  Every row, with a line per row and all on one line (the old way lost the rows cut by its 4096 byte lines)
+    snrNew = 0;
+    if ((rows = newParse( lines, linesLength, &snrNew )) != TEST_ROWS) {
+        printf("%d rows with a line per row\n",rows);
+        errors++;
+    }
+    snrOld = 0;
+    if ((rows = newParse( oneLine, oneLineLength, &snrOld )) != TEST_ROWS) {
+        printf("%d rows on one line\n",rows);
+        errors++;
+    }
+    if (snrOld != snrNew) {
+        printf("the SNRs add up differently, %d and %d\n",snrOld,snrNew);
+        errors++;
+    }
+    snrOld = 0;
+    printf("old parse of the one line response finds %d of %d rows\n",oldParse( oneLine, oneLineLength, &snrOld ),TEST_ROWS);
+
+    //  A row cut off by the end of the response
+    htmlscan_begin( &scan, lines, 400 );
+    if ((!htmlscan_nextRow( &scan, &row )) || (row.numCells >= 13) || (htmlscan_nextRow( &scan, &row ))) {
+        printf("cut off row wrong\n");
+        errors++;
+    }
+
+    //  Benchmark.  The old parse only works with a line per row, time both on that.
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    snrOld = 0;
+    for (int iii = 0; iii < TEST_REPEATS; iii++) {
+        rows = oldParse( lines, linesLength, &snrOld );
+    }
+    oldSec = secondsSince( &start );
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    snrNew = 0;
+    for (int iii = 0; iii < TEST_REPEATS; iii++) {
+        rows = newParse( lines, linesLength, &snrNew );
+    }
+    newSec = secondsSince( &start );
+    if (snrOld != snrNew) {
+        printf("old and new parse differ, SNR sums %d and %d\n",snrOld,snrNew);
+        errors++;
+    }
+    printf("old fgets()/strstr()/strcpy()  %8.3lf ms per response  %10.0lf rows/s\n",oldSec*1000/TEST_REPEATS,TEST_ROWS*TEST_REPEATS/oldSec);
+    printf("htmlscan                        %8.3lf ms per response  %10.0lf rows/s  (%.1lfx)\n",newSec*1000/TEST_REPEATS,
+           TEST_ROWS*TEST_REPEATS/newSec,oldSec/newSec);
+
+    free(lines);
+    free(oneLine);
+    printf("%s\n",errors ? "FAIL" : "PASS");
+    return errors;
+}
+
+#endif
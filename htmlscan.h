@@ -0,0 +1,32 @@
+#ifndef _HTMLSCAN_H_
+#define _HTMLSCAN_H_
+
+#include <stddef.h>
+
+#define HTMLSCAN_MAX_CELLS  16      // wsprnet.org's olddb rows have 13, any more are skipped
+
+struct HtmlView {               // points into the response, not null terminated
+    const char *text;
+    int length;
+};
+
+struct HtmlRow {
+    int numCells;
+    struct HtmlView cell[HTMLSCAN_MAX_CELLS];
+};
+
+struct HtmlScan {
+    const char *next;
+    const char *end;
+};
+
+extern void htmlscan_begin( struct HtmlScan *scan, const char *text, size_t length );
+extern int htmlscan_nextRow( struct HtmlScan *scan, struct HtmlRow *row );
+extern int htmlscan_equals( const struct HtmlView *view, const char *string );
+extern int htmlscan_copy( const struct HtmlView *view, char *string, int size );
+extern int htmlscan_int( const struct HtmlView *view, int *value );
+extern int htmlscan_decimal( const struct HtmlView *view, int decimals, long long *value );
+extern const void *htmlscan_mapFile( const char *filename, size_t *length );
+extern void htmlscan_unmapFile( const void *map, size_t length );
+
+#endif
@@ -0,0 +1,1268 @@
+/*
+    httpclient.c - fetches the reports over HTTP/1.1 in this process.  doCurl() and doCurlFT8() used to system() a shell that ran curl,
+        which wrote x.txt or y.txt on the SD card, and then read the file back.  Every query paid for a shell, a curl, a new connection
+        (and TLS handshake) and two trips through the card, and all that came back from a failure was curl's exit status.
+
+        http_start() starts resolving the host and returns at once.  getaddrinfo() blocks for as long as the resolver takes, so it runs
+        in a thread of its own that writes an eventfd when the addresses are in, and the connect is started from there, non-blocking.
+        The request's deadline counts from http_start(), a resolver that hangs times out like a server that does.  http_finish()
+        poll()s every request that has been started, not only the one asked for, so the pskreporter.info and wsprnet.org queries
+        started together by reports.c run at the same time and the slower one sets the pace.  The request asks for gzip
+        (Accept-Encoding), the response is read into memory, de-chunked and inflated (zlib) there and handed over as the body, straight
+        to the parser.  https:// goes over OpenSSL with the certificate and host name checked, like curl does.
+
+        A connection the server leaves open goes into a small pool and the next request to the same host re-uses it (keep-alive).
+        wsprnet.c asking again with a bigger limit, or the re-queries a few minutes later, skip the connect.  If the server had closed
+        it meanwhile the request goes again on a new connection.
+
+        What went wrong comes back as HTTP_ERR_ in HttpResponse.error (http_errorString() for the log): the name didn't resolve, the
+        connect was refused, the TLS handshake failed, it timed out, the status wasn't 2xx (and which), the gzip was bad...
+
+        The requests table has no lock, wsprnet_start() and pskreporter_start() start the requests and doCurl() and doCurlFT8() finish
+        them, all in the reports thread (reports.c).  The simulation build (sim.c) has its own http_start() and http_finish() that
+        answer from canned files.
+
+    To test (a stand-in server on 127.0.0.1 with canned responses, https isn't tested):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o httpclient httpclient.c -lz -lssl -lcrypto -pthread
+*/
+#define _GNU_SOURCE                 // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include "httpclient.h"
+
+#define HOST_SIZE       256
+#define PATH_SIZE       1024
+#define READ_SIZE       16384       // read this much at a time
+#define USER_AGENT      "twsprRPI"
+
+#define STATE_RESOLVE   0           // getaddrinfo() in its thread, see openConnection()
+#define STATE_CONNECT   1
+#define STATE_HANDSHAKE 2           // TLS
+#define STATE_SEND      3
+#define STATE_RECEIVE   4
+#define STATE_DONE      5
+
+struct Connection {
+    int fd;                         // -1 if none
+    SSL *ssl;                       // NULL for http://
+    int tls;
+    char host[HOST_SIZE];
+    int port;
+    time_t idleSince;
+};
+
+struct Resolver {                   // one getaddrinfo(), shared by a request and the thread running it
+    char host[HOST_SIZE];
+    char service[16];
+    int eventFd;                    // written by the thread when it's done
+    int error;                      // getaddrinfo()'s, 0 if list has the addresses
+    struct addrinfo *list;
+    int done;                       // done and abandoned are protected by resolverLock
+    int abandoned;                  // the request finished first (timed out), the thread frees it
+};
+
+struct Request {
+    int inUse;
+    int state;
+    int error;
+    struct Connection conn;
+    struct Resolver *resolver;      // while STATE_RESOLVE, NULL otherwise
+    int reused;                     // conn came from the idle pool
+    int retried;                    // sent again after a re-used connection turned out to be closed
+    int wantWrite;                  // TLS wants the socket writable before it can go on
+    char *out;                      // the request
+    size_t outLength;
+    size_t outSent;
+    char *in;                       // the response as received, always null terminated
+    size_t inLength;
+    size_t inSize;
+    long bytes;
+    size_t headerLength;            // 0 until the headers are in
+    int status;
+    long long contentLength;        // -1 if not given
+    int chunked;
+    int gzip;
+    int keepAlive;
+    size_t chunkNext;               // the next chunk size line in in[]
+    int lastChunk;                  // the 0 size chunk was seen, the trailers are being read
+    size_t end;                     // the end of the response in in[], once complete
+    long long startNs;
+    long long deadlineNs;
+};
+
+int http_start( const char *url, const char *postBody, int timeoutMs );
+int http_finish( int request, struct HttpResponse *response );
+void http_free( struct HttpResponse *response );
+const char *http_errorString( int error );
+void http_close( void );
+
+static int parseUrl( const char *url, int *tls, char *host, int *port, char *path );
+static int openConnection( struct Request *req );
+static void *resolveThread( void *arg );
+static void dropResolver( struct Request *req );
+static void freeResolver( struct Resolver *rs );
+static int connectTo( struct Request *req, struct addrinfo *list );
+static int takeIdle( struct Request *req );
+static void releaseConnection( struct Request *req );
+static void closeConnection( struct Connection *conn );
+static void pollOnce( void );
+static void step( struct Request *req );
+static int doHandshake( struct Request *req );
+static int doSend( struct Request *req );
+static int doReceive( struct Request *req );
+static int checkComplete( struct Request *req, int atEof );
+static int parseHeaders( struct Request *req, size_t headerEnd );
+static int scanChunks( struct Request *req );
+static size_t dechunk( char *body, size_t length );
+static int inflateBody( const char *data, size_t length, char **out, size_t *outLength );
+static void finishRequest( struct Request *req, int error );
+static int retryRequest( struct Request *req );
+static long long nowNs( void );
+
+static struct Request requests[HTTP_MAX_REQUESTS];
+static struct Connection idle[HTTP_MAX_IDLE];
+static int numIdle = 0;
+static SSL_CTX *tlsContext = (SSL_CTX *)NULL;
+static pthread_mutex_t resolverLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+//  Starts a GET, or a POST of postBody (application/x-www-form-urlencoded) if it isn't NULL.  Returns the request for http_finish(), or
+//      an HTTP_ERR_ (which http_finish() also takes, and gives back).
+int http_start( const char *url, const char *postBody, int timeoutMs ) {
+    struct Request *req = (struct Request *)NULL;
+    char path[PATH_SIZE];
+    size_t postLength = (postBody == (const char *)NULL) ? 0 : strlen( postBody );
+    int iii, error;
+
+    for (iii = 0; iii < HTTP_MAX_REQUESTS; iii++) {
+        if (!requests[iii].inUse) {
+            req = &requests[iii];
+            break;
+        }
+    }
+    if (req == (struct Request *)NULL) {
+        return HTTP_ERR_BUSY;
+    }
+    memset( req, 0, sizeof(*req) );
+    req->conn.fd = -1;
+    req->contentLength = -1;
+    if (parseUrl( url, &req->conn.tls, req->conn.host, &req->conn.port, path )) {
+        return HTTP_ERR_URL;
+    }
+    req->startNs = nowNs();
+    req->deadlineNs = req->startNs + timeoutMs*1000000LL;
+
+    req->out = malloc( strlen(path) + strlen(req->conn.host) + postLength + 512 );
+    if (req->out == (char *)NULL) {
+        return HTTP_ERR_MEMORY;
+    }
+    req->outLength = sprintf( req->out, "%s %s HTTP/1.1\r\nHost: %s", postBody ? "POST" : "GET", path, req->conn.host );
+    if (req->conn.port != (req->conn.tls ? 443 : 80)) {
+        req->outLength += sprintf( &req->out[req->outLength], ":%d", req->conn.port );
+    }
+    req->outLength += sprintf( &req->out[req->outLength], "\r\nUser-Agent: " USER_AGENT "\r\nAccept: */*\r\nAccept-Encoding: gzip\r\n"
+                               "Connection: keep-alive\r\n" );
+    if (postBody) {
+        req->outLength += sprintf( &req->out[req->outLength], "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n",
+                                   postLength );
+        memcpy( &req->out[req->outLength], postBody, postLength );
+        req->outLength += postLength;
+    } else {
+        req->outLength += sprintf( &req->out[req->outLength], "\r\n" );
+    }
+
+    req->inUse = 1;
+    if (takeIdle( req )) {
+        req->reused = 1;
+        req->state = STATE_SEND;
+    } else if ((error = openConnection( req )) != HTTP_OK) {
+        free( req->out );
+        req->inUse = 0;
+        return error;
+    }
+    return (int)(req - requests);
+}
+
+
+//  Waits for a request to finish, the others started go on meanwhile.  Fills in *response and returns response->error.
+int http_finish( int request, struct HttpResponse *response ) {
+    struct Request *req;
+
+    memset( response, 0, sizeof(*response) );
+    if (request < 0) {                  // http_start() failed
+        response->error = request;
+        return request;
+    }
+    if ((request >= HTTP_MAX_REQUESTS) || (!requests[request].inUse)) {
+        response->error = HTTP_ERR_URL;
+        return response->error;
+    }
+    req = &requests[request];
+    while (req->state != STATE_DONE) {
+        pollOnce();
+    }
+
+    response->error = req->error;
+    response->status = req->status;
+    response->bytes = req->bytes;
+    response->reused = req->reused;
+    response->seconds = (nowNs() - req->startNs)*1e-9;
+    if ((req->error == HTTP_OK) || (req->error == HTTP_ERR_STATUS)) {
+        size_t length = req->end - req->headerLength;
+
+        //  The body goes to the front of in[], de-chunked in place, and in[] is handed over.  gzip is inflated into a new buffer.
+        memmove( req->in, &req->in[ req->headerLength ], length );
+        if (req->chunked) {
+            length = dechunk( req->in, length );
+        }
+        req->in[length] = 0;
+        if (req->gzip) {
+            char *inflated;
+            size_t inflatedLength;
+            int error = inflateBody( req->in, length, &inflated, &inflatedLength );
+            if (error != HTTP_OK) {
+                response->error = error;
+            } else {
+                free( req->in );
+                req->in = inflated;
+                length = inflatedLength;
+            }
+        }
+        if (response->error != HTTP_ERR_GZIP) {
+            response->body = req->in;
+            response->length = length;
+            req->in = (char *)NULL;
+        }
+    }
+    releaseConnection( req );
+    free( req->in );
+    free( req->out );
+    req->inUse = 0;
+    return response->error;
+}
+
+
+void http_free( struct HttpResponse *response ) {
+    free( response->body );
+    response->body = (char *)NULL;
+    response->length = 0;
+}
+
+
+const char *http_errorString( int error ) {
+    switch (error) {
+        case HTTP_OK:           return "ok";
+        case HTTP_ERR_URL:      return "bad URL";
+        case HTTP_ERR_BUSY:     return "too many requests";
+        case HTTP_ERR_RESOLVE:  return "host not found";
+        case HTTP_ERR_CONNECT:  return "connect failed";
+        case HTTP_ERR_TLS:      return "TLS failed";
+        case HTTP_ERR_IO:       return "connection lost";
+        case HTTP_ERR_TIMEOUT:  return "timed out";
+        case HTTP_ERR_PROTOCOL: return "bad response";
+        case HTTP_ERR_STATUS:   return "HTTP error status";
+        case HTTP_ERR_GZIP:     return "bad gzip";
+        case HTTP_ERR_MEMORY:   return "out of memory";
+    }
+    return "unknown error";
+}
+
+
+//  Closes the kept-alive connections.
+void http_close( void ) {
+    for (int iii = 0; iii < numIdle; iii++) {
+        closeConnection( &idle[iii] );
+    }
+    numIdle = 0;
+}
+
+
+//  http://host[:port][/path] or https://...
+static int parseUrl( const char *url, int *tls, char *host, int *port, char *path ) {
+    const char *cc, *hostEnd;
+    size_t length;
+
+    if (strncmp( url, "http://", 7 ) == 0) {
+        *tls = 0;
+        *port = 80;
+        cc = &url[7];
+    } else if (strncmp( url, "https://", 8 ) == 0) {
+        *tls = 1;
+        *port = 443;
+        cc = &url[8];
+    } else {
+        return -1;
+    }
+    hostEnd = cc + strcspn( cc, ":/" );
+    length = hostEnd - cc;
+    if ((length == 0) || (length >= HOST_SIZE)) {
+        return -1;
+    }
+    memcpy( host, cc, length );
+    host[length] = 0;
+    cc = hostEnd;
+    if (*cc == ':') {
+        char *end;
+        long value = strtol( &cc[1], &end, 10 );
+        if ((end == &cc[1]) || (value <= 0) || (value > 65535)) {
+            return -1;
+        }
+        *port = (int)value;
+        cc = end;
+    }
+    if (*cc == 0) {
+        strcpy( path, "/" );
+    } else if ((*cc == '/') && (strlen( cc ) < PATH_SIZE)) {
+        strcpy( path, cc );
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+//  Starts resolving the host.  The thread writes the Resolver's eventFd when it's done, pollOnce() waits for that like for any other
+//      step, until the request's deadline, and step() goes on with connectTo().
+static int openConnection( struct Request *req ) {
+    struct Resolver *rs;
+    pthread_t thread;
+
+    rs = calloc( 1, sizeof(struct Resolver) );
+    if (rs == (struct Resolver *)NULL) {
+        return HTTP_ERR_MEMORY;
+    }
+    strcpy( rs->host, req->conn.host );
+    snprintf( rs->service, sizeof(rs->service), "%d", req->conn.port );
+    rs->eventFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if (rs->eventFd == -1) {
+        free( rs );
+        return HTTP_ERR_RESOLVE;
+    }
+    if (pthread_create( &thread, NULL, resolveThread, rs ) != 0) {
+        close( rs->eventFd );
+        free( rs );
+        return HTTP_ERR_RESOLVE;
+    }
+    pthread_detach( thread );
+    req->resolver = rs;
+    req->conn.fd = -1;
+    req->conn.ssl = (SSL *)NULL;
+    req->state = STATE_RESOLVE;
+    return HTTP_OK;
+}
+
+
+//  getaddrinfo() for openConnection().  The eventfd is written under resolverLock so the request can't free it in between.
+static void *resolveThread( void *arg ) {
+    struct Resolver *rs = arg;
+    struct addrinfo hints;
+    uint64_t one = 1;
+    int abandoned;
+
+    memset( &hints, 0, sizeof(hints) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    rs->error = getaddrinfo( rs->host, rs->service, &hints, &rs->list );
+    pthread_mutex_lock( &resolverLock );
+    rs->done = 1;
+    abandoned = rs->abandoned;
+    if ((!abandoned) && (write( rs->eventFd, &one, sizeof(one) ) != sizeof(one))) {
+        printf("resolveThread() - eventfd write failed\n");
+    }
+    pthread_mutex_unlock( &resolverLock );
+    if (abandoned) {
+        freeResolver( rs );
+    }
+    return NULL;
+}
+
+
+//  The request is done with its Resolver.  It is freed here if the thread has finished, by the thread when it does if not.
+static void dropResolver( struct Request *req ) {
+    struct Resolver *rs = req->resolver;
+    int done;
+
+    if (rs == (struct Resolver *)NULL) {
+        return;
+    }
+    req->resolver = (struct Resolver *)NULL;
+    pthread_mutex_lock( &resolverLock );
+    done = rs->done;
+    rs->abandoned = !done;
+    pthread_mutex_unlock( &resolverLock );
+    if (done) {
+        freeResolver( rs );
+    }
+}
+
+
+static void freeResolver( struct Resolver *rs ) {
+    if ((rs->error == 0) && (rs->list != (struct addrinfo *)NULL)) {
+        freeaddrinfo( rs->list );
+    }
+    close( rs->eventFd );
+    free( rs );
+}
+
+
+//  Starts a non-blocking connect to the first address that takes it.
+static int connectTo( struct Request *req, struct addrinfo *list ) {
+    struct addrinfo *ai;
+    int fd = -1, error = HTTP_ERR_CONNECT;
+
+    for (ai = list; ai != (struct addrinfo *)NULL; ai = ai->ai_next) {
+        int one = 1;
+
+        fd = socket( ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol );
+        if (fd == -1) {
+            continue;
+        }
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+        if ((connect( fd, ai->ai_addr, ai->ai_addrlen ) == 0) || (errno == EINPROGRESS)) {
+            error = HTTP_OK;
+            break;
+        }
+        close( fd );
+        fd = -1;
+    }
+    if (error != HTTP_OK) {
+        return error;
+    }
+    req->conn.fd = fd;
+    req->state = STATE_CONNECT;
+    return HTTP_OK;
+}
+
+
+//  A kept-alive connection to the same place, if there is one that is still open.  Returns 1 if req got one.
+static int takeIdle( struct Request *req ) {
+    time_t now = time( NULL );
+    int iii = 0;
+
+    while (iii < numIdle) {
+        struct Connection conn = idle[iii];
+        char cc;
+
+        if ((conn.tls != req->conn.tls) || (conn.port != req->conn.port) || (strcmp( conn.host, req->conn.host ))) {
+            iii++;
+            continue;
+        }
+        idle[iii] = idle[--numIdle];                // out of the pool either way
+        if ((now - conn.idleSince <= HTTP_IDLE_MAX_SEC)
+                && (recv( conn.fd, &cc, 1, MSG_PEEK | MSG_DONTWAIT ) == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            req->conn = conn;                       // nothing to read and not closed
+            return 1;
+        }
+        closeConnection( &conn );                   // too old, or closed by the server (or it sent something unasked for)
+    }
+    return 0;
+}
+
+
+//  Back to the pool if the server left it open and the response ended cleanly, closed if not.
+static void releaseConnection( struct Request *req ) {
+    if (req->conn.fd == -1) {
+        return;
+    }
+    if (((req->error == HTTP_OK) || (req->error == HTTP_ERR_STATUS)) && (req->keepAlive) && (req->end == req->inLength)
+            && (numIdle < HTTP_MAX_IDLE)) {
+        req->conn.idleSince = time( NULL );
+        idle[numIdle++] = req->conn;
+    } else {
+        closeConnection( &req->conn );
+    }
+    req->conn.fd = -1;
+    req->conn.ssl = (SSL *)NULL;
+}
+
+
+static void closeConnection( struct Connection *conn ) {
+    if (conn->ssl != (SSL *)NULL) {
+        SSL_shutdown( conn->ssl );          // non-blocking, it only sends close_notify if it can
+        SSL_free( conn->ssl );
+        conn->ssl = (SSL *)NULL;
+    }
+    if (conn->fd != -1) {
+        close( conn->fd );
+        conn->fd = -1;
+    }
+}
+
+
+//  One poll() over every request that isn't done, until the first deadline, and moves on the ones that are ready.
+static void pollOnce( void ) {
+    struct pollfd fds[HTTP_MAX_REQUESTS];
+    struct Request *which[HTTP_MAX_REQUESTS];
+    long long now = nowNs(), next = 0;
+    int num = 0;
+
+    for (int iii = 0; iii < HTTP_MAX_REQUESTS; iii++) {
+        struct Request *req = &requests[iii];
+
+        if ((!req->inUse) || (req->state == STATE_DONE)) {
+            continue;
+        }
+        if (now >= req->deadlineNs) {
+            finishRequest( req, HTTP_ERR_TIMEOUT );
+            continue;
+        }
+        fds[num].fd = (req->state == STATE_RESOLVE) ? req->resolver->eventFd : req->conn.fd;
+        if (req->state == STATE_RESOLVE) {
+            fds[num].events = POLLIN;
+        } else if (req->state == STATE_CONNECT) {
+            fds[num].events = POLLOUT;
+        } else if (req->conn.ssl != (SSL *)NULL) {
+            fds[num].events = req->wantWrite ? POLLOUT : POLLIN;
+        } else {
+            fds[num].events = (req->state == STATE_SEND) ? POLLOUT : POLLIN;
+        }
+        fds[num].revents = 0;
+        which[num] = req;
+        if ((num == 0) || (req->deadlineNs < next)) {
+            next = req->deadlineNs;
+        }
+        num++;
+    }
+    if (num == 0) {
+        return;
+    }
+    if (poll( fds, num, (int)((next - now + 999999)/1000000) ) <= 0) {
+        return;                             // timed out (the next call finds which) or interrupted
+    }
+    for (int iii = 0; iii < num; iii++) {
+        if (fds[iii].revents) {
+            step( which[iii] );
+        }
+    }
+}
+
+
+//  Takes a request as far as it goes without blocking.
+static void step( struct Request *req ) {
+    int result;
+
+    if (req->state == STATE_RESOLVE) {
+        int error = (req->resolver->error == 0) ? connectTo( req, req->resolver->list ) : HTTP_ERR_RESOLVE;
+
+        dropResolver( req );                // the thread is done, it's freed here
+        if (error != HTTP_OK) {
+            finishRequest( req, error );
+        }
+        return;                             // the connect is polled next
+    }
+    if (req->state == STATE_CONNECT) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if ((getsockopt( req->conn.fd, SOL_SOCKET, SO_ERROR, &error, &length ) == -1) || (error != 0)) {
+            finishRequest( req, HTTP_ERR_CONNECT );
+            return;
+        }
+        req->state = req->conn.tls ? STATE_HANDSHAKE : STATE_SEND;
+        req->wantWrite = 1;
+    }
+    if (req->state == STATE_HANDSHAKE) {
+        result = doHandshake( req );
+        if (result == -1) {
+            finishRequest( req, HTTP_ERR_TLS );
+            return;
+        }
+        if (result == 0) {
+            return;
+        }
+        req->state = STATE_SEND;
+        req->wantWrite = 1;
+    }
+    if (req->state == STATE_SEND) {
+        result = doSend( req );
+        if (result == -1) {
+            if ((req->reused) && (!req->retried)) {
+                retryRequest( req );            // the server closed the kept-alive connection
+            } else {
+                finishRequest( req, HTTP_ERR_IO );
+            }
+            return;
+        }
+        if (result == 0) {
+            return;
+        }
+        req->state = STATE_RECEIVE;
+        req->wantWrite = 0;
+    }
+    if (req->state == STATE_RECEIVE) {
+        doReceive( req );
+    }
+}
+
+
+//  Returns 1 when the TLS handshake is done, 0 if it has to wait for the socket, -1 on error.
+static int doHandshake( struct Request *req ) {
+    int result;
+
+    if (req->conn.ssl == (SSL *)NULL) {
+        if (tlsContext == (SSL_CTX *)NULL) {
+            tlsContext = SSL_CTX_new( TLS_client_method() );
+            if (tlsContext == (SSL_CTX *)NULL) {
+                return -1;
+            }
+            SSL_CTX_set_default_verify_paths( tlsContext );
+            SSL_CTX_set_verify( tlsContext, SSL_VERIFY_PEER, NULL );
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+            SSL_CTX_set_options( tlsContext, SSL_OP_IGNORE_UNEXPECTED_EOF );     // servers that close without close_notify
+#endif
+        }
+        req->conn.ssl = SSL_new( tlsContext );
+        if ((req->conn.ssl == (SSL *)NULL) || (SSL_set_fd( req->conn.ssl, req->conn.fd ) != 1)
+                || (SSL_set_tlsext_host_name( req->conn.ssl, req->conn.host ) != 1) || (SSL_set1_host( req->conn.ssl, req->conn.host ) != 1)) {
+            return -1;
+        }
+    }
+    result = SSL_connect( req->conn.ssl );
+    if (result == 1) {
+        return 1;
+    }
+    switch (SSL_get_error( req->conn.ssl, result )) {
+        case SSL_ERROR_WANT_READ:
+            req->wantWrite = 0;
+            return 0;
+        case SSL_ERROR_WANT_WRITE:
+            req->wantWrite = 1;
+            return 0;
+    }
+    ERR_clear_error();
+    return -1;
+}
+
+
+//  Returns 1 when the request is sent, 0 if it has to wait for the socket, -1 on error.
+static int doSend( struct Request *req ) {
+    while (req->outSent < req->outLength) {
+        ssize_t num;
+
+        if (req->conn.ssl != (SSL *)NULL) {
+            num = SSL_write( req->conn.ssl, &req->out[req->outSent], (int)(req->outLength - req->outSent) );
+            if (num <= 0) {
+                switch (SSL_get_error( req->conn.ssl, (int)num )) {
+                    case SSL_ERROR_WANT_READ:
+                        req->wantWrite = 0;
+                        return 0;
+                    case SSL_ERROR_WANT_WRITE:
+                        req->wantWrite = 1;
+                        return 0;
+                }
+                ERR_clear_error();
+                return -1;
+            }
+        } else {
+            num = send( req->conn.fd, &req->out[req->outSent], req->outLength - req->outSent, MSG_NOSIGNAL );
+            if (num == -1) {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                    return 0;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+        }
+        req->outSent += num;
+    }
+    return 1;
+}
+
+
+//  Reads what there is.  The request is finished when the response is complete, on an error or at the end of the connection.
+static int doReceive( struct Request *req ) {
+    int complete;
+
+    while (1) {
+        ssize_t num;
+        int eof = 0;
+
+        if (req->inLength + READ_SIZE + 1 > req->inSize) {
+            size_t newSize = (req->inSize == 0) ? 4*READ_SIZE : 2*req->inSize;
+            char *newIn = realloc( req->in, newSize );
+            if (newIn == (char *)NULL) {
+                finishRequest( req, HTTP_ERR_MEMORY );
+                return -1;
+            }
+            req->in = newIn;
+            req->inSize = newSize;
+        }
+        if (req->conn.ssl != (SSL *)NULL) {
+            num = SSL_read( req->conn.ssl, &req->in[req->inLength], READ_SIZE );
+            if (num <= 0) {
+                int error = SSL_get_error( req->conn.ssl, (int)num );
+                if (error == SSL_ERROR_WANT_READ) {
+                    req->wantWrite = 0;
+                    return 0;
+                }
+                if (error == SSL_ERROR_WANT_WRITE) {
+                    req->wantWrite = 1;
+                    return 0;
+                }
+                ERR_clear_error();
+                if ((error == SSL_ERROR_ZERO_RETURN) || ((error == SSL_ERROR_SYSCALL) && (num == 0))) {
+                    eof = 1;
+                } else {
+                    num = -1;
+                }
+            }
+        } else {
+            num = recv( req->conn.fd, &req->in[req->inLength], READ_SIZE, 0 );
+            if (num == 0) {
+                eof = 1;
+            } else if (num == -1) {
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                    return 0;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+            }
+        }
+
+        if (eof) {
+            complete = checkComplete( req, 1 );
+            if (complete == 1) {
+                req->keepAlive = 0;
+                finishRequest( req, HTTP_OK );
+            } else if (complete == -1) {
+                finishRequest( req, HTTP_ERR_PROTOCOL );
+            } else if ((req->reused) && (!req->retried) && (req->inLength == 0)) {
+                retryRequest( req );            // the server closed the kept-alive connection
+            } else {
+                finishRequest( req, HTTP_ERR_IO );
+            }
+            return -1;
+        }
+        if (num < 0) {
+            finishRequest( req, HTTP_ERR_IO );
+            return -1;
+        }
+        req->inLength += num;
+        req->bytes += num;
+        req->in[req->inLength] = 0;
+
+        complete = checkComplete( req, 0 );
+        if (complete == 1) {
+            finishRequest( req, HTTP_OK );
+            return 1;
+        }
+        if (complete == -1) {
+            finishRequest( req, HTTP_ERR_PROTOCOL );
+            return -1;
+        }
+    }
+}
+
+
+//  Returns 1 if the response is complete (and sets req->end), 0 if there's more to come, -1 if it isn't a response this understands.
+//      atEof - the server closed the connection, which is the end of a response that has no length and isn't chunked.
+static int checkComplete( struct Request *req, int atEof ) {
+    while (req->headerLength == 0) {
+        const char *cc = memmem( req->in, req->inLength, "\r\n\r\n", 4 );
+
+        if (cc == (const char *)NULL) {
+            return 0;
+        }
+        if (parseHeaders( req, (size_t)(cc - req->in) + 4 )) {
+            return -1;
+        }
+        if ((req->status >= 100) && (req->status < 200)) {     // 100 Continue and the like, the real response follows
+            req->inLength -= req->headerLength;
+            memmove( req->in, &req->in[req->headerLength], req->inLength + 1 );
+            req->headerLength = 0;
+        }
+    }
+    if (req->chunked) {
+        return scanChunks( req );
+    }
+    if (req->contentLength >= 0) {
+        if (req->inLength - req->headerLength >= (size_t)req->contentLength) {
+            req->end = req->headerLength + (size_t)req->contentLength;
+            return 1;
+        }
+        return 0;
+    }
+    if (atEof) {
+        req->end = req->inLength;
+        return 1;
+    }
+    return 0;
+}
+
+
+//  The status line and the headers this needs, in[0] to in[headerEnd] (which ends with the empty line).  Returns 0 or -1.
+static int parseHeaders( struct Request *req, size_t headerEnd ) {
+    const char *line, *end = &req->in[headerEnd - 2];
+    int minor;
+
+    if (sscanf( req->in, "HTTP/1.%d %d", &minor, &req->status ) != 2) {
+        return -1;
+    }
+    req->keepAlive = (minor >= 1);
+    req->contentLength = -1;
+    req->chunked = req->gzip = 0;
+    line = (const char *)memchr( req->in, '\n', headerEnd ) + 1;
+    while (line < end) {
+        const char *eol = memchr( line, '\n', end + 2 - line );
+        const char *colon = memchr( line, ':', eol - line );
+        char value[128];
+        size_t length;
+
+        if (colon != (const char *)NULL) {
+            const char *vv = colon + 1;
+            while ((vv < eol) && ((*vv == ' ') || (*vv == '\t'))) {
+                vv++;
+            }
+            length = eol - vv;
+            while ((length > 0) && ((vv[length-1] == '\r') || (vv[length-1] == ' ') || (vv[length-1] == '\t'))) {
+                length--;
+            }
+            if (length >= sizeof(value)) {
+                length = sizeof(value) - 1;
+            }
+            for (size_t iii = 0; iii < length; iii++) {
+                value[iii] = (vv[iii] >= 'A' && vv[iii] <= 'Z') ? vv[iii] + 'a' - 'A' : vv[iii];
+            }
+            value[length] = 0;
+
+            if (strncasecmp( line, "Content-Length:", 15 ) == 0) {
+                char *cc;
+                req->contentLength = strtoll( value, &cc, 10 );
+                if ((cc == value) || (req->contentLength < 0)) {
+                    return -1;
+                }
+            } else if (strncasecmp( line, "Transfer-Encoding:", 18 ) == 0) {
+                req->chunked = (strstr( value, "chunked" ) != (char *)NULL);
+            } else if (strncasecmp( line, "Content-Encoding:", 17 ) == 0) {
+                req->gzip = (strstr( value, "gzip" ) != (char *)NULL);
+            } else if (strncasecmp( line, "Connection:", 11 ) == 0) {
+                if (strstr( value, "close" )) {
+                    req->keepAlive = 0;
+                } else if (strstr( value, "keep-alive" )) {
+                    req->keepAlive = 1;
+                }
+            }
+        }
+        line = eol + 1;
+    }
+    if (req->chunked) {
+        req->contentLength = -1;        // chunked wins
+    }
+    req->headerLength = headerEnd;
+    req->chunkNext = headerEnd;
+    req->lastChunk = 0;
+    return 0;
+}
+
+
+//  Goes over the chunks that have arrived since the last call.  Returns 1 when the last chunk and the trailers are in, 0 if there's more
+//      to come, -1 if the chunks are garbled.
+static int scanChunks( struct Request *req ) {
+    while (1) {
+        const char *line = &req->in[req->chunkNext];
+        size_t available = req->inLength - req->chunkNext;
+        const char *eol = memmem( line, available, "\r\n", 2 );
+        size_t lineLength, size;
+        char *cc;
+
+        if (eol == (const char *)NULL) {
+            return 0;
+        }
+        lineLength = (eol - line) + 2;
+        if (req->lastChunk) {                   // the trailers, an empty line ends them
+            req->chunkNext += lineLength;
+            if (lineLength == 2) {
+                req->end = req->chunkNext;
+                return 1;
+            }
+            continue;
+        }
+        size = strtoul( line, &cc, 16 );
+        if (cc == line) {
+            return -1;
+        }
+        if (size == 0) {
+            req->lastChunk = 1;
+            req->chunkNext += lineLength;
+            continue;
+        }
+        if (available < lineLength + size + 2) {
+            return 0;
+        }
+        if ((line[lineLength + size] != '\r') || (line[lineLength + size + 1] != '\n')) {
+            return -1;
+        }
+        req->chunkNext += lineLength + size + 2;
+    }
+}
+
+
+//  Takes the chunk sizes out of a complete chunked body, in place.  Returns the length left.
+static size_t dechunk( char *body, size_t length ) {
+    size_t from = 0, to = 0;
+
+    while (from < length) {
+        const char *eol = memmem( &body[from], length - from, "\r\n", 2 );
+        size_t size = strtoul( &body[from], (char **)NULL, 16 );
+
+        if ((eol == (const char *)NULL) || (size == 0)) {
+            break;
+        }
+        from = (eol - body) + 2;
+        memmove( &body[to], &body[from], size );
+        to += size;
+        from += size + 2;
+    }
+    return to;
+}
+
+
+//  Inflates a gzip (or zlib) body into a new buffer, null terminated.  Returns HTTP_OK or HTTP_ERR_.
+static int inflateBody( const char *data, size_t length, char **out, size_t *outLength ) {
+    z_stream stream;
+    size_t size = 4*length + 4096;
+    char *buffer = malloc( size + 1 );
+    int result;
+
+    if (buffer == (char *)NULL) {
+        return HTTP_ERR_MEMORY;
+    }
+    memset( &stream, 0, sizeof(stream) );
+    if (inflateInit2( &stream, 15 + 32 ) != Z_OK) {         // 32 - gzip or zlib header, whichever it is
+        free( buffer );
+        return HTTP_ERR_GZIP;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = (uInt)length;
+    while (1) {
+        stream.next_out = (Bytef *)&buffer[stream.total_out];
+        stream.avail_out = (uInt)(size - stream.total_out);
+        result = inflate( &stream, Z_NO_FLUSH );
+        if (result == Z_STREAM_END) {
+            break;
+        }
+        if (((result != Z_OK) && (result != Z_BUF_ERROR)) || ((stream.avail_out != 0) && (stream.avail_in == 0))) {
+            inflateEnd( &stream );          // bad data, or it ended early
+            free( buffer );
+            return HTTP_ERR_GZIP;
+        }
+        if (stream.avail_out == 0) {
+            char *bigger = realloc( buffer, 2*size + 1 );
+            if (bigger == (char *)NULL) {
+                inflateEnd( &stream );
+                free( buffer );
+                return HTTP_ERR_MEMORY;
+            }
+            buffer = bigger;
+            size *= 2;
+        }
+    }
+    *outLength = stream.total_out;
+    buffer[*outLength] = 0;
+    inflateEnd( &stream );
+    *out = buffer;
+    return HTTP_OK;
+}
+
+
+static void finishRequest( struct Request *req, int error ) {
+    if ((error == HTTP_OK) && ((req->status < 200) || (req->status > 299))) {
+        error = HTTP_ERR_STATUS;
+    }
+    req->error = error;
+    req->state = STATE_DONE;
+    dropResolver( req );                    // timed out while resolving
+    if ((error != HTTP_OK) && (error != HTTP_ERR_STATUS)) {
+        closeConnection( &req->conn );      // the others go back to the pool in http_finish()
+    }
+}
+
+
+//  Sends the request again on a new connection, the kept-alive one was closed by the server.
+static int retryRequest( struct Request *req ) {
+    int error;
+
+    closeConnection( &req->conn );
+    req->retried = 1;
+    req->reused = 0;
+    req->outSent = 0;
+    req->inLength = 0;
+    req->headerLength = 0;
+    req->status = 0;
+    error = openConnection( req );
+    if (error != HTTP_OK) {
+        finishRequest( req, error );
+        return -1;
+    }
+    return 0;
+}
+
+
+static long long nowNs( void ) {
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec*1000000000LL + now.tv_nsec;
+}
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <pthread.h>
+#include <arpa/inet.h>
+
+static int serverPort;
+static int numAccepts = 0;
+static char bigText[1000000];
+
+static void sendAll( int fd, const void *data, size_t length ) {
+    const char *cc = data;
+    while (length > 0) {
+        ssize_t num = send( fd, cc, length, MSG_NOSIGNAL );
+        if (num <= 0) {
+            return;
+        }
+        cc += num;
+        length -= num;
+    }
+}
+
+static size_t gzipText( const char *text, size_t length, char *out, size_t outSize ) {
+    z_stream stream;
+
+    memset( &stream, 0, sizeof(stream) );
+    deflateInit2( &stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY );     // 16 - gzip header
+    stream.next_in = (Bytef *)text;
+    stream.avail_in = length;
+    stream.next_out = (Bytef *)out;
+    stream.avail_out = outSize;
+    deflate( &stream, Z_FINISH );
+    deflateEnd( &stream );
+    return stream.total_out;
+}
+
+//  Sends data as chunks of at most chunkSize, a little apart so the client sees them arrive in pieces
+static void sendChunked( int fd, const char *data, size_t length, size_t chunkSize ) {
+    char line[32];
+
+    while (length > 0) {
+        size_t size = (length < chunkSize) ? length : chunkSize;
+        sendAll( fd, line, sprintf( line, "%zx\r\n", size ) );
+        sendAll( fd, data, size );
+        sendAll( fd, "\r\n", 2 );
+        data += size;
+        length -= size;
+        usleep( 1000 );
+    }
+    sendAll( fd, "0\r\n\r\n", 5 );
+}
+
+//  One connection, as many requests as the client sends on it
+static void *serveConnection( void *arg ) {
+    int fd = (int)(long)arg;
+    char request[65536], head[512], *body;
+    char *gz = malloc( sizeof(bigText) + 100000 );
+
+    while (1) {
+        char method[16], path[256];
+        size_t have = 0, contentLength = 0;
+        char *cc;
+
+        while ((cc = memmem( request, have, "\r\n\r\n", 4 )) == (char *)NULL) {
+            ssize_t num = recv( fd, &request[have], sizeof(request) - 1 - have, 0 );
+            if (num <= 0) {
+                close( fd );
+                free( gz );
+                return NULL;
+            }
+            have += num;
+        }
+        request[have] = 0;
+        body = cc + 4;
+        sscanf( request, "%15s %255s", method, path );
+        if ((cc = strcasestr( request, "Content-Length:" )) != (char *)NULL) {
+            contentLength = atoi( &cc[15] );
+        }
+        while ((size_t)(&request[have] - body) < contentLength) {
+            ssize_t num = recv( fd, &request[have], sizeof(request) - 1 - have, 0 );
+            if (num <= 0) {
+                close( fd );
+                free( gz );
+                return NULL;
+            }
+            have += num;
+        }
+        body[contentLength] = 0;
+
+        if (strcmp( path, "/plain" ) == 0) {
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\nhello plain" ) );
+        } else if (strcmp( path, "/chunked" ) == 0) {
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nX-Junk: 1\r\n\r\n" ) );
+            sendChunked( fd, "hello chunked world", 19, 5 );
+        } else if (strcmp( path, "/gzip" ) == 0) {
+            size_t length = gzipText( "hello gzip", 10, gz, sizeof(bigText) + 100000 );
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nContent-Length: %zu\r\n\r\n", length ) );
+            sendAll( fd, gz, length );
+        } else if (strcmp( path, "/big" ) == 0) {
+            size_t length = gzipText( bigText, sizeof(bigText), gz, sizeof(bigText) + 100000 );
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n" ) );
+            sendChunked( fd, gz, length, 3000 );
+        } else if (strcmp( path, "/404" ) == 0) {
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found" ) );
+        } else if (strcmp( path, "/echo" ) == 0) {
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", contentLength ) );
+            sendAll( fd, body, contentLength );
+        } else if (strcmp( path, "/slow" ) == 0) {
+            usleep( 1000000 );
+            sendAll( fd, head, sprintf( head, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nslow" ) );
+        } else if (strcmp( path, "/stall" ) == 0) {
+            usleep( 2000000 );
+            break;
+        } else {            // /close - HTTP/1.0, the end of the connection is the end of the body
+            sendAll( fd, head, sprintf( head, "HTTP/1.0 200 OK\r\n\r\nuntil close" ) );
+            break;
+        }
+    }
+    close( fd );
+    free( gz );
+    return NULL;
+}
+
+static void *serve( void *arg ) {
+    int listener = (int)(long)arg;
+
+    while (1) {
+        pthread_t thread;
+        int fd = accept( listener, NULL, NULL );
+        if (fd == -1) {
+            return NULL;
+        }
+        __sync_fetch_and_add( &numAccepts, 1 );
+        pthread_create( &thread, NULL, serveConnection, (void *)(long)fd );
+        pthread_detach( thread );
+    }
+}
+
+static int failures = 0;
+
+static void check( const char *what, int ok ) {
+    printf( "%-60s %s\n", what, ok ? "ok" : "FAILED" );
+    if (!ok) {
+        failures++;
+    }
+}
+
+static int get( const char *path, const char *postBody, int timeoutMs, struct HttpResponse *response ) {
+    char url[128];
+    sprintf( url, "http://127.0.0.1:%d%s", serverPort, path );
+    return http_finish( http_start( url, postBody, timeoutMs ), response );
+}
+
+int main() {
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    struct HttpResponse response, second;
+    pthread_t thread;
+    int listener, req1, req2, accepts;
+    long long start;
+
+    for (int iii = 0; iii < (int)sizeof(bigText); iii++) {
+        bigText[iii] = "0123456789 WSPR NQ6B DM13 "[(iii*7 + iii/100) % 26];
+    }
+    listener = socket( AF_INET, SOCK_STREAM, 0 );
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    listen( listener, 16 );
+    getsockname( listener, (struct sockaddr *)&addr, &length );
+    serverPort = ntohs( addr.sin_port );
+    pthread_create( &thread, NULL, serve, (void *)(long)listener );
+
+    get( "/plain", NULL, 2000, &response );
+    check( "Content-Length", (response.error == HTTP_OK) && (response.status == 200) && (strcmp( response.body, "hello plain" ) == 0) );
+    http_free( &response );
+    get( "/chunked", NULL, 2000, &response );
+    check( "chunked, arriving in pieces", (response.error == HTTP_OK) && (strcmp( response.body, "hello chunked world" ) == 0) && (response.reused) );
+    http_free( &response );
+    get( "/gzip", NULL, 2000, &response );
+    check( "gzip", (response.error == HTTP_OK) && (response.length == 10) && (strcmp( response.body, "hello gzip" ) == 0) );
+    http_free( &response );
+    get( "/big", NULL, 5000, &response );
+    check( "1 MB gzip and chunked", (response.error == HTTP_OK) && (response.length == sizeof(bigText))
+                                   && (memcmp( response.body, bigText, sizeof(bigText) ) == 0) && (response.bytes < 100000) );
+    printf( "      %ld bytes received for %zu, %.3f sec\n", response.bytes, response.length, response.seconds );
+    http_free( &response );
+    get( "/echo", "mode=html&band=all&limit=600", 2000, &response );
+    check( "POST, after a 100 Continue", (response.error == HTTP_OK) && (strcmp( response.body, "mode=html&band=all&limit=600" ) == 0) );
+    http_free( &response );
+    get( "/404", NULL, 2000, &response );
+    check( "404", (response.error == HTTP_ERR_STATUS) && (response.status == 404) && (strcmp( response.body, "not found" ) == 0) );
+    http_free( &response );
+    accepts = numAccepts;
+    check( "all of those on one kept-alive connection", accepts == 1 );
+
+    get( "/close", NULL, 2000, &response );
+    check( "HTTP/1.0, body until close", (response.error == HTTP_OK) && (strcmp( response.body, "until close" ) == 0) );
+    http_free( &response );
+    get( "/plain", NULL, 2000, &response );
+    check( "a new connection after the server closed it", (response.error == HTTP_OK) && (!response.reused) && (numAccepts == accepts + 1) );
+    http_free( &response );
+
+    start = nowNs();
+    get( "/stall", NULL, 500, &response );
+    check( "timeout", (response.error == HTTP_ERR_TIMEOUT) && ((nowNs() - start)/1000000 < 700) );
+    http_free( &response );
+
+    //  Two at once take as long as one
+    start = nowNs();
+    req1 = http_start( "http://127.0.0.1:0/slow", NULL, 3000 );      // port 0 is a bad URL
+    check( "bad URL", req1 == HTTP_ERR_URL );
+    {
+        char url[128];
+        sprintf( url, "http://127.0.0.1:%d/slow", serverPort );
+        req1 = http_start( url, NULL, 3000 );
+        req2 = http_start( url, NULL, 3000 );
+    }
+    http_finish( req2, &second );
+    http_finish( req1, &response );
+    printf( "      two 1 sec requests at once, %.3f sec\n", (nowNs() - start)*1e-9 );
+    check( "concurrent", (response.error == HTTP_OK) && (second.error == HTTP_OK) && ((nowNs() - start)/1000000 < 1500) );
+    http_free( &response );
+    http_free( &second );
+
+    close( listener );
+    check( "connection refused", http_finish( http_start( "http://127.0.0.1:1/", NULL, 2000 ), &response ) == HTTP_ERR_CONNECT );
+    check( "host not found", http_finish( http_start( "http://no.such.host.invalid/", NULL, 2000 ), &response ) == HTTP_ERR_RESOLVE );
+    start = nowNs();
+    check( "the deadline covers resolving", (http_finish( http_start( "http://no.such.host.invalid/", NULL, 0 ), &response ) == HTTP_ERR_TIMEOUT)
+                                            && ((nowNs() - start)/1000000 < 50) );
+    check( "not http", http_finish( http_start( "ftp://wsprnet.org/", NULL, 2000 ), &response ) == HTTP_ERR_URL );
+    printf( "%s\n", http_errorString( HTTP_ERR_TIMEOUT ) );
+    http_close();
+    printf( "%s\n", failures ? "FAILED" : "PASSED" );
+    return failures != 0;
+}
+#endif
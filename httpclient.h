@@ -0,0 +1,39 @@
+#ifndef _HTTPCLIENT_H_
+#define _HTTPCLIENT_H_
+
+#include <stddef.h>
+
+#define HTTP_MAX_REQUESTS   4           // running at once
+#define HTTP_MAX_IDLE       4           // kept-alive connections waiting to be re-used
+#define HTTP_IDLE_MAX_SEC   60          // an idle connection older than this is closed rather than re-used
+
+#define HTTP_OK             0
+#define HTTP_ERR_URL        -1          // not http://host[:port]/path or https://...
+#define HTTP_ERR_BUSY       -2          // HTTP_MAX_REQUESTS already running
+#define HTTP_ERR_RESOLVE    -3          // the host name didn't resolve
+#define HTTP_ERR_CONNECT    -4          // refused or unreachable
+#define HTTP_ERR_TLS        -5          // the handshake or the certificate
+#define HTTP_ERR_IO         -6          // send() or recv() failed, or the server closed before the response was complete
+#define HTTP_ERR_TIMEOUT    -7
+#define HTTP_ERR_PROTOCOL   -8          // not an HTTP/1.x response this understands
+#define HTTP_ERR_STATUS     -9          // the status wasn't 2xx, see status
+#define HTTP_ERR_GZIP       -10         // Content-Encoding: gzip that didn't inflate
+#define HTTP_ERR_MEMORY     -11
+
+struct HttpResponse {
+    int error;                  // HTTP_OK or one of the HTTP_ERR_
+    int status;                 // 200, 404, ..., 0 if no response came
+    char *body;                 // de-chunked and inflated, null terminated.  NULL if there was none.  http_free() it.
+    size_t length;
+    long bytes;                 // received, headers and all, before inflating
+    double seconds;             // http_start() to the end
+    int reused;                 // went over a kept-alive connection
+};
+
+extern int http_start( const char *url, const char *postBody, int timeoutMs );
+extern int http_finish( int request, struct HttpResponse *response );
+extern void http_free( struct HttpResponse *response );
+extern const char *http_errorString( int error );
+extern void http_close( void );
+
+#endif
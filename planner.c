@@ -0,0 +1,355 @@
+/*
+    planner.c - works out when everything in a beacon cycle happens, as absolute UTC times, before any of it happens.
+
+        The main loop used to count minutes: minWait started at BEACON_INTERVAL+1, dropped 4 for every beacon and 2 for doCurl(), and
+        the block started when a one minute counter caught up with it.  It only came out 28 minutes when every beacon took exactly 4
+        minutes.  Since the audio became synthesized the beacons end before second 57 and go back to back, so it didn't.
+
+        Now a cycle is a list of slots:
+            - FT8       15 s, ft8Target seconds into the odd minute before the first beacon (if ft8FreqHz)
+            - WSPR      2 min, on even minutes, spacingMin apart (2 is back to back, 4 leaves two minutes of receive between them)
+            - REPORTS   2 min, right after the last beacon, for wsprnet.org and pskreporter
+        and the time between cycles is IDLE (receive).  Cycles start intervalMin minutes apart, counted from an anchor (when the program
+        started) so they don't drift, each pushed to the next even minute.  Any interval works.  If a cycle doesn't fit in the interval
+        the next one is skipped rather than squeezed.
+
+        A transmit slot that overlaps a window in blackout.txt is held (PLAN_HOLD_BLACKOUT) and a cycle planned while it is too hot is
+        held (PLAN_HOLD_HEAT).  twsprRPI.c plans one cycle at a time, PLAN_SETUP_MS before its first slot, and runs it exactly; a slot that
+        is missed is skipped, nothing after it moves.  "./twsprRPI -n" prints the next 24 hours with planner_plan().
+
+    To test:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o planner planner.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "planner.h"
+
+long long planner_nowMs( void );
+long long planner_cycleStartMs( const struct PlanConfig *config, long long anchorMs, long long notBeforeMs );
+long long planner_firstSlotMs( const struct PlanConfig *config, long long cycleStartMs );
+int planner_cycle( const struct PlanConfig *config, long long cycleStartMs, struct PlanSlot *slots, int maxSlots );
+int planner_plan( const struct PlanConfig *config, long long anchorMs, long long fromMs, long long untilMs, struct PlanSlot *slots,
+                  int maxSlots );
+void planner_print( FILE *fptr, const struct PlanSlot *slots, int numSlots, long long nowMs );
+
+static long long leadMs( const struct PlanConfig *config );
+static void addSlot( struct PlanSlot *slot, int kind, int beacon, int freqHz, long long startMs, long long lengthMs );
+static int holdFor( const struct PlanConfig *config, const struct PlanSlot *slot );
+
+static const char *kindName[] = { "IDLE", "FT8", "WSPR", "REPORTS" };
+static const char *holdName[] = { "", "held, blackout", "held, heat" };
+
+#define MINUTE_MS       60000LL
+#define EVEN_MINUTE_MS  120000LL
+
+
+long long planner_nowMs( void ) {
+    struct timespec now;
+    clock_gettime( CLOCK_REALTIME, &now );
+    return (long long)now.tv_sec*1000 + now.tv_nsec/1000000;
+}
+
+
+//  The first cycle whose first slot is at or after notBeforeMs.  Cycle k nominally starts (its first slot) at anchorMs + k*intervalMin
+//      and the beacons are pushed to the next even minute from there.  Returns the time of the first beacon's even minute, or -1 if the
+//      interval is no good.
+long long planner_cycleStartMs( const struct PlanConfig *config, long long anchorMs, long long notBeforeMs ) {
+    long long intervalMs = config->intervalMin*MINUTE_MS;
+    long long lead = leadMs( config );
+    long long kkk = 0;
+
+    if (intervalMs <= 0) {
+        printf("planner_cycleStartMs() - interval of %d minutes\n",config->intervalMin);
+        return -1;
+    }
+    if (notBeforeMs > anchorMs) {
+        kkk = (notBeforeMs - anchorMs)/intervalMs - 1;
+        if (kkk < 0) { kkk = 0; }
+    }
+    while (1) {
+        long long nominal = anchorMs + kkk*intervalMs;
+        long long start = ((nominal + lead + EVEN_MINUTE_MS - 1)/EVEN_MINUTE_MS)*EVEN_MINUTE_MS;
+        if (start - lead >= notBeforeMs) {
+            return start;
+        }
+        kkk++;
+    }
+}
+
+
+//  When the cycle starting at cycleStartMs (from planner_cycleStartMs()) begins, the FT8 slot if there is one.
+long long planner_firstSlotMs( const struct PlanConfig *config, long long cycleStartMs ) {
+    return cycleStartMs - leadMs( config );
+}
+
+
+//  Fills slots[] with the FT8, WSPR and REPORTS slots of one cycle, in order, IDLE between them, holds applied.  Returns the number of
+//      slots, 0 if there are no beacons, or -1.
+int planner_cycle( const struct PlanConfig *config, long long cycleStartMs, struct PlanSlot *slots, int maxSlots ) {
+    long long endMs = cycleStartMs;
+    int numSlots = 0;
+
+    if ((config->spacingMin < 2) || (config->spacingMin % 2)) {
+        printf("planner_cycle() - beacons %d minutes apart, it has to be even and at least 2\n",config->spacingMin);
+        return -1;
+    }
+    if ((config->numBeacons < 0) || (config->numBeacons > PLAN_MAX_BEACONS) || (maxSlots < PLAN_MAX_SLOTS)) {
+        printf("planner_cycle() - too many beacons (%d)\n",config->numBeacons);
+        return -1;
+    }
+    if (config->numBeacons == 0) {          // the FT8 burst only goes out in front of beacons
+        return 0;
+    }
+
+    if (config->ft8FreqHz) {
+        addSlot( &slots[numSlots], PLAN_FT8, -1, config->ft8FreqHz, planner_firstSlotMs( config, cycleStartMs ), PLAN_FT8_MS );
+        endMs = slots[numSlots].startMs + slots[numSlots].lengthMs;
+        numSlots++;
+    }
+    for (int iii = 0; iii < config->numBeacons; iii++) {
+        long long startMs = cycleStartMs + iii*config->spacingMin*MINUTE_MS;
+        if ((numSlots) && (startMs > endMs)) {
+            addSlot( &slots[numSlots++], PLAN_IDLE, -1, 0, endMs, startMs - endMs );
+        }
+        addSlot( &slots[numSlots], PLAN_WSPR, iii, config->txFreqHz[iii], startMs, PLAN_WSPR_MS );
+        endMs = slots[numSlots].startMs + slots[numSlots].lengthMs;
+        numSlots++;
+    }
+    for (int iii = 0; iii < numSlots; iii++) {
+        if (slots[iii].kind != PLAN_IDLE) {
+            slots[iii].hold = holdFor( config, &slots[iii] );
+        }
+    }
+    addSlot( &slots[numSlots++], PLAN_REPORTS, -1, 0, endMs, PLAN_REPORTS_MS );
+    return numSlots;
+}
+
+
+//  Every slot from fromMs until the last cycle that begins before untilMs, with IDLE slots in between, the way twsprRPI.c would run
+//      them if nothing else changed: each cycle is planned PLAN_SETUP_MS after the previous one's reports.  heatHold only applies to
+//      the first cycle.  Returns the number of slots or -1 if they don't fit in maxSlots.
+int planner_plan( const struct PlanConfig *config, long long anchorMs, long long fromMs, long long untilMs, struct PlanSlot *slots,
+                  int maxSlots ) {
+    struct PlanConfig cycleConfig = *config;
+    long long timeMs = fromMs;
+    long long notBeforeMs = fromMs + PLAN_SETUP_MS;
+    int numSlots = 0;
+
+    while (1) {
+        long long startMs = planner_cycleStartMs( &cycleConfig, anchorMs, notBeforeMs );
+        long long firstMs;
+        int inCycle;
+
+        if (startMs < 0) {
+            return -1;
+        }
+        firstMs = planner_firstSlotMs( &cycleConfig, startMs );
+        if (firstMs >= untilMs) {
+            break;
+        }
+        if (numSlots + PLAN_MAX_SLOTS + 1 > maxSlots) {
+            printf("planner_plan() - more than %d slots\n",maxSlots);
+            return -1;
+        }
+        if (firstMs > timeMs) {
+            addSlot( &slots[numSlots++], PLAN_IDLE, -1, 0, timeMs, firstMs - timeMs );
+        }
+        inCycle = planner_cycle( &cycleConfig, startMs, &slots[numSlots], maxSlots - numSlots );
+        if (inCycle < 0) {
+            return -1;
+        }
+        if (inCycle == 0) {                     // nothing to send, the whole day is receive
+            break;
+        }
+        numSlots += inCycle;
+        timeMs = slots[numSlots-1].startMs + slots[numSlots-1].lengthMs;
+        notBeforeMs = timeMs + PLAN_SETUP_MS;
+        cycleConfig.heatHold = 0;
+    }
+    if ((timeMs < untilMs) && (numSlots < maxSlots)) {
+        addSlot( &slots[numSlots++], PLAN_IDLE, -1, 0, timeMs, untilMs - timeMs );
+    }
+    return numSlots;
+}
+
+
+//  One line per slot: start (ms since the epoch), the same in UTC, start relative to nowMs, length, what, frequency, hold.
+void planner_print( FILE *fptr, const struct PlanSlot *slots, int numSlots, long long nowMs ) {
+    char utc[32];
+    struct tm info;
+
+    fprintf(fptr,"      start ms  UTC                          from now ms    length ms  slot          freq Hz\n");
+    for (int iii = 0; iii < numSlots; iii++) {
+        time_t seconds = (time_t)(slots[iii].startMs/1000);
+        gmtime_r( &seconds, &info );
+        strftime( utc, sizeof(utc), "%Y-%m-%d %H:%M:%S", &info );
+        fprintf(fptr,"%14lld  %s.%03d  %+14lld  %11lld  %-8s",slots[iii].startMs,utc,(int)(slots[iii].startMs % 1000),
+                slots[iii].startMs - nowMs,slots[iii].lengthMs,kindName[slots[iii].kind]);
+        if (slots[iii].freqHz) {
+            fprintf(fptr,"  %11d",slots[iii].freqHz);
+        }
+        if (slots[iii].hold) {
+            fprintf(fptr,"  (%s)",holdName[slots[iii].hold]);
+        }
+        fprintf(fptr,"\n");
+    }
+}
+
+
+//  How far ahead of the first beacon's even minute the cycle begins, the FT8 slot in the odd minute before it.
+static long long leadMs( const struct PlanConfig *config ) {
+    if (config->ft8FreqHz == 0) {
+        return 0;
+    }
+    return MINUTE_MS - config->ft8Target*1000LL;
+}
+
+
+static void addSlot( struct PlanSlot *slot, int kind, int beacon, int freqHz, long long startMs, long long lengthMs ) {
+    slot->kind = kind;
+    slot->hold = PLAN_HOLD_NONE;
+    slot->beacon = beacon;
+    slot->freqHz = freqHz;
+    slot->startMs = startMs;
+    slot->lengthMs = lengthMs;
+}
+
+
+static int holdFor( const struct PlanConfig *config, const struct PlanSlot *slot ) {
+    for (int iii = 0; iii < config->numBlackouts; iii++) {
+        if ((slot->startMs < config->blackoutEndMs[iii]) && (slot->startMs + slot->lengthMs > config->blackoutStartMs[iii])) {
+            return PLAN_HOLD_BLACKOUT;
+        }
+    }
+    return config->heatHold ? PLAN_HOLD_HEAT : PLAN_HOLD_NONE;
+}
+
+
+
+//  Plans 24 hours for several schedules and checks them: beacons on even minutes, FT8 in the odd minute before, nothing overlapping,
+//      the idle slots filling the gaps, cycles at least the interval apart and averaging it, holds where they belong.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#define DAY_MS      (24*3600*1000LL)
+#define MAX_SLOTS   4000
+
+static struct PlanSlot slots[MAX_SLOTS];
+
+static int check( const char *name, const struct PlanConfig *config, long long anchorMs, long long fromMs, int print ) {
+    struct timespec t0, t1;
+    long long previousCycleMs = -1, firstCycleMs = -1, lastCycleMs = -1, previousBeaconMs = -1, timeMs = fromMs;
+    int numCycles = 0, errors = 0, numSlots;
+
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+    numSlots = planner_plan( config, anchorMs, fromMs, fromMs + DAY_MS, slots, MAX_SLOTS );
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+    if (numSlots <= 0) {
+        printf("%s: planner_plan() returned %d\n",name,numSlots);
+        return 1;
+    }
+    if (print) {
+        planner_print( stdout, slots, (numSlots < print) ? numSlots : print, fromMs );
+    }
+    for (int iii = 0; iii < numSlots; iii++) {
+        const struct PlanSlot *slot = &slots[iii];
+        if (slot->startMs != timeMs) {
+            printf("%s: slot %d starts at %lld, the last one ended at %lld\n",name,iii,slot->startMs,timeMs);
+            errors++;
+        }
+        timeMs = slot->startMs + slot->lengthMs;
+        if ((slot->kind == PLAN_WSPR) && (slot->startMs % EVEN_MINUTE_MS)) {
+            printf("%s: WSPR slot %d not on an even minute\n",name,iii);
+            errors++;
+        }
+        if ((slot->kind == PLAN_FT8) && (((slot->startMs/MINUTE_MS) % 2 != 1) || (slot->startMs % MINUTE_MS != config->ft8Target*1000LL))) {
+            printf("%s: FT8 slot %d not %d s into an odd minute\n",name,iii,config->ft8Target);
+            errors++;
+        }
+        if ((slot->kind == PLAN_WSPR) && (slot->beacon > 0) && (slot->startMs - previousBeaconMs != config->spacingMin*MINUTE_MS)) {
+            printf("%s: beacon %d not %d min after the one before\n",name,slot->beacon,config->spacingMin);
+            errors++;
+        }
+        if (slot->kind == PLAN_WSPR) {
+            previousBeaconMs = slot->startMs;
+        }
+        if ((slot->kind == PLAN_WSPR) && (slot->beacon == 0)) {
+            if ((previousCycleMs >= 0) && (slot->startMs - previousCycleMs < config->intervalMin*MINUTE_MS - EVEN_MINUTE_MS)) {
+                printf("%s: cycles %lld ms apart\n",name,slot->startMs - previousCycleMs);
+                errors++;
+            }
+            if (firstCycleMs < 0) { firstCycleMs = slot->startMs; }
+            lastCycleMs = previousCycleMs = slot->startMs;
+            numCycles++;
+        }
+    }
+    printf("%-36s %5d slots, %3d cycles, %6.2lf min apart on average, %4.0lf us\n",name,numSlots,numCycles,
+           (numCycles > 1) ? (lastCycleMs - firstCycleMs)/(double)(numCycles - 1)/MINUTE_MS : 0.0,
+           ((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)*1e-9)*1e6);
+    return errors;
+}
+
+int main( void ) {
+    struct PlanConfig config;
+    long long fromMs = 1760702400000LL + 12345;     // 2025-10-17 12:00:12.345 UTC
+    int errors = 0;
+
+    memset( &config, 0, sizeof(config) );
+    config.intervalMin = 28;
+    config.spacingMin = 4;
+    config.numBeacons = 5;
+    config.txFreqHz[0] = 21094600;  config.txFreqHz[1] = 24924650;  config.txFreqHz[2] = 28124640;
+    config.txFreqHz[3] = 50293160;  config.txFreqHz[4] = 144489160;
+    config.ft8FreqHz = 50313000;
+    config.ft8Target = 15;
+    errors += check( "28 min, 5 beacons 4 min apart, FT8", &config, fromMs + PLAN_SETUP_MS, fromMs, 12 );
+
+    config.intervalMin = 27;
+    errors += check( "27 min", &config, fromMs + PLAN_SETUP_MS, fromMs, 0 );
+
+    config.intervalMin = 15;
+    config.spacingMin = 2;
+    config.ft8FreqHz = 0;
+    errors += check( "15 min, back to back, no FT8", &config, fromMs, fromMs, 0 );
+
+    config.intervalMin = 10;
+    config.spacingMin = 4;
+    config.ft8FreqHz = 50313000;
+    config.ft8Target = 45;
+    errors += check( "10 min, too short for the cycle", &config, fromMs, fromMs, 0 );
+
+    config.spacingMin = 3;
+    if (planner_plan( &config, fromMs, fromMs, fromMs + DAY_MS, slots, MAX_SLOTS ) != -1) {
+        printf("odd spacing accepted\n");
+        errors++;
+    }
+
+    //  A blackout over the second beacon of the first cycle and heat: the first cycle is held, the rest isn't.
+    config.intervalMin = 28;
+    config.spacingMin = 4;
+    config.ft8Target = 15;
+    config.heatHold = 1;
+    config.numBlackouts = 1;
+    long long cycleMs = planner_cycleStartMs( &config, fromMs + PLAN_SETUP_MS, fromMs + PLAN_SETUP_MS );
+    config.blackoutStartMs[0] = cycleMs + 4*MINUTE_MS + 30000;
+    config.blackoutEndMs[0] = cycleMs + 4*MINUTE_MS + 40000;
+    errors += check( "blackout and heat", &config, fromMs + PLAN_SETUP_MS, fromMs, 0 );
+    int held[3] = { 0, 0, 0 };
+    for (int iii = 0; iii < 24; iii++) {
+        held[slots[iii].hold]++;
+        if ((slots[iii].kind == PLAN_WSPR) && (slots[iii].beacon == 1) && (slots[iii].startMs == cycleMs + 4*MINUTE_MS)
+                && (slots[iii].hold != PLAN_HOLD_BLACKOUT)) {
+            printf("the beacon in the blackout isn't held\n");
+            errors++;
+        }
+    }
+    printf("first 24 slots: %d sent, %d held for the blackout, %d held for heat\n",held[0],held[1],held[2]);
+    errors += (held[PLAN_HOLD_BLACKOUT] != 1) || (held[PLAN_HOLD_HEAT] != 5);
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors != 0;
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef _PLANNER_H_
+#define _PLANNER_H_
+
+#include <stdio.h>
+
+#define PLAN_IDLE           0       // receive
+#define PLAN_FT8            1
+#define PLAN_WSPR           2
+#define PLAN_REPORTS        3       // collect the reports, doCurl() and doCurlFT8()
+
+#define PLAN_HOLD_NONE      0
+#define PLAN_HOLD_BLACKOUT  1       // overlaps a window in blackout.txt, not sent
+#define PLAN_HOLD_HEAT      2       // too hot when the cycle was planned, sent only if it has cooled by then
+
+#define PLAN_MAX_BEACONS    16
+#define PLAN_MAX_BLACKOUTS  32
+#define PLAN_MAX_SLOTS      (2*PLAN_MAX_BEACONS + 2)    // one cycle: FT8, the beacons, reports and the receive time between them
+
+#define PLAN_WSPR_MS        120000
+#define PLAN_FT8_MS         15000
+#define PLAN_REPORTS_MS     120000
+#define PLAN_SETUP_MS       60000   // WSPRConfig, the temperature and blackout.txt are read this long before a cycle's first slot
+
+struct PlanConfig {
+    int intervalMin;                // start of one cycle to the start of the next, any number of minutes
+    int spacingMin;                 // start of one beacon to the start of the next, even.  2 is back to back.
+    int numBeacons;
+    int txFreqHz[PLAN_MAX_BEACONS];
+    int ft8FreqHz;                  // 0 for no FT8 burst
+    int ft8Target;                  // 15, 30 or 45, the FT8 slot in the odd minute before the first beacon
+    int heatHold;                   // too hot to transmit right now
+    int numBlackouts;
+    long long blackoutStartMs[PLAN_MAX_BLACKOUTS];
+    long long blackoutEndMs[PLAN_MAX_BLACKOUTS];
+};
+
+struct PlanSlot {
+    int kind;
+    int hold;
+    int beacon;                     // index into txFreqHz[] for PLAN_WSPR, -1 otherwise
+    int freqHz;
+    long long startMs;              // UTC, ms since the epoch
+    long long lengthMs;
+};
+
+extern long long planner_nowMs( void );
+extern long long planner_cycleStartMs( const struct PlanConfig *config, long long anchorMs, long long notBeforeMs );
+extern long long planner_firstSlotMs( const struct PlanConfig *config, long long cycleStartMs );
+extern int planner_cycle( const struct PlanConfig *config, long long cycleStartMs, struct PlanSlot *slots, int maxSlots );
+extern int planner_plan( const struct PlanConfig *config, long long anchorMs, long long fromMs, long long untilMs, struct PlanSlot *slots,
+                         int maxSlots );
+extern void planner_print( FILE *fptr, const struct PlanSlot *slots, int numSlots, long long nowMs );
+
+#endif
@@ -1,9 +1,8 @@
 /*
     To run standalone:
         - uncomment MAIN_HERE directive at the bottom of file.
-            gcc -g -Wall pskreporter.c azdist.c geodist.c grid2deg.c -lm
-        - I usually want to remove the curl command below and just read the latest x.txt file.
-        - I'll have to change the three parameters in call to doCurl() at the bottom of the file, date1/2/3 to whatever times are in the x.txt file.
+            gcc -g -Wall pskreporter.c httpclient.c xmlscan.c gridcache.c spotstore.c geodist.c grid2deg.c -lm -lz -lssl -lcrypto -pthread
+        - It queries pskreporter.info itself (httpclient.c), there is no y.txt any more.
         - The call to sendUDPEmailMsg() must be commented out.  There is a commented out print statement below it that can be restored to print its message.
 */
 #include <stdio.h>
@@ -18,8 +17,15 @@
 #include <math.h>
 #include <ctype.h>
 #include "twsprRPI.h"
-
-#define START_OF_LINE   "  <receptionReport receiverCallsign="
+#include "reports.h"
+#include "httpclient.h"
+#include "xmlscan.h"
+#include "gridcache.h"
+#include "spotstore.h"
+
+#define PSKREPORTER_URL "https://retrieve.pskreporter.info/query"
+#define QUERY           "senderCallsign=NQ6B&rronly=1&noactive=1"    // only the reception reports, not the active receivers list
+#define WINDOW_MARGIN_SEC   120         // the reports asked for start this long before the FT8 burst
 #define MAX_ENTRIES     500
 
 #define PURPLE    "\033[95m"
@@ -33,10 +39,6 @@
 #define UNDERLINE "\033[4m"
 #define END       "\033[0m"
 
-extern void azdist_(char* MyGrid, char* HisGrid,            // would normally be in a .h file but this is the only place that calls it.
-                    int* nAz, int* nDmiles, int* nDkm);
-
-
 struct Entry {
     char call[64];
     char grid[64];
@@ -49,53 +51,103 @@ struct Entry {
 };
 typedef struct Entry Entry;
 
-int doCurlFT8( time_t firstTxTime );
+struct Parse {                          // one response, for onElement()
+    Entry **entries;
+    int numEntries;
+    time_t firstTxTime;
+    int reports;                        // receptionReport elements, the ones not kept too
+    long long lastSequenceNumber;       // the cursor it ended with, 0 if it had none
+    long long maxFlowStartSeconds;
+};
+
+//  The cursor.  A query only asks for the reports pskreporter.info got after the last one (lastseqno), so the download and the parse grow
+//      with the new reports, not with the station's history.  Both come from the last response that was read.
+static long long lastSequenceNumber = 0;        // 0 until there has been a response
+static long long maxFlowStartSeconds = 0;       // its newest report
+
+int pskreporter_start( time_t firstTxTime );
+int doCurlFT8( time_t firstTxTime, int request, struct ReportTiming *timing );
 
 static int processEntries( Entry **entries, int *numEntries, time_t firstTxTime );
-static int parseXMLLine( char *string, Entry **entry, int *numEntries );
-static char* parseOneItem( char *string, char *quotedString );
-static void doOneGrid( char *his, int *nAz, int *nDmiles );
+static void onElement( const struct XmlElement *element, void *context );
+
+//  Starts the query for the FT8 reports, doCurlFT8() waits for it.  reports.c starts it together with wsprnet.org's so both are fetched
+//      at the same time.  Only the reports since the cursor are asked for, and none from before firstTxTime (0 - from before the newest
+//      report last time, or all of them the first time).  Returns the request, see http_start().
+int pskreporter_start( time_t firstTxTime ) {
+    char postBody[256];
+    long long since = (firstTxTime != 0) ? (long long)firstTxTime : maxFlowStartSeconds;
+    int length;
+
+    length = snprintf( postBody, sizeof(postBody), QUERY );
+    if (lastSequenceNumber != 0) {
+        length += snprintf( &postBody[length], sizeof(postBody) - length, "&lastseqno=%lld", lastSequenceNumber );
+    }
+    if (since != 0) {       // negative is seconds back from now
+        length += snprintf( &postBody[length], sizeof(postBody) - length, "&flowStartSeconds=%lld",
+                            -((long long)time( NULL ) - since + WINDOW_MARGIN_SEC) );
+    }
+    return http_start( PSKREPORTER_URL, postBody, REPORTS_FETCH_MAX_SEC*1000 );
+}
+
 
-int doCurlFT8( time_t firstTxTime ) {
-    FILE *fptr;
-    char *cc, string[4096];
+//  Waits for the FT8 reports from pskreporter.info (request, from pskreporter_start()) and prints them.  Called by the reports thread
+//      (reports.c), timing gets how long the fetch and the rest took.  It can be NULL.
+int doCurlFT8( time_t firstTxTime, int request, struct ReportTiming *timing ) {
     int returnValue = 0;
     Entry *entries[MAX_ENTRIES];
-    int numEntries = 0;
+    struct Parse parse;
+    struct XmlScan scan;
     int iii;
+    struct ReportTiming unused;
+    struct HttpResponse response;
+    struct timespec t1, t2;
 
-    system("curl -s -d \"senderCallsign=NQ6B\"  https://retrieve.pskreporter.info/query -o y.txt");
-
-    fptr = fopen("y.txt","rt");
-    if (fptr == (FILE *)NULL) {
+    if (timing == (struct ReportTiming *)NULL) {
+        timing = &unused;
+    }
+    memset( timing, 0, sizeof(*timing) );
+
+    http_finish( request, &response );
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+    timing->fetchSec = response.seconds;
+    timing->bytes = response.bytes;
+    timing->fetchError = response.error;
+    timing->httpStatus = response.status;
+    if (response.error != HTTP_OK) {
+        http_free( &response );
         return -1;
     }
-    //printf("\n");
-    while (!feof(fptr)) {
-        cc = fgets( string, 4096, fptr );         // read one line of the file
-        if (cc == (char *)NULL) {
-            break;
-        }
-        if (strstr( string, START_OF_LINE))  {
-            if (parseXMLLine( &string[strlen(START_OF_LINE)], entries, &numEntries ) ) {
-                break;
-            }
-        }
+
+    //  The elements go to onElement() one at a time.  It keeps this cycle's FT8 reports in entries[] and notes the cursor.
+    memset( &parse, 0, sizeof(parse) );
+    parse.entries = entries;
+    parse.firstTxTime = firstTxTime;
+    xmlscan_begin( &scan, onElement, &parse );
+    xmlscan_feed( &scan, response.body, response.length );
+    http_free( &response );
+    if (parse.lastSequenceNumber != 0) {
+        lastSequenceNumber = parse.lastSequenceNumber;
+    }
+    if (parse.maxFlowStartSeconds > maxFlowStartSeconds) {
+        maxFlowStartSeconds = parse.maxFlowStartSeconds;
     }
+    timing->rows = parse.reports;
 
-    //  The output of the above curl statement and file read is entries[], a list of all the station that heard this beacon, with duplicates removed.
-    //      Now display them.
-    processEntries( entries, &numEntries, firstTxTime );
+    //  Now display them.
+    processEntries( entries, &parse.numEntries, firstTxTime );
 
-    for (iii = 0; iii < numEntries; iii++) {
+    for (iii = 0; iii < parse.numEntries; iii++) {
         if (entries[iii] != (Entry *)NULL) {
             free( entries[iii] );
         }
     }
-    fclose(fptr);
 
     //printf("Num entries %d\n",numEntries);
 
+    timing->numSpots = timing->newSpots = parse.numEntries;
+    clock_gettime( CLOCK_MONOTONIC, &t2 );
+    timing->parseSec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec)*1e-9;
     return returnValue;
 }
 
@@ -118,13 +170,13 @@ static int processEntries( Entry **entries, int *numEntries, time_t firstTxTime
     for (int iii = 0; iii < *numEntries; iii++) {
         if (entries[iii] != (Entry *)NULL) {
             int tempInt;
-            struct tm *time_info;
+            struct tm tm, *time_info;
 
             if (strcmp("FT8",entries[iii]->mode)) { continue; }
 
             //  convert entries[iii]->seconds to long integer tseconds then parse into time structure
             sscanf( entries[iii]->seconds, "%ld", &tseconds );
-            time_info = localtime(&tseconds);
+            time_info = localtime_r( &tseconds, &tm );     // the reports thread, localtime() shares its buffer with the main thread
 
             if (tseconds < firstTxTime) { continue; } 
 
@@ -150,6 +202,24 @@ static int processEntries( Entry **entries, int *numEntries, time_t firstTxTime
             fprintf(terminal,END);
             numRecentEntries++;
 
+            //  keep it (spotstore.c)
+            {
+                struct Spot spot;
+                double dfreq = 0.0;
+
+                memset( &spot, 0, sizeof(spot) );
+                spot.time = tseconds;
+                sscanf( entries[iii]->freq, "%lf", &dfreq );
+                spot.freqHz = (uint32_t)dfreq;
+                sscanf( entries[iii]->snr, "%d", &spot.snr );
+                spot.reporter = entries[iii]->call;
+                spot.grid = entries[iii]->grid;
+                sscanf( entries[iii]->distance, "%d", &spot.distance );
+                sscanf( entries[iii]->azimuth, "%d", &spot.azimuth );
+                spot.source = SPOT_PSKREPORTER;
+                spotstore_add( &spot );
+            }
+
             //  Potentially send Email if on 6 or 2m
             {
                 double dfreq;
@@ -193,6 +263,9 @@ static int processEntries( Entry **entries, int *numEntries, time_t firstTxTime
     fprintf(terminal,END);
     //fprintf(terminal," ------- \n");
     fprintf(terminal,"Num entries %d\n",numRecentEntries);
+    if (spotstore_flush() == -1) {
+        printf("Couldn't store the FT8 spots\n");
+    }
 
     if (needToSendEmail) {
         sendUDPEmailMsg( emailMessage );
@@ -202,8 +275,9 @@ static int processEntries( Entry **entries, int *numEntries, time_t firstTxTime
 }
 
 
-static int parseXMLLine( char *string, Entry **entry, int *numEntries ) {
-  /*
+/*
+    onElement() - called by xmlscan_feed() for each element of the response, in any order, any attribute order, on as many lines as it
+    likes.  The ones it uses:
 
   <lastSequenceNumber value="42033658637"/>
   <maxFlowStartSeconds value="1702800105"/>         451 seconds after recentFlowStartSeconds (7 min 31 sec)
@@ -214,106 +288,72 @@ static int parseXMLLine( char *string, Entry **entry, int *numEntries ) {
   <receptionReport receiverCallsign="NQ6B" receiverLocator="DM12QU" senderCallsign="NQ6B" senderLocator="DM12QU"
         frequency="50313649" flowStartSeconds="1702799651" mode="FT8" isSender="1" receiverDXCC="United States" receiverDXCCCode="K"
         senderLotwUpload="2023-12-07" senderEqslAuthGuar="A" sNR="-5" />
-  <receptionReport receiverCallsign="KF6JSD" receiverLocator="DM12QU" senderCallsign="NQ6B" senderLocator="DM12QU"
-        frequency="50313627" flowStartSeconds="1702799651" mode="FT8" isSender="1" receiverDXCC="United States" receiverDXCCCode="K"
-        senderLotwUpload="2023-12-07" senderEqslAuthGuar="A" sNR="28" />
-
-  <senderSearch callsign="NQ6B" recentFlowStartSeconds="1702799654"  />
-
-  */
-    char call[64], grid[64], freq[64], seconds[64], mode[64], snr[64], distance[64], azimuth[64];
-    char *cc;
-
-    cc = parseOneItem( string, call );      if (cc == (char *)-1) { return -1; }
-    //printf("  %s\n",call);
-
-    cc = strstr( cc, "receiverLocator=" );  if (cc == (char *)NULL) { return -1; }
-    cc = parseOneItem( &cc[ strlen("receiverLocator=") ], grid );
-    grid[4] = tolower( grid[4] );       // have to convert the last two letters to lower case or else the computation of distance and azimuth won't work.
-    grid[5] = tolower( grid[5] );
-    //printf("  %s\n",grid);
 
-    cc = strstr( cc, "frequency=" );  if (cc == (char *)NULL) { return -1; }
-    cc = parseOneItem( &cc[ strlen("frequency=") ], freq );
-    //printf("  %s\n",freq);
-
-    cc = strstr( cc, "flowStartSeconds=" );  if (cc == (char *)NULL) { return -1; }
-    cc = parseOneItem( &cc[ strlen("flowStartSeconds=") ], seconds );
-    //printf("  %s\n",seconds);
-
-    cc = strstr( cc, "mode=" );  if (cc == (char *)NULL) { return -1; }
-    cc = parseOneItem( &cc[ strlen("mode=") ], mode );
-    //printf("  %s\n",mode);
-
-    cc = strstr( cc, "sNR=" );  if (cc == (char *)NULL) { return -1; }
-    cc = parseOneItem( &cc[ strlen("sNR=") ], snr );
-    //printf("  %s\n",snr);
+    A report is kept if it is FT8, not older than firstTxTime and has the six attributes below, none longer than 63 characters.
+*/
+static void onElement( const struct XmlElement *element, void *context ) {
+    static const char *names[] = { "receiverCallsign", "receiverLocator", "frequency", "flowStartSeconds", "mode", "sNR" };
+    struct Parse *parse = (struct Parse *)context;
+    const struct XmlView *values[6], *value;
+    long long seconds;
+    Entry *entry;
+
+    if (xmlscan_equals( &element->name, "lastSequenceNumber" )) {
+        value = xmlscan_attribute( element, "value" );
+        if ((value == (const struct XmlView *)NULL) || (xmlscan_long( value, &parse->lastSequenceNumber ))) {
+            parse->lastSequenceNumber = 0;
+        }
+        return;
+    }
+    if (xmlscan_equals( &element->name, "maxFlowStartSeconds" )) {
+        value = xmlscan_attribute( element, "value" );
+        if ((value == (const struct XmlView *)NULL) || (xmlscan_long( value, &parse->maxFlowStartSeconds ))) {
+            parse->maxFlowStartSeconds = 0;
+        }
+        return;
+    }
+    if (!xmlscan_equals( &element->name, "receptionReport" )) {
+        return;
+    }
+    parse->reports++;
+    if ((xmlscan_attributes( element, names, 6, values ) != 6) || (xmlscan_long( values[3], &seconds ))) {
+        return;
+    }
+    if ((seconds < parse->firstTxTime) || (!xmlscan_equals( values[4], "FT8" )) || (parse->numEntries == MAX_ENTRIES)) {
+        return;
+    }
 
-    entry[*numEntries] = malloc( sizeof( Entry ) );
-    if (entry[*numEntries] == (Entry *)NULL) {
+    entry = malloc( sizeof( Entry ) );
+    if (entry == (Entry *)NULL) {
         printf("Error in malloc()\n");
-        return -1;
+        return;
+    }
+    if ((xmlscan_copy( values[0], entry->call, sizeof(entry->call) ) < 0) || (xmlscan_copy( values[1], entry->grid, sizeof(entry->grid) ) < 0)
+            || (xmlscan_copy( values[2], entry->freq, sizeof(entry->freq) ) < 0)
+            || (xmlscan_copy( values[3], entry->seconds, sizeof(entry->seconds) ) < 0)
+            || (xmlscan_copy( values[4], entry->mode, sizeof(entry->mode) ) < 0) || (xmlscan_copy( values[5], entry->snr, sizeof(entry->snr) ) < 0)) {
+        free( entry );
+        return;
     }
+    entry->grid[4] = tolower( entry->grid[4] );     // the subsquare in lower case, the way wsprnet.org shows it
+    entry->grid[5] = tolower( entry->grid[5] );
 
-    //  get azimuth and distance
+    //  get azimuth and distance, 0 if the grid square isn't one
     {
-        int nAz,nDist2;
+        struct GridPath path;
 
-        doOneGrid( grid, &nAz, &nDist2 );
-        sprintf(azimuth,"%03d",nAz);
-        sprintf(distance,"%4d",nDist2);
+        gridcache_lookup( entry->grid, &path );
+        sprintf(entry->azimuth,"%03d",path.azimuth);
+        sprintf(entry->distance,"%4d",path.miles);
     }
-    //printf("  %s\n",distance);
-    //printf("  %s\n\n",azimuth);
 
-    strcpy( entry[*numEntries]->call,call);
-    strcpy( entry[*numEntries]->grid,grid);
-    strcpy( entry[*numEntries]->freq,freq);
-    strcpy( entry[*numEntries]->seconds,seconds);
-    strcpy( entry[*numEntries]->mode,mode);
-    strcpy( entry[*numEntries]->snr,snr);
-    strcpy( entry[*numEntries]->distance,distance);
-    strcpy( entry[*numEntries]->azimuth,azimuth);
-
-    (*numEntries)++;
-
-    return 0;
+    parse->entries[ parse->numEntries++ ] = entry;
 }
 
 
 
-/*
-    parseOneItem() - All items are in double quotes.  This function pulls one item out and returns it.  Returns a pointer to one character past the
-    quoted string or (char *)-1 on error.
-        *string - pointer to the beginning of the quoted string.  The first character is assumed to be a double quote.
-*/
-static char* parseOneItem( char *string, char *quotedString ) {
-    char *cc;
-
-    //  Find end of this quoted string.
-    cc = strchr( &string[1],'\"');                          // move past the beginning double quote and find the ending double quote
-    if (cc == (char *)NULL) { return (char *)-1; }
-    *cc = 0;
-    if (strlen( &string[1] ) > 64) { return (char *)-1; }   //  no items are greater than 64 bytes.  If found one then error.
-    strcpy(quotedString, &string[1]);
-
-    return &cc[1];
-}
-
-
-static void doOneGrid( char *his, int *nAz, int *nDmiles ) {
-    int nDkm;
-    char mine[] = "DM12qu";
-
-    azdist_( mine, his, nAz,        //  Azimuth
-                        nDmiles,    //  Distance in miles
-                        &nDkm       //  Distance in km
-                        );
-}
-
 
 
-// uncomment curl() call and, if using a different curl results, change fopen (two lines below curl) back to x.txt
 //#define MAIN_HERE 1
 #ifdef MAIN_HERE
 time_t firstTxTime;
@@ -321,7 +361,7 @@ time_t firstTxTime;
 int main() {
     //time( &firstTxTime );   // get current time
     firstTxTime = 0;        // alternatively set to 0 to get all reports
-    return doCurlFT8(firstTxTime);
+    return doCurlFT8(firstTxTime, pskreporter_start(firstTxTime), (struct ReportTiming *)NULL);
 }
 
 
@@ -1,6 +1,9 @@
 #ifndef _PSKREPORTER_H_
 #define _PSKREPORTER_H_
 
-extern int doCurlFT8( time_t firstTxTime );                       // in pskreporter.c
+struct ReportTiming;
+
+extern int pskreporter_start( time_t firstTxTime );                                   // in pskreporter.c
+extern int doCurlFT8( time_t firstTxTime, int request, struct ReportTiming *timing );
 
 #endif
@@ -1,6 +0,0 @@
-#ifndef _PULSEAUDIO_H_
-#define _PULSEAUDIO_H_
-
-extern int pulseAudioVolume( int setVolumeHigh );
-
-#endif
@@ -0,0 +1,312 @@
+/*
+    reactor.c - the one place the program sleeps.  The main loop used to block in select() for 60 seconds, and waitForTopOfEvenMinute()
+        polled time(), localtime() and ioctl(TIOCINQ) on stdin and sockRx every 10 ms.  That was about 100 wakeups a second on the Pi
+        for the whole two minutes of every beacon.
+
+        Everything that can wake the program is registered here once: stdin, the UDP receive socket, alsaplay.c's completion eventfd,
+        and a timerfd.  reactor_wait() sleeps in epoll_wait() until one of the sources in its mask is readable or an absolute
+        CLOCK_REALTIME (UTC) deadline passes.  The deadline is a timerfd armed with TFD_TIMER_ABSTIME, so it doesn't drift the way a
+        relative 60 second timeout does, and TFD_TIMER_CANCEL_ON_SET wakes the caller if NTP steps the clock so it can work the deadline
+        out again.  A signal (SIGINT, SIGUSR1, ...) interrupts the wait and returns REACTOR_SIGNAL.
+
+        Sources not in the mask are left alone, whatever is waiting on them stays there for a later call.  The caller has to read a
+        source that is returned, epoll is level triggered.
+
+        Every return from epoll_wait() is counted, by source, so the number of wakeups per beacon cycle can be printed and compared.
+
+    To test:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o reactor reactor.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "reactor.h"
+
+int reactor_open( void );
+void reactor_close( void );
+int reactor_add( int source, int fd );
+void reactor_remove( int source );
+int reactor_wait( const struct timespec *deadline, int mask );
+void reactor_nextTick( const struct timespec *limit, struct timespec *deadline );
+long reactor_wakeups( long *bySource );
+void reactor_resetWakeups( void );
+
+static int enableSources( int mask );
+
+static int epollFd = -1;
+static int timerFd = -1;
+static int sourceFd[REACTOR_NUM_SOURCES];
+static int enabledMask = 0;                     // sources epoll is currently watching
+static long wakeups[REACTOR_NUM_SOURCES];
+
+
+//  Creates the epoll set and the timer.  Does nothing if it's already open.
+int reactor_open( void ) {
+    struct epoll_event event;
+
+    if (epollFd != -1) {
+        return 0;
+    }
+    for (int iii = 0; iii < REACTOR_NUM_SOURCES; iii++) {
+        sourceFd[iii] = -1;
+    }
+    enabledMask = 0;
+
+    epollFd = epoll_create1( EPOLL_CLOEXEC );
+    if (epollFd == -1) {
+        printf("reactor_open() - epoll_create1() failed\n");
+        return -1;
+    }
+    timerFd = timerfd_create( CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC );
+    if (timerFd == -1) {
+        printf("reactor_open() - timerfd_create() failed\n");
+        close( epollFd );
+        epollFd = -1;
+        return -1;
+    }
+    memset( &event, 0, sizeof(event) );
+    event.events = EPOLLIN;
+    event.data.u32 = REACTOR_TIMEOUT;
+    if (epoll_ctl( epollFd, EPOLL_CTL_ADD, timerFd, &event )) {
+        printf("reactor_open() - unable to add the timer\n");
+        reactor_close();
+        return -1;
+    }
+    sourceFd[REACTOR_TIMEOUT] = timerFd;
+    reactor_resetWakeups();
+    return 0;
+}
+
+
+void reactor_close( void ) {
+    if (epollFd == -1) {
+        return;
+    }
+    close( timerFd );
+    close( epollFd );
+    timerFd = -1;
+    epollFd = -1;
+}
+
+
+//  Registers fd as source (REACTOR_STDIN, REACTOR_UDP or REACTOR_AUDIO), replacing whatever fd it had.  It isn't watched until a
+//      reactor_wait() asks for it.  An fd epoll can't wait on (stdin redirected from a file or /dev/null) is reported and left out, that
+//      isn't an error.
+int reactor_add( int source, int fd ) {
+    struct epoll_event event;
+
+    if ((source <= REACTOR_TIMEOUT) || (source >= REACTOR_SIGNAL) || (reactor_open())) {
+        return -1;
+    }
+    reactor_remove( source );
+    memset( &event, 0, sizeof(event) );
+    event.events = 0;
+    event.data.u32 = source;
+    if (epoll_ctl( epollFd, EPOLL_CTL_ADD, fd, &event )) {
+        if (errno == EPERM) {
+            printf("reactor_add() - fd %d can't be waited on, ignored\n",fd);
+            return 0;
+        }
+        printf("reactor_add() - epoll_ctl() failed for fd %d\n",fd);
+        return -1;
+    }
+    sourceFd[source] = fd;
+    return 0;
+}
+
+
+//  Stops watching source.  Used for stdin at end of file, which would otherwise be readable forever.
+void reactor_remove( int source ) {
+    if ((epollFd == -1) || (source <= REACTOR_TIMEOUT) || (source >= REACTOR_SIGNAL) || (sourceFd[source] == -1)) {
+        return;
+    }
+    epoll_ctl( epollFd, EPOLL_CTL_DEL, sourceFd[source], (struct epoll_event *)NULL );
+    sourceFd[source] = -1;
+    enabledMask &= ~REACTOR_MASK(source);
+}
+
+
+//  Sleeps until one of the sources in mask is readable or the absolute CLOCK_REALTIME deadline passes (no deadline if NULL).  Returns
+//      the source, REACTOR_TIMEOUT, REACTOR_SIGNAL if a signal came in, or -1 on an error.  A deadline already in the past returns
+//      REACTOR_TIMEOUT right away.
+int reactor_wait( const struct timespec *deadline, int mask ) {
+    struct itimerspec timer;
+    struct epoll_event event;
+    uint64_t expirations;
+    int numEvents;
+
+    if ((reactor_open()) || (enableSources( mask ))) {
+        return -1;
+    }
+    memset( &timer, 0, sizeof(timer) );
+    if (deadline != (struct timespec *)NULL) {
+        timer.it_value = *deadline;
+        if ((timer.it_value.tv_sec == 0) && (timer.it_value.tv_nsec == 0)) {
+            timer.it_value.tv_nsec = 1;             // zero would disarm it
+        }
+    }
+    if (timerfd_settime( timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timer, (struct itimerspec *)NULL )) {
+        printf("reactor_wait() - timerfd_settime() failed\n");
+        return -1;
+    }
+
+    numEvents = epoll_wait( epollFd, &event, 1, -1 );
+    if (numEvents < 0) {
+        if (errno == EINTR) {
+            wakeups[REACTOR_SIGNAL]++;
+            return REACTOR_SIGNAL;
+        }
+        printf("reactor_wait() - epoll_wait() failed\n");
+        return -1;
+    }
+    if (numEvents == 0) {
+        return REACTOR_SIGNAL;                      // not expected with no timeout, the caller checks again either way
+    }
+    wakeups[event.data.u32]++;
+    if (event.data.u32 == REACTOR_TIMEOUT) {
+        if (read( timerFd, &expirations, sizeof(expirations) ) < 0) { }     // ECANCELED if the clock was set, the caller re-checks the time
+    }
+    return event.data.u32;
+}
+
+
+//  The next multiple of REACTOR_TICK_SEC seconds of wall clock time, or limit if that comes first (limit may be NULL).  The countdowns
+//      on the screen use it so they change on the tens of seconds.
+void reactor_nextTick( const struct timespec *limit, struct timespec *deadline ) {
+    clock_gettime( CLOCK_REALTIME, deadline );
+    deadline->tv_sec = (deadline->tv_sec/REACTOR_TICK_SEC + 1)*REACTOR_TICK_SEC;
+    deadline->tv_nsec = 0;
+    if ((limit != (struct timespec *)NULL)
+            && ((limit->tv_sec < deadline->tv_sec) || ((limit->tv_sec == deadline->tv_sec) && (limit->tv_nsec < deadline->tv_nsec)))) {
+        *deadline = *limit;
+    }
+}
+
+
+//  Total wakeups since reactor_resetWakeups().  If bySource isn't NULL it gets the REACTOR_NUM_SOURCES counts.
+long reactor_wakeups( long *bySource ) {
+    long total = 0;
+    for (int iii = 0; iii < REACTOR_NUM_SOURCES; iii++) {
+        total += wakeups[iii];
+        if (bySource != (long *)NULL) {
+            bySource[iii] = wakeups[iii];
+        }
+    }
+    return total;
+}
+
+
+void reactor_resetWakeups( void ) {
+    memset( wakeups, 0, sizeof(wakeups) );
+}
+
+
+//  Watch exactly the registered sources in mask.  Only the ones that change cost a system call.
+static int enableSources( int mask ) {
+    struct epoll_event event;
+
+    for (int source = REACTOR_TIMEOUT + 1; source < REACTOR_SIGNAL; source++) {
+        int want = (mask & REACTOR_MASK(source)) && (sourceFd[source] != -1);
+        if (want == ((enabledMask & REACTOR_MASK(source)) != 0)) {
+            continue;
+        }
+        memset( &event, 0, sizeof(event) );
+        event.events = want ? EPOLLIN : 0;
+        event.data.u32 = source;
+        if (epoll_ctl( epollFd, EPOLL_CTL_MOD, sourceFd[source], &event )) {
+            printf("reactor_wait() - unable to change fd %d\n",sourceFd[source]);
+            return -1;
+        }
+        enabledMask ^= REACTOR_MASK(source);
+    }
+    return 0;
+}
+
+
+
+//  Checks that a deadline costs one wakeup and lands on time, that a readable source in the mask wakes it right away, that one
+//      outside the mask doesn't, and that a signal interrupts it.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <signal.h>
+
+static double secondsSince( const struct timespec *t0 ) {
+    struct timespec now;
+    clock_gettime( CLOCK_REALTIME, &now );
+    return (now.tv_sec - t0->tv_sec) + (now.tv_nsec - t0->tv_nsec)*1e-9;
+}
+
+static void onAlarm( int signal ) { }
+
+int main( void ) {
+    struct timespec t0, deadline;
+    struct sigaction psa;
+    long bySource[REACTOR_NUM_SOURCES];
+    int pipeFd[2];
+    int errors = 0;
+    int result;
+    double late;
+
+    if (reactor_open() || pipe( pipeFd ) || reactor_add( REACTOR_UDP, pipeFd[0] )) {
+        return 1;
+    }
+
+    clock_gettime( CLOCK_REALTIME, &t0 );
+    deadline = t0;
+    deadline.tv_sec += 1;
+    deadline.tv_nsec += 500000000L;
+    if (deadline.tv_nsec >= 1000000000L) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000L; }
+    result = reactor_wait( &deadline, REACTOR_MASK(REACTOR_UDP) );
+    late = secondsSince( &t0 ) - 1.5;
+    printf("deadline 1.5 s: result %d, %.3lf ms late, %ld wakeups\n",result,late*1e3,reactor_wakeups( (long *)NULL ));
+    errors += (result != REACTOR_TIMEOUT) || (late < 0.0) || (late > 0.02) || (reactor_wakeups( (long *)NULL ) != 1);
+
+    if (write( pipeFd[1], "x", 1 ) != 1) { return 1; }
+    clock_gettime( CLOCK_REALTIME, &t0 );
+    deadline = t0;
+    deadline.tv_sec += 1;
+    result = reactor_wait( &deadline, 0 );
+    printf("readable, not in the mask: result %d after %.3lf s\n",result,secondsSince( &t0 ));
+    errors += (result != REACTOR_TIMEOUT);
+    clock_gettime( CLOCK_REALTIME, &t0 );
+    result = reactor_wait( (struct timespec *)NULL, REACTOR_MASK(REACTOR_UDP) );
+    printf("readable, in the mask: result %d after %.3lf ms\n",result,secondsSince( &t0 )*1e3);
+    errors += (result != REACTOR_UDP) || (secondsSince( &t0 ) > 0.01);
+    char ccc;
+    if (read( pipeFd[0], &ccc, 1 ) != 1) { return 1; }
+
+    clock_gettime( CLOCK_REALTIME, &t0 );
+    t0.tv_sec -= 10;
+    result = reactor_wait( &t0, REACTOR_MASK(REACTOR_UDP) );
+    printf("deadline in the past: result %d\n",result);
+    errors += (result != REACTOR_TIMEOUT);
+
+    memset( &psa, 0, sizeof(psa) );
+    psa.sa_handler = onAlarm;
+    sigaction( SIGALRM, &psa, NULL );
+    alarm( 1 );
+    clock_gettime( CLOCK_REALTIME, &t0 );
+    deadline = t0;
+    deadline.tv_sec += 5;
+    result = reactor_wait( &deadline, REACTOR_MASK(REACTOR_UDP) );
+    printf("SIGALRM: result %d after %.3lf s\n",result,secondsSince( &t0 ));
+    errors += (result != REACTOR_SIGNAL);
+
+    printf("wakeups %ld:",reactor_wakeups( bySource ));
+    for (int iii = 0; iii < REACTOR_NUM_SOURCES; iii++) {
+        printf(" %ld",bySource[iii]);
+    }
+    printf("\n");
+    reactor_close();
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors != 0;
+}
+#endif
@@ -0,0 +1,25 @@
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <time.h>
+
+#define REACTOR_TIMEOUT         0       // the deadline passed
+#define REACTOR_STDIN           1
+#define REACTOR_UDP             2       // sockRx, messages from UDPRepeater4.py
+#define REACTOR_AUDIO           3       // alsaplay.c finished a buffer
+#define REACTOR_SIGNAL          4       // interrupted by a signal, check terminate
+#define REACTOR_NUM_SOURCES     5
+#define REACTOR_MASK(source)    (1 << (source))
+
+#define REACTOR_TICK_SEC        10      // waits with a countdown on the screen refresh it this often
+
+extern int reactor_open( void );
+extern void reactor_close( void );
+extern int reactor_add( int source, int fd );
+extern void reactor_remove( int source );
+extern int reactor_wait( const struct timespec *deadline, int mask );
+extern void reactor_nextTick( const struct timespec *limit, struct timespec *deadline );
+extern long reactor_wakeups( long *bySource );
+extern void reactor_resetWakeups( void );
+
+#endif
@@ -0,0 +1,431 @@
+/*
+    reports.c - collects the reports in a thread of its own.  After the beacon block main() used to wait for the reports slot and then call
+        doCurlFT8() and doCurl() itself.  Each one ran curl, waited on the network and then parsed, printed, logged and sent the Email
+        alerts, and nothing else got done meanwhile: no keyboard, no UDP, and a slow wsprnet.org pushed the next cycle late.
+
+        Now main() hands a ReportJob to reports_submit() right after the last beacon and goes straight on to the next cycle.  The reports
+        thread waits for the job's reports slot (notBeforeMs), starts the pskreporter.info (if FT8 was sent) and wsprnet.org (if a beacon
+        was sent) queries together (httpclient.c), parses each as it comes in, keeps the spots (spotstore.c), and writes how long each
+        took to REPORTS_LOG_FILENAME:
+            2026-06-21 13:28  FT8  fetch  0.84 s  parse  0.01 s   41230 bytes    12 spots   WSPR  fetch  3.10 s  parse  0.02 s  221544 bytes    48 spots   late  0.0 s
+        "late" is how long after the reports slot the job started, non-zero only if the previous cycle's reports were still running.
+
+        Some reporters upload minutes late, so wsprnet.org is asked again at the times in REPORTS_REQUERY_MIN.  doCurl() keeps the cycle's
+        spots, asks for about as many rows as the beacons had last time instead of 600, and only prints, logs and alerts the new ones:
+            2026-06-21 13:32  WSPR +4 min  fetch  1.20 s  parse  0.01 s   31870 bytes    62 rows     3 new spots
+
+        A query times out after REPORTS_FETCH_MAX_SEC so a server that hangs only holds up the reports.  A failed one is logged with what
+        went wrong, "(timed out)", "(HTTP 503)", "(connect failed)"...  One job waits while another runs, a newer job replaces one that
+        hasn't started and a job that hasn't started by its deadlineMs (the next cycle's reports slot) is dropped.  Either is logged.  An error in doCurl() or doCurlFT8() is printed and logged, it no longer stops the beacons.
+
+        The thread blocks all signals, they stay with main() and interrupt its reactor_wait().
+
+        In the simulation build (sim.c) there is no thread.  reports_submit() collects the reports right away, in the calling thread, on
+        the virtual clock, so the trace stays the same from one run to the next.
+
+    To test:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o reports reports.c planner.c -lm -pthread
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include "twsprRPI.h"
+#include "pskreporter.h"
+#include "planner.h"
+#include "reports.h"
+#include "httpclient.h"
+#include "spotstore.h"
+#include "gridcache.h"
+
+extern int wsprnet_start( void );                                                   // in wsprnet.c
+extern int doCurl( struct BeaconData *beaconData, char* termPTSNum, int requery, int request, struct ReportTiming *timing );
+
+int reports_open( void );
+void reports_close( int finishPending );
+int reports_submit( const struct ReportJob *job );
+int reports_busy( void );
+
+static void *reportsThread( void *unused );
+static void runJob( const struct ReportJob *job );
+static int waitUntil( long long whenMs );
+static const char *failure( int failed, const struct ReportTiming *timing, char *text, int size );
+static void logLine( long long whenMs, const char *text );
+
+static pthread_t thread;
+static int threadRunning = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+//  Everything below is protected by lock.
+static struct ReportJob pendingJob;
+static int jobPending = 0;
+static int running = 0;
+static int quitThread = 0;
+static int finishOnQuit = 0;
+
+
+//  Start the reports thread.  Returns 0 or -1 on error.
+int reports_open( void ) {
+#ifdef SIMULATION
+    return 0;                   // no thread, see above
+#endif
+    if (threadRunning) {
+        return 0;
+    }
+    quitThread = 0;
+    if (pthread_create( &thread, NULL, reportsThread, NULL )) {
+        printf("reports_open() - pthread_create() failed\n");
+        return -1;
+    }
+    threadRunning = 1;
+    return 0;
+}
+
+
+//  Stop the thread.  If finishPending a job already handed over is still collected (it may wait for its reports slot), otherwise only one
+//      that is running is finished.  A query isn't stopped part way, REPORTS_FETCH_MAX_SEC is the longest it can take.
+void reports_close( int finishPending ) {
+    if (!threadRunning) {
+        return;
+    }
+    pthread_mutex_lock( &lock );
+    if ((jobPending && finishPending) || running) {
+        printf("Waiting for the reports to finish\n");
+    }
+    quitThread = 1;
+    finishOnQuit = finishPending;
+    pthread_cond_signal( &cond );
+    pthread_mutex_unlock( &lock );
+    pthread_join( thread, NULL );
+    threadRunning = 0;
+    if (jobPending) {
+        char text[128];
+        snprintf( text, sizeof(text), "reports for %lld dropped, the program quit", pendingJob.notBeforeMs/1000 );
+        logLine( planner_nowMs(), text );
+        jobPending = 0;
+    }
+}
+
+
+//  Hand a job to the reports thread and return right away.  The job is copied.  Returns 0, or 1 if it replaced a job that hadn't started.
+int reports_submit( const struct ReportJob *job ) {
+    int replaced;
+
+    if (!threadRunning) {
+        runJob( job );          // the simulation
+        return 0;
+    }
+    pthread_mutex_lock( &lock );
+    replaced = jobPending;
+    if (replaced) {
+        char text[128];
+        snprintf( text, sizeof(text), "reports for %lld dropped, a newer cycle's replaced them", pendingJob.notBeforeMs/1000 );
+        logLine( planner_nowMs(), text );
+    }
+    pendingJob = *job;
+    jobPending = 1;
+    pthread_cond_signal( &cond );
+    pthread_mutex_unlock( &lock );
+    return replaced;
+}
+
+
+//  1 if a job is waiting or running.
+int reports_busy( void ) {
+    int busy;
+
+    pthread_mutex_lock( &lock );
+    busy = jobPending || running;
+    pthread_mutex_unlock( &lock );
+    return busy;
+}
+
+
+//  Waits for a job, then for its reports slot, then collects them.  The wait for the slot starts over if a newer job replaces it.
+static void *reportsThread( void *unused ) {
+    sigset_t allSignals;
+    struct ReportJob job;
+
+    sigfillset( &allSignals );
+    pthread_sigmask( SIG_BLOCK, &allSignals, (sigset_t *)NULL );
+
+    pthread_mutex_lock( &lock );
+    while (1) {
+        if (quitThread && ((!jobPending) || (!finishOnQuit))) {
+            break;
+        }
+        if (!jobPending) {
+            pthread_cond_wait( &cond, &lock );
+            continue;
+        }
+        if (planner_nowMs() < pendingJob.notBeforeMs) {
+            struct timespec until;
+            until.tv_sec = (time_t)(pendingJob.notBeforeMs/1000);
+            until.tv_nsec = (long)(pendingJob.notBeforeMs%1000)*1000000;
+            pthread_cond_timedwait( &cond, &lock, &until );      // CLOCK_REALTIME, the same clock as the plan
+            continue;
+        }
+        job = pendingJob;
+        jobPending = 0;
+        running = 1;
+        pthread_mutex_unlock( &lock );
+
+        runJob( &job );
+
+        pthread_mutex_lock( &lock );
+        running = 0;
+    }
+    http_close();           // the kept-alive connections
+    spotstore_close();
+    pthread_mutex_unlock( &lock );
+    return NULL;
+}
+
+
+//  fetch -> parse -> remove the duplicates -> print, log and alert, all done by doCurlFT8() and doCurl().  Then one line with the times.
+//      Both queries are started first, so they are fetched at the same time and the slower server sets the pace.  wsprnet.org is asked
+//      again REPORTS_REQUERY_MIN later for the reporters that upload late, doCurl() only shows what's new.  The re-queries stop if a newer
+//      cycle's job comes in or the program quits.
+static void runJob( const struct ReportJob *job ) {
+    struct ReportTiming ft8, wspr;
+    struct BeaconData beaconData[MAX_NUMBER_OF_BEACONS];
+    char termPTSNum[4];
+    char text[256], why[64];
+    int length = 0, failed;
+    int ft8Request = HTTP_ERR_URL, wsprRequest = HTTP_ERR_URL;
+    long long startMs = planner_nowMs();
+    const int requeryMin[] = REPORTS_REQUERY_MIN;
+
+    if (startMs > job->deadlineMs) {
+        snprintf( text, sizeof(text), "reports for %lld dropped, %.1lf s late", job->notBeforeMs/1000, (startMs - job->notBeforeMs)/1000.0 );
+        printf("Reports %s\n",text);
+        logLine( startMs, text );
+        return;
+    }
+
+    if (gridcache_setHome( job->locator ) == -1) {     // here and not in main(), gridcache.c is only used by this thread
+        gridcache_setHome( MY_LOCATOR );
+    }
+    if (job->firstTxTime) {
+        ft8Request = pskreporter_start( job->firstTxTime );
+    }
+    if (job->beaconWasSent) {
+        wsprRequest = wsprnet_start();
+    }
+    if (job->firstTxTime) {
+        failed = doCurlFT8( job->firstTxTime, ft8Request, &ft8 );
+        if (failed) {
+            printf("Reports - doCurlFT8() failed\n");
+        }
+        length += snprintf( &text[length], sizeof(text) - length, "FT8  fetch %5.2lf s  parse %5.2lf s  %6ld bytes  %4d spots%s   ",
+                            ft8.fetchSec, ft8.parseSec, ft8.bytes, ft8.numSpots, failure( failed, &ft8, why, sizeof(why) ) );
+    }
+    if (job->beaconWasSent) {
+        memcpy( beaconData, job->beaconData, sizeof(beaconData) );      // doCurl() trims the timestamps
+        memcpy( termPTSNum, job->termPTSNum, sizeof(termPTSNum) );
+        failed = doCurl( beaconData, termPTSNum, 0, wsprRequest, &wspr );
+        if (failed) {
+            printf("Reports - doCurl() failed\n");
+        }
+        length += snprintf( &text[length], sizeof(text) - length, "WSPR  fetch %5.2lf s  parse %5.2lf s  %6ld bytes  %4d spots%s   ",
+                            wspr.fetchSec, wspr.parseSec, wspr.bytes, wspr.numSpots, failure( failed, &wspr, why, sizeof(why) ) );
+    }
+    snprintf( &text[length], sizeof(text) - length, "late %4.1lf s", (startMs - job->notBeforeMs)/1000.0 );
+    printf("Reports %s\n",text);
+    logLine( startMs, text );
+
+    for (int iii = 1; (job->beaconWasSent) && (iii < sizeof(requeryMin)/sizeof(requeryMin[0])); iii++) {
+        if (waitUntil( job->notBeforeMs + requeryMin[iii]*60000LL )) {
+            break;
+        }
+        failed = doCurl( beaconData, termPTSNum, iii, wsprnet_start(), &wspr );
+        if (failed) {
+            printf("Reports - doCurl() failed\n");
+        }
+        snprintf( text, sizeof(text), "WSPR +%d min  fetch %5.2lf s  parse %5.2lf s  %6ld bytes  %4d rows  %4d new spots%s",
+                  requeryMin[iii], wspr.fetchSec, wspr.parseSec, wspr.bytes, wspr.rows, wspr.newSpots, failure( failed, &wspr, why, sizeof(why) ) );
+        printf("Reports %s\n",text);
+        logLine( planner_nowMs(), text );
+    }
+}
+
+
+//  What goes on the log line after a failed doCurl() or doCurlFT8(): why the fetch failed, or only that it did.  "" if it didn't.
+static const char *failure( int failed, const struct ReportTiming *timing, char *text, int size ) {
+    if (timing->fetchError == HTTP_ERR_STATUS) {
+        snprintf( text, size, " (HTTP %d)", timing->httpStatus );
+    } else if (timing->fetchError != HTTP_OK) {
+        snprintf( text, size, " (%s)", http_errorString( timing->fetchError ) );
+    } else if (failed) {
+        snprintf( text, size, " (failed)" );
+    } else {
+        text[0] = 0;
+    }
+    return text;
+}
+
+
+//  Waits until whenMs.  Returns 1 if it should stop waiting instead, the program is quitting or a newer cycle's job is waiting.  In the
+//      simulation there is nothing to wait for.
+static int waitUntil( long long whenMs ) {
+    int stop;
+
+    if (!threadRunning) {
+        return 0;
+    }
+    pthread_mutex_lock( &lock );
+    while ((!quitThread) && (!jobPending) && (planner_nowMs() < whenMs)) {
+        struct timespec until;
+        until.tv_sec = (time_t)(whenMs/1000);
+        until.tv_nsec = (long)(whenMs%1000)*1000000;
+        pthread_cond_timedwait( &cond, &lock, &until );
+    }
+    stop = quitThread || jobPending;
+    pthread_mutex_unlock( &lock );
+    return stop;
+}
+
+
+static void logLine( long long whenMs, const char *text ) {
+    FILE *fptr;
+    char timestamp[32];
+    time_t seconds = (time_t)(whenMs/1000);
+    struct tm info;
+
+    fptr = fopen( REPORTS_LOG_FILENAME, "at" );
+    if (fptr == (FILE *)NULL) {
+        return;
+    }
+    gmtime_r( &seconds, &info );
+    strftime( timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M", &info );
+    fprintf(fptr,"%s  %s\n",timestamp,text);
+    fclose(fptr);
+}
+
+
+
+//  The test replaces doCurl() and doCurlFT8() with ones that take 2 seconds and no time (and httpclient.c, spotstore.c and gridcache.c with nothing),
+//      and checks that reports_submit() doesn't wait, that a job waits for its reports slot, that a newer job replaces one that hasn't
+//      started and stops the re-queries of the one running, and what reports_close() does.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <unistd.h>
+
+static int calls = 0;
+static int requeries = 0;
+
+int wsprnet_start( void ) {
+    return 0;
+}
+
+int pskreporter_start( time_t firstTxTime ) {
+    return 1;
+}
+
+const char *http_errorString( int error ) {
+    return "timed out";
+}
+
+void http_close( void ) {
+}
+
+void spotstore_close( void ) {
+}
+
+int gridcache_setHome( const char *grid ) {
+    return 0;
+}
+
+int doCurl( struct BeaconData *beaconData, char* termPTSNum, int requery, int request, struct ReportTiming *timing ) {
+    memset( timing, 0, sizeof(*timing) );
+    if (requery) {
+        requeries++;
+        return 0;
+    }
+    sleep(2);
+    timing->fetchSec = 2.0;
+    timing->numSpots = timing->newSpots = 7;
+    calls++;
+    return 0;
+}
+
+int doCurlFT8( time_t firstTxTime, int request, struct ReportTiming *timing ) {
+    memset( timing, 0, sizeof(*timing) );
+    timing->numSpots = timing->newSpots = 3;
+    calls++;
+    return 0;
+}
+
+int main() {
+    struct ReportJob job;
+    long long startMs;
+    int errors = 0;
+
+    memset( &job, 0, sizeof(job) );
+    job.firstTxTime = 1;
+    job.beaconWasSent = 1;
+    if (reports_open()) {
+        return 1;
+    }
+
+    //  Submitted a second ahead, collected a second later
+    startMs = planner_nowMs();
+    job.notBeforeMs = startMs + 1000;
+    job.deadlineMs = startMs + 60000;
+    reports_submit( &job );
+    if (planner_nowMs() - startMs > 50) {
+        printf("reports_submit() waited %lld ms\n",planner_nowMs() - startMs);
+        errors++;
+    }
+    usleep(500000);
+    if ((calls != 0) || (!reports_busy())) {
+        printf("started before its reports slot\n");
+        errors++;
+    }
+
+    //  While it runs one job waits and a newer one replaces it.  The one running doesn't re-query, the newer one's reports slot was 11
+    //      minutes ago so its re-queries are due right away.
+    usleep(1500000);
+    job.notBeforeMs = planner_nowMs();
+    reports_submit( &job );
+    job.notBeforeMs = planner_nowMs() - 11*60000;
+    if (reports_submit( &job ) != 1) {
+        printf("the waiting job wasn't replaced\n");
+        errors++;
+    }
+    while (reports_busy()) {
+        usleep(100000);
+    }
+    if ((calls != 4) || (requeries != 2)) {
+        printf("%d calls and %d re-queries, expected 4 and 2\n",calls,requeries);
+        errors++;
+    }
+
+    //  Closed without finishing the job waiting for its slot, then closed with, which doesn't wait for the re-queries
+    job.notBeforeMs = planner_nowMs() + 60000;
+    job.deadlineMs = job.notBeforeMs + 60000;
+    reports_submit( &job );
+    startMs = planner_nowMs();
+    reports_close( 0 );
+    if ((planner_nowMs() - startMs > 100) || (calls != 4)) {
+        printf("reports_close(0) took %lld ms, %d calls\n",planner_nowMs() - startMs,calls);
+        errors++;
+    }
+    reports_open();
+    job.notBeforeMs = planner_nowMs() + 500;
+    reports_submit( &job );
+    reports_close( 1 );
+    if ((calls != 6) || (requeries != 2)) {
+        printf("reports_close(1) - %d calls and %d re-queries, expected 6 and 2\n",calls,requeries);
+        errors++;
+    }
+
+    printf("%s, see %s\n",errors ? "FAIL" : "PASS",REPORTS_LOG_FILENAME);
+    return errors;
+}
+
+#endif
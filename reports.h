@@ -0,0 +1,37 @@
+#ifndef _REPORTS_H_
+#define _REPORTS_H_
+
+#include <time.h>
+#include "twsprRPI.h"
+
+#define REPORTS_FETCH_MAX_SEC   90          // http_start() timeout, a server (or resolver) that hangs can't hold the reports thread longer than this
+#define REPORTS_LOG_FILENAME    "log_reports.txt"
+#define REPORTS_REQUERY_MIN     { 0, 4, 10 }    // wsprnet.org is asked at the reports slot and again this many minutes later, for the late uploads
+
+struct ReportTiming {           // filled in by doCurl() and doCurlFT8()
+    double fetchSec;            // from http_start() to the end of the response (httpclient.c)
+    double parseSec;            // reading the file, removing the duplicates, printing, logging and the Email alerts
+    int numSpots;               // spots read, for wsprnet.org after the duplicates are removed
+    int newSpots;               // not shown by an earlier query of the same cycle
+    long bytes;                 // received, gzip compressed
+    int rows;                   // parsed
+    int fetchError;             // HTTP_ERR_ (httpclient.h), HTTP_OK if the fetch worked
+    int httpStatus;             // the server's, 0 if there was no response
+};
+
+struct ReportJob {
+    long long notBeforeMs;      // the reports slot, the spots have had time to be uploaded.  UTC, ms since the epoch.
+    long long deadlineMs;       // a job still waiting when this passes is dropped (the next cycle's reports are due)
+    time_t firstTxTime;         // the FT8 burst, 0 if none was sent
+    int beaconWasSent;
+    struct BeaconData beaconData[MAX_NUMBER_OF_BEACONS];
+    char termPTSNum[4];
+    char locator[8];            // the home grid square from WSPRConfig, runJob() hands it to gridcache_setHome()
+};
+
+extern int reports_open( void );
+extern void reports_close( int finishPending );
+extern int reports_submit( const struct ReportJob *job );
+extern int reports_busy( void );
+
+#endif
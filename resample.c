@@ -0,0 +1,513 @@
+/*
+    resample.c - converts audio between sample rates and channel counts ahead of time, so the sound card (and pulseaudio) gets samples at
+        its own rate and nothing has to be resampled on the fly while the transmitter is keyed.  Also used by ft8decode.c to bring
+        recordings to its internal 12800 Hz.
+
+        The rates must have a reasonable ratio, L/M in lowest terms with L up to RESAMPLE_MAX_PHASES: 12000 -> 44100 is 147/40,
+        12000 -> 48000 is 4/1, 44100 -> 12800 is 128/441.  Each of the L phases of the filter is a Kaiser windowed sinc cut off at 45% of
+        the lower rate, RESAMPLE_ZEROS zero crossings each side, so images and aliases are down about 90 dB.  The taps of each phase are
+        padded to a multiple of 4 and the inner product is done 4 at a time with SSE (x86) or NEON (ARM).  On a 32 bit Pi OS NEON needs
+        -mfpu=neon-fp-armv8 (or -mfpu=neon), on 64 bit it's always there.  Anything else gets the plain C loop.
+
+        resample_convert() is the mixer: the same number of channels in and out are resampled one by one, otherwise the input channels are
+        averaged to mono and copied to every output channel.
+
+    To run the spectral purity test and the benchmark:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o resample resample.c fft.c wspr.c -lm
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLE_NEON   1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define RESAMPLE_SSE    1
+#endif
+#include "resample.h"
+
+#define RESAMPLE_MAX_PHASES 1024
+#define RESAMPLE_ZEROS      24          // sinc zero crossings each side
+#define RESAMPLE_CUTOFF     0.45        // of the lower rate
+#define KAISER_BETA         9.0
+
+struct Resampler {
+    int inRate;
+    int outRate;
+    int up;                 // L
+    int down;               // M
+    int halfTaps;           // input samples each side of the output sample
+    int taps;               // per phase, 2*halfTaps rounded up to a multiple of 4, the extra taps are 0
+    float *filter;          // [up][taps], 16 byte aligned
+};
+
+struct Resampler *resample_create( int inRate, int outRate );
+void resample_free( struct Resampler *rs );
+long resample_outputFrames( const struct Resampler *rs, long inFrames );
+long resample_process( const struct Resampler *rs, const float *in, long inFrames, float *out );
+short *resample_convert( const short *in, long inFrames, int inRate, int inChannels, int outRate, int outChannels, long *outFrames );
+long resample_convertInto( const short *in, long inFrames, int inRate, int inChannels, short *out, long maxFrames, int outRate, int outChannels );
+long resample_convertedFrames( long inFrames, int inRate, int outRate );
+
+static long process( const struct Resampler *rs, const float *in, long inFrames, float *out, int useSimd );
+static float dotProduct( const float *xx, const float *hh, int taps );
+static float dotProductScalar( const float *xx, const float *hh, int taps );
+static double besselI0( double xx );
+static short toShort( float value );
+
+
+//  Returns the filter for inRate -> outRate or NULL if the ratio needs too many phases (or malloc() fails).  Free it with resample_free().
+struct Resampler *resample_create( int inRate, int outRate ) {
+    struct Resampler *rs;
+    int gcd = inRate, other = outRate;
+    double cutoff;
+
+    if ((inRate <= 0) || (outRate <= 0)) {
+        return (struct Resampler *)NULL;
+    }
+    while (other) {
+        int temp = gcd % other;
+        gcd = other;
+        other = temp;
+    }
+    if (outRate/gcd > RESAMPLE_MAX_PHASES) {
+        printf("resample_create() - can't resample %d Hz to %d Hz\n",inRate,outRate);
+        return (struct Resampler *)NULL;
+    }
+    rs = (struct Resampler *)malloc( sizeof(struct Resampler) );
+    if (rs == (struct Resampler *)NULL) {
+        return (struct Resampler *)NULL;
+    }
+    rs->inRate = inRate;
+    rs->outRate = outRate;
+    rs->up = outRate/gcd;
+    rs->down = inRate/gcd;
+    cutoff = RESAMPLE_CUTOFF*((inRate < outRate) ? inRate : outRate);
+    rs->halfTaps = (int)ceil( RESAMPLE_ZEROS*inRate/(2.0*cutoff) );
+    rs->taps = (2*rs->halfTaps + 3) & ~3;
+    if (posix_memalign( (void **)&rs->filter, 16, (size_t)rs->up*rs->taps*sizeof(float) )) {
+        printf("resample_create() - Error in malloc()\n");
+        free( rs );
+        return (struct Resampler *)NULL;
+    }
+
+    //  Phase p is for an output sample p/up of an input sample after input sample n0.  Tap j multiplies input sample n0 - halfTaps + 1 + j.
+    for (int ppp = 0; ppp < rs->up; ppp++) {
+        for (int jjj = 0; jjj < rs->taps; jjj++) {
+            double tau = (jjj - rs->halfTaps + 1) - (double)ppp/rs->up;        // input samples from the output sample
+            double xx = 2.0*cutoff*tau/inRate;
+            double sinc = (fabs( xx ) < 1e-9) ? 1.0 : sin( M_PI*xx )/(M_PI*xx);
+            double rr = tau/rs->halfTaps;                                       // -1 to 1 across the filter
+            double kaiser = (fabs( rr ) < 1.0) ? besselI0( KAISER_BETA*sqrt( 1.0 - rr*rr ) )/besselI0( KAISER_BETA ) : 0.0;
+            rs->filter[ppp*rs->taps + jjj] = (jjj < 2*rs->halfTaps) ? 2.0*cutoff/inRate*sinc*kaiser : 0.0;
+        }
+    }
+    return rs;
+}
+
+
+void resample_free( struct Resampler *rs ) {
+    if (rs == (struct Resampler *)NULL) {
+        return;
+    }
+    free( rs->filter );
+    free( rs );
+}
+
+
+long resample_outputFrames( const struct Resampler *rs, long inFrames ) {
+    return (long)((long long)inFrames*rs->up/rs->down);
+}
+
+
+//  Mono.  out[] must hold resample_outputFrames().  Returns the number of frames written.
+long resample_process( const struct Resampler *rs, const float *in, long inFrames, float *out ) {
+    return process( rs, in, inFrames, out, 1 );
+}
+
+
+//  Converts interleaved 16 bit audio.  Returns a malloc()ed buffer of *outFrames frames of outChannels (caller frees) or NULL.
+short *resample_convert( const short *in, long inFrames, int inRate, int inChannels, int outRate, int outChannels, long *outFrames ) {
+    long maxFrames = resample_convertedFrames( inFrames, inRate, outRate );
+    short *out;
+
+    *outFrames = 0;
+    if ((maxFrames < 0) || (outChannels < 1)) {
+        return (short *)NULL;
+    }
+    out = (short *)malloc( (maxFrames + 1)*outChannels*sizeof(short) );
+    if (out == (short *)NULL) {
+        printf("resample_convert() - Error in malloc()\n");
+        return (short *)NULL;
+    }
+    *outFrames = resample_convertInto( in, inFrames, inRate, inChannels, out, maxFrames, outRate, outChannels );
+    if (*outFrames < 0) {
+        free( out );
+        *outFrames = 0;
+        return (short *)NULL;
+    }
+    return out;
+}
+
+
+//  Same as resample_convert() into a buffer that holds maxFrames frames of outChannels, for when the caller owns the memory
+//      (audiocache.c).  Returns the number of frames written or -1.
+long resample_convertInto( const short *in, long inFrames, int inRate, int inChannels, short *out, long maxFrames, int outRate, int outChannels ) {
+    struct Resampler *rs;
+    float *mono, *resampled;
+    long outFrames;
+    int passes = (inChannels == outChannels) ? inChannels : 1;
+
+    if ((inChannels < 1) || (outChannels < 1)) {
+        return -1;
+    }
+    rs = resample_create( inRate, outRate );
+    if (rs == (struct Resampler *)NULL) {
+        return -1;
+    }
+    outFrames = resample_outputFrames( rs, inFrames );
+    if (outFrames > maxFrames) {
+        printf("resample_convertInto() - %ld frames won't fit in %ld\n",outFrames,maxFrames);
+        resample_free( rs );
+        return -1;
+    }
+    mono = (float *)malloc( inFrames*sizeof(float) );
+    resampled = (float *)malloc( outFrames*sizeof(float) );
+    if ((mono == (float *)NULL) || (resampled == (float *)NULL)) {
+        printf("resample_convertInto() - Error in malloc()\n");
+        outFrames = -1;
+    }
+
+    for (int pass = 0; (outFrames >= 0) && (pass < passes); pass++) {
+        if (passes > 1) {
+            for (long iii = 0; iii < inFrames; iii++) {
+                mono[iii] = in[iii*inChannels + pass];
+            }
+        } else {
+            for (long iii = 0; iii < inFrames; iii++) {
+                float sum = 0.0f;
+                for (int ccc = 0; ccc < inChannels; ccc++) {
+                    sum += in[iii*inChannels + ccc];
+                }
+                mono[iii] = sum/inChannels;
+            }
+        }
+        process( rs, mono, inFrames, resampled, 1 );
+        for (long iii = 0; iii < outFrames; iii++) {
+            if (passes > 1) {
+                out[iii*outChannels + pass] = toShort( resampled[iii] );
+            } else {
+                for (int ccc = 0; ccc < outChannels; ccc++) {
+                    out[iii*outChannels + ccc] = toShort( resampled[iii] );
+                }
+            }
+        }
+    }
+    free( mono );
+    free( resampled );
+    resample_free( rs );
+    return outFrames;
+}
+
+
+//  Frames resample_convert() makes from inFrames, without working out the filter.  -1 if the rates are no good.
+long resample_convertedFrames( long inFrames, int inRate, int outRate ) {
+    int gcd = inRate, other = outRate;
+
+    if ((inRate <= 0) || (outRate <= 0)) {
+        return -1;
+    }
+    while (other) {
+        int temp = gcd % other;
+        gcd = other;
+        other = temp;
+    }
+    return (long)((long long)inFrames*(outRate/gcd)/(inRate/gcd));
+}
+
+
+//  Output sample m is at input position m*down/up.  Rather than divide for every sample the whole and fractional parts are stepped.
+static long process( const struct Resampler *rs, const float *in, long inFrames, float *out, int useSimd ) {
+    long outFrames = resample_outputFrames( rs, inFrames );
+    long index = 0;                     // input sample at or before the output sample
+    int phase = 0;                      // in units of 1/up of an input sample
+    int stepWhole = rs->down/rs->up, stepPhase = rs->down % rs->up;
+
+    for (long mmm = 0; mmm < outFrames; mmm++) {
+        long start = index - rs->halfTaps + 1;
+        const float *hh = &rs->filter[phase*rs->taps];
+
+        if ((start >= 0) && (start + rs->taps <= inFrames)) {
+            out[mmm] = useSimd ? dotProduct( &in[start], hh, rs->taps ) : dotProductScalar( &in[start], hh, rs->taps );
+        } else {
+            float sum = 0.0f;               // the ends, where the filter hangs off the input
+            for (int jjj = 0; jjj < rs->taps; jjj++) {
+                if ((start + jjj >= 0) && (start + jjj < inFrames)) {
+                    sum += in[start + jjj]*hh[jjj];
+                }
+            }
+            out[mmm] = sum;
+        }
+        index += stepWhole;
+        phase += stepPhase;
+        if (phase >= rs->up) {
+            phase -= rs->up;
+            index++;
+        }
+    }
+    return outFrames;
+}
+
+
+//  taps is a multiple of 4 and hh is 16 byte aligned.  xx can be anywhere.
+static float dotProduct( const float *xx, const float *hh, int taps ) {
+#if defined(RESAMPLE_NEON)
+    float32x4_t acc = vdupq_n_f32( 0.0f );
+    float32x2_t sum;
+    for (int jjj = 0; jjj < taps; jjj += 4) {
+        acc = vmlaq_f32( acc, vld1q_f32( &xx[jjj] ), vld1q_f32( &hh[jjj] ) );
+    }
+    sum = vadd_f32( vget_low_f32( acc ), vget_high_f32( acc ) );
+    return vget_lane_f32( vpadd_f32( sum, sum ), 0 );
+#elif defined(RESAMPLE_SSE)
+    __m128 acc = _mm_setzero_ps();
+    for (int jjj = 0; jjj < taps; jjj += 4) {
+        acc = _mm_add_ps( acc, _mm_mul_ps( _mm_loadu_ps( &xx[jjj] ), _mm_load_ps( &hh[jjj] ) ) );
+    }
+    acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+    acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+    return _mm_cvtss_f32( acc );
+#else
+    return dotProductScalar( xx, hh, taps );
+#endif
+}
+
+
+static float dotProductScalar( const float *xx, const float *hh, int taps ) {
+    float sum = 0.0f;
+    for (int jjj = 0; jjj < taps; jjj++) {
+        sum += xx[jjj]*hh[jjj];
+    }
+    return sum;
+}
+
+
+//  Modified Bessel function of the first kind, order 0, for the Kaiser window.  The series converges quickly for the betas used here.
+static double besselI0( double xx ) {
+    double sum = 1.0, term = 1.0;
+    for (int kkk = 1; kkk < 50; kkk++) {
+        term *= (xx/(2.0*kkk))*(xx/(2.0*kkk));
+        sum += term;
+        if (term < 1e-12*sum) {
+            break;
+        }
+    }
+    return sum;
+}
+
+
+static short toShort( float value ) {
+    return (short)((value > 32767.0f) ? 32767 : ((value < -32768.0f) ? -32768 : lrintf( value )));
+}
+
+
+
+//  Spectral purity test and benchmark.
+//      - 12 kHz tones across the 200 Hz WSPR window (1400 - 1600 Hz) are resampled to 44.1 and 48 kHz.  A Blackman-Harris FFT of the
+//        output must show nothing within 100 Hz of the window above PURITY_LIMIT_DBC, other than the tones that went in, and nothing
+//        anywhere else below the new Nyquist above IMAGE_LIMIT_DBC.
+//      - The WSPR beacon resampled from 12 kHz must be within PURITY_LIMIT_DBC of the beacon synthesized at 44.1 or 48 kHz, in the window.
+//      - Stereo to mono, mono to stereo and the passthrough case give the right samples.
+//      - Frames per second per core, SIMD and plain C, for the rate pairs used.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <time.h>
+#include "fft.h"
+#include "wspr.h"
+
+#define PURITY_FFT_SIZE     (1 << 18)
+#define PURITY_LIMIT_DBC    (-90.0)
+#define IMAGE_LIMIT_DBC     (-80.0)
+#define EXCLUDE_HZ          3.0         // either side of each tone that went in, the window's main lobe
+
+static struct FFTPlan *purityPlan;
+
+//  Spectrum in dB of the middle PURITY_FFT_SIZE samples of out[].
+static void spectrum( const float *out, long numFrames, double *db ) {
+    struct Complex *buf = (struct Complex *)malloc( PURITY_FFT_SIZE*sizeof(struct Complex) );
+    long offset = (numFrames - PURITY_FFT_SIZE)/2;
+
+    for (int iii = 0; iii < PURITY_FFT_SIZE; iii++) {
+        double ww = 2.0*M_PI*iii/(PURITY_FFT_SIZE - 1);
+        double bh = 0.35875 - 0.48829*cos( ww ) + 0.14128*cos( 2.0*ww ) - 0.01168*cos( 3.0*ww );
+        buf[iii].re = out[offset + iii]*bh;
+        buf[iii].im = 0.0;
+    }
+    fft_forward( purityPlan, buf );
+    for (int iii = 0; iii < PURITY_FFT_SIZE/2; iii++) {
+        db[iii] = 10.0*log10( buf[iii].re*buf[iii].re + buf[iii].im*buf[iii].im + 1e-30 );
+    }
+    free( buf );
+}
+
+//  Worst level (dBc) in [loHz, hiHz] more than EXCLUDE_HZ from any of the tones, and where it is.
+static double worstSpur( const double *db, int outRate, const double *tones, int numTones, double loHz, double hiHz, double *where ) {
+    double binHz = (double)outRate/PURITY_FFT_SIZE, carrier = -1e9, worst = -1e9;
+
+    for (int iii = 0; iii < PURITY_FFT_SIZE/2; iii++) {
+        if (db[iii] > carrier) { carrier = db[iii]; }
+    }
+    for (int iii = (int)(loHz/binHz); (iii <= (int)(hiHz/binHz)) && (iii < PURITY_FFT_SIZE/2); iii++) {
+        int near = 0;
+        for (int ttt = 0; ttt < numTones; ttt++) {
+            if (fabs( iii*binHz - tones[ttt] ) < EXCLUDE_HZ) { near = 1; }
+        }
+        if (!near && (db[iii] - carrier > worst)) {
+            worst = db[iii] - carrier;
+            *where = iii*binHz;
+        }
+    }
+    return worst;
+}
+
+//  The NQ6B DM12 37 beacon at 1500 Hz as floats at any rate, the phase worked out from the time of each sample so the 12 kHz and the
+//  44.1/48 kHz versions are samples of the same waveform.  One second of silence first, same as wspr_generate().
+static void beacon( int rate, float *out, long *numFrames ) {
+    unsigned char symbols[WSPR_NUM_SYMBOLS];
+    double symbolSeconds = (double)WSPR_SAMPLES_PER_SYMBOL/WSPR_SAMPLE_RATE, startPhase[WSPR_NUM_SYMBOLS];
+
+    wspr_encode( "NQ6B", "DM12", 37, symbols );
+    startPhase[0] = 0.0;
+    for (int kkk = 1; kkk < WSPR_NUM_SYMBOLS; kkk++) {
+        startPhase[kkk] = fmod( startPhase[kkk-1] + 2.0*M_PI*(1500.0 + (symbols[kkk-1] - 1.5)*WSPR_TONE_SPACING)*symbolSeconds, 2.0*M_PI );
+    }
+    *numFrames = (long)((1.0 + WSPR_NUM_SYMBOLS*symbolSeconds)*rate);
+    for (long mmm = 0; mmm < *numFrames; mmm++) {
+        double tt = (double)mmm/rate - 1.0;
+        int kkk = (int)floor( tt/symbolSeconds );
+        out[mmm] = ((kkk < 0) || (kkk >= WSPR_NUM_SYMBOLS)) ? 0.0f :
+                   15000.0*sin( startPhase[kkk] + 2.0*M_PI*(1500.0 + (symbols[kkk] - 1.5)*WSPR_TONE_SPACING)*(tt - kkk*symbolSeconds) );
+    }
+}
+
+static double elapsed( const struct timespec *t0 ) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec)/1e9;
+}
+
+int main() {
+    static const int outRates[2] = { 44100, 48000 };
+    static const double tones[5] = { 1400.0, 1450.0, 1500.0, 1550.0, 1600.0 };
+    static const int benchRates[3][2] = { { 12000, 48000 }, { 12000, 44100 }, { 44100, 12800 } };
+    long inFrames = 30*12000, outFrames;
+    float *in, *out;
+    double *db, where = 0.0;
+    int errors = 0;
+
+    purityPlan = fft_plan( PURITY_FFT_SIZE );
+    db = (double *)malloc( PURITY_FFT_SIZE/2*sizeof(double) );
+    in = (float *)malloc( WSPR_BUFFER_SAMPLES*sizeof(float) );
+    out = (float *)malloc( 5*WSPR_BUFFER_SAMPLES*sizeof(float) );
+
+    for (int rrr = 0; rrr < 2; rrr++) {
+        struct Resampler *rs = resample_create( 12000, outRates[rrr] );
+        double inBand, image;
+
+        //  Five tones at once, each 6 dB below full scale over five.
+        for (long iii = 0; iii < inFrames; iii++) {
+            in[iii] = 0.0f;
+            for (int ttt = 0; ttt < 5; ttt++) {
+                in[iii] += 3000.0*sin( 2.0*M_PI*tones[ttt]*iii/12000.0 + ttt );
+            }
+        }
+        outFrames = resample_process( rs, in, inFrames, out );
+        spectrum( out, outFrames, db );
+        inBand = worstSpur( db, outRates[rrr], tones, 5, 1400.0 - 100.0, 1600.0 + 100.0, &where );
+        printf("12000 -> %d, tones: worst in the WSPR window %6.1lf dBc at %7.1lf Hz", outRates[rrr], inBand, where);
+        image = worstSpur( db, outRates[rrr], tones, 5, 0.0, outRates[rrr]/2.0, &where );
+        printf(", anywhere %6.1lf dBc at %7.1lf Hz\n", image, where);
+        if ((inBand > PURITY_LIMIT_DBC) || (image > IMAGE_LIMIT_DBC)) { errors++; }
+
+        //  The beacon.  Its own FSK sidebands fill the window, so what's measured is the difference between the resampled beacon and the
+        //  same beacon synthesized directly at the output rate.
+        {
+            float *direct = (float *)malloc( 5*WSPR_BUFFER_SAMPLES*sizeof(float) );
+            double carrier = -1e9, residual;
+            long directFrames;
+
+            beacon( 12000, in, &inFrames );
+            outFrames = resample_process( rs, in, inFrames, out );
+            beacon( outRates[rrr], direct, &directFrames );
+            spectrum( direct, outFrames, db );
+            for (int iii = 0; iii < PURITY_FFT_SIZE/2; iii++) {
+                if (db[iii] > carrier) { carrier = db[iii]; }
+            }
+            for (long iii = 0; iii < outFrames; iii++) { out[iii] -= direct[iii]; }
+            spectrum( out, outFrames, db );
+            residual = -1e9;
+            for (int iii = (int)(1400.0*PURITY_FFT_SIZE/outRates[rrr]); iii <= (int)(1600.0*PURITY_FFT_SIZE/outRates[rrr]); iii++) {
+                if (db[iii] - carrier > residual) {
+                    residual = db[iii] - carrier;
+                    where = (double)iii*outRates[rrr]/PURITY_FFT_SIZE;
+                }
+            }
+            printf("12000 -> %d, WSPR beacon: worst error in the window %6.1lf dBc at %7.1lf Hz\n", outRates[rrr], residual, where);
+            if (residual > PURITY_LIMIT_DBC) { errors++; }
+            free( direct );
+            inFrames = 30*12000;
+        }
+        resample_free( rs );
+    }
+
+    //  The mixer
+    {
+        short stereo[2*4800], *conv;
+        long frames;
+        for (int iii = 0; iii < 4800; iii++) {
+            stereo[2*iii] = (short)(8000.0*sin( 2.0*M_PI*1000.0*iii/48000.0 ));
+            stereo[2*iii+1] = -stereo[2*iii]/2;
+        }
+        conv = resample_convert( stereo, 4800, 48000, 2, 48000, 1, &frames );       // (x - x/2)/2 = x/4
+        if ((frames != 4800) || (abs( conv[2400] - stereo[4800]/4 ) > 2)) { printf("stereo -> mono wrong\n"); errors++; }
+        free( conv );
+        conv = resample_convert( stereo, 4800, 48000, 2, 48000, 2, &frames );       // same rate, same channels
+        if ((frames != 4800) || (abs( conv[4801] - stereo[4801] ) > 1)) { printf("stereo passthrough wrong\n"); errors++; }
+        free( conv );
+        conv = resample_convert( stereo, 4800, 48000, 2, 12000, 2, &frames );
+        if ((frames != 1200) || (abs( conv[1200] - stereo[4800] ) > 40) || (abs( conv[1201] - stereo[4801] ) > 40)) { printf("48000 -> 12000 wrong\n"); errors++; }
+        free( conv );
+    }
+
+    //  Benchmark, one thread.
+    for (int bbb = 0; bbb < 3; bbb++) {
+        struct Resampler *rs = resample_create( benchRates[bbb][0], benchRates[bbb][1] );
+        struct timespec t0;
+        double simd, scalar;
+        long frames = 20*benchRates[bbb][0];
+
+        for (long iii = 0; iii < frames; iii++) { in[iii] = sin( 0.1*iii ); }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        outFrames = process( rs, in, frames, out, 1 );
+        simd = elapsed( &t0 );
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        process( rs, in, frames, out, 0 );
+        scalar = elapsed( &t0 );
+        printf("%5d -> %5d: %d taps, %.1lf M output frames/sec (plain C %.1lf M), a WSPR beacon takes %.0lf ms\n", benchRates[bbb][0],
+               benchRates[bbb][1], rs->taps, outFrames/simd/1e6, outFrames/scalar/1e6, 110.6*benchRates[bbb][1]/(outFrames/simd)*1e3);
+        resample_free( rs );
+    }
+
+    fft_freePlan( purityPlan );
+    free( db );
+    free( in );
+    free( out );
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _RESAMPLE_H_
+#define _RESAMPLE_H_
+
+struct Resampler;               // polyphase filter for one pair of rates, read only once made so threads can share it
+
+extern struct Resampler *resample_create( int inRate, int outRate );
+extern void resample_free( struct Resampler *rs );
+extern long resample_outputFrames( const struct Resampler *rs, long inFrames );
+extern long resample_process( const struct Resampler *rs, const float *in, long inFrames, float *out );
+extern short *resample_convert( const short *in, long inFrames, int inRate, int inChannels, int outRate, int outChannels, long *outFrames );
+extern long resample_convertInto( const short *in, long inFrames, int inRate, int inChannels, short *out, long maxFrames, int outRate,
+                                  int outChannels );
+extern long resample_convertedFrames( long inFrames, int inRate, int outRate );
+
+#endif
@@ -0,0 +1,789 @@
+/*
+    sim.c - runs twsprRPI on a virtual clock, with no radio, sound card, temperature sensor or network, so a day of beacon cycles takes
+        seconds instead of a day.  It is linked in place of ft847.c, getTempData.c, alsaplay.c, reactor.c and httpclient.c and provides
+        their functions, and the linker sends time(), clock_gettime(), clock_nanosleep(), usleep(), system(), sendto() and recvfrom()
+        here (--wrap) instead of to libc.  Built with -DSIMULATION twsprRPI.c skips findttyUSB() and hands every cycle's plan to
+        sim_traceSlots(), and wav_output3.c makes all the audio at 12 kHz mono.
+
+        The clock only moves when the program waits: reactor_wait() jumps straight to its deadline, or to the next event in the mask
+        that comes first (a scheduled "txMode;" UDP message, the end of the audio).  Sleeps jump by their length.  Everything the
+        program computes takes no time at all, so the same scenario always gives the same trace.
+
+        Radio, GPIO, audio and network are fakes that write to SIM_TRACE_FILENAME, one line per event with the virtual time in ms and UTC:
+            PLAN    the slots planner_cycle() made for a cycle (planner_print())
+            CAT     every frequency or mode written to the FT847
+            PTT     every MOX edge, with how long it was keyed and how far ahead of the first tone it was keyed
+            AUDIO   every burst started, when its first tone leaves and how long it is
+            UDP     messages sent (SDRPlay, preamp.py, Email) and the "txMode;" messages received
+            POWER   the FT847 switched off or on by the heat logic
+            HTTP    wsprnet.org and pskreporter queries.  The response is the canned sim_x.txt (wsprnet.org) or sim_y.txt (pskreporter)
+                    if there is one, otherwise it is empty.
+        At the end the totals are added to the trace and printed on stderr: cycles, how far apart they were, slots held and sent, time
+        keyed, wakeups.  The trace can be diffed between two builds to see what a scheduler change did.
+
+        The scenario is read from SIM_SCENARIO_FILENAME in the current directory.  Times of day are UTC and repeat every day.  TZ is set to
+        UTC so blackout.txt (local time) is in UTC too.  For example:
+            startUTC  2026-06-21 00:00:00
+            runHours  24
+            tempDegF  00:00  66.0
+            tempDegF  13:00  87.5                       cycles held
+            tempDegF  14:00  91.0                       FT847 powered off
+            tempDegF  16:00  84.0                       powered back on
+            txModeAt  06:30:00                          WSJT-X keyed the FT847 (UDP "txMode;")
+            blackout  2026-06-21 18:14:00, 2026-06-21 18:18:00
+        Blackout lines replace blackout.txt.  Without a scenario file it won't start, so it can't be run in the real directory by mistake
+        and overwrite the logs.
+
+    To run a day in a scratch directory with a WSPRConfig (an audioFmt line is checked but the audio is always 12 kHz mono, see
+        setAudioFormat() in wav_output3.c, so nothing is resampled):
+        gcc -g -Wall -DSIMULATION -o twsprSim twsprRPI.c wav_output3.c wspr.c ft8.c wsprnet.c htmlscan.c spottable.c gridcache.c spotstore.c geodist.c grid2deg.c txgain.c resample.c audiocache.c planner.c pskreporter.c xmlscan.c reports.c sim.c -lrt -lm -pthread -Wl,--wrap=time,--wrap=clock_gettime,--wrap=clock_nanosleep,--wrap=usleep,--wrap=system,--wrap=sendto,--wrap=recvfrom
+        ./twsprSim < /dev/null > /dev/null
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "twsprRPI.h"
+#include "ft847.h"
+#include "getTempData.h"
+#include "alsaplay.h"
+#include "reactor.h"
+#include "planner.h"
+#include "httpclient.h"
+#include "sim.h"
+
+#define SIM_MAX_EVENTS      256
+#define SIM_MAX_TEMPS       64
+#define SIM_MAX_CYCLES      1024
+#define NS                  1000000000LL
+#define DAY_SEC             86400LL
+
+//  ft847.c
+int ft847_open( void );
+int ft847_close( void );
+int ft847_FETMOXOn( void );
+int ft847_FETMOXOff( void );
+int ft847_writeFreqHz( int freq );
+int ft847_dialFreqHz( int freq );
+int ft847_setUSBMode( void );
+//  getTempData.c
+double getTempData( void );
+int powerOnOffFT847( int powerOn );
+//  alsaplay.c
+int alsaplay_open( const char *device );
+void alsaplay_close( void );
+int alsaplay_start( const short *samples, int numFrames, int rate, int channels, const struct timespec *startTime );
+int alsaplay_eventFd( void );
+int alsaplay_wait( int timeoutMs );
+void alsaplay_stop( void );
+long alsaplay_framesWritten( void );
+int alsaplay_startError( double *errorSec );
+//  reactor.c
+int reactor_open( void );
+void reactor_close( void );
+int reactor_add( int source, int fd );
+void reactor_remove( int source );
+int reactor_wait( const struct timespec *deadline, int mask );
+void reactor_nextTick( const struct timespec *limit, struct timespec *deadline );
+long reactor_wakeups( long *bySource );
+void reactor_resetWakeups( void );
+//  httpclient.c
+int http_start( const char *url, const char *postBody, int timeoutMs );
+int http_finish( int request, struct HttpResponse *response );
+void http_free( struct HttpResponse *response );
+const char *http_errorString( int error );
+void http_close( void );
+//  libc, through -Wl,--wrap
+time_t __wrap_time( time_t *tloc );
+int __wrap_clock_gettime( clockid_t clockId, struct timespec *ts );
+int __wrap_clock_nanosleep( clockid_t clockId, int flags, const struct timespec *request, struct timespec *remain );
+int __wrap_usleep( useconds_t usec );
+int __wrap_system( const char *command );
+ssize_t __wrap_sendto( int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrLen );
+ssize_t __wrap_recvfrom( int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrLen );
+extern int __real_clock_gettime( clockid_t clockId, struct timespec *ts );
+
+void sim_traceSlots( const struct PlanSlot *slots, int numSlots );
+
+static void simInit( void );
+static int readScenario( void );
+static int timeOfDay( const char *string, long long *secOfDay );
+static void advanceTo( long long ns );
+static void trace( const char *format, ... );
+static void summary( void );
+
+static int initialized = 0;
+static FILE *traceFile;
+static long long simNs;                 // the virtual CLOCK_REALTIME, ns since the epoch
+static long long startNs;
+static long long endNs;
+static int ended = 0;
+static struct timespec wallStart;
+
+static char httpUrl[HTTP_MAX_REQUESTS][256];      // the requests started, "" if free
+
+static long long txModeNs[SIM_MAX_EVENTS];      // "txMode;" arrives on sockRx at these times, in order
+static int numTxModes = 0;
+static int nextTxMode = 0;
+static long long tempSec[SIM_MAX_TEMPS];        // temperature profile, seconds into the UTC day, in order
+static double tempDegF[SIM_MAX_TEMPS];
+static int numTemps = 0;
+
+static int watchedMask = 0;                     // reactor_add()ed sources
+static long wakeups[REACTOR_NUM_SOURCES];
+static long totalWakeups = 0;
+
+static int catFreqHz = 0;                       // last frequency written
+static int pttOn = 0;
+static long long pttOnNs;
+static int radioPowered = 1;
+static int playing = 0;                         // a burst is in the fake sound card
+static long long audioFirstToneNs;
+static long long audioEndNs;
+static long audioFrames = 0;
+
+static int numCycles = 0;
+static long long cycleMs[SIM_MAX_CYCLES];       // first beacon of each cycle
+static int slotsPlanned = 0, heldBlackout = 0, heldHeat = 0;
+static int burstsWSPR = 0, burstsFT8 = 0, catWrites = 0, powerCycles = 0, txModesReceived = 0;
+static long long keyedNs = 0;
+static long long leadMinNs = LLONG_MAX, leadMaxNs = LLONG_MIN;  // PTT on to the first tone
+
+
+//
+//  ft847.c
+//
+int ft847_open( void ) {
+    simInit();
+    trace("CAT     open\n");
+    return 3;                   // looks like a file descriptor
+}
+
+
+int ft847_close( void ) {
+    trace("CAT     close\n");
+    return 0;
+}
+
+
+int ft847_FETMOXOn( void ) {
+    simInit();
+    if (pttOn) {
+        trace("PTT     on again, already keyed\n");
+        return 0;
+    }
+    pttOn = 1;
+    pttOnNs = simNs;
+    if ((playing) && (audioFirstToneNs > simNs - NS)) {
+        long long leadNs = audioFirstToneNs - simNs;
+        if (leadNs < leadMinNs) { leadMinNs = leadNs; }
+        if (leadNs > leadMaxNs) { leadMaxNs = leadNs; }
+        trace("PTT     on   %d Hz, first tone in %+.3lf s\n",catFreqHz,leadNs/(double)NS);
+    } else {
+        trace("PTT     on   %d Hz, no audio playing\n",catFreqHz);
+    }
+    if (!radioPowered) {
+        trace("PTT     on with the FT847 powered off\n");
+    }
+    return 0;
+}
+
+
+int ft847_FETMOXOff( void ) {
+    simInit();
+    if (!pttOn) {
+        return 0;
+    }
+    pttOn = 0;
+    keyedNs += simNs - pttOnNs;
+    trace("PTT     off  keyed %.3lf s\n",(simNs - pttOnNs)/(double)NS);
+    return 0;
+}
+
+
+int ft847_writeFreqHz( int freq ) {
+    simInit();
+    catFreqHz = (freq/10)*10;       // the FT847 drops the units digit
+    catWrites++;
+    trace("CAT     freq %d\n",catFreqHz);
+    return 0;
+}
+
+
+//  Same as ft847.c.
+int ft847_dialFreqHz( int freq ) {
+    return ((freq + 5) / 10) * 10;
+}
+
+
+int ft847_setUSBMode( void ) {
+    simInit();
+    catWrites++;
+    trace("CAT     USB\n");
+    return 0;
+}
+
+
+//
+//  getTempData.c - the temperature comes from the scenario's tempDegF lines.  The last one at or before the time of day applies, before
+//      the first one of the day the last one of the day before does.
+//
+double getTempData( void ) {
+    long long secOfDay;
+
+    simInit();
+    if (numTemps == 0) {
+        return 70.0;
+    }
+    secOfDay = (simNs/NS) % DAY_SEC;
+    for (int iii = numTemps-1; iii >= 0; iii--) {
+        if (tempSec[iii] <= secOfDay) {
+            return tempDegF[iii];
+        }
+    }
+    return tempDegF[numTemps-1];
+}
+
+
+int powerOnOffFT847( int powerOn ) {
+    simInit();
+    radioPowered = powerOn;
+    powerCycles += (powerOn == 0);
+    trace("POWER   %s  %.1lf F\n",powerOn ? "on" : "off",getTempData());
+    return 0;
+}
+
+
+//
+//  alsaplay.c - the sound card plays in no time.  A burst with a start time has its leading silence dropped, like alsaplay.c does, so
+//      its first tone is exactly at the start time.
+//
+int alsaplay_open( const char *device ) {
+    simInit();
+    trace("AUDIO   open %s\n",device);
+    return 0;
+}
+
+
+void alsaplay_close( void ) {
+    trace("AUDIO   close\n");
+}
+
+
+int alsaplay_start( const short *samples, int numFrames, int rate, int channels, const struct timespec *startTime ) {
+    long leadFrames = 0;
+
+    simInit();
+    if (playing) {
+        return -1;
+    }
+    if (startTime != (const struct timespec *)NULL) {
+        while ((leadFrames < numFrames) && (samples[leadFrames*channels] == 0)) {
+            leadFrames++;
+        }
+        audioFirstToneNs = startTime->tv_sec*NS + startTime->tv_nsec;
+        if (audioFirstToneNs < simNs) {
+            audioFirstToneNs = simNs;
+        }
+    } else {
+        audioFirstToneNs = simNs;
+    }
+    audioEndNs = audioFirstToneNs + (numFrames - leadFrames)*NS/rate;
+    audioFrames = numFrames;
+    playing = 1;
+    if (audioEndNs - audioFirstToneNs < 30*NS) {
+        burstsFT8++;
+    } else {
+        burstsWSPR++;
+    }
+    trace("AUDIO   start %d Hz x%d, first tone in %+.3lf s, %.3lf s long\n",rate,channels,(audioFirstToneNs - simNs)/(double)NS,
+          (audioEndNs - audioFirstToneNs)/(double)NS);
+    return 0;
+}
+
+
+int alsaplay_eventFd( void ) {
+    return -1;                  // nothing to poll, reactor_wait() below knows when the audio ends
+}
+
+
+int alsaplay_wait( int timeoutMs ) {
+    simInit();
+    if (!playing) {
+        trace("AUDIO   wait with nothing playing\n");
+        return 1;
+    }
+    if (audioEndNs > simNs + timeoutMs*1000000LL) {
+        advanceTo( simNs + timeoutMs*1000000LL );
+        return 0;
+    }
+    advanceTo( audioEndNs );
+    playing = 0;
+    trace("AUDIO   done\n");
+    return 1;
+}
+
+
+void alsaplay_stop( void ) {
+    if ((playing) && (audioEndNs > simNs)) {
+        audioEndNs = simNs;
+        trace("AUDIO   stopped\n");
+    }
+}
+
+
+long alsaplay_framesWritten( void ) {
+    return audioFrames;
+}
+
+
+int alsaplay_startError( double *errorSec ) {
+    *errorSec = 0.0;
+    return 0;
+}
+
+
+//
+//  reactor.c - stdin never has anything.  The UDP receive socket has the scenario's "txMode;" messages.
+//
+int reactor_open( void ) {
+    simInit();
+    return 0;
+}
+
+
+void reactor_close( void ) {
+}
+
+
+int reactor_add( int source, int fd ) {
+    if ((source <= REACTOR_TIMEOUT) || (source >= REACTOR_SIGNAL)) {
+        return -1;
+    }
+    watchedMask |= REACTOR_MASK(source);
+    return 0;
+}
+
+
+void reactor_remove( int source ) {
+    watchedMask &= ~REACTOR_MASK(source);
+}
+
+
+//  Jumps to the deadline or to the first event in mask before it.  At the end of the scenario it sets terminate, the way SIGINT would.
+int reactor_wait( const struct timespec *deadline, int mask ) {
+    long long wakeNs = (deadline != (const struct timespec *)NULL) ? deadline->tv_sec*NS + deadline->tv_nsec : LLONG_MAX;
+    int source = REACTOR_TIMEOUT;
+
+    simInit();
+    mask &= watchedMask;
+    if ((mask & REACTOR_MASK(REACTOR_UDP)) && (nextTxMode < numTxModes) && (txModeNs[nextTxMode] < wakeNs)) {
+        wakeNs = txModeNs[nextTxMode];
+        source = REACTOR_UDP;
+    }
+    if ((mask & REACTOR_MASK(REACTOR_AUDIO)) && (playing) && (audioEndNs < wakeNs)) {
+        wakeNs = audioEndNs;
+        source = REACTOR_AUDIO;
+    }
+    if (wakeNs >= endNs) {
+        wakeNs = endNs;
+        if (!ended) {
+            trace("END     of the scenario\n");
+            ended = 1;
+        }
+        terminate = 1;
+        source = REACTOR_SIGNAL;
+    }
+    advanceTo( wakeNs );
+    wakeups[source]++;
+    totalWakeups++;
+    return source;
+}
+
+
+//  Same as reactor.c.
+void reactor_nextTick( const struct timespec *limit, struct timespec *deadline ) {
+    __wrap_clock_gettime( CLOCK_REALTIME, deadline );
+    deadline->tv_sec = (deadline->tv_sec/REACTOR_TICK_SEC + 1)*REACTOR_TICK_SEC;
+    deadline->tv_nsec = 0;
+    if ((limit != (struct timespec *)NULL)
+            && ((limit->tv_sec < deadline->tv_sec) || ((limit->tv_sec == deadline->tv_sec) && (limit->tv_nsec < deadline->tv_nsec)))) {
+        *deadline = *limit;
+    }
+}
+
+
+long reactor_wakeups( long *bySource ) {
+    long total = 0;
+    for (int iii = 0; iii < REACTOR_NUM_SOURCES; iii++) {
+        total += wakeups[iii];
+        if (bySource != (long *)NULL) {
+            bySource[iii] = wakeups[iii];
+        }
+    }
+    return total;
+}
+
+
+void reactor_resetWakeups( void ) {
+    memset( wakeups, 0, sizeof(wakeups) );
+}
+
+
+//
+//  libc
+//
+time_t __wrap_time( time_t *tloc ) {
+    simInit();
+    if (tloc != (time_t *)NULL) {
+        *tloc = (time_t)(simNs/NS);
+    }
+    return (time_t)(simNs/NS);
+}
+
+
+//  Both clocks are the virtual one.
+int __wrap_clock_gettime( clockid_t clockId, struct timespec *ts ) {
+    simInit();
+    ts->tv_sec = (time_t)(simNs/NS);
+    ts->tv_nsec = (long)(simNs%NS);
+    return 0;
+}
+
+
+int __wrap_clock_nanosleep( clockid_t clockId, int flags, const struct timespec *request, struct timespec *remain ) {
+    long long requestNs = request->tv_sec*NS + request->tv_nsec;
+
+    simInit();
+    advanceTo( (flags & TIMER_ABSTIME) ? requestNs : simNs + requestNs );
+    return 0;
+}
+
+
+int __wrap_usleep( useconds_t usec ) {
+    simInit();
+    advanceTo( simNs + usec*1000LL );
+    return 0;
+}
+
+
+//  Nothing is expected, the reports are fetched by http_start() and http_finish() below.
+int __wrap_system( const char *command ) {
+    simInit();
+    trace("SYSTEM  %s (not run)\n",command);
+    return 0;
+}
+
+
+//  The queries take no time, the response is read when it is waited for.
+int http_start( const char *url, const char *postBody, int timeoutMs ) {
+    simInit();
+    for (int iii = 0; iii < HTTP_MAX_REQUESTS; iii++) {
+        if (httpUrl[iii][0] == 0) {
+            snprintf( httpUrl[iii], sizeof(httpUrl[iii]), "%s", url );
+            return iii;
+        }
+    }
+    trace("HTTP    %s (too many requests)\n",url);
+    return HTTP_ERR_BUSY;
+}
+
+
+//  The body is a copy of sim_x.txt for wsprnet.org, sim_y.txt for the others, or empty.
+int http_finish( int request, struct HttpResponse *response ) {
+    const char *canned;
+    FILE *in;
+    long length = 0;
+
+    memset( response, 0, sizeof(*response) );
+    if ((request < 0) || (request >= HTTP_MAX_REQUESTS)) {
+        response->error = (request < 0) ? request : HTTP_ERR_URL;
+        return response->error;
+    }
+    canned = strstr( httpUrl[request], "wsprnet.org" ) ? "sim_x.txt" : "sim_y.txt";
+    in = fopen( canned, "rb" );
+    if (in != (FILE *)NULL) {
+        fseek( in, 0, SEEK_END );
+        length = ftell( in );
+        rewind( in );
+    }
+    response->body = malloc( length + 1 );
+    if (response->body == (char *)NULL) {
+        response->error = HTTP_ERR_MEMORY;
+    } else {
+        if ((in != (FILE *)NULL) && (fread( response->body, 1, length, in ) != (size_t)length)) {
+            length = 0;
+        }
+        response->body[length] = 0;
+        response->length = length;
+        response->bytes = length;
+        response->status = 200;
+    }
+    if (in != (FILE *)NULL) {
+        fclose(in);
+    }
+    trace("HTTP    %s from %s\n",httpUrl[request],(in != (FILE *)NULL) ? canned : "nothing");
+    httpUrl[request][0] = 0;
+    return response->error;
+}
+
+
+void http_free( struct HttpResponse *response ) {
+    free( response->body );
+    response->body = (char *)NULL;
+}
+
+
+const char *http_errorString( int error ) {
+    return (error == HTTP_OK) ? "ok" : "error";
+}
+
+
+void http_close( void ) {
+}
+
+
+ssize_t __wrap_sendto( int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrLen ) {
+    char text[64];
+    size_t num = (len < sizeof(text)-1) ? len : sizeof(text)-1;
+
+    simInit();
+    memcpy( text, buf, num );
+    text[num] = 0;
+    text[strcspn( text, "\n" )] = 0;        // the first line of an Email
+    trace("UDP     out  %s\n",text);
+    return (ssize_t)len;
+}
+
+
+ssize_t __wrap_recvfrom( int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrLen ) {
+    const char message[] = "txMode;";
+
+    simInit();
+    if ((nextTxMode >= numTxModes) || (txModeNs[nextTxMode] > simNs) || (len < sizeof(message))) {
+        return -1;
+    }
+    nextTxMode++;
+    txModesReceived++;
+    memcpy( buf, message, sizeof(message) );
+    trace("UDP     in   %s\n",message);
+    return (ssize_t)(sizeof(message) - 1);
+}
+
+
+//  Called by twsprRPI.c with every cycle's plan.
+void sim_traceSlots( const struct PlanSlot *slots, int numSlots ) {
+    simInit();
+    trace("PLAN    %d slots\n",numSlots);
+    planner_print( traceFile, slots, numSlots, simNs/1000000 );
+    for (int iii = 0; iii < numSlots; iii++) {
+        if ((slots[iii].kind == PLAN_WSPR) && (slots[iii].beacon == 0) && (numCycles < SIM_MAX_CYCLES)) {
+            cycleMs[numCycles++] = slots[iii].startMs;
+        }
+        if ((slots[iii].kind == PLAN_WSPR) || (slots[iii].kind == PLAN_FT8)) {
+            slotsPlanned++;
+            heldBlackout += (slots[iii].hold == PLAN_HOLD_BLACKOUT);
+            heldHeat += (slots[iii].hold == PLAN_HOLD_HEAT);
+        }
+    }
+}
+
+
+static void simInit( void ) {
+    if (initialized) {
+        return;
+    }
+    initialized = 1;
+    __real_clock_gettime( CLOCK_MONOTONIC, &wallStart );
+    setenv( "TZ", "UTC", 1 );
+    tzset();
+
+    traceFile = fopen( SIM_TRACE_FILENAME, "wt" );
+    if (traceFile == (FILE *)NULL) {
+        fprintf(stderr,"Unable to open %s for writing.\n",SIM_TRACE_FILENAME);
+        exit(1);
+    }
+    if (readScenario()) {
+        exit(1);
+    }
+    atexit( summary );
+    trace("START   %.1lf hours, %d txMode messages, %d temperatures\n",(endNs - startNs)/(3600.0*NS),numTxModes,numTemps);
+}
+
+
+//  See the comment at the top for the format.  Returns -1 if there is no scenario or it can't be read.
+static int readScenario( void ) {
+    FILE *fptr;
+    FILE *blackoutFile = (FILE *)NULL;
+    char string[256], token[16];
+    struct tm start;
+    double runHours = 24.0;
+    long long txModeSec[SIM_MAX_EVENTS];
+    int numTxModeSec = 0;
+
+    memset( &start, 0, sizeof(start) );
+    start.tm_year = 2026 - 1900;
+    start.tm_mon = 5;
+    start.tm_mday = 21;
+
+    fptr = fopen( SIM_SCENARIO_FILENAME, "rt" );
+    if (fptr == (FILE *)NULL) {
+        fprintf(stderr,"No %s in this directory, see sim.c.  Run the simulation in a scratch directory.\n",SIM_SCENARIO_FILENAME);
+        return -1;
+    }
+    while (fgets( string, sizeof(string), fptr )) {
+        long long secOfDay;
+        if ((string[0] == '#') || (sscanf( string, "%15s", token ) != 1)) {
+            continue;
+        }
+        if (!strcmp(token,"startUTC")) {
+            if (sscanf( &string[8], "%d-%d-%d %d:%d:%d", &start.tm_year, &start.tm_mon, &start.tm_mday, &start.tm_hour, &start.tm_min,
+                        &start.tm_sec ) != 6) {
+                fprintf(stderr,"%s - bad line %s",SIM_SCENARIO_FILENAME,string);
+                fclose(fptr);
+                return -1;
+            }
+            start.tm_year -= 1900;
+            start.tm_mon--;
+        } else if (!strcmp(token,"runHours")) {
+            sscanf( &string[8], "%lf", &runHours );
+        } else if (!strcmp(token,"tempDegF")) {
+            char when[16];
+            double degF;
+            if ((numTemps < SIM_MAX_TEMPS) && (sscanf( &string[8], "%15s %lf", when, &degF ) == 2) && (timeOfDay( when, &secOfDay ) == 0)) {
+                tempSec[numTemps] = secOfDay;
+                tempDegF[numTemps++] = degF;
+            }
+        } else if (!strcmp(token,"txModeAt")) {
+            char when[16];
+            if ((numTxModeSec < SIM_MAX_EVENTS) && (sscanf( &string[8], "%15s", when ) == 1) && (timeOfDay( when, &secOfDay ) == 0)) {
+                txModeSec[numTxModeSec++] = secOfDay;
+            }
+        } else if (!strcmp(token,"blackout")) {
+            if (blackoutFile == (FILE *)NULL) {
+                blackoutFile = fopen( "blackout.txt", "wt" );
+            }
+            if (blackoutFile != (FILE *)NULL) {
+                fprintf(blackoutFile,"%s",&string[10]);
+            }
+        }
+    }
+    fclose(fptr);
+    if (blackoutFile != (FILE *)NULL) {
+        fclose(blackoutFile);
+    }
+
+    //  Sort the temperatures by time of day, they're looked up backwards.
+    for (int iii = 1; iii < numTemps; iii++) {
+        for (int jjj = iii; (jjj > 0) && (tempSec[jjj-1] > tempSec[jjj]); jjj--) {
+            long long sec = tempSec[jjj];  double degF = tempDegF[jjj];
+            tempSec[jjj] = tempSec[jjj-1];  tempDegF[jjj] = tempDegF[jjj-1];
+            tempSec[jjj-1] = sec;  tempDegF[jjj-1] = degF;
+        }
+    }
+
+    startNs = (long long)timegm( &start )*NS;
+    endNs = startNs + (long long)(runHours*3600.0*NS);
+    simNs = startNs;
+
+    //  The txMode times of day, every day of the run, in order.
+    for (long long day = (startNs/NS/DAY_SEC)*DAY_SEC; day*NS < endNs; day += DAY_SEC) {
+        for (int iii = 0; iii < numTxModeSec; iii++) {
+            long long ns = (day + txModeSec[iii])*NS;
+            int jjj;
+            if ((ns < startNs) || (ns >= endNs) || (numTxModes == SIM_MAX_EVENTS)) {
+                continue;
+            }
+            for (jjj = numTxModes; (jjj > 0) && (txModeNs[jjj-1] > ns); jjj--) {
+                txModeNs[jjj] = txModeNs[jjj-1];
+            }
+            txModeNs[jjj] = ns;
+            numTxModes++;
+        }
+    }
+    return 0;
+}
+
+
+//  "HH:MM" or "HH:MM:SS" to seconds into the day.
+static int timeOfDay( const char *string, long long *secOfDay ) {
+    int hour, minute, second = 0;
+
+    if (sscanf( string, "%d:%d:%d", &hour, &minute, &second ) < 2) {
+        return -1;
+    }
+    *secOfDay = hour*3600LL + minute*60 + second;
+    return 0;
+}
+
+
+static void advanceTo( long long ns ) {
+    if (ns > simNs) {
+        simNs = ns;
+    }
+}
+
+
+static void trace( const char *format, ... ) {
+    va_list args;
+    char utc[32];
+    struct tm info;
+    time_t seconds = (time_t)(simNs/NS);
+
+    if (traceFile == (FILE *)NULL) {
+        return;
+    }
+    gmtime_r( &seconds, &info );
+    strftime( utc, sizeof(utc), "%Y-%m-%d %H:%M:%S", &info );
+    fprintf(traceFile,"%14lld  %s.%03d  ",simNs/1000000,utc,(int)((simNs/1000000) % 1000));
+    va_start( args, format );
+    vfprintf( traceFile, format, args );
+    va_end( args );
+}
+
+
+//  At exit, the totals.  Everything but the wall clock time goes in the trace too so two traces of the same scenario are identical.
+static void summary( void ) {
+    char text[1024];
+    struct timespec wallEnd;
+    double meanMin = 0.0, minMin = 0.0, maxMin = 0.0;
+    int length;
+
+    if (pttOn) {
+        trace("PTT     still keyed at exit\n");
+        keyedNs += simNs - pttOnNs;
+    }
+    if (numCycles > 1) {
+        meanMin = (cycleMs[numCycles-1] - cycleMs[0])/(double)(numCycles-1)/60000.0;
+        minMin = maxMin = (cycleMs[1] - cycleMs[0])/60000.0;
+        for (int iii = 2; iii < numCycles; iii++) {
+            double apart = (cycleMs[iii] - cycleMs[iii-1])/60000.0;
+            if (apart < minMin) { minMin = apart; }
+            if (apart > maxMin) { maxMin = apart; }
+        }
+    }
+    length = snprintf(text, sizeof(text),
+            "Simulated %.2lf hours\n"
+            "  cycles %d, first beacons %.2lf min apart on average (%.2lf - %.2lf)\n"
+            "  transmit slots planned %d, held for blackouts %d, held for heat %d\n"
+            "  bursts sent WSPR %d, FT8 %d, keyed %.1lf min\n"
+            "  PTT on to first tone %.3lf - %.3lf s\n"
+            "  CAT writes %d, FT847 powered off %d times, txMode messages %d\n"
+            "  wakeups %ld\n",
+            (simNs - startNs)/(3600.0*NS),numCycles,meanMin,minMin,maxMin,slotsPlanned,heldBlackout,heldHeat,burstsWSPR,burstsFT8,
+            keyedNs/(60.0*NS),(leadMinNs == LLONG_MAX) ? 0.0 : leadMinNs/(double)NS,(leadMaxNs == LLONG_MIN) ? 0.0 : leadMaxNs/(double)NS,
+            catWrites,powerCycles,txModesReceived,totalWakeups);
+    if (traceFile != (FILE *)NULL) {
+        fprintf(traceFile,"%s",text);
+        fclose(traceFile);
+        traceFile = (FILE *)NULL;
+    }
+    __real_clock_gettime( CLOCK_MONOTONIC, &wallEnd );
+    fprintf(stderr,"%.*s  %.2lf s of wall clock time\n",length,text,
+            (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec)*1e-9);
+}
@@ -0,0 +1,11 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include "planner.h"
+
+#define SIM_SCENARIO_FILENAME   "simulation.txt"
+#define SIM_TRACE_FILENAME      "sim_trace.txt"
+
+extern void sim_traceSlots( const struct PlanSlot *slots, int numSlots );
+
+#endif
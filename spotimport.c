@@ -0,0 +1,1023 @@
+/*
+    spotimport.c - loads the years of text logs from before spotstore.c into the spot store, so spotquery can ask about them too.
+
+        ./spotimport                                            raw_reports_log.txt, log_golden.txt and log_twspr.txt in this directory
+        ./spotimport -n old/raw_reports_log.txt                 only check it, report the lines it can't read
+        ./spotimport -d spotstore -threads 4 a.txt b.txt        the files in any order, each line is recognized by itself
+
+        The logs are mixed up and changed format over the years:
+            "   19:18  50.294526  -10  0       K0AB0   FN42aa    186 mi  062 deg  (2506 mi)"      a spot, raw_reports_log.txt
+            "  g 19:18  50.294526  -10  0       K0AB0   FN42aa    186 mi  062 deg (2506 mi)"      a golden call, printed again
+            " ------- 2024-11-01 above "  or  " ------- 2024-11-01 above, late "                  the date of the spots above it
+            "  72.500 deg    28126100 Hz     28126090 Hz   28126110 Hz   10 (10) Hz  (6 calls) 2024-11-01"    log_golden.txt
+            "Burst10m  1730488200   Fri Nov 01 2024 12:10:00  72.500 F"                              log_twspr.txt
+        The spot lines have only the time of day.  The date is on the separator after each cycle's spots, except for the first year of
+        raw_reports_log.txt which has no separators at all.  Those spots are dated from log_twspr.txt: a spot at 19:18 on 10m is the
+        first Burst10m logged in the few minutes after a 19:18, going forward through both files together.  Spots it can't date are
+        reported and left out, as are the lines it can't read, with their file and line number.  The golden copies are left out (the
+        spot is already in above them), log_golden.txt and the other log_twspr.txt events have no spots and are only counted.
+
+        How it goes:
+            1. The files are mapped and cut into CHUNK_BYTES chunks at line ends.
+            2. The chunks are read on threadpool.c's workers, each into its own arrays of spots, separators and bursts.  This is the
+               part that looks at every character.
+            3. Going through the chunks in order, the spots above each separator get its date and the line numbers are added up.
+               Then, on the workers again, the dated spots are checked against the bursts.
+            4. The undated spots are matched to the bursts and everything goes to spotstore_add(), in file order.
+        Step 3's first half and step 4 are one thread, spotstore.c is a single writer, but they only go through numbers.
+
+        A separator's date is from the row on wsprnet.org just older than the spots, the beacon's previous cycle.  So a cycle that
+        crosses midnight has spots at 23:58 and 00:02 above the older date, the 00:00 cycle alone has the day before, and the first
+        cycle after the beacon was off for a few days has the day it went off.  The spot lines are in order, which fixes the first two,
+        and the bursts fix the last.  Without log_twspr.txt those spots are a few days early.
+
+        On one x86 core it reads about 3.5 million lines a second (3.2M lines, 240 MB) and stores 5 million spots a second.
+
+        Stop twsprRPI first, the store has one writer.  Run it once, the spots aren't checked against what's in the store already.
+
+    To build:
+        gcc -g -Wall -O2 -o spotimport spotimport.c spotstore.c threadpool.c -pthread
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spotstore.h"
+#include "threadpool.h"
+
+#define CHUNK_BYTES         (1 << 20)       // a job for one worker
+#define MAX_FILES           32
+#define MAX_REPORTED        20              // bad lines printed a chunk, and undated spots in all, the rest are only counted
+#define BURST_WINDOW        (6*60)          // a burst is logged this long at most after its cycle's minute (the 2 minutes of WSPR and some)
+#define BURST_LOOKBACK      3600            // the bands of a cycle are printed mixed, look back this far before the last burst matched
+#define BURST_LOOKAHEAD     (7*86400)       // how much older than the spots a separator's date can be
+#define MINUTES             1440
+#define SLACK               3600            // how much older than the spots above the last separator spots can be, the late ones
+
+struct Record {                 // a spot line, as read
+    uint32_t time;              // UTC, 0 until it's dated
+    uint32_t freqHz;
+    int16_t minute;             // of the day
+    int16_t snr;
+    int16_t drift;
+    uint16_t distance;          // miles from MY_LOCATOR, the one in ( )
+    uint16_t azimuth;
+    int line;                   // in the chunk, 0 is the first
+    char reporter[20];
+    char grid[8];
+};
+
+struct Burst {                  // a Burst line of log_twspr.txt
+    uint32_t time;
+    int kind;                   // burstKinds[]
+};
+
+struct Separator {
+    int at;                     // records[] before it are above it
+    int day;                    // days since 1970
+};
+
+struct BadLine {
+    int line;                   // in the chunk
+    const char *text;
+    int length;
+};
+
+struct Chunk {
+    int file;
+    const char *start;
+    const char *end;            // one past the last '\n'
+    long firstLine;             // in the file, of start, 1 is the first.  Step 3.
+
+    struct Record *records;
+    int numRecords;
+    int maxRecords;
+    struct Separator *separators;
+    int numSeparators;
+    int maxSeparators;
+
+    struct Burst *bursts;
+    int numBursts;
+    int maxBursts;
+
+    struct BadLine *bad;        // the first MAX_REPORTED
+    int numBad;
+
+    int numLines;
+    int numGolden;
+    int numCorrections;         // log_golden.txt lines
+    int numEvents;              // log_twspr.txt lines, bursts too
+};
+
+struct Piece {                  // part of the spots above a separator, they can be spread over chunks
+    struct Record *records;
+    int from;
+    int to;
+};
+
+static int mapFiles( int numFiles, char **names );
+static int cutChunks( void );
+static void parseChunk( void *unused, int index );
+static int parseLine( struct Chunk *chunk, const char *text, const char *end, int line );
+static int parseSpot( const char *text, const char *end, struct Record *record );
+static int parseSeparator( const char *text, const char *end );
+static int parseCorrection( const char *text, const char *end );
+static int parseEvent( const char *text, const char *end, struct Burst *burst, int *isBurst );
+static void dateBlock( const struct Piece *pieces, int numPieces, int day, uint32_t *previous );
+static void dateAll( void );
+static void checkChunk( void *unused, int index );
+static int dateFromBursts( struct Record *record, long *cursor );
+static long matchBurst( struct Record *record, long first, uint32_t limit );
+static long firstBurstAt( uint32_t time );
+static int indexBursts( void );
+static int burstKind( uint32_t freqHz );
+static int storeAll( const char *directory, int checkOnly );
+static void addBad( struct Chunk *chunk, int line, const char *text, const char *end );
+static const char *findLine( const struct Chunk *chunk, int line, int *length );
+static void reportBad( void );
+static int compareBursts( const void *aa, const void *bb );
+static const char *skipSpaces( const char *text, const char *end );
+static const char *readInt( const char *text, const char *end, int *value );
+static const char *readWord( const char *text, const char *end, char *word, int size );
+static const char *readDate( const char *text, const char *end, int *day );
+static const char *expect( const char *text, const char *end, const char *word );
+static double msSince( const struct timespec *start );
+
+static const char *defaultFiles[] = { "raw_reports_log.txt", "log_golden.txt", "log_twspr.txt" };
+
+static const struct {           // the Burst names, for the frequencies twsprRPI.c gave them
+    const char *name;
+    uint32_t aboveHz;
+} burstKinds[] = { { "2m", 144000000 }, { "6m", 50000000 }, { "10m", 28000000 }, { "12m", 24000000 }, { "15m", 0 } };
+#define NUM_KINDS   ((int)(sizeof(burstKinds)/sizeof(burstKinds[0])))
+
+static struct {
+    const char *name;
+    const char *data;
+    size_t size;
+} files[MAX_FILES];
+static int numFiles = 0;
+
+static struct Chunk *chunks = (struct Chunk *)NULL;
+static int numChunks = 0;
+
+static struct Burst *bursts = (struct Burst *)NULL;     // all of them, by time
+static long numBursts = 0;
+static long *byMinute = (long *)NULL;                   // indexes in bursts[] that fit a spot of a kind at a minute, by kind and minute
+static long minuteStart[NUM_KINDS*MINUTES + 1];         //      where each kind and minute's start in byMinute[]
+
+static long numStored = 0;
+static long numUndated = 0;
+
+
+int main( int argc, char **argv ) {
+    const char *directory = SPOTSTORE_DIR;
+    int numThreads = -1;
+    int checkOnly = 0;
+    int first = argc;
+    struct timespec start, parsed;
+    double parseMs;
+    long numLines = 0, numSpots = 0, numGolden = 0, numSeparators = 0, numCorrections = 0, numEvents = 0, numBad = 0;
+
+    for (int iii = 1; iii < argc; iii++) {
+        if ((!strcmp(argv[iii],"-d")) && (iii+1 < argc)) {
+            directory = argv[++iii];
+        } else if ((!strcmp(argv[iii],"-threads")) && (iii+1 < argc)) {
+            numThreads = atoi( argv[++iii] ) - 1;          // the main thread works too
+            if (numThreads < 0) {
+                numThreads = -1;
+            }
+        } else if (!strcmp(argv[iii],"-n")) {
+            checkOnly = 1;
+        } else if (argv[iii][0] == '-') {
+            printf("\nUsage \"./spotimport [options] [files]\", default files raw_reports_log.txt log_golden.txt log_twspr.txt:");
+            printf("\n     - \"-d <directory>\" the store, default \"%s\".",SPOTSTORE_DIR);
+            printf("\n     - \"-threads <n>\" default one per core.");
+            printf("\n     - \"-n\" only read the files and report, don't store anything.");
+            printf("\n\n");
+            return 1;
+        } else {
+            first = iii;
+            break;
+        }
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    if (first < argc) {
+        if (mapFiles( argc - first, &argv[first] ) == -1) {
+            return 1;
+        }
+    } else if (mapFiles( sizeof(defaultFiles)/sizeof(defaultFiles[0]), (char **)defaultFiles ) == -1) {
+        return 1;
+    }
+    if (cutChunks() == -1) {
+        return 1;
+    }
+    if (numThreads != 0) {
+        threadpool_open( numThreads );      // -1 is one per core
+    }
+    threadpool_run( parseChunk, NULL, numChunks );
+    dateAll();
+    if (numBursts > 0) {
+        threadpool_run( checkChunk, NULL, numChunks );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &parsed );
+    parseMs = msSince( &start );
+
+    for (int iii = 0; iii < numChunks; iii++) {
+        numLines += chunks[iii].numLines;
+        numSpots += chunks[iii].numRecords;
+        numGolden += chunks[iii].numGolden;
+        numSeparators += chunks[iii].numSeparators;
+        numCorrections += chunks[iii].numCorrections;
+        numEvents += chunks[iii].numEvents;
+        numBad += chunks[iii].numBad;
+    }
+    printf("%d files, %ld lines in %.1f ms on %d threads, %.2f M lines/s\n",numFiles,numLines,parseMs,
+           threadpool_numThreads(),numLines/(parseMs*1000.0));
+    printf("  %ld spots, %ld golden copies, %ld separators, %ld log_golden.txt lines, %ld log_twspr.txt lines (%ld bursts)\n",
+           numSpots,numGolden,numSeparators,numCorrections,numEvents,numBursts);
+
+    reportBad();
+    if (storeAll( directory, checkOnly ) == -1) {
+        printf("Couldn't store the spots in %s\n",directory);
+    }
+    if (!checkOnly) {
+        printf("  %ld spots stored in %s in %.1f ms\n",numStored,directory,msSince( &parsed ));
+    }
+    printf("  %ld lines not read, %ld spots not dated\n",numBad,numUndated);
+    threadpool_close();
+    return 0;
+}
+
+
+//  Maps the files read only.  The ones that aren't there are skipped (not everyone has all three), -1 if none are.
+static int mapFiles( int num, char **names ) {
+    for (int iii = 0; (iii < num) && (numFiles < MAX_FILES); iii++) {
+        struct stat info;
+        int fd = open( names[iii], O_RDONLY );
+
+        if (fd == -1) {
+            printf("Can't open %s, skipped\n",names[iii]);
+            continue;
+        }
+        if ((fstat( fd, &info ) == -1) || (info.st_size == 0)) {
+            close( fd );
+            continue;
+        }
+        files[numFiles].data = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        close( fd );
+        if (files[numFiles].data == MAP_FAILED) {
+            perror("mapFiles() - mmap()");
+            continue;
+        }
+        madvise( (void *)files[numFiles].data, info.st_size, MADV_SEQUENTIAL );
+        files[numFiles].name = names[iii];
+        files[numFiles].size = info.st_size;
+        numFiles++;
+    }
+    if (numFiles == 0) {
+        printf("Nothing to import\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+//  Step 1.  CHUNK_BYTES or so each, moved on to the end of a line so no line is split.
+static int cutChunks( void ) {
+    int maxChunks = 0;
+
+    for (int iii = 0; iii < numFiles; iii++) {
+        maxChunks += files[iii].size/CHUNK_BYTES + 1;
+    }
+    chunks = calloc( maxChunks, sizeof(struct Chunk) );
+    if (chunks == (struct Chunk *)NULL) {
+        printf("Error in calloc()\n");
+        return -1;
+    }
+    for (int iii = 0; iii < numFiles; iii++) {
+        const char *text = files[iii].data;
+        const char *end = text + files[iii].size;
+
+        while (text < end) {
+            const char *cut = (end - text > CHUNK_BYTES) ? text + CHUNK_BYTES : end;
+
+            if (cut < end) {
+                cut = memchr( cut, '\n', end - cut );
+                cut = (cut == (const char *)NULL) ? end : cut + 1;
+            }
+            chunks[numChunks].file = iii;
+            chunks[numChunks].start = text;
+            chunks[numChunks].end = cut;
+            numChunks++;
+            text = cut;
+        }
+    }
+    return 0;
+}
+
+
+//  Step 2, a threadpool_run() callback.  Everything it writes is in chunks[index].
+static void parseChunk( void *unused, int index ) {
+    struct Chunk *chunk = &chunks[index];
+    const char *text = chunk->start;
+
+    chunk->maxRecords = (chunk->end - chunk->start)/64 + 16;
+    chunk->records = malloc( chunk->maxRecords*sizeof(struct Record) );
+    if (chunk->records == (struct Record *)NULL) {
+        chunk->maxRecords = 0;
+    }
+    while (text < chunk->end) {
+        const char *end = memchr( text, '\n', chunk->end - text );
+        const char *next;
+
+        if (end == (const char *)NULL) {
+            end = chunk->end;           // the last line of a file without a '\n'
+        }
+        next = end + 1;
+        if ((end > text) && (end[-1] == '\r')) {
+            end--;
+        }
+        if (parseLine( chunk, text, end, chunk->numLines ) == -1) {
+            addBad( chunk, chunk->numLines, text, end );
+        }
+        chunk->numLines++;
+        text = next;
+    }
+}
+
+
+//  One line, whichever file it's from.  -1 if it isn't any of them.
+static int parseLine( struct Chunk *chunk, const char *text, const char *end, int line ) {
+    const char *start = skipSpaces( text, end );
+    int day, isBurst;
+    struct Burst burst;
+
+    if (start == end) {
+        return 0;                               // the blank line before the golden calls
+    }
+    if ((start[0] == '-') && (end - start > 1) && (start[1] == '-')) {
+        day = parseSeparator( start, end );
+        if (day == -1) {
+            return -1;
+        }
+        if (chunk->numSeparators == chunk->maxSeparators) {
+            int newMax = (chunk->maxSeparators == 0) ? 256 : 2*chunk->maxSeparators;
+            struct Separator *newSeparators = realloc( chunk->separators, newMax*sizeof(struct Separator) );
+
+            if (newSeparators == (struct Separator *)NULL) {
+                return -1;
+            }
+            chunk->separators = newSeparators;
+            chunk->maxSeparators = newMax;
+        }
+        chunk->separators[chunk->numSeparators].at = chunk->numRecords;
+        chunk->separators[chunk->numSeparators].day = day;
+        chunk->numSeparators++;
+        return 0;
+    }
+    if (((*start >= '0') && (*start <= '9')) || (*start == '-')) {
+        if ((end - start > 2) && (start[2] == ':')) {
+            struct Record *record;
+
+            if (chunk->numRecords == chunk->maxRecords) {
+                int newMax = (chunk->maxRecords == 0) ? 1024 : 2*chunk->maxRecords;
+                struct Record *newRecords = realloc( chunk->records, newMax*sizeof(struct Record) );
+
+                if (newRecords == (struct Record *)NULL) {
+                    return -1;
+                }
+                chunk->records = newRecords;
+                chunk->maxRecords = newMax;
+            }
+            record = &chunk->records[chunk->numRecords];
+            if (parseSpot( start, end, record ) == -1) {
+                return -1;
+            }
+            record->line = line;
+            chunk->numRecords++;
+            return 0;
+        }
+        if (parseCorrection( start, end ) == -1) {
+            return -1;
+        }
+        chunk->numCorrections++;
+        return 0;
+    }
+    if ((start[0] == 'g') && (end - start > 1) && (start[1] == ' ')) {
+        struct Record golden;
+
+        if (parseSpot( start + 2, end, &golden ) == -1) {
+            return -1;
+        }
+        chunk->numGolden++;
+        return 0;
+    }
+    if (parseEvent( start, end, &burst, &isBurst ) == -1) {
+        return -1;
+    }
+    chunk->numEvents++;
+    if (isBurst) {
+        if (chunk->numBursts == chunk->maxBursts) {
+            int newMax = (chunk->maxBursts == 0) ? 256 : 2*chunk->maxBursts;
+            struct Burst *newBursts = realloc( chunk->bursts, newMax*sizeof(struct Burst) );
+
+            if (newBursts == (struct Burst *)NULL) {
+                return -1;
+            }
+            chunk->bursts = newBursts;
+            chunk->maxBursts = newMax;
+        }
+        chunk->bursts[chunk->numBursts++] = burst;
+    }
+    return 0;
+}
+
+
+//  "19:18  50.294526  -10  0       K0AB0   FN42aa    186 mi  062 deg  (2506 mi)".  The ( ) is the distance from MY_LOCATOR, the one
+//      kept, the first is from the grid sent.  The oldest lines may not have it.
+static int parseSpot( const char *text, const char *end, struct Record *record ) {
+    int hour, minute, mhz, fraction, digits, distance, distance2;
+    char number[16];
+    const char *cc;
+
+    text = skipSpaces( text, end );
+    if ((end - text < 5) || (text[2] != ':')) {
+        return -1;
+    }
+    hour = (text[0] - '0')*10 + (text[1] - '0');
+    minute = (text[3] - '0')*10 + (text[4] - '0');
+    if ((hour < 0) || (hour > 23) || (minute < 0) || (minute > 59)) {
+        return -1;
+    }
+    record->time = 0;
+    record->minute = hour*60 + minute;
+
+    //  "50.294526", MHz as wsprnet.org shows it
+    text = readWord( text + 5, end, number, sizeof(number) );
+    if (text == (const char *)NULL) { return -1; }
+    cc = number;
+    for (mhz = 0; (*cc >= '0') && (*cc <= '9'); cc++) {
+        mhz = mhz*10 + (*cc - '0');
+    }
+    if ((*cc != '.') || (mhz > 4000)) { return -1; }
+    for (cc++, fraction = 0, digits = 0; (*cc >= '0') && (*cc <= '9') && (digits < 6); cc++, digits++) {
+        fraction = fraction*10 + (*cc - '0');
+    }
+    if ((*cc != 0) || (digits == 0)) { return -1; }
+    for (; digits < 6; digits++) {
+        fraction *= 10;
+    }
+    record->freqHz = (uint32_t)mhz*1000000 + fraction;
+
+    if ((text = readInt( text, end, &hour )) == (const char *)NULL) { return -1; }         // SNR
+    record->snr = hour;
+    if ((text = readInt( text, end, &minute )) == (const char *)NULL) { return -1; }       // drift
+    record->drift = minute;
+    if ((text = readWord( text, end, record->reporter, sizeof(record->reporter) )) == (const char *)NULL) { return -1; }
+    if ((text = readWord( text, end, record->grid, sizeof(record->grid) )) == (const char *)NULL) { return -1; }
+    if ((text = readInt( text, end, &distance )) == (const char *)NULL) { return -1; }
+    if ((text = expect( text, end, "mi" )) == (const char *)NULL) { return -1; }
+    if ((text = readInt( text, end, &minute )) == (const char *)NULL) { return -1; }       // azimuth
+    record->azimuth = minute;
+    if ((text = expect( text, end, "deg" )) == (const char *)NULL) { return -1; }
+
+    text = skipSpaces( text, end );
+    if (text == end) {
+        distance2 = distance;
+    } else {
+        if ((*text != '(') || ((text = readInt( text + 1, end, &distance2 )) == (const char *)NULL)) { return -1; }
+        if ((text = expect( text, end, "mi)" )) == (const char *)NULL) { return -1; }
+        if (skipSpaces( text, end ) != end) { return -1; }
+    }
+    if ((distance2 < 0) || (distance2 > UINT16_MAX) || (record->azimuth > 360)) {
+        return -1;
+    }
+    record->distance = distance2;
+    return 0;
+}
+
+
+//  "------- 2024-11-01 above" and maybe ", late" after.  The day, days since 1970, or -1.
+static int parseSeparator( const char *text, const char *end ) {
+    int day;
+
+    while ((text < end) && (*text == '-')) {
+        text++;
+    }
+    if ((text = readDate( text, end, &day )) == (const char *)NULL) {
+        return -1;
+    }
+    if (expect( text, end, "above" ) == (const char *)NULL) {
+        return -1;
+    }
+    return day;
+}
+
+
+//  log_golden.txt, "72.500 deg    28126100 Hz     28126090 Hz   28126110 Hz   10 (10) Hz  (6 calls) 2024-11-01".  Only checked, it
+//      has no spots.
+static int parseCorrection( const char *text, const char *end ) {
+    char word[16];
+    int day;
+
+    if ((text = readWord( text, end, word, sizeof(word) )) == (const char *)NULL) { return -1; }     // temperature
+    if ((text = expect( text, end, "deg" )) == (const char *)NULL) { return -1; }
+    for (; end - text > 6; text++) {                    // the date is after "calls)"
+        if (!memcmp( text, "calls)", 6 )) {
+            return (readDate( text + 6, end, &day ) == (const char *)NULL) ? -1 : 0;
+        }
+    }
+    return -1;
+}
+
+
+//  log_twspr.txt, "Burst10m  1730488200   Fri Nov 01 2024 12:10:00  72.500 F" or Startup, Shutdown, HeatWait, HeatOff.  The time
+//      after the name is what's used.  *isBurst is set for a Burst, with the band and time in *burst.
+static int parseEvent( const char *text, const char *end, struct Burst *burst, int *isBurst ) {
+    char name[16];
+    long seconds = 0;
+    int digits = 0;
+
+    *isBurst = 0;
+    if ((text = readWord( text, end, name, sizeof(name) )) == (const char *)NULL) {
+        return -1;
+    }
+    if (strncmp( name, "Burst", 5 ) && strcmp( name, "Startup" ) && strcmp( name, "Shutdown" ) && strcmp( name, "HeatWait" )
+                                    && strcmp( name, "HeatOff" )) {
+        return -1;
+    }
+    text = skipSpaces( text, end );
+    for (; (text < end) && (*text >= '0') && (*text <= '9') && (digits < 11); text++, digits++) {
+        seconds = seconds*10 + (*text - '0');
+    }
+    if ((digits == 0) || (seconds > UINT32_MAX) || ((text < end) && (*text != ' '))) {
+        return -1;
+    }
+    if (!strncmp( name, "Burst", 5 )) {
+        for (burst->kind = 0; (burst->kind < NUM_KINDS) && (strcmp( &name[5], burstKinds[burst->kind].name )); burst->kind++) {
+        }
+        if (burst->kind == NUM_KINDS) {
+            return -1;
+        }
+        burst->time = seconds;
+        *isBurst = 1;
+    }
+    return 0;
+}
+
+
+//  The spots above a separator for day.  The date is from the row on wsprnet.org just older than them, they're the same day or later:
+//      - if the cycle went over midnight (spots at 23:58 and 00:02) the ones after it are the next day.
+//      - the spots are in order, a day is added until they're no more than SLACK before *previous, the spots above the last separator.
+//        That's the 00:00 cycle alone with the date of the 23:58 row.  The late ones are a few minutes older.
+static void dateBlock( const struct Piece *pieces, int numPieces, int day, uint32_t *previous ) {
+    int late = 0, early = 0;
+    uint32_t last = *previous;
+
+    for (int iii = 0; iii < numPieces; iii++) {
+        for (int jjj = pieces[iii].from; jjj < pieces[iii].to; jjj++) {
+            late |= (pieces[iii].records[jjj].minute >= 23*60);
+            early |= (pieces[iii].records[jjj].minute < 60);
+        }
+    }
+    for (int iii = 0; iii < numPieces; iii++) {
+        for (int jjj = pieces[iii].from; jjj < pieces[iii].to; jjj++) {
+            struct Record *record = &pieces[iii].records[jjj];
+            int nextDay = (late && early && (record->minute < 60));
+
+            record->time = (uint32_t)(day + nextDay)*86400 + record->minute*60;
+            while (record->time + SLACK < *previous) {
+                record->time += 86400;
+            }
+            last = (record->time > last) ? record->time : last;
+        }
+    }
+    *previous = last;
+}
+
+
+//  Step 3.  The spots above a separator go back to the one before it, which can be chunks earlier.  The spots above the first
+//      separator of a file are left undated, they may be the year without any.  Also numbers the lines and gathers the bursts.  One
+//      thread, but it's a few compares a spot, the reading was done in step 2.
+static void dateAll( void ) {
+    struct Piece *pieces = malloc( (numChunks + 1)*sizeof(struct Piece) );
+    int numPieces = 0;
+    int sawSeparator = 0;
+    uint32_t previous = 0;
+    long line = 1;
+    long total = 0;
+
+    for (int iii = 0; iii < numChunks; iii++) {
+        struct Chunk *chunk = &chunks[iii];
+        int from = 0;
+
+        if ((iii == 0) || (chunk->file != chunks[iii-1].file)) {
+            numPieces = 0;
+            sawSeparator = 0;
+            previous = 0;
+            line = 1;
+        }
+        chunk->firstLine = line;
+        line += chunk->numLines;
+        total += chunk->numBursts;
+
+        if (pieces == (struct Piece *)NULL) {
+            continue;
+        }
+        for (int jjj = 0; jjj < chunk->numSeparators; jjj++) {
+            pieces[numPieces].records = chunk->records;
+            pieces[numPieces].from = from;
+            pieces[numPieces].to = chunk->separators[jjj].at;
+            numPieces++;
+            if (sawSeparator) {
+                dateBlock( pieces, numPieces, chunk->separators[jjj].day, &previous );
+            }
+            sawSeparator = 1;
+            numPieces = 0;
+            from = chunk->separators[jjj].at;
+        }
+        pieces[numPieces].records = chunk->records;
+        pieces[numPieces].from = from;
+        pieces[numPieces].to = chunk->numRecords;
+        numPieces++;
+    }
+    free( pieces );
+
+    bursts = malloc( (total + 1)*sizeof(struct Burst) );
+    if (bursts == (struct Burst *)NULL) {
+        return;
+    }
+    for (int iii = 0; iii < numChunks; iii++) {
+        if (chunks[iii].numBursts > 0) {
+            memcpy( &bursts[numBursts], chunks[iii].bursts, chunks[iii].numBursts*sizeof(struct Burst) );
+            numBursts += chunks[iii].numBursts;
+        }
+    }
+    qsort( bursts, numBursts, sizeof(struct Burst), compareBursts );
+    if (indexBursts() == -1) {
+        numBursts = 0;
+    }
+}
+
+
+//  The first in bursts[] at time or later, numBursts if there isn't one.
+static long firstBurstAt( uint32_t time ) {
+    long low = 0, high = numBursts;
+
+    while (low < high) {
+        long middle = (low + high)/2;
+
+        if (bursts[middle].time < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+
+//  byMinute[], so a spot finds its burst by a binary search instead of going through them.  A burst is in the list of each minute
+//      up to BURST_WINDOW before it.  In time order since bursts[] is.
+static int indexBursts( void ) {
+    long *fill;
+
+    byMinute = malloc( (numBursts*(BURST_WINDOW/60 + 1) + 1)*sizeof(long) );
+    fill = calloc( NUM_KINDS*MINUTES, sizeof(long) );
+    if ((byMinute == (long *)NULL) || (fill == (long *)NULL)) {
+        printf("Error in malloc()\n");
+        free( fill );
+        return -1;
+    }
+    for (int pass = 0; pass < 2; pass++) {              // count, then fill in
+        for (long iii = 0; iii < numBursts; iii++) {
+            for (uint32_t spot = bursts[iii].time - bursts[iii].time%60; bursts[iii].time - spot <= BURST_WINDOW; spot -= 60) {
+                int list = bursts[iii].kind*MINUTES + (spot%86400)/60;
+
+                if (pass == 0) {
+                    minuteStart[list + 1]++;
+                } else {
+                    byMinute[minuteStart[list] + fill[list]++] = iii;
+                }
+            }
+        }
+        for (int iii = 0; (pass == 0) && (iii < NUM_KINDS*MINUTES); iii++) {
+            minuteStart[iii + 1] += minuteStart[iii];
+        }
+    }
+    free( fill );
+    return 0;
+}
+
+
+//  burstKinds[] of a spot's frequency.
+static int burstKind( uint32_t freqHz ) {
+    int kind = 0;
+
+    while ((kind < NUM_KINDS - 1) && (freqHz <= burstKinds[kind].aboveHz)) {
+        kind++;
+    }
+    return kind;
+}
+
+
+//  Step 3 again, a threadpool_run() callback when there are bursts.  The separator's date is from the row just older than the spots,
+//      and that's the beacon's last one, it can be days older if the beacon was off.  The spot is the first burst on its band at its
+//      minute from that day on.  Not moved if log_twspr.txt doesn't have one.
+static void checkChunk( void *unused, int index ) {
+    struct Chunk *chunk = &chunks[index];
+
+    for (int iii = 0; iii < chunk->numRecords; iii++) {
+        struct Record *record = &chunk->records[iii];
+        uint32_t from = record->time;                   // the day of the separator, or the next if it went over midnight
+
+        if (record->time != 0) {
+            matchBurst( record, firstBurstAt( from ), from + BURST_LOOKAHEAD );
+        }
+    }
+}
+
+
+//  A spot from before the separators, dated by matchBurst() from about *cursor, the last burst matched (the spot lines are in order
+//      too, however long the beacon was off in between).  The bands of a cycle are printed mixed, so it looks back a bit too.  -1 if
+//      there isn't one.
+static int dateFromBursts( struct Record *record, long *cursor ) {
+    long first = *cursor;
+    long found;
+
+    if (numBursts == 0) {
+        return -1;
+    }
+    while ((first > 0) && (bursts[first-1].time + BURST_LOOKBACK > bursts[*cursor].time)) {
+        first--;
+    }
+    found = matchBurst( record, first, UINT32_MAX );
+    if (found > *cursor) {
+        *cursor = found;
+    }
+    return (found == -1) ? -1 : 0;
+}
+
+
+//  The first burst from bursts[first] on, up to limit, that's on the spot's band and logged within BURST_WINDOW after its minute.
+//      record->time is set from it.  Its index, or -1.
+static long matchBurst( struct Record *record, long first, uint32_t limit ) {
+    int list = burstKind( record->freqHz )*MINUTES + record->minute;
+    long low = minuteStart[list], high = minuteStart[list + 1];
+    long found;
+    uint32_t time;
+
+    while (low < high) {
+        long middle = (low + high)/2;
+
+        if (byMinute[middle] < first) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == minuteStart[list + 1]) {
+        return -1;
+    }
+    found = byMinute[low];
+    time = bursts[found].time;
+    if (time > limit) {
+        return -1;
+    }
+    record->time = time - time%86400 + record->minute*60;
+    if (record->time > time) {
+        record->time -= 86400;
+    }
+    return found;
+}
+
+
+//  Step 4, in file order.  With checkOnly the spots are only dated.
+static int storeAll( const char *directory, int checkOnly ) {
+    struct Spot spot;
+    long cursor = 0;
+    uint32_t lastDated = 0;         // the spots after the separators end, the cursor goes on from the last dated one
+    int returnValue = 0;
+
+    if ((!checkOnly) && (spotstore_open( directory ) == -1)) {
+        return -1;
+    }
+    memset( &spot, 0, sizeof(spot) );
+    spot.source = SPOT_IMPORTED;
+    for (int iii = 0; iii < numChunks; iii++) {
+        struct Chunk *chunk = &chunks[iii];
+
+        if ((iii > 0) && (chunk->file != chunks[iii-1].file)) {
+            cursor = 0;
+            lastDated = 0;
+        }
+        for (int jjj = 0; (jjj < chunk->numRecords) && (returnValue == 0); jjj++) {
+            struct Record *record = &chunk->records[jjj];
+
+            if ((record->time == 0) && (numBursts > 0) && (lastDated > bursts[cursor].time)) {
+                cursor = firstBurstAt( lastDated );
+                cursor = (cursor == numBursts) ? numBursts - 1 : cursor;
+                lastDated = 0;
+            } else if (record->time != 0) {
+                lastDated = record->time;
+            }
+            if ((record->time == 0) && (dateFromBursts( record, &cursor ) == -1)) {
+                if (numUndated++ < MAX_REPORTED) {
+                    int length;
+                    const char *text = findLine( chunk, record->line, &length );
+
+                    printf("%s:%ld: no date for \"%.*s\"\n",files[chunk->file].name,chunk->firstLine + record->line,length,text);
+                }
+                continue;
+            }
+            if (checkOnly) {
+                continue;
+            }
+            spot.time = record->time;
+            spot.freqHz = record->freqHz;
+            spot.snr = record->snr;
+            spot.drift = record->drift;
+            spot.reporter = record->reporter;
+            spot.grid = record->grid;
+            spot.distance = record->distance;
+            spot.azimuth = record->azimuth;
+            if (spotstore_add( &spot ) == -1) {
+                returnValue = -1;
+            } else {
+                numStored++;
+            }
+        }
+        free( chunk->records );
+        chunk->records = (struct Record *)NULL;
+    }
+    if (!checkOnly) {
+        if (spotstore_flush() == -1) {
+            returnValue = -1;
+        }
+        spotstore_close();
+    }
+    return returnValue;
+}
+
+
+//  Keeps where a line that couldn't be read is, for reportBad().  All of them are counted, the first MAX_REPORTED of a chunk kept.
+static void addBad( struct Chunk *chunk, int line, const char *text, const char *end ) {
+    if (chunk->numBad < MAX_REPORTED) {
+        if (chunk->bad == (struct BadLine *)NULL) {
+            chunk->bad = malloc( MAX_REPORTED*sizeof(struct BadLine) );
+        }
+        if (chunk->bad != (struct BadLine *)NULL) {
+            chunk->bad[chunk->numBad].line = line;
+            chunk->bad[chunk->numBad].text = text;
+            chunk->bad[chunk->numBad].length = end - text;
+        }
+    }
+    chunk->numBad++;
+}
+
+
+//  The lines that couldn't be read, file:line: and the line, in file order.  MAX_REPORTED of them.
+static void reportBad( void ) {
+    int reported = 0;
+
+    for (int iii = 0; (iii < numChunks) && (reported < MAX_REPORTED); iii++) {
+        struct Chunk *chunk = &chunks[iii];
+
+        for (int jjj = 0; (jjj < chunk->numBad) && (jjj < MAX_REPORTED) && (chunk->bad != (struct BadLine *)NULL)
+                                                 && (reported < MAX_REPORTED); jjj++, reported++) {
+            int length = (chunk->bad[jjj].length > 100) ? 100 : chunk->bad[jjj].length;
+
+            printf("%s:%ld: can't read \"%.*s\"\n",files[chunk->file].name,chunk->firstLine + chunk->bad[jjj].line,length,
+                   chunk->bad[jjj].text);
+        }
+    }
+}
+
+
+//  The text of line (in the chunk) for a message.  Goes through the chunk from the start, it's only for the few reported.
+static const char *findLine( const struct Chunk *chunk, int line, int *length ) {
+    const char *text = chunk->start;
+    const char *eol;
+
+    for (int iii = 0; iii < line; iii++) {
+        text = memchr( text, '\n', chunk->end - text ) + 1;
+    }
+    eol = memchr( text, '\n', chunk->end - text );
+    *length = (eol == (const char *)NULL) ? chunk->end - text : eol - text;
+    if ((*length > 0) && (text[*length - 1] == '\r')) {
+        (*length)--;
+    }
+    return text;
+}
+
+
+static int compareBursts( const void *aa, const void *bb ) {
+    const struct Burst *a = aa, *b = bb;
+
+    return (a->time > b->time) - (a->time < b->time);
+}
+
+
+static const char *skipSpaces( const char *text, const char *end ) {
+    while ((text < end) && ((*text == ' ') || (*text == '\t'))) {
+        text++;
+    }
+    return text;
+}
+
+
+//  A number after spaces, "+37" and "-10" too.  Where it ended, or NULL if there's no number or something other than a space after it.
+static const char *readInt( const char *text, const char *end, int *value ) {
+    int sign = 1, digits = 0;
+
+    text = skipSpaces( text, end );
+    if ((text < end) && ((*text == '-') || (*text == '+'))) {
+        sign = (*text == '-') ? -1 : 1;
+        text++;
+    }
+    for (*value = 0; (text < end) && (*text >= '0') && (*text <= '9') && (digits < 9); text++, digits++) {
+        *value = *value*10 + (*text - '0');
+    }
+    if ((digits == 0) || ((text < end) && (*text != ' ') && (*text != '\t'))) {
+        return (const char *)NULL;
+    }
+    *value *= sign;
+    return text;
+}
+
+
+//  A word after spaces into word[size], null terminated.  NULL if there isn't one or it's too long.
+static const char *readWord( const char *text, const char *end, char *word, int size ) {
+    int length = 0;
+
+    text = skipSpaces( text, end );
+    while ((text < end) && (*text != ' ') && (*text != '\t')) {
+        if (length == size - 1) {
+            return (const char *)NULL;
+        }
+        word[length++] = *text++;
+    }
+    word[length] = 0;
+    return (length == 0) ? (const char *)NULL : text;
+}
+
+
+//  "2024-11-01" after spaces, *day is days since 1970.  NULL if it isn't a date.
+static const char *readDate( const char *text, const char *end, int *day ) {
+    int year, month, mday, era, yearOfEra, dayOfYear;
+
+    text = skipSpaces( text, end );
+    if ((end - text < 10) || (text[4] != '-') || (text[7] != '-')) {
+        return (const char *)NULL;
+    }
+    for (int iii = 0; iii < 10; iii++) {
+        if ((iii != 4) && (iii != 7) && ((text[iii] < '0') || (text[iii] > '9'))) {
+            return (const char *)NULL;
+        }
+    }
+    year = (text[0] - '0')*1000 + (text[1] - '0')*100 + (text[2] - '0')*10 + (text[3] - '0');
+    month = (text[5] - '0')*10 + (text[6] - '0');
+    mday = (text[8] - '0')*10 + (text[9] - '0');
+    if ((year < 1970) || (month < 1) || (month > 12) || (mday < 1) || (mday > 31)) {
+        return (const char *)NULL;
+    }
+
+    //  days from the civil date, March based so the leap day is last
+    year -= (month <= 2);
+    era = year/400;
+    yearOfEra = year - era*400;
+    dayOfYear = (153*(month + ((month > 2) ? -3 : 9)) + 2)/5 + mday - 1;
+    *day = era*146097 + yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear - 719468;
+    return text + 10;
+}
+
+
+//  word after spaces, and then a space or the end.  Where it ended or NULL.
+static const char *expect( const char *text, const char *end, const char *word ) {
+    int length = strlen( word );
+
+    text = skipSpaces( text, end );
+    if ((end - text < length) || (memcmp( text, word, length ))) {
+        return (const char *)NULL;
+    }
+    text += length;
+    if ((text < end) && (*text != ' ') && (*text != '\t') && (*text != ',')) {
+        return (const char *)NULL;
+    }
+    return text;
+}
+
+
+static double msSince( const struct timespec *start ) {
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec)*1000.0 + (now.tv_nsec - start->tv_nsec)*1e-6;
+}
@@ -0,0 +1,131 @@
+/*
+    spotquery.c - asks the spot store (spotstore.c) who heard the beacon.  Replaces grepping raw_reports_log.txt.
+
+        ./spotquery -band 10m -days 30                  everyone on 10m in the last 30 days
+        ./spotquery -call KA7OEI-1 -from 2024-01-01     one reporter since the start of 2024
+        ./spotquery -grid JO -miles 5000 -count         how many spots from JO grid squares 5000 miles and more away
+
+        The spots are printed oldest month first, the way raw_reports_log.txt had them with the date in front.  The number found and how
+        long it took go to stderr.  It maps the store read only, the running program can keep adding to it.
+
+    To build:
+        gcc -g -Wall -O2 -o spotquery spotquery.c spotstore.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "spotstore.h"
+
+static int printSpot( const struct Spot *spot, void *context );
+static time_t parseDate( const char *date );
+static const char *sourceName( int source );
+
+
+int main( int argc, char **argv ) {
+    const char *directory = SPOTSTORE_DIR;
+    struct SpotQuery query;
+    struct SpotStore *store;
+    struct timespec start, end;
+    int countOnly = 0;
+    long found;
+
+    memset( &query, 0, sizeof(query) );
+    for (int i = 1; i < argc; i++) {
+        if ((!strcmp(argv[i],"-d")) && (i+1 < argc)) {
+            directory = argv[++i];
+        } else if ((!strcmp(argv[i],"-from")) && (i+1 < argc)) {
+            query.from = parseDate( argv[++i] );
+        } else if ((!strcmp(argv[i],"-to")) && (i+1 < argc)) {
+            query.to = parseDate( argv[++i] );
+        } else if ((!strcmp(argv[i],"-days")) && (i+1 < argc)) {
+            query.from = time( NULL ) - atol( argv[++i] )*86400;
+        } else if ((!strcmp(argv[i],"-band")) && (i+1 < argc)) {
+            query.band = spotstore_bandOf( argv[++i] );
+            if (query.band == 0) {
+                printf("No band \"%s\", they are 2200m ... 10m, 6m, 4m, 2m, 70cm, 23cm\n",argv[i]);
+                return 1;
+            }
+        } else if ((!strcmp(argv[i],"-call")) && (i+1 < argc)) {
+            query.reporter = argv[++i];
+        } else if ((!strcmp(argv[i],"-grid")) && (i+1 < argc)) {
+            query.gridPrefix = argv[++i];
+        } else if ((!strcmp(argv[i],"-miles")) && (i+1 < argc)) {
+            query.minDistance = atoi( argv[++i] );
+        } else if ((!strcmp(argv[i],"-source")) && (i+1 < argc)) {
+            i++;
+            query.source = (!strcmp(argv[i],"wsprnet")) ? SPOT_WSPRNET : (!strcmp(argv[i],"pskreporter")) ? SPOT_PSKREPORTER
+                                                                        : (!strcmp(argv[i],"imported")) ? SPOT_IMPORTED : -1;
+        } else if (!strcmp(argv[i],"-count")) {
+            countOnly = 1;
+        } else {
+            printf("\nUsage \"./spotquery [options]\", all of them optional:");
+            printf("\n     - \"-d <directory>\" the store, default \"%s\".",SPOTSTORE_DIR);
+            printf("\n     - \"-from <YYYY-MM-DD[ HH:MM]>\" \"-to <YYYY-MM-DD[ HH:MM]>\" UTC, or \"-days <n>\" the last n days.");
+            printf("\n     - \"-band <10m>\" \"-call <reporter>\" \"-grid <prefix>\" \"-miles <at least>\"");
+            printf("\n     - \"-source <wsprnet|pskreporter|imported>\"");
+            printf("\n     - \"-count\" only count them.");
+            printf("\n\n");
+            return 1;
+        }
+        if ((query.from == -1) || (query.to == -1) || (query.source == -1)) {
+            printf("Can't read \"%s\"\n",argv[i]);
+            return 1;
+        }
+    }
+
+    store = spotstore_openRead( directory );
+    if (store == (struct SpotStore *)NULL) {
+        printf("No spot store in %s\n",directory);
+        return 1;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    found = spotstore_query( store, &query, (countOnly) ? (SpotFn)NULL : printSpot, stdout );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    if (countOnly) {
+        printf("%ld\n",found);
+    }
+    fprintf(stderr,"%ld spots, %.2f ms\n",found,(end.tv_sec - start.tv_sec)*1000.0 + (end.tv_nsec - start.tv_nsec)*1e-6);
+    spotstore_closeRead( store );
+    return 0;
+}
+
+
+//  raw_reports_log.txt's line with the date in front, and the band and where it came from after
+static int printSpot( const struct Spot *spot, void *context ) {
+    struct tm tm;
+    time_t time = spot->time;
+
+    gmtime_r( &time, &tm );
+    fprintf((FILE *)context,"%04d-%02d-%02d %02d:%02d %4d.%06d  %3d %2d  %10s   %6s  %5d mi  %03d deg  %5s %s\n",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, spot->freqHz/1000000, spot->freqHz%1000000,
+            spot->snr, spot->drift, spot->reporter, spot->grid, spot->distance, spot->azimuth, spotstore_bandName( spot->band ),
+            sourceName( spot->source ));
+    return 0;
+}
+
+
+//  "2024-11-01" or "2024-11-01 19:18", UTC.  -1 if it isn't a date.
+static time_t parseDate( const char *date ) {
+    struct tm tm;
+    int fields;
+
+    memset( &tm, 0, sizeof(tm) );
+    fields = sscanf( date, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min );
+    if ((fields != 3) && (fields != 5)) {
+        return -1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return timegm( &tm );
+}
+
+
+static const char *sourceName( int source ) {
+    switch (source) {
+        case SPOT_WSPRNET:      return "wsprnet";
+        case SPOT_PSKREPORTER:  return "pskreporter";
+        case SPOT_IMPORTED:     return "imported";
+    }
+    return "?";
+}
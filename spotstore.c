@@ -0,0 +1,1192 @@
+/*
+    spotstore.c - every spot heard, kept in columns so years of them can be asked about in milliseconds.  processEntries() used to append
+        each wsprnet.org spot to raw_reports_log.txt as a printed line, with the golden calls printed again among them, the date only on
+        a " ------- <date> above" line after each cycle (and not at all in the first year of the file) and pskreporter.info's spots not at
+        all.  Asking who heard the beacon on 10m last month meant grepping and guessing dates.
+
+        Now each spot is a row of fixed width numbers in a directory (SPOTSTORE_DIR):
+            strings.dat     the dictionary, the reporters' callsigns and grid squares, null terminated one after the other.  A string's
+                            id is its place in the file, 0 is "".  Only ever appended to.
+            YYYYMM.col      the spots of one month (UTC), in segments of SPOTSTORE_SEGMENT_ROWS.  A segment is its columns one after the
+                            other, each SPOTSTORE_SEGMENT_ROWS long, so a column can be read without the others:
+                                time (4, seconds UTC), freqHz (4), reporter (4, id), grid (4, id), distance (2, miles), azimuth (2),
+                                snr (1), drift (1), band (1, spotstore_band()), source (1, SPOT_WSPRNET...)
+                            24 bytes a spot, against about 80 for a line of raw_reports_log.txt.
+            YYYYMM.idx      the number of spots in the month, then for each segment the min and max of its time, frequency, SNR and
+                            distance, and bit masks of its bands, sources and reporters (the id mod 64).  A query skips a month, then a
+                            segment, on these before it looks at any spot.
+        The numbers are in the machine's byte order, the Pi and x86 are both little endian.
+
+        Writing is append only.  spotstore_add() keeps the spots in memory and spotstore_flush() (once a cycle) writes any new strings,
+        then the columns, then the segment index and last the count, so a crash part way leaves the count at the spots that are all there;
+        whatever is past it is written over next time.  The one writer is the reports thread (reports.c), doCurl() and doCurlFT8() add and
+        flush.
+
+        Reading maps the files (spotstore_openRead()), spotquery.c is the command line tool.  The daemon can be writing at the same time, a
+        reader sees the spots that were there when it opened the store.
+
+    To test and benchmark (two years of made up spots, written, read back and queried):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o spotstore spotstore.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spotstore.h"
+
+#define INDEX_MAGIC         "SPOTIDX1"
+#define MAX_OPEN            4                   // partitions (months) kept open for writing
+#define MAX_PENDING         65536               // spots kept before spotstore_add() flushes by itself
+#define MIN_SLOTS           1024                // dictionary hash table, a power of 2.  Doubled when it gets half full.
+#define SEGMENT_BYTES       (24*SPOTSTORE_SEGMENT_ROWS)
+
+enum { COL_TIME, COL_FREQ, COL_REPORTER, COL_GRID, COL_DISTANCE, COL_AZIMUTH, COL_SNR, COL_DRIFT, COL_BAND, COL_SOURCE, NUM_COLUMNS };
+
+static const int columnWidth[NUM_COLUMNS] = { 4, 4, 4, 4, 2, 2, 1, 1, 1, 1 };
+static const int columnOffset[NUM_COLUMNS] = { 0, 4*SPOTSTORE_SEGMENT_ROWS, 8*SPOTSTORE_SEGMENT_ROWS, 12*SPOTSTORE_SEGMENT_ROWS,
+                                               16*SPOTSTORE_SEGMENT_ROWS, 18*SPOTSTORE_SEGMENT_ROWS, 20*SPOTSTORE_SEGMENT_ROWS,
+                                               21*SPOTSTORE_SEGMENT_ROWS, 22*SPOTSTORE_SEGMENT_ROWS, 23*SPOTSTORE_SEGMENT_ROWS };
+
+static const struct {
+    uint32_t lowHz;
+    uint32_t highHz;
+    const char *name;
+} bands[] = { { 0, 0, "?" },
+              { 135700, 137800, "2200m" },        { 472000, 479000, "630m" },         { 1800000, 2000000, "160m" },
+              { 3500000, 4000000, "80m" },        { 5250000, 5450000, "60m" },        { 7000000, 7300000, "40m" },
+              { 10100000, 10150000, "30m" },      { 14000000, 14350000, "20m" },      { 18068000, 18168000, "17m" },
+              { 21000000, 21450000, "15m" },      { 24890000, 24990000, "12m" },      { 28000000, 29700000, "10m" },
+              { 50000000, 54000000, "6m" },       { 70000000, 71000000, "4m" },       { 144000000, 148000000, "2m" },
+              { 420000000, 450000000, "70cm" },   { 1240000000, 1300000000, "23cm" } };
+#define NUM_BANDS   ((int)(sizeof(bands)/sizeof(bands[0])))
+
+struct IndexHeader {            // YYYYMM.idx, then numSegments struct SegmentIndex
+    char magic[8];
+    uint32_t segmentRows;
+    uint32_t numSegments;
+    uint32_t numRows;
+    uint32_t unused;
+};
+
+struct SegmentIndex {           // 40 bytes
+    uint32_t minTime;
+    uint32_t maxTime;
+    uint32_t minFreqHz;
+    uint32_t maxFreqHz;
+    uint32_t bandMask;          // 1 << band
+    uint32_t unused;
+    uint64_t reporterMask;      // 1 << (reporter id % 64)
+    uint16_t minDistance;
+    uint16_t maxDistance;
+    int8_t minSnr;
+    int8_t maxSnr;
+    uint8_t sourceMask;         // 1 << source
+    uint8_t unused2;
+};
+
+struct Row {                    // a spot waiting in spotstore_add()
+    int month;                  // partition, year*100 + month
+    uint32_t time;
+    uint32_t freqHz;
+    uint32_t reporter;
+    uint32_t grid;
+    uint16_t distance;
+    uint16_t azimuth;
+    int8_t snr;
+    int8_t drift;
+    uint8_t band;
+    uint8_t source;
+};
+
+struct Partition {              // a month open for writing
+    int month;                  // 0 is not in use
+    int dataFd;
+    int indexFd;
+    struct IndexHeader header;
+    struct SegmentIndex *segments;
+    int maxSegments;
+    long lastUsed;
+};
+
+struct ReadPartition {          // a month mapped for reading
+    int month;
+    const uint8_t *data;
+    size_t dataSize;
+    const uint8_t *index;
+    size_t indexSize;
+    int numSegments;
+    uint32_t numRows;
+};
+
+struct SpotStore {
+    const char *strings;        // strings.dat, mapped
+    size_t stringsSize;
+    uint32_t *offsets;          // by id
+    int numStrings;
+    struct ReadPartition *partitions;       // oldest first
+    int numPartitions;
+};
+
+int spotstore_open( const char *directory );
+int spotstore_add( const struct Spot *spot );
+int spotstore_flush( void );
+void spotstore_close( void );
+struct SpotStore *spotstore_openRead( const char *directory );
+long spotstore_query( struct SpotStore *store, const struct SpotQuery *query, SpotFn fn, void *context );
+void spotstore_closeRead( struct SpotStore *store );
+int spotstore_band( uint32_t freqHz );
+const char *spotstore_bandName( int band );
+int spotstore_bandOf( const char *name );
+
+static int loadStrings( void );
+static int internString( const char *text );
+static unsigned int hashString( const char *text, int length );
+static int growSlots( void );
+static int writeStrings( void );
+static struct Partition *openPartition( int month );
+static int appendRows( struct Partition *part, const struct Row *rows, int numRows );
+static void addToIndex( struct SegmentIndex *seg, const struct Row *row, int first );
+static int monthOf( time_t time );
+static int writeAll( int fd, const void *data, size_t length, off_t offset );
+static const void *mapFile( const char *name, size_t *size );
+static int compareMonths( const void *aa, const void *bb );
+
+//  The writer
+static char directory[256] = "";                // "" until spotstore_open()
+static struct Partition partitions[MAX_OPEN];
+static long useCount = 0;
+static struct Row *pending = (struct Row *)NULL;
+static int numPending = 0;
+static int maxPending = 0;
+static uint8_t scratch[4*SPOTSTORE_SEGMENT_ROWS];   // one column of a segment
+
+//  The writer's dictionary, strings.dat as it is on disk and the strings added since
+static int stringsFd = -1;
+static char *pool = (char *)NULL;               // the strings, null terminated, one after the other, as in strings.dat
+static size_t poolUsed = 0;
+static size_t poolSize = 0;
+static size_t poolWritten = 0;                  // what strings.dat has
+static uint32_t *offsets = (uint32_t *)NULL;    // in pool[], by id
+static unsigned int *hashes = (unsigned int *)NULL;     // by id
+static int numStrings = 0;
+static int maxStrings = 0;
+static int *slots = (int *)NULL;                // id + 1, 0 is empty
+static unsigned int numSlots = 0;
+
+
+//  Opens (or makes) the store in directory for writing.  spotstore_add() opens SPOTSTORE_DIR if this wasn't called.
+int spotstore_open( const char *dir ) {
+    char name[320];
+
+    spotstore_close();
+    if ((mkdir( dir, 0755 ) == -1) && (errno != EEXIST)) {
+        perror("spotstore_open() - mkdir()");
+        return -1;
+    }
+    snprintf( name, sizeof(name), "%s/strings.dat", dir );
+    stringsFd = open( name, O_RDWR | O_CREAT, 0644 );
+    if (stringsFd == -1) {
+        perror("spotstore_open() - open()");
+        return -1;
+    }
+    snprintf( directory, sizeof(directory), "%s", dir );
+    if (loadStrings() == -1) {
+        spotstore_close();
+        return -1;
+    }
+    return 0;
+}
+
+
+//  Keeps a spot for spotstore_flush().  spot->band is worked out here.  -1 if it can't be stored (before 1970 or after 2106, or out of
+//      memory).
+int spotstore_add( const struct Spot *spot ) {
+    struct Row *row;
+
+    if ((directory[0] == 0) && (spotstore_open( SPOTSTORE_DIR ) == -1)) {
+        return -1;
+    }
+    if ((spot->time < 0) || ((long long)spot->time > (long long)UINT32_MAX)) {
+        return -1;
+    }
+    if ((numPending == MAX_PENDING) && (spotstore_flush() == -1)) {
+        return -1;
+    }
+    if (numPending == maxPending) {
+        int newMax = (maxPending == 0) ? 1024 : 2*maxPending;
+        struct Row *newPending = realloc( pending, newMax*sizeof(struct Row) );
+        if (newPending == (struct Row *)NULL) {
+            printf("Error in realloc()\n");
+            return -1;
+        }
+        pending = newPending;
+        maxPending = newMax;
+    }
+    row = &pending[numPending];
+    row->month = monthOf( spot->time );
+    row->time = (uint32_t)spot->time;
+    row->freqHz = spot->freqHz;
+    row->reporter = internString( (spot->reporter == (const char *)NULL) ? "" : spot->reporter );
+    row->grid = internString( (spot->grid == (const char *)NULL) ? "" : spot->grid );
+    row->distance = (spot->distance < 0) ? 0 : ((spot->distance > UINT16_MAX) ? UINT16_MAX : spot->distance);
+    row->azimuth = (spot->azimuth < 0) ? 0 : ((spot->azimuth > UINT16_MAX) ? UINT16_MAX : spot->azimuth);
+    row->snr = (spot->snr < INT8_MIN) ? INT8_MIN : ((spot->snr > INT8_MAX) ? INT8_MAX : spot->snr);
+    row->drift = (spot->drift < INT8_MIN) ? INT8_MIN : ((spot->drift > INT8_MAX) ? INT8_MAX : spot->drift);
+    row->band = spotstore_band( spot->freqHz );
+    row->source = spot->source & 7;
+    numPending++;
+    return 0;
+}
+
+
+//  Writes the spots kept by spotstore_add().  They are gone from memory whether it worked or not, -1 if it didn't.
+int spotstore_flush( void ) {
+    int returnValue = 0;
+    int first, last;
+
+    if (numPending == 0) {
+        return 0;
+    }
+    if (writeStrings() == -1) {         // before any spot that uses them
+        numPending = 0;
+        return -1;
+    }
+
+    //  A run of spots in the same month at a time, almost always all of them
+    for (first = 0; first < numPending; first = last) {
+        struct Partition *part;
+
+        for (last = first + 1; (last < numPending) && (pending[last].month == pending[first].month); last++) {
+        }
+        part = openPartition( pending[first].month );
+        if ((part == (struct Partition *)NULL) || (appendRows( part, &pending[first], last - first ) == -1)) {
+            returnValue = -1;
+        }
+    }
+    numPending = 0;
+    return returnValue;
+}
+
+
+//  Flushes and closes the files.  The dictionary is forgotten, the memory is kept.
+void spotstore_close( void ) {
+    if (directory[0] != 0) {
+        spotstore_flush();
+    }
+    for (int iii = 0; iii < MAX_OPEN; iii++) {
+        if (partitions[iii].month != 0) {
+            close( partitions[iii].dataFd );
+            close( partitions[iii].indexFd );
+            partitions[iii].month = 0;
+        }
+    }
+    if (stringsFd != -1) {
+        close( stringsFd );
+        stringsFd = -1;
+    }
+    numStrings = 0;
+    poolUsed = poolWritten = 0;
+    if (slots != (int *)NULL) {
+        memset( slots, 0, numSlots*sizeof(int) );
+    }
+    directory[0] = 0;
+}
+
+
+
+//  Maps the store in directory for spotstore_query().  NULL if there isn't one.
+struct SpotStore *spotstore_openRead( const char *dir ) {
+    struct SpotStore *store;
+    struct dirent *entry;
+    DIR *dp;
+    char name[320];
+    size_t at;
+    int max = 0;
+
+    store = calloc( 1, sizeof(struct SpotStore) );
+    if (store == (struct SpotStore *)NULL) {
+        printf("Error in calloc()\n");
+        return (struct SpotStore *)NULL;
+    }
+
+    //  The dictionary, the offset of each string
+    snprintf( name, sizeof(name), "%s/strings.dat", dir );
+    store->strings = mapFile( name, &store->stringsSize );
+    if (store->strings == (const char *)NULL) {
+        free( store );
+        return (struct SpotStore *)NULL;
+    }
+    for (at = 0; at < store->stringsSize; ) {
+        const char *end = memchr( &store->strings[at], 0, store->stringsSize - at );
+        if (end == (const char *)NULL) {
+            break;                      // being written
+        }
+        if (store->numStrings == max) {
+            uint32_t *newOffsets;
+            max = (max == 0) ? 4096 : 2*max;
+            newOffsets = realloc( store->offsets, max*sizeof(uint32_t) );
+            if (newOffsets == (uint32_t *)NULL) {
+                printf("Error in realloc()\n");
+                spotstore_closeRead( store );
+                return (struct SpotStore *)NULL;
+            }
+            store->offsets = newOffsets;
+        }
+        store->offsets[ store->numStrings++ ] = (uint32_t)at;
+        at = end - store->strings + 1;
+    }
+
+    //  The months
+    dp = opendir( dir );
+    if (dp == (DIR *)NULL) {
+        spotstore_closeRead( store );
+        return (struct SpotStore *)NULL;
+    }
+    max = 0;
+    while ((entry = readdir( dp )) != (struct dirent *)NULL) {
+        struct ReadPartition part;
+        const struct IndexHeader *header;
+        int month;
+        char tail[8];
+
+        if ((strlen( entry->d_name ) != 10) || (sscanf( entry->d_name, "%6d%5s", &month, tail ) != 2) || (strcmp( tail, ".idx" ))) {
+            continue;
+        }
+        memset( &part, 0, sizeof(part) );
+        part.month = month;
+        snprintf( name, sizeof(name), "%s/%s", dir, entry->d_name );
+        part.index = mapFile( name, &part.indexSize );
+        snprintf( name, sizeof(name), "%s/%06d.col", dir, month );
+        part.data = mapFile( name, &part.dataSize );
+        header = (const struct IndexHeader *)part.index;
+        if ((part.index == (const uint8_t *)NULL) || (part.data == (const uint8_t *)NULL) || (part.indexSize < sizeof(struct IndexHeader))
+                || (memcmp( header->magic, INDEX_MAGIC, 8 )) || (header->segmentRows != SPOTSTORE_SEGMENT_ROWS)) {
+            printf("%s isn't a spot store month\n",name);
+            if (part.indexSize > 0) { munmap( (void *)part.index, part.indexSize ); }
+            if (part.dataSize > 0) { munmap( (void *)part.data, part.dataSize ); }
+            continue;
+        }
+
+        //  Only the segments that are all there, the writer may be adding one
+        part.numSegments = header->numSegments;
+        part.numRows = header->numRows;
+        if (part.numSegments > (int)((part.indexSize - sizeof(struct IndexHeader))/sizeof(struct SegmentIndex))) {
+            part.numSegments = (int)((part.indexSize - sizeof(struct IndexHeader))/sizeof(struct SegmentIndex));
+        }
+        if (part.numSegments > (int)(part.dataSize/SEGMENT_BYTES)) {
+            part.numSegments = (int)(part.dataSize/SEGMENT_BYTES);
+        }
+        if (part.numRows > (uint32_t)part.numSegments*SPOTSTORE_SEGMENT_ROWS) {
+            part.numRows = (uint32_t)part.numSegments*SPOTSTORE_SEGMENT_ROWS;
+        }
+
+        if (store->numPartitions == max) {
+            struct ReadPartition *newPartitions;
+            max = (max == 0) ? 64 : 2*max;
+            newPartitions = realloc( store->partitions, max*sizeof(struct ReadPartition) );
+            if (newPartitions == (struct ReadPartition *)NULL) {
+                printf("Error in realloc()\n");
+                break;
+            }
+            store->partitions = newPartitions;
+        }
+        store->partitions[ store->numPartitions++ ] = part;
+    }
+    closedir( dp );
+    qsort( store->partitions, store->numPartitions, sizeof(struct ReadPartition), compareMonths );
+    return store;
+}
+
+
+//  Calls fn (if not NULL) for each spot that matches query, oldest month first and in the order they were added within a month.  The
+//      strings in the spot are good until spotstore_closeRead().  Returns the number that matched (up to where fn stopped it).
+long spotstore_query( struct SpotStore *store, const struct SpotQuery *query, SpotFn fn, void *context ) {
+    uint32_t from = (query->from <= 0) ? 0 : (uint32_t)query->from;
+    uint32_t to = ((query->to <= 0) || ((long long)query->to > (long long)UINT32_MAX)) ? UINT32_MAX : (uint32_t)query->to;
+    int fromMonth = monthOf( from ), toMonth = monthOf( to );
+    uint32_t reporter = 0;
+    uint64_t reporterMask = 0;
+    uint8_t *gridMatch = (uint8_t *)NULL;
+    long found = 0;
+    int stop = 0;
+
+    //  The strings asked for, as ids
+    if ((query->reporter != (const char *)NULL) && (query->reporter[0] != 0)) {
+        for (reporter = 1; (int)reporter < store->numStrings; reporter++) {
+            if (strcmp( &store->strings[ store->offsets[reporter] ], query->reporter ) == 0) {
+                break;
+            }
+        }
+        if ((int)reporter == store->numStrings) {
+            return 0;                   // never heard
+        }
+        reporterMask = (uint64_t)1 << (reporter % 64);
+    }
+    if ((query->gridPrefix != (const char *)NULL) && (query->gridPrefix[0] != 0)) {
+        size_t length = strlen( query->gridPrefix );
+        gridMatch = calloc( store->numStrings + 1, 1 );
+        if (gridMatch == (uint8_t *)NULL) {
+            printf("Error in calloc()\n");
+            return -1;
+        }
+        for (int iii = 1; iii < store->numStrings; iii++) {
+            gridMatch[iii] = (strncasecmp( &store->strings[ store->offsets[iii] ], query->gridPrefix, length ) == 0);
+        }
+    }
+
+    for (int ppp = 0; (ppp < store->numPartitions) && (!stop); ppp++) {
+        const struct ReadPartition *part = &store->partitions[ppp];
+        const struct SegmentIndex *segments = (const struct SegmentIndex *)(part->index + sizeof(struct IndexHeader));
+
+        if ((part->month < fromMonth) || (part->month > toMonth)) {
+            continue;
+        }
+        for (int sss = 0; (sss < part->numSegments) && (!stop); sss++) {
+            const struct SegmentIndex *seg = &segments[sss];
+            const uint8_t *base = part->data + (size_t)sss*SEGMENT_BYTES;
+            const uint32_t *time, *freqHz, *reporters, *grids;
+            const uint16_t *distance, *azimuth;
+            const int8_t *snr, *drift;
+            const uint8_t *band, *source;
+            int rows = (part->numRows - (uint32_t)sss*SPOTSTORE_SEGMENT_ROWS > SPOTSTORE_SEGMENT_ROWS) ? SPOTSTORE_SEGMENT_ROWS
+                                                                                                      : (int)(part->numRows - sss*SPOTSTORE_SEGMENT_ROWS);
+
+            //  Skipped on the index
+            if ((seg->maxTime < from) || (seg->minTime >= to) || ((query->band) && (!(seg->bandMask & (1u << query->band))))
+                    || ((reporter) && (!(seg->reporterMask & reporterMask))) || ((query->source) && (!(seg->sourceMask & (1u << query->source))))
+                    || (seg->maxDistance < query->minDistance)) {
+                continue;
+            }
+            time = (const uint32_t *)(base + columnOffset[COL_TIME]);
+            freqHz = (const uint32_t *)(base + columnOffset[COL_FREQ]);
+            reporters = (const uint32_t *)(base + columnOffset[COL_REPORTER]);
+            grids = (const uint32_t *)(base + columnOffset[COL_GRID]);
+            distance = (const uint16_t *)(base + columnOffset[COL_DISTANCE]);
+            azimuth = (const uint16_t *)(base + columnOffset[COL_AZIMUTH]);
+            snr = (const int8_t *)(base + columnOffset[COL_SNR]);
+            drift = (const int8_t *)(base + columnOffset[COL_DRIFT]);
+            band = base + columnOffset[COL_BAND];
+            source = base + columnOffset[COL_SOURCE];
+
+            for (int rrr = 0; rrr < rows; rrr++) {
+                struct Spot spot;
+
+                if ((time[rrr] < from) || (time[rrr] >= to) || ((query->band) && (band[rrr] != query->band))
+                        || ((reporter) && (reporters[rrr] != reporter)) || ((query->source) && (source[rrr] != query->source))
+                        || (distance[rrr] < query->minDistance)
+                        || ((gridMatch != (uint8_t *)NULL) && (((int)grids[rrr] >= store->numStrings) || (!gridMatch[ grids[rrr] ])))) {
+                    continue;
+                }
+                found++;
+                if (fn == (SpotFn)NULL) {
+                    continue;
+                }
+                spot.time = time[rrr];
+                spot.freqHz = freqHz[rrr];
+                spot.snr = snr[rrr];
+                spot.drift = drift[rrr];
+                spot.reporter = ((int)reporters[rrr] < store->numStrings) ? &store->strings[ store->offsets[ reporters[rrr] ] ] : "";
+                spot.grid = ((int)grids[rrr] < store->numStrings) ? &store->strings[ store->offsets[ grids[rrr] ] ] : "";
+                spot.distance = distance[rrr];
+                spot.azimuth = azimuth[rrr];
+                spot.band = band[rrr];
+                spot.source = source[rrr];
+                if (fn( &spot, context )) {
+                    stop = 1;
+                    break;
+                }
+            }
+        }
+    }
+    free( gridMatch );
+    return found;
+}
+
+
+void spotstore_closeRead( struct SpotStore *store ) {
+    if (store == (struct SpotStore *)NULL) {
+        return;
+    }
+    for (int iii = 0; iii < store->numPartitions; iii++) {
+        if (store->partitions[iii].indexSize > 0) { munmap( (void *)store->partitions[iii].index, store->partitions[iii].indexSize ); }
+        if (store->partitions[iii].dataSize > 0) { munmap( (void *)store->partitions[iii].data, store->partitions[iii].dataSize ); }
+    }
+    if (store->stringsSize > 0) {
+        munmap( (void *)store->strings, store->stringsSize );
+    }
+    free( store->partitions );
+    free( store->offsets );
+    free( store );
+}
+
+
+
+//  The band a frequency is in, 0 if it isn't in one
+int spotstore_band( uint32_t freqHz ) {
+    for (int iii = 1; iii < NUM_BANDS; iii++) {
+        if ((freqHz >= bands[iii].lowHz) && (freqHz <= bands[iii].highHz)) {
+            return iii;
+        }
+    }
+    return 0;
+}
+
+
+const char *spotstore_bandName( int band ) {
+    return ((band > 0) && (band < NUM_BANDS)) ? bands[band].name : bands[0].name;
+}
+
+
+//  "10m" to its band, 0 if there isn't one
+int spotstore_bandOf( const char *name ) {
+    for (int iii = 1; iii < NUM_BANDS; iii++) {
+        if (strcasecmp( name, bands[iii].name ) == 0) {
+            return iii;
+        }
+    }
+    return 0;
+}
+
+
+
+//  Reads strings.dat into the dictionary.  A string cut off by a crash is taken off the end of the file.
+static int loadStrings( void ) {
+    struct stat st;
+    size_t at;
+
+    if (fstat( stringsFd, &st ) == -1) {
+        perror("spotstore_open() - fstat()");
+        return -1;
+    }
+    if ((size_t)st.st_size + 1 > poolSize) {
+        size_t newSize = (size_t)st.st_size + 65536;
+        char *newPool = realloc( pool, newSize );
+        if (newPool == (char *)NULL) {
+            printf("Error in realloc()\n");
+            return -1;
+        }
+        pool = newPool;
+        poolSize = newSize;
+    }
+    if ((st.st_size > 0) && (pread( stringsFd, pool, st.st_size, 0 ) != st.st_size)) {
+        perror("spotstore_open() - read()");
+        return -1;
+    }
+    if ((st.st_size > 0) && (pool[0] != 0)) {
+        printf("%s/strings.dat isn't a spot store dictionary\n",directory);
+        return -1;
+    }
+
+    //  Each string is interned in turn, so it gets the id of its place in the file
+    poolUsed = poolWritten = 0;
+    numStrings = 0;
+    if (internString( "" ) != 0) {
+        return -1;
+    }
+    poolWritten = poolUsed;
+    for (at = 0; at < (size_t)st.st_size; ) {
+        const char *end = memchr( &pool[at], 0, st.st_size - at );
+        int id;
+
+        if (end == (const char *)NULL) {
+            break;
+        }
+        if (at == 0) {                  // "", id 0
+            at = 1;
+            continue;
+        }
+
+        //  internString() appends to pool[] at poolUsed, which is at, the string is already there
+        id = internString( &pool[at] );
+        if (id != numStrings - 1) {
+            printf("%s/strings.dat has \"%s\" twice\n",directory,&pool[at]);
+            return -1;
+        }
+        at = end - pool + 1;
+        poolWritten = poolUsed;
+    }
+    if (poolWritten == 1) {             // a new file, "" isn't in it yet
+        poolWritten = 0;
+    }
+    if ((off_t)poolWritten < st.st_size) {
+        if (ftruncate( stringsFd, poolWritten ) == -1) {
+            perror("spotstore_open() - ftruncate()");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+//  The id of text, added to the dictionary (and written by the next flush) if it isn't there.  0 ("") if out of memory.
+static int internString( const char *text ) {
+    int length = strlen( text );
+    unsigned int hash, iii;
+
+    if ((2*(numStrings + 1) > (int)numSlots) && (growSlots() == -1)) {
+        return 0;
+    }
+    hash = hashString( text, length );
+    for (iii = hash & (numSlots - 1); slots[iii] != 0; iii = (iii + 1) & (numSlots - 1)) {
+        int id = slots[iii] - 1;
+        if ((hashes[id] == hash) && (strcmp( &pool[ offsets[id] ], text ) == 0)) {
+            return id;
+        }
+    }
+
+    //  Not there, add it
+    if (numStrings == maxStrings) {
+        int newMax = (maxStrings == 0) ? 4096 : 2*maxStrings;
+        uint32_t *newOffsets = realloc( offsets, newMax*sizeof(uint32_t) );
+        unsigned int *newHashes = realloc( hashes, newMax*sizeof(unsigned int) );
+        if (newOffsets != (uint32_t *)NULL) { offsets = newOffsets; }
+        if (newHashes != (unsigned int *)NULL) { hashes = newHashes; }
+        if ((newOffsets == (uint32_t *)NULL) || (newHashes == (unsigned int *)NULL)) {
+            printf("Error in realloc()\n");
+            return 0;
+        }
+        maxStrings = newMax;
+    }
+    if (poolUsed + length + 1 > poolSize) {
+        size_t newSize = (poolSize == 0) ? 65536 : 2*poolSize + length;
+        char *newPool;
+        if ((text >= pool) && (text < pool + poolSize)) {
+            return 0;                   // loadStrings() made room for the file, this can't happen
+        }
+        newPool = realloc( pool, newSize );
+        if (newPool == (char *)NULL) {
+            printf("Error in realloc()\n");
+            return 0;
+        }
+        pool = newPool;
+        poolSize = newSize;
+    }
+    if (&pool[poolUsed] != text) {
+        memmove( &pool[poolUsed], text, length + 1 );
+    }
+    offsets[numStrings] = poolUsed;
+    hashes[numStrings] = hash;
+    poolUsed += length + 1;
+    slots[iii] = numStrings + 1;
+    return numStrings++;
+}
+
+
+static unsigned int hashString( const char *text, int length ) {
+    unsigned int hash = 2166136261u;
+
+    for (int iii = 0; iii < length; iii++) {
+        hash = (hash ^ (unsigned char)text[iii]) * 16777619u;
+    }
+    return hash;
+}
+
+
+//  Doubles the dictionary's hash table (or makes the first one) and puts the ids back in.
+static int growSlots( void ) {
+    unsigned int newNumSlots = (numSlots == 0) ? MIN_SLOTS : 2*numSlots;
+    int *newSlots = calloc( newNumSlots, sizeof(int) );
+
+    if (newSlots == (int *)NULL) {
+        printf("Error in calloc()\n");
+        return -1;
+    }
+    for (int iii = 0; iii < numStrings; iii++) {
+        unsigned int jjj;
+        for (jjj = hashes[iii] & (newNumSlots - 1); newSlots[jjj] != 0; jjj = (jjj + 1) & (newNumSlots - 1)) {
+        }
+        newSlots[jjj] = iii + 1;
+    }
+    free( slots );
+    slots = newSlots;
+    numSlots = newNumSlots;
+    return 0;
+}
+
+
+//  Appends the strings added since the last time to strings.dat
+static int writeStrings( void ) {
+    if (poolUsed == poolWritten) {
+        return 0;
+    }
+    if (writeAll( stringsFd, &pool[poolWritten], poolUsed - poolWritten, (off_t)poolWritten ) == -1) {
+        if (ftruncate( stringsFd, poolWritten ) == -1) {
+            perror("spotstore_flush() - ftruncate()");
+        }
+        return -1;
+    }
+    poolWritten = poolUsed;
+    return 0;
+}
+
+
+//  The month's files, opened (or made) if they aren't open.  The least recently used month is closed for it.
+static struct Partition *openPartition( int month ) {
+    struct Partition *part = &partitions[0];
+    char name[320];
+    struct stat st;
+
+    for (int iii = 0; iii < MAX_OPEN; iii++) {
+        if (partitions[iii].month == month) {
+            partitions[iii].lastUsed = ++useCount;
+            return &partitions[iii];
+        }
+        if ((part->month != 0) && ((partitions[iii].month == 0) || (partitions[iii].lastUsed < part->lastUsed))) {
+            part = &partitions[iii];
+        }
+    }
+    if (part->month != 0) {
+        close( part->dataFd );
+        close( part->indexFd );
+        part->month = 0;
+    }
+
+    snprintf( name, sizeof(name), "%s/%06d.col", directory, month );
+    part->dataFd = open( name, O_RDWR | O_CREAT, 0644 );
+    snprintf( name, sizeof(name), "%s/%06d.idx", directory, month );
+    part->indexFd = open( name, O_RDWR | O_CREAT, 0644 );
+    if ((part->dataFd == -1) || (part->indexFd == -1) || (fstat( part->indexFd, &st ) == -1)) {
+        perror("spotstore - open()");
+        if (part->dataFd != -1) { close( part->dataFd ); }
+        if (part->indexFd != -1) { close( part->indexFd ); }
+        return (struct Partition *)NULL;
+    }
+
+    //  The index, all of it is read and kept
+    memset( &part->header, 0, sizeof(part->header) );
+    if (st.st_size == 0) {
+        memcpy( part->header.magic, INDEX_MAGIC, 8 );
+        part->header.segmentRows = SPOTSTORE_SEGMENT_ROWS;
+    } else if ((pread( part->indexFd, &part->header, sizeof(part->header), 0 ) != sizeof(part->header))
+                || (memcmp( part->header.magic, INDEX_MAGIC, 8 )) || (part->header.segmentRows != SPOTSTORE_SEGMENT_ROWS)) {
+        printf("%s isn't a spot store month\n",name);
+        close( part->dataFd );
+        close( part->indexFd );
+        return (struct Partition *)NULL;
+    }
+    if ((int)part->header.numSegments + 1 > part->maxSegments) {
+        int newMax = part->header.numSegments + 64;
+        struct SegmentIndex *newSegments = realloc( part->segments, newMax*sizeof(struct SegmentIndex) );
+        if (newSegments == (struct SegmentIndex *)NULL) {
+            printf("Error in realloc()\n");
+            close( part->dataFd );
+            close( part->indexFd );
+            return (struct Partition *)NULL;
+        }
+        part->segments = newSegments;
+        part->maxSegments = newMax;
+    }
+    if ((part->header.numSegments > 0) && (pread( part->indexFd, part->segments, part->header.numSegments*sizeof(struct SegmentIndex),
+                                                  sizeof(struct IndexHeader) ) != (ssize_t)(part->header.numSegments*sizeof(struct SegmentIndex)))) {
+        printf("%s is cut short\n",name);
+        close( part->dataFd );
+        close( part->indexFd );
+        return (struct Partition *)NULL;
+    }
+    part->month = month;
+    part->lastUsed = ++useCount;
+    return part;
+}
+
+
+//  Writes the rows to the end of the month, the columns first, then the segments' index and the count.
+static int appendRows( struct Partition *part, const struct Row *rows, int numRows ) {
+    int firstSegment = (part->header.numRows == part->header.numSegments*SPOTSTORE_SEGMENT_ROWS) ? part->header.numSegments
+                                                                                                 : part->header.numSegments - 1;
+    uint32_t numRowsAfter = part->header.numRows;
+    int done = 0;
+
+    while (done < numRows) {
+        int segment = numRowsAfter / SPOTSTORE_SEGMENT_ROWS;
+        int at = numRowsAfter % SPOTSTORE_SEGMENT_ROWS;
+        int count = (numRows - done < SPOTSTORE_SEGMENT_ROWS - at) ? numRows - done : SPOTSTORE_SEGMENT_ROWS - at;
+        off_t base = (off_t)segment*SEGMENT_BYTES;
+
+        if (segment == part->maxSegments) {
+            int newMax = 2*part->maxSegments;
+            struct SegmentIndex *newSegments = realloc( part->segments, newMax*sizeof(struct SegmentIndex) );
+            if (newSegments == (struct SegmentIndex *)NULL) {
+                printf("Error in realloc()\n");
+                return -1;
+            }
+            part->segments = newSegments;
+            part->maxSegments = newMax;
+        }
+        if ((at == 0) && (ftruncate( part->dataFd, base + SEGMENT_BYTES ) == -1)) {      // a new segment is all there for a reader
+            perror("spotstore - ftruncate()");
+            return -1;
+        }
+
+        for (int ccc = 0; ccc < NUM_COLUMNS; ccc++) {
+            for (int iii = 0; iii < count; iii++) {
+                const struct Row *row = &rows[done + iii];
+                switch (ccc) {
+                    case COL_TIME:      ((uint32_t *)scratch)[iii] = row->time;         break;
+                    case COL_FREQ:      ((uint32_t *)scratch)[iii] = row->freqHz;       break;
+                    case COL_REPORTER:  ((uint32_t *)scratch)[iii] = row->reporter;     break;
+                    case COL_GRID:      ((uint32_t *)scratch)[iii] = row->grid;         break;
+                    case COL_DISTANCE:  ((uint16_t *)scratch)[iii] = row->distance;     break;
+                    case COL_AZIMUTH:   ((uint16_t *)scratch)[iii] = row->azimuth;      break;
+                    case COL_SNR:       ((int8_t *)scratch)[iii] = row->snr;            break;
+                    case COL_DRIFT:     ((int8_t *)scratch)[iii] = row->drift;          break;
+                    case COL_BAND:      scratch[iii] = row->band;                       break;
+                    case COL_SOURCE:    scratch[iii] = row->source;                     break;
+                }
+            }
+            if (writeAll( part->dataFd, scratch, count*columnWidth[ccc], base + columnOffset[ccc] + at*columnWidth[ccc] ) == -1) {
+                return -1;
+            }
+        }
+        for (int iii = 0; iii < count; iii++) {
+            addToIndex( &part->segments[segment], &rows[done + iii], (at == 0) && (iii == 0) );
+        }
+        done += count;
+        numRowsAfter += count;
+    }
+
+    //  The index of the segments that changed, then the count
+    part->header.numRows = numRowsAfter;
+    part->header.numSegments = (numRowsAfter + SPOTSTORE_SEGMENT_ROWS - 1) / SPOTSTORE_SEGMENT_ROWS;
+    if ((writeAll( part->indexFd, &part->segments[firstSegment], (part->header.numSegments - firstSegment)*sizeof(struct SegmentIndex),
+                   sizeof(struct IndexHeader) + firstSegment*sizeof(struct SegmentIndex) ) == -1)
+            || (writeAll( part->indexFd, &part->header, sizeof(struct IndexHeader), 0 ) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+static void addToIndex( struct SegmentIndex *seg, const struct Row *row, int first ) {
+    if (first) {
+        memset( seg, 0, sizeof(struct SegmentIndex) );
+        seg->minTime = seg->maxTime = row->time;
+        seg->minFreqHz = seg->maxFreqHz = row->freqHz;
+        seg->minDistance = seg->maxDistance = row->distance;
+        seg->minSnr = seg->maxSnr = row->snr;
+    }
+    if (row->time < seg->minTime) { seg->minTime = row->time; }
+    if (row->time > seg->maxTime) { seg->maxTime = row->time; }
+    if (row->freqHz < seg->minFreqHz) { seg->minFreqHz = row->freqHz; }
+    if (row->freqHz > seg->maxFreqHz) { seg->maxFreqHz = row->freqHz; }
+    if (row->distance < seg->minDistance) { seg->minDistance = row->distance; }
+    if (row->distance > seg->maxDistance) { seg->maxDistance = row->distance; }
+    if (row->snr < seg->minSnr) { seg->minSnr = row->snr; }
+    if (row->snr > seg->maxSnr) { seg->maxSnr = row->snr; }
+    seg->bandMask |= 1u << row->band;
+    seg->sourceMask |= 1u << row->source;
+    seg->reporterMask |= (uint64_t)1 << (row->reporter % 64);
+}
+
+
+//  year*100 + month, UTC
+static int monthOf( time_t time ) {
+    struct tm tm;
+
+    gmtime_r( &time, &tm );
+    return (tm.tm_year + 1900)*100 + tm.tm_mon + 1;
+}
+
+
+static int writeAll( int fd, const void *data, size_t length, off_t offset ) {
+    const char *cc = data;
+
+    while (length > 0) {
+        ssize_t written = pwrite( fd, cc, length, offset );
+        if (written <= 0) {
+            if ((written == -1) && (errno == EINTR)) {
+                continue;
+            }
+            perror("spotstore - pwrite()");
+            return -1;
+        }
+        cc += written;
+        offset += written;
+        length -= written;
+    }
+    return 0;
+}
+
+
+//  The whole file, read only.  NULL if it isn't there, "" (not mapped, size 0) if it is empty.
+static const void *mapFile( const char *name, size_t *size ) {
+    struct stat st;
+    void *data;
+    int fd = open( name, O_RDONLY );
+
+    *size = 0;
+    if (fd == -1) {
+        return NULL;
+    }
+    if ((fstat( fd, &st ) == -1) || (st.st_size == 0)) {
+        close( fd );
+        return (st.st_size == 0) ? "" : NULL;
+    }
+    data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (data == MAP_FAILED) {
+        perror("spotstore - mmap()");
+        return NULL;
+    }
+    *size = st.st_size;
+    return data;
+}
+
+
+static int compareMonths( const void *aa, const void *bb ) {
+    return ((const struct ReadPartition *)aa)->month - ((const struct ReadPartition *)bb)->month;
+}
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#define TEST_DIR        "spotstore_test"
+#define START_TIME      1704067200      // 2024-01-01 00:00 UTC
+#define NUM_CYCLES      (2*365*48)      // two years, a cycle every 30 minutes
+#define NUM_REPORTERS   3000
+#define LAST_MONTH      1730419200      // 2024-11-01, the month before the last
+
+struct Expected {
+    long all;
+    long tenLastMonth;                  // 10m, LAST_MONTH to a month later
+    long oneReporter;                   // REPORTER7 ever
+    long jo5000;                        // JO grid squares, 5000 miles and more
+    long lastDay;
+};
+
+static const uint32_t testFreqs[] = { 28126100, 24926100, 50294500, 144490500, 21096100, 14097100 };
+
+static double secondsSince( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)*1e-9;
+}
+
+//  The made up spot number nnn of a cycle
+static void makeSpot( int cycle, int nnn, struct Spot *spot, char *reporter, char *grid ) {
+    unsigned int hash = (unsigned int)(cycle*7919 + nnn*104729) * 2654435761u;
+    int who = (int)((hash >> 8) % NUM_REPORTERS);
+
+    who = (who*who) / NUM_REPORTERS;    // a few are heard much more often
+    sprintf( reporter, "REPORTER%d", who );
+    sprintf( grid, "%c%c%d%d%c%c", (who % 3 == 0) ? 'J' : 'D', (who % 3 == 0) ? 'O' : 'M', who % 10, (who/10) % 10, 'a' + who % 24, 'a' + (who/24) % 24 );
+    memset( spot, 0, sizeof(*spot) );
+    spot->time = START_TIME + cycle*1800 + (nnn % 4)*120;
+    spot->freqHz = testFreqs[ (hash >> 4) % 6 ] + (hash % 200);
+    spot->snr = (int)((hash >> 12) % 40) - 30;
+    spot->drift = (int)((hash >> 20) % 3) - 1;
+    spot->reporter = reporter;
+    spot->grid = grid;
+    spot->distance = (who % 3 == 0) ? 5000 + who % 1000 : who % 3000;
+    spot->azimuth = who % 360;
+    spot->source = (nnn % 5 == 0) ? SPOT_PSKREPORTER : SPOT_WSPRNET;
+}
+
+static int countSpot( const struct Spot *spot, void *context ) {
+    (*(long *)context)++;
+    return 0;
+}
+
+static int checkSpot( const struct Spot *spot, void *context ) {
+    struct Spot expected;
+    char reporter[32], grid[16];
+    int *errors = context;
+
+    makeSpot( 0, 0, &expected, reporter, grid );
+    if ((spot->time != expected.time) || (spot->freqHz != expected.freqHz) || (spot->snr != expected.snr) || (spot->drift != expected.drift)
+            || (strcmp( spot->reporter, reporter )) || (strcmp( spot->grid, grid )) || (spot->distance != expected.distance)
+            || (spot->azimuth != expected.azimuth) || (spot->source != expected.source) || (spot->band != spotstore_band( expected.freqHz ))) {
+        printf("the first spot came back wrong: %s %s %u\n",spot->reporter,spot->grid,spot->freqHz);
+        (*errors)++;
+    }
+    return 1;                           // just the first one
+}
+
+static void emptyDirectory( const char *dir ) {
+    DIR *dp = opendir( dir );
+    struct dirent *entry;
+    char name[320];
+
+    if (dp == (DIR *)NULL) {
+        return;
+    }
+    while ((entry = readdir( dp )) != (struct dirent *)NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf( name, sizeof(name), "%s/%s", dir, entry->d_name );
+            unlink( name );
+        }
+    }
+    closedir( dp );
+}
+
+static double timeQuery( struct SpotStore *store, const struct SpotQuery *query, long *found ) {
+    struct timespec start;
+    double seconds;
+    int repeats = 20;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int iii = 0; iii < repeats; iii++) {
+        *found = 0;
+        spotstore_query( store, query, countSpot, found );
+    }
+    seconds = secondsSince( &start );
+    return seconds*1000.0/repeats;
+}
+
+int main() {
+    struct Expected expected;
+    struct SpotStore *store;
+    struct SpotQuery query;
+    struct Spot spot;
+    struct timespec start;
+    struct stat st;
+    char reporter[32], grid[16], name[320];
+    long found, total = 0;
+    double seconds, ms;
+    int errors = 0, fd;
+
+    //  Two years of cycles, each written at the end of the cycle the way the reports thread does it
+    emptyDirectory( TEST_DIR );
+    memset( &expected, 0, sizeof(expected) );
+    if (spotstore_open( TEST_DIR ) == -1) {
+        return 1;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for (int cycle = 0; cycle < NUM_CYCLES; cycle++) {
+        int numSpots = 40 + (cycle*31) % 160;
+
+        for (int nnn = 0; nnn < numSpots; nnn++) {
+            makeSpot( cycle, nnn, &spot, reporter, grid );
+            if (spotstore_add( &spot ) == -1) {
+                errors++;
+            }
+            expected.all++;
+            if ((spotstore_band( spot.freqHz ) == spotstore_bandOf( "10m" )) && (spot.time >= LAST_MONTH) && (spot.time < LAST_MONTH + 30*86400)) {
+                expected.tenLastMonth++;
+            }
+            if (!strcmp( reporter, "REPORTER7" )) {
+                expected.oneReporter++;
+            }
+            if ((!strncmp( grid, "JO", 2 )) && (spot.distance >= 5000)) {
+                expected.jo5000++;
+            }
+            if (spot.time >= START_TIME + (NUM_CYCLES - 48)*1800) {
+                expected.lastDay++;
+            }
+        }
+        if (spotstore_flush() == -1) {
+            errors++;
+        }
+    }
+    spotstore_close();
+    seconds = secondsSince( &start );
+    for (int month = 202401; month <= 202512; month += (month % 100 == 12) ? 89 : 1) {
+        snprintf( name, sizeof(name), "%s/%06d.col", TEST_DIR, month );
+        if (stat( name, &st ) == 0) {
+            total += st.st_size;
+        }
+    }
+    printf("%ld spots written in %.2f s (%.0f a second), a flush a cycle, %.1f MB of columns\n",expected.all,seconds,expected.all/seconds,
+           total/1e6);
+
+    //  A string cut off by a crash is dropped, and the store carries on
+    snprintf( name, sizeof(name), "%s/strings.dat", TEST_DIR );
+    fd = open( name, O_WRONLY | O_APPEND );
+    if ((fd == -1) || (write( fd, "CUTOFF", 6 ) != 6)) {
+        printf("can't append to %s\n",name);
+        errors++;
+    }
+    close( fd );
+    spotstore_open( TEST_DIR );
+    makeSpot( NUM_CYCLES, 0, &spot, reporter, grid );
+    spot.reporter = "NEW1CALL";
+    spotstore_add( &spot );
+    spotstore_close();
+    expected.all++;
+    expected.lastDay++;
+    if ((!strncmp( grid, "JO", 2 )) && (spot.distance >= 5000)) {
+        expected.jo5000++;
+    }
+
+    //  Read back
+    store = spotstore_openRead( TEST_DIR );
+    if (store == (struct SpotStore *)NULL) {
+        printf("can't open %s\n",TEST_DIR);
+        return 1;
+    }
+    memset( &query, 0, sizeof(query) );
+    spotstore_query( store, &query, checkSpot, &errors );
+
+    ms = timeQuery( store, &query, &found );
+    printf("    all spots                          %8ld  %7.2f ms\n",found,ms);
+    if (found != expected.all) {
+        printf("        expected %ld\n",expected.all);
+        errors++;
+    }
+    if (spotstore_query( store, &query, (SpotFn)NULL, NULL ) != expected.all) {
+        printf("    counting without a callback is wrong\n");
+        errors++;
+    }
+
+    memset( &query, 0, sizeof(query) );
+    query.band = spotstore_bandOf( "10m" );
+    query.from = LAST_MONTH;
+    query.to = LAST_MONTH + 30*86400;
+    ms = timeQuery( store, &query, &found );
+    printf("    10m last month                     %8ld  %7.2f ms\n",found,ms);
+    if (found != expected.tenLastMonth) {
+        printf("        expected %ld\n",expected.tenLastMonth);
+        errors++;
+    }
+
+    memset( &query, 0, sizeof(query) );
+    query.reporter = "REPORTER7";
+    ms = timeQuery( store, &query, &found );
+    printf("    REPORTER7, two years               %8ld  %7.2f ms\n",found,ms);
+    if (found != expected.oneReporter) {
+        printf("        expected %ld\n",expected.oneReporter);
+        errors++;
+    }
+
+    memset( &query, 0, sizeof(query) );
+    query.gridPrefix = "jo";
+    query.minDistance = 5000;
+    ms = timeQuery( store, &query, &found );
+    printf("    JO, 5000 miles and more            %8ld  %7.2f ms\n",found,ms);
+    if (found != expected.jo5000) {
+        printf("        expected %ld\n",expected.jo5000);
+        errors++;
+    }
+
+    memset( &query, 0, sizeof(query) );
+    query.from = START_TIME + (NUM_CYCLES - 48)*1800;
+    ms = timeQuery( store, &query, &found );
+    printf("    the last day                       %8ld  %7.2f ms\n",found,ms);
+    if (found != expected.lastDay) {
+        printf("        expected %ld\n",expected.lastDay);
+        errors++;
+    }
+
+    memset( &query, 0, sizeof(query) );
+    query.reporter = "NEW1CALL";
+    if (spotstore_query( store, &query, (SpotFn)NULL, NULL ) != 1) {
+        printf("    the spot after the cut off string is missing\n");
+        errors++;
+    }
+    query.reporter = "NOBODY";
+    if (spotstore_query( store, &query, (SpotFn)NULL, NULL ) != 0) {
+        errors++;
+    }
+    spotstore_closeRead( store );
+
+    printf("%s\n",(errors) ? "FAIL" : "PASS");
+    return (errors) ? 1 : 0;
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef _SPOTSTORE_H_
+#define _SPOTSTORE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#define SPOTSTORE_DIR           "spotstore"     // in the working directory, where raw_reports_log.txt was
+#define SPOTSTORE_SEGMENT_ROWS  8192            // spots in a segment, each segment has its own min/max index
+
+#define SPOT_WSPRNET            1               // Spot.source
+#define SPOT_PSKREPORTER        2
+#define SPOT_IMPORTED           3               // from the old text logs
+
+struct Spot {                   // one spot as it goes in and comes out, the strings are kept in the store's dictionary
+    time_t time;                // UTC
+    uint32_t freqHz;
+    int snr;                    // dB
+    int drift;                  // Hz/minute, 0 for FT8
+    const char *reporter;
+    const char *grid;
+    int distance;               // miles from MY_LOCATOR (gridcache.c)
+    int azimuth;                // degrees
+    int band;                   // spotstore_band() of freqHz, filled in by spotstore_add()
+    int source;                 // SPOT_WSPRNET...
+};
+
+struct SpotQuery {              // 0 or NULL is anything
+    time_t from;                // from <= time < to
+    time_t to;
+    int band;                   // spotstore_band()
+    const char *reporter;       // the callsign exactly
+    const char *gridPrefix;     // "DM13", "JO"
+    int source;
+    int minDistance;            // miles
+};
+
+typedef int (*SpotFn)( const struct Spot *spot, void *context );     // return non-zero to stop
+
+struct SpotStore;
+
+extern int spotstore_open( const char *directory );
+extern int spotstore_add( const struct Spot *spot );
+extern int spotstore_flush( void );
+extern void spotstore_close( void );
+
+extern struct SpotStore *spotstore_openRead( const char *directory );
+extern long spotstore_query( struct SpotStore *store, const struct SpotQuery *query, SpotFn fn, void *context );
+extern void spotstore_closeRead( struct SpotStore *store );
+
+extern int spotstore_band( uint32_t freqHz );
+extern const char *spotstore_bandName( int band );
+extern int spotstore_bandOf( const char *name );
+
+#endif
@@ -0,0 +1,533 @@
+/*
+    spottable.c - the cycle's wsprnet.org spots, one per band and reporter.  A reporter often decodes a beacon more than once (the same
+        band at another time, or on more than one receiver), wsprnet.c keeps the best SNR.  It used to find the duplicate by going
+        through every entry for every row, copying both frequencies and cutting them at the '.' to compare the bands, and stopped adding
+        at 500 entries although it asks wsprnet.org for up to 600 rows.
+
+        Now the entries are in an open addressing hash table keyed on the band (the MHz) and the reporter, so a row is one lookup
+        whatever the number of spots, and there is no limit.  The entries come from an arena of blocks that are kept and re-used by
+        spottable_reset(), nothing is freed between cycles.  spottable_entries() lists them in the order they were added (newest first,
+        the order of the rows).
+
+        An entry is numbers, parsed once when the row is read: the frequency in Hz, the SNR, drift, distance and azimuth.  It was nine
+        char[64] strings (580 bytes) that were sscanf()ed again by every loop that looked at them; now it is 32 bytes.  The reporter
+        and grid square are interned by spottable_intern(), the same string is the same id for the cycle, so comparing them is
+        comparing two numbers.  spottable_string() gives the text back for printing.
+
+        It holds one cycle of wsprnet.org spots for doCurl(), in the reports thread (reports.c), and is reset when the next cycle's first
+        query comes in.
+
+    To test and benchmark (against the old scan and strings, with tens of thousands of rows):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o spottable spottable.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spottable.h"
+
+#define BLOCK_ENTRIES   256             // entries per arena block
+#define MIN_SLOTS       1024            // hash table size, a power of 2.  Doubled when it gets half full.
+#define MIN_POOL        16384           // bytes of interned strings to start with, doubled as needed
+
+struct Block {
+    struct Block *next;
+    int used;
+    Entry entry[BLOCK_ENTRIES];
+};
+
+void spottable_reset( void );
+Entry *spottable_insert( int64_t freqHz, uint32_t reporter, int *added );
+Entry **spottable_entries( int *numEntries );
+uint32_t spottable_intern( const char *text, int length );
+const char *spottable_string( uint32_t id );
+
+static unsigned int hashEntry( int64_t band, uint32_t reporter );
+static unsigned int hashString( const char *text, int length );
+static unsigned int entryHash( int index );
+static unsigned int stringHash( int index );
+static int internString( const char *text, int length );
+static Entry *allocateEntry( void );
+static int growSlots( int **slots, unsigned int *numSlots, int count, unsigned int (*hashOf)( int index ) );
+
+//  The spots
+static struct Block *firstBlock = (struct Block *)NULL;
+static struct Block *currentBlock = (struct Block *)NULL;
+static Entry **entries = (Entry **)NULL;           // in the order they were added
+static int numEntries = 0;
+static int maxEntries = 0;
+static int *slots = (int *)NULL;                   // index in entries[] + 1, 0 is empty
+static unsigned int numSlots = 0;
+
+//  The interned strings.  Id 0 is "".
+static char *pool = (char *)NULL;                  // the strings, null terminated, one after the other
+static int poolUsed = 0;
+static int poolSize = 0;
+static int *offsets = (int *)NULL;                 // in pool[], by id
+static unsigned int *hashes = (unsigned int *)NULL;     // by id
+static int numStrings = 0;
+static int maxStrings = 0;
+static int *stringSlots = (int *)NULL;             // id + 1, 0 is empty
+static unsigned int numStringSlots = 0;
+
+
+//  A new cycle.  The entries and strings are forgotten, their memory is kept for the next ones.
+void spottable_reset( void ) {
+    currentBlock = firstBlock;
+    if (currentBlock != (struct Block *)NULL) {
+        currentBlock->used = 0;
+    }
+    numEntries = 0;
+    if (slots != (int *)NULL) {
+        memset( slots, 0, numSlots*sizeof(int) );
+    }
+    numStrings = 0;
+    poolUsed = 0;
+    if (stringSlots != (int *)NULL) {
+        memset( stringSlots, 0, numStringSlots*sizeof(int) );
+    }
+}
+
+
+//  The entry for the band of freqHz (the whole MHz) and the reporter.  If there isn't one yet it is added with freqHz and reporter
+//      filled in, *added is set and the caller fills in the rest.  NULL if out of memory.
+Entry *spottable_insert( int64_t freqHz, uint32_t reporter, int *added ) {
+    int64_t band = freqHz / 1000000;
+    unsigned int hash, iii;
+    Entry *entry;
+
+    if ((2*(numEntries + 1) > (int)numSlots) && (growSlots( &slots, &numSlots, numEntries, entryHash ) == -1)) {
+        return (Entry *)NULL;
+    }
+    hash = hashEntry( band, reporter );
+    for (iii = hash & (numSlots - 1); slots[iii] != 0; iii = (iii + 1) & (numSlots - 1)) {
+        entry = entries[ slots[iii] - 1 ];
+        if ((entry->hash == hash) && (entry->reporter == reporter) && (entry->freqHz / 1000000 == band)) {
+            *added = 0;
+            return entry;
+        }
+    }
+
+    //  Not there, add it
+    if (numEntries == maxEntries) {
+        int newMax = (maxEntries == 0) ? BLOCK_ENTRIES : 2*maxEntries;
+        Entry **newEntries = realloc( entries, newMax*sizeof(Entry *) );
+        if (newEntries == (Entry **)NULL) {
+            return (Entry *)NULL;
+        }
+        entries = newEntries;
+        maxEntries = newMax;
+    }
+    entry = allocateEntry();
+    if (entry == (Entry *)NULL) {
+        return (Entry *)NULL;
+    }
+    memset( entry, 0, sizeof(Entry) );
+    entry->freqHz = freqHz;
+    entry->reporter = reporter;
+    entry->hash = hash;
+    entries[numEntries++] = entry;
+    slots[iii] = numEntries;
+    *added = 1;
+    return entry;
+}
+
+
+Entry **spottable_entries( int *numEntriesReturned ) {
+    *numEntriesReturned = numEntries;
+    return entries;
+}
+
+
+//  The id of text (not null terminated), the same for the same text until spottable_reset().  0 ("") if out of memory.
+uint32_t spottable_intern( const char *text, int length ) {
+    int id;
+
+    if ((numStrings == 0) && (internString( "", 0 ) != 0)) {      // "" is always id 0
+        return 0;
+    }
+    id = internString( text, length );
+    return (id == -1) ? 0 : (uint32_t)id;
+}
+
+
+//  The text of an id.  Good until the next spottable_intern() or spottable_reset().
+const char *spottable_string( uint32_t id ) {
+    if ((int)id >= numStrings) {
+        return "";
+    }
+    return &pool[ offsets[id] ];
+}
+
+
+static unsigned int hashEntry( int64_t band, uint32_t reporter ) {
+    unsigned int hash = (unsigned int)band * 2654435761u ^ reporter * 2246822519u;
+    return hash ^ (hash >> 15);
+}
+
+
+//  FNV-1a
+static unsigned int hashString( const char *text, int length ) {
+    unsigned int hash = 2166136261u;
+
+    for (int iii = 0; iii < length; iii++) {
+        hash = (hash ^ (unsigned char)text[iii]) * 16777619u;
+    }
+    return hash;
+}
+
+
+static unsigned int entryHash( int index ) {
+    return entries[index]->hash;
+}
+
+
+static unsigned int stringHash( int index ) {
+    return hashes[index];
+}
+
+
+//  Finds or adds text.  Returns its id, -1 if out of memory.
+static int internString( const char *text, int length ) {
+    unsigned int hash, iii;
+
+    if ((2*(numStrings + 1) > (int)numStringSlots) && (growSlots( &stringSlots, &numStringSlots, numStrings, stringHash ) == -1)) {
+        return -1;
+    }
+    hash = hashString( text, length );
+    for (iii = hash & (numStringSlots - 1); stringSlots[iii] != 0; iii = (iii + 1) & (numStringSlots - 1)) {
+        int id = stringSlots[iii] - 1;
+        const char *string = &pool[ offsets[id] ];
+        if ((hashes[id] == hash) && (strncmp( string, text, length ) == 0) && (string[length] == 0)) {
+            return id;
+        }
+    }
+
+    //  Not there, add it
+    if (numStrings == maxStrings) {
+        int newMax = (maxStrings == 0) ? BLOCK_ENTRIES : 2*maxStrings;
+        int *newOffsets = realloc( offsets, newMax*sizeof(int) );
+        unsigned int *newHashes;
+        if (newOffsets == (int *)NULL) {
+            printf("Error in realloc()\n");
+            return -1;
+        }
+        offsets = newOffsets;
+        newHashes = realloc( hashes, newMax*sizeof(unsigned int) );
+        if (newHashes == (unsigned int *)NULL) {
+            printf("Error in realloc()\n");
+            return -1;
+        }
+        hashes = newHashes;
+        maxStrings = newMax;
+    }
+    if (poolUsed + length + 1 > poolSize) {
+        int newSize = (poolSize == 0) ? MIN_POOL : poolSize;
+        char *newPool;
+        while (newSize < poolUsed + length + 1) {
+            newSize *= 2;
+        }
+        newPool = realloc( pool, newSize );
+        if (newPool == (char *)NULL) {
+            printf("Error in realloc()\n");
+            return -1;
+        }
+        pool = newPool;
+        poolSize = newSize;
+    }
+    memcpy( &pool[poolUsed], text, length );
+    pool[poolUsed + length] = 0;
+    offsets[numStrings] = poolUsed;
+    hashes[numStrings] = hash;
+    poolUsed += length + 1;
+    stringSlots[iii] = numStrings + 1;
+    return numStrings++;
+}
+
+
+//  The next entry of the arena, re-using the blocks of earlier cycles before allocating another.
+static Entry *allocateEntry( void ) {
+    if ((currentBlock == (struct Block *)NULL) || (currentBlock->used == BLOCK_ENTRIES)) {
+        struct Block *next = (currentBlock == (struct Block *)NULL) ? firstBlock : currentBlock->next;
+
+        if (next == (struct Block *)NULL) {
+            next = malloc( sizeof(struct Block) );
+            if (next == (struct Block *)NULL) {
+                printf("Error in malloc()\n");
+                return (Entry *)NULL;
+            }
+            next->next = (struct Block *)NULL;
+            if (currentBlock == (struct Block *)NULL) {
+                firstBlock = next;
+            } else {
+                currentBlock->next = next;
+            }
+        }
+        next->used = 0;
+        currentBlock = next;
+    }
+    return &currentBlock->entry[ currentBlock->used++ ];
+}
+
+
+//  Doubles a hash table (or makes the first one) and puts the count indices back in.
+static int growSlots( int **slots, unsigned int *numSlots, int count, unsigned int (*hashOf)( int index ) ) {
+    unsigned int newNumSlots = (*numSlots == 0) ? MIN_SLOTS : 2*(*numSlots);
+    int *newSlots = calloc( newNumSlots, sizeof(int) );
+
+    if (newSlots == (int *)NULL) {
+        printf("Error in calloc()\n");
+        return -1;
+    }
+    for (int iii = 0; iii < count; iii++) {
+        unsigned int jjj;
+        for (jjj = hashOf( iii ) & (newNumSlots - 1); newSlots[jjj] != 0; jjj = (jjj + 1) & (newNumSlots - 1)) {
+        }
+        newSlots[jjj] = iii + 1;
+    }
+    free( *slots );
+    *slots = newSlots;
+    *numSlots = newNumSlots;
+    return 0;
+}
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <time.h>
+
+#define OLD_MAX_ROWS    20000           // the old scan takes minutes beyond this
+
+struct OldEntry {                       // wsprnet.c's before this file
+    char timestamp[64];
+    char freq[64];
+    char snr[64];
+    char drift[64];
+    char reporter[64];
+    char reporterLocation[64];
+    char distance[64];
+    char azimuth[64];
+    char distance2[64];
+};
+
+static char *bands[] = { "1.838", "3.570", "7.040", "10.140", "14.097", "18.106", "21.096", "24.926", "28.126", "50.294" };
+
+//  A made up reports query: reporters heard on a few bands, each more than once
+static void makeRow( int iii, int numRows, char *freq, char *reporter, char *snr, char *distance ) {
+    unsigned int rnd = (unsigned int)iii * 2654435761u;
+
+    sprintf( freq, "%s%03u", bands[ (rnd >> 8) % 4 + (rnd >> 20) % 7 ], rnd % 1000 );
+    sprintf( reporter, "K%dXYZ", (int)((rnd >> 4) % (unsigned int)(numRows/2 + 1)) );
+    sprintf( snr, "%d", -(int)((rnd >> 12) % 30) );
+    sprintf( distance, "%d", (int)((rnd >> 16) % 9000) );
+}
+
+//  The old way: a scan of every entry, the fields kept as strings
+static int oldInsert( struct OldEntry **entry, int *numEntries, char *freq, char *reporter, char *snr, char *distance ) {
+    int iii;
+
+    for (iii = 0; iii < *numEntries; iii++) {
+        char freqEntry[20], freqNew[20], *cc;
+        strcpy(freqEntry,entry[iii]->freq);
+        strcpy(freqNew,freq);
+        cc = strchr(freqEntry,'.');
+        *cc = 0;
+        cc = strchr(freqNew,'.');
+        *cc = 0;
+        if ( strcmp( freqEntry, freqNew ) == 0 ) {
+            if ( strcmp(entry[iii]->reporter, reporter) == 0 ) {
+                int snrEntry, snrCur;
+                sscanf( entry[iii]->snr, "%d", &snrEntry );
+                sscanf( snr, "%d", &snrCur  );
+                if ( snrEntry < snrCur ) {
+                    strcpy(entry[iii]->snr,snr);
+                }
+                return 0;
+            }
+        }
+    }
+    entry[*numEntries] = malloc( sizeof( struct OldEntry ) );
+    strcpy( entry[*numEntries]->timestamp, "23:58" );
+    strcpy( entry[*numEntries]->freq, freq );
+    strcpy( entry[*numEntries]->snr, snr );
+    strcpy( entry[*numEntries]->drift, "0" );
+    strcpy( entry[*numEntries]->reporter, reporter );
+    strcpy( entry[*numEntries]->reporterLocation, "DM13ji" );
+    strcpy( entry[*numEntries]->distance, distance );
+    strcpy( entry[*numEntries]->azimuth, "045" );
+    strcpy( entry[*numEntries]->distance2, "  73" );
+    (*numEntries)++;
+    return 1;
+}
+
+//  What processEntries() did with each entry: the frequency sscanf()ed four times, the distance and SNR once, and the line printed
+static long oldShow( struct OldEntry *entry ) {
+    char line[1024];
+    double entryFreq;
+    int tempInt, length;
+
+    sscanf( entry->freq, "%lf", &entryFreq );
+    sscanf( entry->freq, "%lf", &entryFreq );
+    sscanf( entry->distance, "%d", &tempInt );
+    sscanf( entry->snr, "%d", &tempInt );
+    length = sprintf( line, "   %s %10s  %3s %2s  %10s   %6s  %5s mi  %3s deg\n", entry->timestamp, entry->freq, entry->snr, entry->drift,
+                      entry->reporter, entry->reporterLocation, entry->distance, entry->azimuth );
+    sscanf( entry->freq, "%lf", &entryFreq );
+    sscanf( entry->freq, "%lf", &entryFreq );
+    return length + tempInt;
+}
+
+//  The new way: parsed once, numbers from then on
+static int newInsert( char *freq, char *reporter, char *snr, char *distance ) {
+    int added, snrCur = atoi( snr );
+    int64_t freqHz = (int64_t)(atof( freq )*1e6 + 0.5);
+    Entry *entry = spottable_insert( freqHz, spottable_intern( reporter, strlen(reporter) ), &added );
+
+    if (added) {
+        entry->minute = 23*60 + 58;
+        entry->snr = snrCur;
+        entry->drift = 0;
+        entry->reporterLocation = spottable_intern( "DM13ji", 6 );
+        entry->distance = atoi( distance );
+        entry->azimuth = 45;
+        entry->distance2 = 73;
+    } else if (entry->snr < snrCur) {
+        entry->snr = snrCur;
+    }
+    return added;
+}
+
+static long newShow( Entry *entry ) {
+    char line[256];
+    int tempInt = 0;
+
+    if ((entry->freqHz > 28000000) && (entry->freqHz < 29000000)) { tempInt++; }
+    if (entry->distance > 3000) { tempInt++; }
+    if (entry->snr >= 0) { tempInt++; }
+    return sprintf( line, "   %02d:%02d %3d.%06d  %3d %2d  %10s   %6s  %5d mi  %03d deg\n", entry->minute/60, entry->minute%60,
+                    (int)(entry->freqHz/1000000), (int)(entry->freqHz%1000000), entry->snr, entry->drift, spottable_string( entry->reporter ),
+                    spottable_string( entry->reporterLocation ), entry->distance, entry->azimuth ) + tempInt;
+}
+
+static double secondsSince( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)*1e-9;
+}
+
+int main() {
+    int sizes[] = { 600, 5000, 20000, 50000, 200000 };
+    char freq[64], reporter[64], snr[64], distance[64];
+    int errors = 0, added, num;
+    uint32_t n3izn, n3iznSdr;
+    Entry *first, *entry, **list;
+    struct timespec start;
+
+    //  Interning
+    spottable_reset();
+    n3iznSdr = spottable_intern( "N3IZN/SDRxx", 9 );
+    n3izn = spottable_intern( "N3IZN", 5 );
+    if ((n3iznSdr == 0) || (n3izn == 0) || (n3izn == n3iznSdr) || (spottable_intern( "N3IZN/SDR", 9 ) != n3iznSdr)
+            || (strcmp( spottable_string( n3iznSdr ), "N3IZN/SDR" )) || (spottable_intern( "", 0 ) != 0) || (strcmp( spottable_string( 0 ), "" ))) {
+        printf("interning wrong\n");
+        errors++;
+    }
+
+    //  The same band and reporter is the same entry, another band or reporter isn't
+    first = spottable_insert( 28126084, n3iznSdr, &added );
+    if ((first == (Entry *)NULL) || (!added) || (first->freqHz != 28126084) || (first->reporter != n3iznSdr)) {
+        printf("first insert wrong\n");
+        errors++;
+    }
+    if ((spottable_insert( 28126101, n3iznSdr, &added ) != first) || (added)) {
+        printf("same band and reporter not found\n");
+        errors++;
+    }
+    if ((spottable_insert( 2812610, n3iznSdr, &added ) == first) || (!added)
+            || (spottable_insert( 28126084, n3izn, &added ) == first) || (!added)
+            || (spottable_insert( 50294000, n3iznSdr, &added ) == first) || (!added)) {
+        printf("another band or reporter found the first entry\n");
+        errors++;
+    }
+    list = spottable_entries( &num );
+    if ((num != 4) || (list[0] != first)) {
+        printf("%d entries\n",num);
+        errors++;
+    }
+
+    //  Well beyond the old 500 entries, and the same after a reset re-uses the arena
+    for (int pass = 0; pass < 2; pass++) {
+        spottable_reset();
+        for (int iii = 0; iii < 20000; iii++) {
+            sprintf( reporter, "R%d", iii );
+            if ((spottable_insert( 14097100, spottable_intern( reporter, strlen(reporter) ), &added ) == (Entry *)NULL) || (!added)) {
+                errors++;
+            }
+        }
+        for (int iii = 0; iii < 20000; iii += 7) {
+            sprintf( reporter, "R%d", iii );
+            entry = spottable_insert( 14097180, spottable_intern( reporter, strlen(reporter) ), &added );
+            if ((added) || (strcmp( spottable_string( entry->reporter ), reporter ))) {
+                errors++;
+            }
+        }
+        list = spottable_entries( &num );
+        if (num != 20000) {
+            printf("pass %d, %d entries\n",pass,num);
+            errors++;
+        }
+    }
+
+    //  Benchmark, ns per row for the old way and the new, reading the row (making it included) and showing the entries.  About one
+    //      row in ten is a duplicate.
+    printf("%zu bytes per entry, was %zu\n",sizeof(Entry),sizeof(struct OldEntry));
+    printf("   rows  entries       old ns/row       new ns/row\n");
+    for (int sss = 0; sss < (int)(sizeof(sizes)/sizeof(sizes[0])); sss++) {
+        int numRows = sizes[sss], numOld = 0, newEntries = 0;
+        long check = 0;
+        double oldSec = 0, newSec;
+
+        if (numRows <= OLD_MAX_ROWS) {
+            struct OldEntry **old = malloc( numRows*sizeof(struct OldEntry *) );
+            clock_gettime( CLOCK_MONOTONIC, &start );
+            for (int iii = 0; iii < numRows; iii++) {
+                makeRow( iii, numRows, freq, reporter, snr, distance );
+                oldInsert( old, &numOld, freq, reporter, snr, distance );
+            }
+            for (int iii = 0; iii < numOld; iii++) {
+                check += oldShow( old[iii] );
+            }
+            oldSec = secondsSince( &start );
+            for (int iii = 0; iii < numOld; iii++) {
+                free( old[iii] );
+            }
+            free( old );
+        }
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        spottable_reset();
+        for (int iii = 0; iii < numRows; iii++) {
+            makeRow( iii, numRows, freq, reporter, snr, distance );
+            newEntries += newInsert( freq, reporter, snr, distance );
+        }
+        list = spottable_entries( &num );
+        for (int iii = 0; iii < num; iii++) {
+            check -= newShow( list[iii] );
+        }
+        newSec = secondsSince( &start );
+        if ((numRows <= OLD_MAX_ROWS) && (numOld != newEntries)) {
+            printf("old scan %d entries, hash table %d\n",numOld,newEntries);
+            errors++;
+        }
+        if (numRows <= OLD_MAX_ROWS) {
+            printf("%7d  %7d  %15.0lf  %15.0lf\n",numRows,newEntries,oldSec*1e9/numRows,newSec*1e9/numRows);
+        } else {
+            printf("%7d  %7d  %15s  %15.0lf\n",numRows,newEntries,"-",newSec*1e9/numRows);
+        }
+    }
+
+    printf("%s\n",errors ? "FAIL" : "PASS");
+    return errors;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _SPOTTABLE_H_
+#define _SPOTTABLE_H_
+
+#include <stdint.h>
+
+struct Entry {                  // one wsprnet.org spot, the best SNR of a reporter on a band.  Parsed once, 32 bytes.
+    int64_t freqHz;
+    uint32_t hash;              // of the band and reporter, spottable.c's
+    uint32_t reporter;          // spottable_string()
+    uint32_t reporterLocation;  // spottable_string(), the grid square
+    uint16_t minute;            // UTC, hour*60 + minute
+    uint16_t distance;          // miles, wsprnet.org's
+    uint16_t azimuth;           // degrees, gridcache.c's
+    uint16_t distance2;         // miles, gridcache.c's
+    int8_t snr;
+    int8_t drift;
+};
+typedef struct Entry Entry;
+
+extern void spottable_reset( void );
+extern Entry *spottable_insert( int64_t freqHz, uint32_t reporter, int *added );
+extern Entry **spottable_entries( int *numEntries );
+extern uint32_t spottable_intern( const char *text, int length );
+extern const char *spottable_string( uint32_t id );
+
+#endif
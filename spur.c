@@ -0,0 +1,424 @@
+/*
+    spur.c - measures the spectral purity of transmit audio.  wav_output3.c went to aplay (and now alsaplay.c) because portaudio put out
+        spurs about 20 dB down on the Pi, and until now that could only be seen on the air.  This runs an averaged FFT over a buffer (or a
+        wav file) and lists every spur: its frequency, offset from the signal, level relative to the signal (dBc) and whether it falls in
+        the 200 Hz WSPR window.  A mask gives the worst allowed in band and out of band levels, spur_analyze() returns how many spurs
+        are over it.
+
+        The spectrum is the average of half overlapped Blackman-Harris (4 term, -92 dB sidelobes) FFTs about SPUR_FFT_SECONDS long, so the
+        bins are about 0.35 Hz, less than a quarter of the WSPR tone spacing.  Two FFTs are done at a time, one in the real part and one in
+        the imaginary part.  The signal is whatever is within SPUR_EDGE_DB of the strongest bin, bridging gaps up to SPUR_EDGE_GAP_HZ,
+        and its power is the 0 dBc reference.  A spur is a local peak outside the signal at least SPUR_PROMINENCE_DB above the median of
+        the bins SPUR_NOISE_HZ either side, and its level is the power summed over the window's main lobe.  Stereo is mixed to mono.
+
+    To analyze wav files (mapped by audiocache.c), or with no files to run the self test and analyze the repository's wav files:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o spur spur.c fft.c wspr.c ft8.c resample.c audiocache.c -lm
+            ./spur [-i inBandDbc] [-o outOfBandDbc] [-w lowHz highHz] [-f floorDbc] [file.wav ...]
+        - it exits with 1 if any spur is over the mask.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fft.h"
+#include "spur.h"
+
+#define SPUR_FFT_SECONDS        2.5         // rounded up to a power of 2 samples
+#define SPUR_MAINLOBE_BINS      4           // Blackman-Harris main lobe, either side of the peak
+#define SPUR_EDGE_DB            (-50.0)
+#define SPUR_EDGE_GAP_HZ        2.0
+#define SPUR_PROMINENCE_DB      10.0
+#define SPUR_NOISE_HZ           20.0
+#define FULL_SCALE_POWER        (32768.0*32768.0/2.0)
+
+void spur_defaultMask( struct SpurMask *mask );
+int spur_analyze( const short *samples, long numFrames, int rate, int channels, const struct SpurMask *mask, struct SpurReport *report );
+void spur_print( FILE *fptr, const char *name, const struct SpurMask *mask, const struct SpurReport *report );
+
+static double *averageSpectrum( const short *samples, long numFrames, int channels, int fftSize, int *averages );
+static double localMedian( const double *psd, int numBins, int bin, int halfWidth );
+static int compareDouble( const void *aa, const void *bb );
+static int compareSpur( const void *aa, const void *bb );
+
+
+//  WSPR window 1400 - 1600 Hz (a 1500 Hz dial offset), -50 dBc in it, -43 dBc (FCC 97.307 below 30 MHz) everywhere else, spurs
+//      reported down to -90 dBc from 20 Hz (below the hum) to Nyquist.
+void spur_defaultMask( struct SpurMask *mask ) {
+    mask->windowLowHz = 1400.0;
+    mask->windowHighHz = 1600.0;
+    mask->inBandDbc = -50.0;
+    mask->outOfBandDbc = -43.0;
+    mask->floorDbc = -90.0;
+    mask->minHz = 20.0;
+    mask->maxHz = 0.0;
+}
+
+
+//  Fills in report.  Returns the number of spurs over the mask (0 is a pass) or -1 on an error.
+int spur_analyze( const short *samples, long numFrames, int rate, int channels, const struct SpurMask *mask, struct SpurReport *report ) {
+    struct Spur *found = (struct Spur *)NULL;
+    double *psd, binHz, maxHz, threshold, signalPower = 0.0, weighted = 0.0;
+    int fftSize = 2, numBins, minBin, maxBin, peak, lowBin, highBin, gapBins, noiseBins, numFound = 0;
+
+    memset( report, 0, sizeof(struct SpurReport) );
+    report->worstInBandDbc = -999.0;
+    report->worstOutOfBandDbc = -999.0;
+    if ((rate <= 0) || (channels < 1) || (numFrames < 1)) {
+        return -1;
+    }
+    while (fftSize < SPUR_FFT_SECONDS*rate) { fftSize <<= 1; }
+    psd = averageSpectrum( samples, numFrames, channels, fftSize, &report->averages );
+    if (psd == (double *)NULL) {
+        return -1;
+    }
+    numBins = fftSize/2 + 1;
+    binHz = (double)rate/fftSize;
+    maxHz = ((mask->maxHz <= 0.0) || (mask->maxHz > rate/2.0)) ? rate/2.0 : mask->maxHz;
+    minBin = (int)ceil( mask->minHz/binHz );
+    maxBin = (int)floor( maxHz/binHz );
+    if (maxBin >= numBins) { maxBin = numBins - 1; }
+    report->rate = rate;
+    report->fftSize = fftSize;
+    report->seconds = (double)numFrames/rate;
+
+    //  The signal, out from the strongest bin until there's nothing within SPUR_EDGE_DB of it for SPUR_EDGE_GAP_HZ.
+    peak = minBin;
+    for (int bin = minBin; bin <= maxBin; bin++) {
+        if (psd[bin] > psd[peak]) { peak = bin; }
+    }
+    if (psd[peak] <= 0.0) {
+        printf("spur_analyze() - no signal\n");
+        free( psd );
+        return -1;
+    }
+    threshold = psd[peak]*pow( 10.0, SPUR_EDGE_DB/10.0 );
+    gapBins = (int)ceil( SPUR_EDGE_GAP_HZ/binHz );
+    lowBin = highBin = peak;
+    for (int bin = peak - 1; (bin >= minBin) && (bin >= lowBin - gapBins); bin--) {
+        if (psd[bin] >= threshold) { lowBin = bin; }
+    }
+    for (int bin = peak + 1; (bin <= maxBin) && (bin <= highBin + gapBins); bin++) {
+        if (psd[bin] >= threshold) { highBin = bin; }
+    }
+    lowBin = (lowBin - SPUR_MAINLOBE_BINS < 0) ? 0 : lowBin - SPUR_MAINLOBE_BINS;
+    highBin = (highBin + SPUR_MAINLOBE_BINS >= numBins) ? numBins - 1 : highBin + SPUR_MAINLOBE_BINS;
+    for (int bin = lowBin; bin <= highBin; bin++) {
+        signalPower += psd[bin];
+        weighted += psd[bin]*bin*binHz;
+    }
+    report->signalLowHz = lowBin*binHz;
+    report->signalHighHz = highBin*binHz;
+    report->centerHz = weighted/signalPower;
+    report->signalDbfs = 10.0*log10( signalPower/FULL_SCALE_POWER );
+
+    //  The spurs.  A peak has to be the highest bin within a main lobe each side of it, counting a tie only once.
+    found = (struct Spur *)malloc( (maxBin - minBin + 1)*sizeof(struct Spur) );
+    if (found == (struct Spur *)NULL) {
+        printf("spur_analyze() - Error in malloc()\n");
+        free( psd );
+        return -1;
+    }
+    noiseBins = (int)ceil( SPUR_NOISE_HZ/binHz );
+    for (int bin = minBin; bin <= maxBin; bin++) {
+        double power = 0.0, dbc, delta = 0.0;
+        int isPeak = 1;
+
+        if ((bin >= lowBin - SPUR_MAINLOBE_BINS) && (bin <= highBin + SPUR_MAINLOBE_BINS)) {
+            continue;
+        }
+        for (int jjj = bin - SPUR_MAINLOBE_BINS; isPeak && (jjj <= bin + SPUR_MAINLOBE_BINS); jjj++) {
+            if ((jjj < 0) || (jjj >= numBins) || (jjj == bin)) { continue; }
+            if ((psd[jjj] > psd[bin]) || ((jjj < bin) && (psd[jjj] == psd[bin]))) { isPeak = 0; }
+        }
+        if (!isPeak) {
+            continue;
+        }
+        for (int jjj = bin - SPUR_MAINLOBE_BINS; jjj <= bin + SPUR_MAINLOBE_BINS; jjj++) {
+            if ((jjj >= 0) && (jjj < numBins)) { power += psd[jjj]; }
+        }
+        dbc = 10.0*log10( power/signalPower );
+        if ((dbc < mask->floorDbc) || (psd[bin] < localMedian( psd, numBins, bin, noiseBins )*pow( 10.0, SPUR_PROMINENCE_DB/10.0 ))) {
+            continue;
+        }
+        if ((bin > 0) && (bin < numBins - 1) && (psd[bin-1] > 0.0) && (psd[bin+1] > 0.0)) {
+            double left = log( psd[bin-1] ), middle = log( psd[bin] ), right = log( psd[bin+1] );
+            double denominator = left - 2.0*middle + right;
+            delta = (denominator < 0.0) ? 0.5*(left - right)/denominator : 0.0;
+        }
+        found[numFound].freqHz = (bin + delta)*binHz;
+        found[numFound].offsetHz = found[numFound].freqHz - report->centerHz;
+        found[numFound].dbc = dbc;
+        found[numFound].inBand = (found[numFound].freqHz >= mask->windowLowHz) && (found[numFound].freqHz <= mask->windowHighHz);
+        found[numFound].overMask = dbc > (found[numFound].inBand ? mask->inBandDbc : mask->outOfBandDbc);
+        if (found[numFound].inBand && (dbc > report->worstInBandDbc)) { report->worstInBandDbc = dbc; }
+        if (!found[numFound].inBand && (dbc > report->worstOutOfBandDbc)) { report->worstOutOfBandDbc = dbc; }
+        report->numOverMask += found[numFound].overMask;
+        numFound++;
+    }
+    qsort( found, numFound, sizeof(struct Spur), compareSpur );
+    report->numSpurs = (numFound < SPUR_MAX_SPURS) ? numFound : SPUR_MAX_SPURS;
+    memcpy( report->spurs, found, report->numSpurs*sizeof(struct Spur) );
+    free( found );
+    free( psd );
+    return report->numOverMask;
+}
+
+
+
+void spur_print( FILE *fptr, const char *name, const struct SpurMask *mask, const struct SpurReport *report ) {
+    fprintf(fptr,"%s: %.1lf sec at %d Hz, %d point FFT (%.2lf Hz), %d averages\n", name, report->seconds, report->rate, report->fftSize,
+            (double)report->rate/report->fftSize, report->averages);
+    fprintf(fptr,"    signal %.1lf - %.1lf Hz, center %.2lf Hz, %.1lf dBFS\n", report->signalLowHz, report->signalHighHz, report->centerHz,
+            report->signalDbfs);
+    if (report->numSpurs > 0) {
+        fprintf(fptr,"      freq Hz   offset Hz     dBc   band\n");
+    }
+    for (int iii = 0; iii < report->numSpurs; iii++) {
+        const struct Spur *spur = &report->spurs[iii];
+        fprintf(fptr,"    %9.2lf   %+9.2lf  %6.1lf   %s%s\n", spur->freqHz, spur->offsetHz, spur->dbc, spur->inBand ? "in " : "out",
+                spur->overMask ? "   over mask" : "");
+    }
+    fprintf(fptr,"    worst in band %.1lf dBc (mask %.1lf), out of band %.1lf dBc (mask %.1lf): %s\n", report->worstInBandDbc, mask->inBandDbc,
+            report->worstOutOfBandDbc, mask->outOfBandDbc, report->numOverMask ? "FAIL" : "pass");
+}
+
+
+//  Average power spectrum, bins 0 to fftSize/2, scaled so the bins of a sine add up to its power.  Returns a malloc()ed array or NULL.
+static double *averageSpectrum( const short *samples, long numFrames, int channels, int fftSize, int *averages ) {
+    struct FFTPlan *plan = fft_plan( fftSize );
+    struct Complex *buf = (struct Complex *)malloc( fftSize*sizeof(struct Complex) );
+    double *window = (double *)malloc( fftSize*sizeof(double) );
+    double *psd = (double *)calloc( fftSize/2 + 1, sizeof(double) );
+    double windowPower = 0.0;
+    int hop = fftSize/2, numSegments;
+
+    if ((plan == (struct FFTPlan *)NULL) || (buf == (struct Complex *)NULL) || (window == (double *)NULL) || (psd == (double *)NULL)) {
+        printf("spur_analyze() - Error in malloc()\n");
+        fft_freePlan( plan );
+        free( buf );
+        free( window );
+        free( psd );
+        return (double *)NULL;
+    }
+    for (int iii = 0; iii < fftSize; iii++) {
+        double ww = 2.0*M_PI*iii/fftSize;
+        window[iii] = 0.35875 - 0.48829*cos( ww ) + 0.14128*cos( 2.0*ww ) - 0.01168*cos( 3.0*ww );
+        windowPower += window[iii]*window[iii];
+    }
+    numSegments = (numFrames <= fftSize) ? 1 : (int)((numFrames - fftSize)/hop) + 1;
+
+    for (int seg = 0; seg < numSegments; seg += 2) {
+        for (int part = 0; part < 2; part++) {
+            long start = (long)(seg + part)*hop;
+            for (int iii = 0; iii < fftSize; iii++) {
+                double value = 0.0;
+                if ((seg + part < numSegments) && (start + iii < numFrames)) {
+                    for (int ccc = 0; ccc < channels; ccc++) {
+                        value += samples[(start + iii)*channels + ccc];
+                    }
+                    value *= window[iii]/channels;
+                }
+                if (part == 0) {
+                    buf[iii].re = value;
+                } else {
+                    buf[iii].im = value;
+                }
+            }
+        }
+        fft_forward( plan, buf );
+        for (int kkk = 0; kkk <= fftSize/2; kkk++) {        // X1 = (Z[k] + Z*[N-k])/2, X2 = (Z[k] - Z*[N-k])/2i
+            const struct Complex *zk = &buf[kkk], *zn = &buf[(fftSize - kkk) & (fftSize - 1)];
+            double re1 = (zk->re + zn->re)/2.0, im1 = (zk->im - zn->im)/2.0;
+            double re2 = (zk->im + zn->im)/2.0, im2 = (zn->re - zk->re)/2.0;
+            psd[kkk] += re1*re1 + im1*im1 + re2*re2 + im2*im2;
+        }
+    }
+    for (int kkk = 0; kkk <= fftSize/2; kkk++) {
+        psd[kkk] *= 2.0/((double)fftSize*windowPower*numSegments);
+    }
+    *averages = numSegments;
+    fft_freePlan( plan );
+    free( buf );
+    free( window );
+    return psd;
+}
+
+
+static double localMedian( const double *psd, int numBins, int bin, int halfWidth ) {
+    double values[2*halfWidth + 1];
+    int count = 0;
+
+    for (int jjj = bin - halfWidth; jjj <= bin + halfWidth; jjj++) {
+        if ((jjj >= 0) && (jjj < numBins) && (abs( jjj - bin ) > SPUR_MAINLOBE_BINS)) {
+            values[count++] = psd[jjj];
+        }
+    }
+    if (count == 0) {
+        return 0.0;
+    }
+    qsort( values, count, sizeof(double), compareDouble );
+    return values[count/2];
+}
+
+
+static int compareDouble( const void *aa, const void *bb ) {
+    double diff = *(const double *)aa - *(const double *)bb;
+    return (diff > 0.0) - (diff < 0.0);
+}
+
+
+static int compareSpur( const void *aa, const void *bb ) {
+    double diff = ((const struct Spur *)bb)->dbc - ((const struct Spur *)aa)->dbc;
+    return (diff > 0.0) - (diff < 0.0);
+}
+
+
+
+
+//  With wav files on the command line each one is analyzed against the mask.  Without, the self test:
+//      - A clean WSPR beacon, and the same beacon converted to 44.1 kHz stereo (resample.c), must pass.
+//      - The beacon with a -30 dBc tone added at 1450 Hz must report it in band at 1450 Hz, -30 dBc, and fail.  So must a -20 dBc tone at
+//        3000 Hz (out of band), the size of the portaudio spurs.
+//      - A synthesized FT8 signal must pass.
+//      - Every wav file in the repository is analyzed and timed.  Two minutes of audio has to take well under a second.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <time.h>
+#include "wspr.h"
+#include "ft8.h"
+#include "resample.h"
+#include "audiocache.h"
+
+static const char *repoFiles[] = { "1470.wav", "1480.wav", "1490.wav", "1500.wav", "1510.wav", "1520.wav", "1530.wav",
+                                   "TST_NQ6B_DM12_900Hz.wav", "TST_NQ6B_DM12_1400Hz.wav", "TST_NQ6B_DM12_2040Hz.wav" };
+
+static double elapsed( const struct timespec *t0 ) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec)/1e9;
+}
+
+//  Adds a tone dbc below a constant envelope signal of peak amplitude.
+static void addTone( short *samples, int numSamples, int start, double freqHz, double dbc, double amplitude ) {
+    double toneAmplitude = amplitude*pow( 10.0, dbc/20.0 );
+    for (int iii = start; iii < numSamples; iii++) {
+        samples[iii] += (short)lrint( toneAmplitude*sin( 2.0*M_PI*freqHz*iii/WSPR_SAMPLE_RATE ) );
+    }
+}
+
+static int check( const char *name, int result, int expected, const struct SpurMask *mask, const struct SpurReport *report ) {
+    spur_print( stdout, name, mask, report );
+    if ((result < 0) || ((result > 0) != expected)) {
+        printf("    expected %s\n", expected ? "FAIL" : "pass");
+        return 1;
+    }
+    return 0;
+}
+
+int main( int argc, char *argv[] ) {
+    struct SpurMask mask;
+    struct SpurReport report;
+    struct timespec t0;
+    int errors = 0, numFiles = 0, result;
+
+    spur_defaultMask( &mask );
+    for (int iii = 1; iii < argc; iii++) {
+        if (!strcmp( argv[iii], "-i" ) && (iii + 1 < argc)) {
+            mask.inBandDbc = atof( argv[++iii] );
+        } else if (!strcmp( argv[iii], "-o" ) && (iii + 1 < argc)) {
+            mask.outOfBandDbc = atof( argv[++iii] );
+        } else if (!strcmp( argv[iii], "-f" ) && (iii + 1 < argc)) {
+            mask.floorDbc = atof( argv[++iii] );
+        } else if (!strcmp( argv[iii], "-w" ) && (iii + 2 < argc)) {
+            mask.windowLowHz = atof( argv[++iii] );
+            mask.windowHighHz = atof( argv[++iii] );
+        } else {
+            struct AudioView wav;
+            numFiles++;
+            if (audiocache_mapWav( argv[iii], 0.0, 0.0, &wav )) {
+                errors++;
+                continue;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            result = spur_analyze( wav.samples, wav.numFrames, wav.rate, wav.channels, &mask, &report );
+            spur_print( stdout, argv[iii], &mask, &report );
+            printf("    %.0lf ms\n", elapsed( &t0 )*1e3);
+            errors += (result != 0);
+            audiocache_unmapWav( &wav );
+        }
+    }
+    if (numFiles > 0) {
+        return errors ? 1 : 0;
+    }
+
+    {
+        int numSamples;
+        long numFrames;
+        short *beacon = wspr_generate( "NQ6B", "DM12", 37, 1500.0, &numSamples );
+        short *spurred = (short *)malloc( numSamples*sizeof(short) );
+        short *converted;
+        double peak = 0.0;
+
+        for (int iii = 0; iii < numSamples; iii++) {
+            if (abs( beacon[iii] ) > peak) { peak = abs( beacon[iii] ); }
+        }
+        result = spur_analyze( beacon, numSamples, WSPR_SAMPLE_RATE, 1, &mask, &report );
+        errors += check( "beacon", result, 0, &mask, &report );
+
+        converted = resample_convert( beacon, numSamples, WSPR_SAMPLE_RATE, 1, 44100, 2, &numFrames );
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        result = spur_analyze( converted, numFrames, 44100, 2, &mask, &report );
+        errors += check( "beacon at 44.1 kHz stereo", result, 0, &mask, &report );
+        printf("    %.0lf ms\n", elapsed( &t0 )*1e3);
+        free( converted );
+
+        for (int iii = 0; iii < numSamples; iii++) { spurred[iii] = beacon[iii]/2; }         // room for the tone without clipping
+        addTone( spurred, numSamples, WSPR_LEAD_IN_SAMPLES, 1450.0, -30.0, peak/2 );
+        result = spur_analyze( spurred, numSamples, WSPR_SAMPLE_RATE, 1, &mask, &report );
+        errors += check( "beacon + 1450 Hz at -30 dBc", result, 1, &mask, &report );
+        if ((report.numSpurs < 1) || (fabs( report.spurs[0].freqHz - 1450.0 ) > 0.1) || !report.spurs[0].inBand ||
+            (fabs( report.spurs[0].dbc + 30.0 ) > 0.5)) {
+            printf("    1450 Hz spur wrong\n");
+            errors++;
+        }
+
+        for (int iii = 0; iii < numSamples; iii++) { spurred[iii] = beacon[iii]/2; }
+        addTone( spurred, numSamples, WSPR_LEAD_IN_SAMPLES, 3000.0, -20.0, peak/2 );
+        result = spur_analyze( spurred, numSamples, WSPR_SAMPLE_RATE, 1, &mask, &report );
+        errors += check( "beacon + 3000 Hz at -20 dBc", result, 1, &mask, &report );
+        if ((report.numSpurs < 1) || (fabs( report.spurs[0].freqHz - 3000.0 ) > 0.1) || report.spurs[0].inBand ||
+            (fabs( report.spurs[0].dbc + 20.0 ) > 0.5)) {
+            printf("    3000 Hz spur wrong\n");
+            errors++;
+        }
+        free( spurred );
+        free( beacon );
+    }
+    {
+        int numSamples;
+        short *ft8 = ft8_generate( "TST NQ6B DM12", 1400.0, &numSamples );
+        result = spur_analyze( ft8, numSamples, FT8_SAMPLE_RATE, 1, &mask, &report );
+        errors += check( "FT8", result, 0, &mask, &report );
+        free( ft8 );
+    }
+
+    printf("\nThe repository's wav files:\n");
+    for (int fff = 0; fff < (int)(sizeof(repoFiles)/sizeof(repoFiles[0])); fff++) {
+        struct AudioView wav;
+        if (audiocache_mapWav( repoFiles[fff], 0.0, 0.0, &wav )) {
+            errors++;
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        result = spur_analyze( wav.samples, wav.numFrames, wav.rate, wav.channels, &mask, &report );
+        spur_print( stdout, repoFiles[fff], &mask, &report );
+        printf("    %.0lf ms\n", elapsed( &t0 )*1e3);
+        audiocache_unmapWav( &wav );
+    }
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _SPUR_H_
+#define _SPUR_H_
+
+#define SPUR_MAX_SPURS      32
+
+struct SpurMask {
+    double windowLowHz;     // the 200 Hz WSPR window, audio frequencies.  Spurs in it are in band.
+    double windowHighHz;
+    double inBandDbc;       // a spur above this in the window fails
+    double outOfBandDbc;    // a spur above this anywhere else fails
+    double floorDbc;        // spurs below this are not reported
+    double minHz;           // spurs are looked for from minHz to maxHz, 0 is the Nyquist frequency
+    double maxHz;
+};
+
+struct Spur {
+    double freqHz;
+    double offsetHz;        // from the center of the signal
+    double dbc;             // spur power relative to the power of the whole signal
+    int inBand;
+    int overMask;
+};
+
+struct SpurReport {
+    int rate;
+    int fftSize;
+    int averages;           // FFTs averaged, half overlapped
+    double seconds;
+    double signalLowHz;     // what the signal occupies, down to SPUR_EDGE_DB below its strongest bin
+    double signalHighHz;
+    double centerHz;        // power weighted
+    double signalDbfs;      // 0 is a full scale sine
+    double worstInBandDbc;  // -999 if there were none above floorDbc
+    double worstOutOfBandDbc;
+    int numOverMask;
+    int numSpurs;           // strongest first, at most SPUR_MAX_SPURS of them
+    struct Spur spurs[SPUR_MAX_SPURS];
+};
+
+extern void spur_defaultMask( struct SpurMask *mask );
+extern int spur_analyze( const short *samples, long numFrames, int rate, int channels, const struct SpurMask *mask, struct SpurReport *report );
+extern void spur_print( FILE *fptr, const char *name, const struct SpurMask *mask, const struct SpurReport *report );
+
+#endif
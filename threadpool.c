@@ -0,0 +1,197 @@
+/*
+    threadpool.c - a few worker threads for the decoders.  The threads are started once by threadpool_open() and sleep on a condition
+        variable between jobs, so a decode doesn't pay for pthread_create() every two minutes.
+
+        threadpool_run( func, arg, count ) calls func( arg, index ) for index 0 to count-1, spread over the workers and the calling thread, and
+        returns when all of them are done.  The indexes are handed out one at a time, so a few slow ones (a candidate the Fano decoder
+        grinds on) don't hold up the rest.  One job at a time, threadpool_run() is not meant to be called from two threads at once.
+
+        If threadpool_open() was never called (or failed) threadpool_run() just loops in the calling thread.
+
+    To test:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -o threadpool threadpool.c -pthread
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "threadpool.h"
+
+int threadpool_open( int numThreads );
+void threadpool_close( void );
+int threadpool_numThreads( void );
+void threadpool_run( void (*func)( void *arg, int index ), void *arg, int count );
+
+static void *workerThread( void *unused );
+static void doWork( void );
+
+static pthread_t threads[THREADPOOL_MAX_THREADS];
+static int numWorkers = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+
+static void (*jobFunc)( void *arg, int index );        // the current job, all guarded by lock
+static void *jobArg;
+static int jobCount = 0;
+static int jobNext = 0;
+static int jobFinished = 0;
+static int jobGeneration = 0;       // bumped for each job so a worker knows it's new
+static int quit = 0;
+
+
+//  Starts numThreads workers.  0 means one per core, less one for the thread that calls threadpool_run().  Returns 0 or -1.
+int threadpool_open( int numThreads ) {
+    if (numWorkers > 0) {
+        return 0;
+    }
+    if (numThreads <= 0) {
+        numThreads = sysconf( _SC_NPROCESSORS_ONLN ) - 1;
+    }
+    if (numThreads > THREADPOOL_MAX_THREADS) {
+        numThreads = THREADPOOL_MAX_THREADS;
+    }
+    quit = 0;
+    for (int iii = 0; iii < numThreads; iii++) {
+        if (pthread_create( &threads[iii], NULL, workerThread, NULL )) {
+            printf("threadpool_open() - pthread_create() failed\n");
+            threadpool_close();
+            return -1;
+        }
+        numWorkers++;
+    }
+    return 0;
+}
+
+
+void threadpool_close( void ) {
+    pthread_mutex_lock( &lock );
+    quit = 1;
+    pthread_cond_broadcast( &workReady );
+    pthread_mutex_unlock( &lock );
+    for (int iii = 0; iii < numWorkers; iii++) {
+        pthread_join( threads[iii], NULL );
+    }
+    numWorkers = 0;
+}
+
+
+//  Number of threads that work on a job, counting the caller.
+int threadpool_numThreads( void ) {
+    return numWorkers + 1;
+}
+
+
+void threadpool_run( void (*func)( void *arg, int index ), void *arg, int count ) {
+    if (count <= 0) {
+        return;
+    }
+    pthread_mutex_lock( &lock );
+    jobFunc = func;
+    jobArg = arg;
+    jobCount = count;
+    jobNext = 0;
+    jobFinished = 0;
+    jobGeneration++;
+    pthread_cond_broadcast( &workReady );
+    pthread_mutex_unlock( &lock );
+
+    doWork();                           // the caller helps out
+
+    pthread_mutex_lock( &lock );
+    while (jobFinished < jobCount) {
+        pthread_cond_wait( &workDone, &lock );
+    }
+    jobCount = 0;
+    pthread_mutex_unlock( &lock );
+}
+
+
+static void *workerThread( void *unused ) {
+    int generation = 0;
+
+    pthread_mutex_lock( &lock );
+    for (;;) {
+        while (!quit && ((jobGeneration == generation) || (jobNext >= jobCount))) {
+            if (jobGeneration != generation) {
+                generation = jobGeneration;     // a job that's already handed out, skip it
+            }
+            pthread_cond_wait( &workReady, &lock );
+        }
+        if (quit) {
+            break;
+        }
+        generation = jobGeneration;
+        pthread_mutex_unlock( &lock );
+        doWork();
+        pthread_mutex_lock( &lock );
+    }
+    pthread_mutex_unlock( &lock );
+    return NULL;
+}
+
+
+//  Takes indexes from the current job until there are none left.
+static void doWork( void ) {
+    void (*func)( void *arg, int index );
+    void *arg;
+    int index;
+
+    for (;;) {
+        pthread_mutex_lock( &lock );
+        if (jobNext >= jobCount) {
+            pthread_mutex_unlock( &lock );
+            return;
+        }
+        index = jobNext++;
+        func = jobFunc;
+        arg = jobArg;
+        pthread_mutex_unlock( &lock );
+
+        func( arg, index );
+
+        pthread_mutex_lock( &lock );
+        jobFinished++;
+        if (jobFinished == jobCount) {
+            pthread_cond_signal( &workDone );
+        }
+        pthread_mutex_unlock( &lock );
+    }
+}
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <string.h>
+
+static void square( void *arg, int index ) {
+    long *results = (long *)arg;
+    results[index] = (long)index*index;
+    usleep( 100 );
+}
+
+int main() {
+    long results[1000];
+    int errors = 0;
+
+    if (threadpool_open( 0 )) { return 1; }
+    printf("%d threads\n", threadpool_numThreads());
+    for (int pass = 0; pass < 50; pass++) {
+        int count = (pass*37) % 1000 + 1;
+        memset( results, 0xff, sizeof(results) );
+        threadpool_run( square, results, count );
+        for (int iii = 0; iii < count; iii++) {
+            if (results[iii] != (long)iii*iii) { errors++; }
+        }
+    }
+    threadpool_close();
+    threadpool_run( square, results, 10 );      // no workers, runs in this thread
+    if (results[9] != 81) { errors++; }
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#define THREADPOOL_MAX_THREADS  16
+
+extern int threadpool_open( int numThreads );
+extern void threadpool_close( void );
+extern int threadpool_numThreads( void );
+extern void threadpool_run( void (*func)( void *arg, int index ), void *arg, int count );
+
+#endif
@@ -1,5 +1,5 @@
 /*
-    gcc -g -Wall -o twsprRPI twsprRPI.c wav_output3.c ft847.c wsprnet.c azdist.c geodist.c grid2deg.c getTempData.c pulseaudio.c pskreporter.c -lrt -lm -lasound -pthread
+    gcc -g -Wall -o twsprRPI twsprRPI.c wav_output3.c alsaplay.c wspr.c ft8.c ft847.c wsprnet.c httpclient.c htmlscan.c spottable.c gridcache.c spotstore.c geodist.c grid2deg.c getTempData.c txgain.c resample.c audiocache.c reactor.c planner.c pskreporter.c xmlscan.c reports.c -lrt -lm -lasound -lz -lssl -lcrypto -pthread
 
     When running direct stderr to null with
         ./twsprRPI 2>/dev/null
@@ -10,14 +10,19 @@
 
     * Another file, WSPRConfig, is read before starting any beacon.  It contains the Rx and Tx frequencies.  It is closed after every run so it can be modified.
 
-    * A third file, blackout.txt, exists to prevent sending beacon during a satellite pass.  It is checked at the beginning of each waitForTopOfEvenMinute().  If
-    necessary it will hold the program until the blackout period ends.  Format of blackout.txt file is described just above doBlackout() below.
+    * A third file, blackout.txt, exists to prevent sending beacon during a satellite pass.  It is read before each beacon cycle is planned and any beacon
+    that overlaps a blackout window is skipped.  Format of blackout.txt file is described just above readBlackouts() below.
 
-    * A fourth file, raw_reports_log.txt, records all stations that reported hearing my beacon.  The date is missing from the first year or so of this file.
+    * A fourth file, raw_reports_log.txt, recorded all stations that reported hearing my beacon.  The date is missing from the first year or so of this file.
+    Now they go into the spotstore directory (spotstore.c), with the date, and pskreporter.info's FT8 spots too.  ./spotquery asks it who heard me.  ./spotimport
+    loads the old file into it.
 
     * A fifth file, duplicate.txt, allows me to monitor the beacons from another computer allowing me to make QSOs using the idle time between beacons.  I also
     use it to print out debug lines.
 
+    * log_reports.txt gets a line for every cycle's reports, how long the fetch and the parse took for pskreporter.info and wsprnet.org.  The reports are
+    collected by a thread of their own (reports.c) while the next cycle goes on.
+
     Ideas:
      - steer radio to different frequencies, say 40 MHz for one hour every night, then 2m for one hour every night, 6m for one hour.  Will have to
        change WSJT-X frequency.  One way to do this automatically seems to be to save several --rig-name options.  There doesn't seem to be a UDP
@@ -34,7 +39,6 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
-#include <sys/select.h>
 #include <sys/ioctl.h>
 #include <signal.h>
 #include <string.h>
@@ -44,9 +48,16 @@
 #include "ft847.h"
 #include "twsprRPI.h"
 #include "wav_output3.h"
+#include "alsaplay.h"
 #include "getTempData.h"
-#include "pulseaudio.h"
+#include "txgain.h"
 #include "pskreporter.h"
+#include "reactor.h"
+#include "planner.h"
+#include "reports.h"
+#ifdef SIMULATION
+#include "sim.h"                // the virtual clock build, see sim.c
+#endif
 
 #include <netinet/in.h>
 #include <net/if.h>
@@ -56,8 +67,6 @@
 
 #include <netdb.h>
 
-#define MINUTES_TO_WAIT     (BEACON_INTERVAL+1)
-#define SECONDS_TO_WAIT     (MINUTES_TO_WAIT*60)    //  Tx for 2 min, wait 25 min, then waitForTopOfEvenMinute() will wait for the next min, resulting in Tx 28 min apart.
 #define WSPR_DEFAULT_15M    (21094630)
 #define WSPR_DEFAULT_10M    (28124620)
 #define WSPR_DEFAULT_6M     (50293080)
@@ -79,8 +88,6 @@
 #define UDP_TX_MESSAGE          "txMode;"
 #define DEFAULT_MY_IP           "192.168.1.105"
 
-extern int doCurl( struct BeaconData *beaconData, char* termPTSNum );
-
 int terminate = 0;
 
 static int signalCaptured = 0;
@@ -94,7 +101,12 @@ int SockAddrStructureSize3;             // for UDP message to send Email
 static struct sockaddr_in adr_clnt4;    // for receiving data, used in recvfrom() in two locations
 static int sockRx;                      // socket for receiving data from UDPRepeater4.py
 
-static char lineToRemove[256] = "";     // for blackoutCheck() and blackoutUpdateFile()
+static char lineToRemove[256] = "";     // for readBlackouts() and blackoutUpdateFile()
+static int planInterval = BEACON_INTERVAL;  // "schedule" line in WSPRConfig, see planner.c
+static int planSpacing = BEACON_SPACING;
+static char homeLocator[8] = MY_LOCATOR;    // "locator" line in WSPRConfig, passed to the reports thread in each ReportJob (gridcache.c)
+static int heatPowerOff = 0;            // for heatCheck(), the FT847 was powered off because the box is too hot
+static int heatInLog = 0;               //      and the HeatWait entry is already in the log
 static FILE *dupFile;                   // for DUP_FILENAME, see comment above
 static char myIP[ INET_ADDRSTRLEN ];
 
@@ -106,11 +118,14 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData );
 static int readConfigFileWSPRFreqHelp( int convResult, int WSPRFreq );
 static int readConfigFileHelp( char *string );
 static void SignalHandler( int signal );
-static int txWspr( int rxFreq, struct BeaconData *beaconData); //, int txFreq, char* timestamp );
-static int txFT8( int rxFreq, int txFreq, int target );
+static int txWspr( int rxFreq, struct BeaconData *beaconData, time_t slotTime );
+static int txFT8( int rxFreq, int txFreq, time_t slotTime );
 static int radio_receive_freq( int rxFreq );
-static char *getWavFilename( int txFreq );
-static int waitForTopOfEvenMinute( int txFreq, int target );
+static double getToneHz( int txFreq );
+static int waitForTopOfEvenMinute( int txFreq, time_t targetTime, struct timespec *topOfMinute );
+static int waitForCycle( struct PlanConfig *config, long long *anchorMs, long long notBeforeMs, long long *cycleStartMs, int *rxFreqHz,
+                         struct BeaconData *beaconData );
+static int waitForHeldSlot( long long slotMs );
 static int updateFiles( char *eventName );
 static int findttyUSB( void );
 static int installSignalHandlers( int useMyHandlers );
@@ -118,9 +133,12 @@ static int initializeNetwork( void );
 static void closeNetwork( void );
 static int sendUDPMsg( int doingTx );
 static int getMyIPAddress( char *myIPAddress );
-static int blackoutCheck( time_t *blackoutEndTime );
 static int blackoutUpdateFile( void );
-static int doBlackout( void );
+static int readBlackouts( struct PlanConfig *config, int removeExpired );
+static int heatCheck( void );
+static void planConfigure( struct PlanConfig *config, const struct BeaconData *beaconData, int heatHold );
+static int dryRun( void );
+static void printWakeups( void );
 
 
 //  signal 10 completes beacon block then quits
@@ -135,14 +153,15 @@ static void SignalHandler( int signal ) {
 
 
 int main( int argc, char **argv ) {
-    fd_set rfds;
-    struct timeval tv;
-    int retval;
-    int NumBytesIn;
+    struct PlanConfig planConfig;
+    struct PlanSlot slots[ PLAN_MAX_SLOTS ];
+    long long anchorMs, cycleStartMs, lastCycleEndMs;
+    int numSlots;
+    int retval = 0;
     struct BeaconData beaconData[ MAX_NUMBER_OF_BEACONS ];
     char termPTSNum[4] = "";
-    int heatWait = 0;
-    int resetSelectWait = 1;
+    char *audioDevice = ALSAPLAY_DEFAULT_DEVICE;
+    int dryRunOnly = 0;
 
     int rx0FreqHz = WSPR_DEFAULT_10M;
 
@@ -154,10 +173,23 @@ int main( int argc, char **argv ) {
                 printf("\n       Use \"tty\" command to determine this terminal's number.");
                 printf("\n       Do NOT use leading zeros.");
                 printf("\n       If parameter is not a number then 15m output will go the this terminal.");
+                printf("\n     - \"-d <device>\" ALSA device for the audio, default \"%s\".  \"null\" runs without a sound card.",ALSAPLAY_DEFAULT_DEVICE);
+                printf("\n     - \"-n\" dry run.  Print the slots planned for the next 24 hours (ms since the epoch, UTC) and quit.");
                 printf("\n\n");
                 return 1;
             }
 
+            if ((!strcmp(argv[i],"-d")) && (i+1 < argc)) {
+                audioDevice = argv[++i];
+                printf("\nUsing ALSA device %s\n\n",audioDevice);
+                continue;
+            }
+
+            if (!strcmp(argv[i],"-n")) {
+                dryRunOnly = 1;
+                continue;
+            }
+
             //  Anything else then check to see if all numbers
             if ( strspn(argv[i], "0123456789") == strlen(argv[i]) ) {
                 strcpy(termPTSNum,argv[i]);
@@ -166,6 +198,10 @@ int main( int argc, char **argv ) {
         }
     }
 
+    if (dryRunOnly) {               // before anything is opened, the radio and the network belong to the copy that is running
+        return dryRun();
+    }
+
     if (getMyIPAddress( myIP ) != 0) {
         strcpy( myIP, DEFAULT_MY_IP );      // if error set default
     }
@@ -178,15 +214,21 @@ int main( int argc, char **argv ) {
     }
 
     if (initializeNetwork() == -1) { return -1; }
-    if (initializePortAudio() == -1) { return -1; }
+    if (initializePortAudio( audioDevice ) == -1) { return -1; }
+    if (reports_open() == -1) { return -1; }
+    if (reactor_add( REACTOR_STDIN, 0 ) || reactor_add( REACTOR_UDP, sockRx )) { return -1; }     // the audio is added by initializePortAudio()
     if (ft847_open() == -1) { return -1; }
     if (updateFiles("Startup ")) { return 1; }
 
     for (int iii = 0; iii < MAX_NUMBER_OF_BEACONS; iii++) {    // initialize beacon data.  Really not necessary.  It's initialized in readConfigFile()
         beaconData[iii].txFreqHz = 0;
         beaconData[iii].timestamp[0] = 0;
-        beaconData[iii].tone[0] = 0;
+        beaconData[iii].toneHz = 0.0;
         beaconData[iii].txFreqHzActual = 0;
+        beaconData[iii].dialFreqHz = 0;
+        beaconData[iii].toneHzSent = 0.0;
+        beaconData[iii].requestedFreqHz = 0.0;
+        beaconData[iii].achievedFreqHz = 0.0;
         beaconData[iii].temperature = 0.0;
     }
 
@@ -194,13 +236,12 @@ int main( int argc, char **argv ) {
     printf("<ENTER> to quit, '*'+<ENTER> to read WSPRConfig and change Rx freq, '-'+<ENTER> to terminate wait period\n");
     printf("\n");
 
-    // minCounter counts minutes from 0 to minWait.
-    int minWait = MINUTES_TO_WAIT;
+    //  The cycles are counted from anchorMs (see planner.c)
+    lastCycleEndMs = planner_nowMs();
 #ifdef NO_WAIT_FIRST_BURST
-    int minCounter = MINUTES_TO_WAIT-1;         // so it does a Tx on the next available interval
-    printf("Wait 1 min (<ENT>, *<ENT>, -<ENT>): ");  fflush( (FILE *)NULL );
+    anchorMs = lastCycleEndMs + PLAN_SETUP_MS;          // so it does a Tx on the next available interval
 #else
-    int minCounter = 0;
+    anchorMs = lastCycleEndMs + planInterval*60000LL;
 #endif
 
     if (installSignalHandlers(1)) {
@@ -217,305 +258,202 @@ int main( int argc, char **argv ) {
     //  Main Loop
     //
 
-    //  Each loop is one minute.  At timeout minCounter is bumped.  If less than minWait then loop.  Once the beacons begin, timing is done within txWspr() with a call
-    //      to waitForTopOfEvenMinute().  When it emerges from the beacon block (all the calls to txWspr()) minCounter is set to 0.
-    //  However, within that beacon block minWait is initialized to MINUTES_TO_WAIT and then dropped by 4 minutes with each beacon sent.  After the last beacon
-    //      it is dropped by two more minutes for WSPRNet.org collections.  So when the beacon block ends, minCounter == 0 and minWait has the number of
-    //      minutes to wait until the next beacon block.
-    //  It goes off every 28 minutes because -  MINUTES_TO_WAIT == 29.  minWait is set to MINUTES_TO_WAIT just before each beacon block begins.  After each individual
-    //      beacon is sent minWait -= 4.  After doCurl() minWait -= 2.  If there are four beacons then when the beacon block is complete, although minWait has dropped 18
-    //      minutes, only 16 minutes have elapsed since the first beacon began.  Now minWait == 11 so by the time minCounter == minWait 27 minutes have elapsed since the
-    //      first beacon.  The loop then drops into the beacon block with one minute left.  The first call to txWspr() consumes that minute.
+    //  Each loop is one beacon cycle.  planner.c works out when the next cycle starts: cycles are planInterval minutes apart, counted from
+    //      anchorMs, each beginning with the FT8 burst in the odd minute before the first beacon.  waitForCycle() receives until
+    //      PLAN_SETUP_MS before that, counting the minutes and handling the keyboard and UDP messages.
+    //  Then WSPRConfig, the temperature and blackout.txt are read and the whole cycle is planned as absolute UTC slots (planner_cycle()):
+    //      FT8, the beacons planSpacing minutes apart, the receive time between them and the reports.  The plan is printed and run
+    //      exactly.  A slot that is held (blackout, heat) or missed (paused, transmitting) is skipped and nothing after it moves, so the
+    //      interval doesn't depend on how long anything took.  It used to be minute counting (minWait -= 4 per beacon) that only came
+    //      out right when every beacon took exactly four minutes.
+    //  The wakeups (reactor_wait() returns) are counted and printed once per cycle.
     while (terminate == 0) {
-        if (minCounter == 0) {
-            if (resetSelectWait) {      // I use this an an indication that a UDP message arrived.  In that case this has already been printed.  Don't do it again.
-                printf("Wait %d min (<ENT>, *<ENT>, -<ENT>): ",minWait);  fflush( (FILE *)NULL );
-                fprintf(dupFile,"Wait %d min (<ENT>, *<ENT>, -<ENT>): ",minWait);  fflush( (FILE *)dupFile );
-            }
+        int ft8WasSent = 0;
+        int beaconWasSent = 0;
+        int abortCycle = 0;
+        time_t firstTxTime = 0;
+        int waitResult;
+        int heat;
+
+        planConfigure( &planConfig, beaconData, 0 );
+        waitResult = waitForCycle( &planConfig, &anchorMs, lastCycleEndMs + PLAN_SETUP_MS, &cycleStartMs, &rx0FreqHz, beaconData );
+        if (waitResult == 1) {          // <ENTER>
+            retval = 0;
+            break;
+        } else if (waitResult) {
+            retval = -1;
+            break;
         }
 
-        if (resetSelectWait) {
-            tv.tv_sec = 60;
-            tv.tv_usec = 0;
+        //  Before starting make sure /dev/ttyUSBFT847 still points to ttyUSB0 or ttyUSB1.  If it points to something else then the USB to RS232 port
+        //      is going south.  See 4/25/2024 entry in LinuxNotes2.docx or RaspberryPiNotes.docx
+        if (findttyUSB()) {         // return 0 if ok, 1 if ttyUSBFT847 points to something else, -1 on error.
+            sendUDPEmailMsg( "RPi .104 ttyUSBFT847 problem\nttyUSBFT847 no longer points to ttyUSB0 or ttyUSB1\n  It is either gone or points to another ttyUSBX\n" );
+            retval = -1;
+            break;
         }
-        resetSelectWait = 1;    // cleared when a UDP message arrives, don't want to get out of sync with top-of-minute
 
-        FD_ZERO(&rfds);
-        FD_SET(0, &rfds);       //  stdin
-        FD_SET(sockRx, &rfds);
-
-        retval = select((sockRx + 1), &rfds, NULL, NULL, &tv);
-        if (retval < 0) {
-            if (terminate == 0) { printf("Error in select()\n"); } else { printf("Captured signal %d\n",signalCaptured); }
+        //
+        //
+        //  Read the config file and prepare for the beacons
+        //
+        //
+        if (readConfigFile( &rx0FreqHz, beaconData )) {
+            retval = -1;    // on error or if rx0FreqHz == 0
             break;
         }
-        else if (retval > 0) {
-            if (FD_ISSET(sockRx, &rfds)) {       //  if data on Ethernet port
-                //  Determine how many characters are waiting on the network port .....
-                ioctl(sockRx,TIOCINQ,&NumBytesIn);
-                if (NumBytesIn > 0) {
-                    unsigned int len_inet;
-                    int iii;
-                    unsigned char dgram[512];              // receive buffer
-
-                    len_inet = sizeof(adr_clnt4);
-                    iii = recvfrom(sockRx,
-                            dgram,          // receive buffer
-                            sizeof(dgram),  // max length (a constant her would be better).
-                            0,              // no flags
-                            (struct sockaddr *)&adr_clnt4,   // filled in by function
-                            &len_inet
-                            );
-                    if (iii < 0) {
-                        printf("UDP receive socket - recvfrom() failed\n");
-                        continue;
-                    }
-                    dgram[iii] = 0;
-
-                    //for (int jjj = 0; jjj < iii; jjj++) { printf("%02hhx ",dgram[jjj]); } printf("\n");   // print out bytes
-                    //printf("%s\n",(char *)dgram);     // print out message
-                    //printf("tv.tv_sec %ld\n",(long)tv.tv_sec);    // print out number of seconds left in select()
-
-                    //  If transmitting then make sure that we don't transmit in the next two minutes.
-                    if (strcmp(UDP_TX_MESSAGE,(char *)dgram) == 0) {
-
-                        //  if it is close to starting the beacon sequence (minWait is signed so if minWait < 3 (unlikely) the IF statement will still do the right thing)
-                        if (minCounter > (minWait-3)) {
-                            if (minCounter < 2) {      // (won't happen the way I use it, minCounter counts up not down)
-                                minCounter = 0;
-                            } else {
-                                minCounter -=2;         // add two minutes to wait
-                            }
-                            printf("+2 ");  fflush( (FILE *)NULL );
-                            fprintf(dupFile,"+2 ");  fflush( (FILE *)dupFile );
-                        }
-                    }
-                    resetSelectWait = 0;    // continue with whatever seconds are left in select() 60 second sleep so it stays in sync with top-of-minute
-                    continue;               // necessary to avoid minCounter being bumped below.
-                }
+        if (radio_receive_freq( rx0FreqHz )) {                 // set radio to newly read frequency.  It happens again at the end of txWspr() but I don't want to wait.
+            retval = -1;    // on error or if rx0FreqHz == 0
+            break;
+        }
+        printf("Rx %d\nTx ",rx0FreqHz );
+        fprintf(dupFile,"Rx %d\nTx ",rx0FreqHz );
+        for (int iii = 0; iii < MAX_NUMBER_OF_BEACONS; iii++) {         // zero out timestamp strings
+            //beaconData[iii].timestamp[0] = 0;                     // this is done in readConfigFile() as each beacon is read.
+            if (beaconData[iii].txFreqHz != 0) {
+                printf("%d  ",beaconData[iii].txFreqHz);
+                fprintf(dupFile,"%d  ",beaconData[iii].txFreqHz);
             }
-            else if (FD_ISSET(0, &rfds)) {          //  If keyboard data.  Note I'm not putting the keyboard in raw mode so
-                //  The keyboard was hit.           //    nothing will happen unless I hit ENTER.
-                ioctl(0,TIOCINQ,&NumBytesIn);
-                if (NumBytesIn > 0) {
-                    int iii = getchar();
-                    if (NumBytesIn == 1) {      // if <ENTER>.  Since not in raw mode then if only one character it has to be <ENTER>
-                        retval = 0;
-                        break;
-                    }
-                    else if (NumBytesIn == 2) {
-                        getchar();                  // get the <ENTER>.
-                        if (45 == iii) {            // if '-' then cut the wait time short
-                            minCounter = minWait;
-                        } else if (42 == iii) {     // if '*' then read the config file and change Rx freq
-                            if (readConfigFile( &rx0FreqHz, beaconData ) || (radio_receive_freq( rx0FreqHz ))) {
-                                retval = -1;
-                                break;
-                            }
-                        }
-                    } else {
-                        printf("Unknown command\n");
-                        retval = -1;
-                        break;
-                    }
-                }           //  if (NumBytesIn > 0)
-            }             //  else if (FD_ISSET(0, &rfds))    //  stdin
-        }               //  else <select returned without error or timeout>
+        }
+        printf("\n");
+        fprintf(dupFile,"\n");
+
+        //
+        //
+        //  Temperature and blackouts - a cycle planned while the box is too hot is held, a slot in a blackout window is skipped.
+        //
+        //
+        heat = heatCheck();
+        if (heat < 0) {
+            retval = -1;
+            break;
+        }
+        planConfigure( &planConfig, beaconData, heat );
+        readBlackouts( &planConfig, 1 );
+
+        //
+        //
+        //  Plan the cycle.  It was waited for with the old WSPRConfig, a new interval or spacing starts with the next cycle.
+        //
+        //
+        numSlots = planner_cycle( &planConfig, cycleStartMs, slots, PLAN_MAX_SLOTS );
+        if (numSlots < 0) {
+            retval = -1;
+            break;
+        }
+        planner_print( stdout, slots, numSlots, planner_nowMs() );
+        planner_print( dupFile, slots, numSlots, planner_nowMs() );
+#ifdef SIMULATION
+        sim_traceSlots( slots, numSlots );
+#endif
+        if (numSlots == 0) {
+            printf("No beacons\n");
+            fprintf(dupFile,"No beacons\n");
+            lastCycleEndMs = planner_firstSlotMs( &planConfig, cycleStartMs );
+            continue;
+        }
 
-        //  If just timeout
-        minCounter++;
-        if (minCounter < minWait) {
-            printf("%0d ",minCounter);  fflush( (FILE *)NULL );
-            fprintf(dupFile,"%0d ",minCounter);  fflush( (FILE *)dupFile );
-        } else {
-            int beaconWasSent = 0;
-            int beaconCounter = 0;
-            int heatWaitInLog = 0;
-            int heatWaitPowerOff = 0;
-            int heatAbort = 0;
-            int ft8WasSent = 0;
-            time_t firstTxTime;
-
-            //  Before starting make sure /dev/ttyUSBFT847 still points to ttyUSB0 or ttyUSB1.  If it points to something else then the USB to RS232 port
-            //      is going south.  See 4/25/2024 entry in LinuxNotes2.docx or RaspberryPiNotes.docx
-            if (findttyUSB()) {         // return 0 if ok, 1 if ttyUSBFT847 points to something else, -1 on error.
-                sendUDPEmailMsg( "RPi .104 ttyUSBFT847 problem\nttyUSBFT847 no longer points to ttyUSB0 or ttyUSB1\n  It is either gone or points to another ttyUSBX\n" );
-                retval = -1;
-                break;
-            }
+        printf("ENTER: pause, X-ENTER: abort beacon, CTRL-C quit,\n  signal 10 complete beacons then quit\n");
+        fprintf(dupFile,"ENTER: pause, X-ENTER: abort beacon, CTRL-C quit,\n  signal 10 complete beacons then quit\n");
 
-            //
-            //
-            //  Read the config file and prepare for the beacons
-            //
-            //
-            if (readConfigFile( &rx0FreqHz, beaconData )) {
-                retval = -1;    // on error or if rx0FreqHz == 0
-                break;
-            }
-            if (radio_receive_freq( rx0FreqHz )) {                 // set radio to newly read frequency.  It happens again at the end of txWspr() but I don't want to wait.
-                retval = -1;    // on error or if rx0FreqHz == 0
-                break;
+        //
+        //
+        //  Send FT8 and the beacons (the beacon block).  txWspr() and txFT8() wait for the slot.
+        //
+        //
+        for (int iii = 0; (iii < numSlots) && (terminate == 0) && (abortCycle == 0); iii++) {
+            struct PlanSlot *slot = &slots[iii];
+            time_t slotTime = (time_t)(slot->startMs/1000);
+            int result;
+
+            if ((slot->kind != PLAN_FT8) && (slot->kind != PLAN_WSPR)) {
+                continue;
             }
-            printf("Rx %d\nTx ",rx0FreqHz );
-            fprintf(dupFile,"Rx %d\nTx ",rx0FreqHz );
-            for (int iii = 0; iii < MAX_NUMBER_OF_BEACONS; iii++) {         // zero out timestamp strings
-                //beaconData[iii].timestamp[0] = 0;                     // this is done in readConfigFile() as each beacon is read.
-                if (beaconData[iii].txFreqHz != 0) {
-                    printf("%d  ",beaconData[iii].txFreqHz);
-                    fprintf(dupFile,"%d  ",beaconData[iii].txFreqHz);
-                }
+            if (slot->hold == PLAN_HOLD_BLACKOUT) {
+                printf("Blackout, %d Hz skipped\n",slot->freqHz);
+                fprintf(dupFile,"Blackout, %d Hz skipped\n",slot->freqHz);
+                continue;
             }
-            printf("\n");
-            fprintf(dupFile,"\n");
-            minWait = MINUTES_TO_WAIT;
-
-            //
-            //
-            //  Temperature - Before starting the beacon code block check here if temperature is > 90 deg.  If so wait.
-            //
-            //
-            heatWait = 0;
-            printf("\n");  fprintf(dupFile,"\n");
-            while ( (terminate == 0) && (heatAbort == 0) ) {
-                double currentTemperature = getTempData();
-                if (currentTemperature < TEMPERATURE_BEACON_MAX) { //  This will capture errors also.  getTempData() returns -1.0 on error and +1.0 if process not running.
+            if (slot->hold == PLAN_HOLD_HEAT) {
+                result = waitForHeldSlot( slot->startMs );
+                if (result < 0) {
+                    terminate = 1;
+                    retval = -1;
                     break;
-                } else {
-                    // decide whether to turn FT847 power off.  Turn off > 90 but don't turn back on until < 86.
-                    if (heatWaitPowerOff) {                                             // if FT847 is powered OFF ...
-                        if (currentTemperature < TEMPERATURE_HYSTERESIS_BOTTOM) {       //   and the box has cooled 4 degrees ...
-                            heatWaitPowerOff = 0;                                       //   clear flag and power the FT847 back up.
-                            if ( powerOnOffFT847(1) ) { terminate = 1; break; }         // Power On - assume gpio23 is already set up
-                            //system("echo \"1\" > /sys/class/gpio/gpio23/value");        // Power On - assume gpio23 is already set up
-                            if (updateFiles("HeatWait")) { retval = -1; }               // Insert another HeatWait message into log
-                            sendUDPEmailMsg( "Box below 86 deg, radio on\nBox temperature below 86 degrees, radio powered on\n" );
-                        }
-                    } else {                                                            // if FT847 is powered ON
-                        if (currentTemperature > TEMPERATURE_POWER_OFF) {               //    and the box is above 90 degrees
-                            heatWaitPowerOff = 1;                                       //    set flag and power the FT847 off
-                            if ( powerOnOffFT847(0) ) { terminate = 1; break; }         //  Power OFF
-                            //system("echo \"0\" > /sys/class/gpio/gpio23/value");        //  Power OFF
-                            if (updateFiles("HeatOff ")) { retval = -1; }
-                        } else {                                                        // if (85 < temperature < 90) AND (FT847 powered on).
-                            if (heatWaitInLog == 0) {                                   //    just check if a log file entry needs to be made.
-                                if (updateFiles("HeatWait")) { retval = -1; }
-                                heatWaitInLog = 1;
-                                //sendUDPEmailMsg( "Box above 85 deg, beacons halted\nBox temperature above 85 deg, beacons halted.\n" );
-                            }
-                        }
-                    }
-                    // print message on the screen
-                    if (heatWaitPowerOff) {
-                        printf("\rTemperature too high: %3.3lf F.  Waiting two minutes (%d min) with power OFF",currentTemperature,heatWait);
-                        fprintf(dupFile,"\rTemperature too high: %3.3lf F.  Waiting two minutes (%d min) with power OFF",currentTemperature,heatWait);
-                    } else {
-                        printf("\rTemperature too high: %3.3lf F.  Waiting two minutes (%d min) Sig 12 abort  ",currentTemperature,heatWait);
-                        fprintf(dupFile,"\rTemperature too high: %3.3lf F.  Waiting two minutes (%d min) Sig 12 abort  ",currentTemperature,heatWait);
-                    }
-                    fflush(stdout);   fflush(dupFile);
-                    // wait two minutes.
-                    for (int kkk = 0; kkk < 120; kkk++) {
-                        sleep(1);
-                        if (terminate) {
-                            break;
-                        }
-                        if (!heatWaitPowerOff) {                    // if radio still on and signal 12 then abort heat block.
-                            if (signalCaptured == SIGUSR2) {        
-                                heatAbort = 1;
-                                break;
-                            }
-                        }
-                    }
-                    heatWait += 2;
                 }
-            }
-            if (heatWait > 0) {
-                printf("\n");
-                fprintf(dupFile,"\n");
-            }
-
-            printf("ENTER: pause, X-ENTER: abort beacon, CTRL-C quit,\n  signal 10 complete beacons then quit\n");
-            fprintf(dupFile,"ENTER: pause, X-ENTER: abort beacon, CTRL-C quit,\n  signal 10 complete beacons then quit\n");
-
-            //
-            //
-            //  Send beacons (the beacon block)
-            //
-            //
-            while (terminate == 0) {
-                //  Quit if done.  All unused beaconData[] entries are zero and are all at end of array so quit on first zero.
-                if (beaconData[ beaconCounter ].txFreqHz == 0) {
-                    break;
+                if (result) {
+                    continue;
                 }
+            }
 
-                // Send FT8 messages
-                if (beaconCounter < 1) {    // only on first 2 minute interval so only one FT8 beacon per beacon block
-                    if (beaconCounter == 0) { time( &firstTxTime ); }
-                    if ( txFT8( rx0FreqHz, FT8_50MHZ, 15 ) ) {
-                        retval = -1;
-                        break;
-                    }; 
+            if (slot->kind == PLAN_FT8) {
+                result = txFT8( rx0FreqHz, slot->freqHz, slotTime );
+                if (result == 0) {
+                    firstTxTime = slotTime;
                     ft8WasSent = 1;
-               }
-                
-                //  Send beacon.  Fill in timestamp
-                if (txWspr(rx0FreqHz, &beaconData[beaconCounter])) {
-                    retval = -1;
-                    break;
                 }
-
-                minWait -= 4;
-                beaconWasSent = 1;
-                beaconCounter++;
+            } else {
+                result = txWspr( rx0FreqHz, &beaconData[ slot->beacon ], slotTime );
+                if (result == 0) {
+                    beaconWasSent = 1;
+                }
             }
-
-            //
-            // if a beacon was sent then wait two minutes and collect data from WSPRNet.org
-            //
-            if (waitForTopOfEvenMinute( 0, 0 )) {           // ... wait for two more minutes
+            if (result == 2) {              // missed, on to the next slot
+                printf("Missed, %d Hz skipped\n",slot->freqHz);
+                fprintf(dupFile,"Missed, %d Hz skipped\n",slot->freqHz);
+            } else if (result) {            // X-ENTER, a signal or an error.  No more beacons but still collect the reports.
                 retval = -1;
-                break;
+                abortCycle = 1;
             }
-            minWait -= 2;
-            if ( ft8WasSent ) {
-                if (doCurlFT8( firstTxTime )){                // if I want to see all reports then set firstTxTime to 0.
-                    retval = -1;
-                    break;
-                }
-            }
-            if ( beaconWasSent ) {
-                if (doCurl( beaconData, termPTSNum )) {         // ... and get results from wsprnet.org
-                    retval = -1;
-                    break;
-                }
+        }
+
+        //
+        //  If anything was sent hand the reports to the reports thread (reports.c).  It waits for the reports slot and collects them from
+        //      pskreporter.info and wsprnet.org while this goes on to the next cycle, a slow server no longer makes it late.
+        //
+        if (ft8WasSent || beaconWasSent) {
+            struct ReportJob job;
+
+            job.notBeforeMs = slots[numSlots-1].startMs;
+            job.deadlineMs = job.notBeforeMs + planInterval*60000LL;
+            job.firstTxTime = ft8WasSent ? firstTxTime : 0;         // if I want to see all reports then set firstTxTime to 1.
+            job.beaconWasSent = beaconWasSent;
+            memcpy( job.beaconData, beaconData, sizeof(job.beaconData) );
+            memcpy( job.termPTSNum, termPTSNum, sizeof(job.termPTSNum) );
+            memcpy( job.locator, homeLocator, sizeof(job.locator) );
+            if (reports_submit( &job )) {
+                printf("The last cycle's reports were still waiting, dropped\n");
             }
-            minCounter = 0;
-            printf("\n");
-            fprintf(dupFile,"\n\n");
         }
+        lastCycleEndMs = slots[numSlots-1].startMs + slots[numSlots-1].lengthMs;
+        printf("\n");
+        fprintf(dupFile,"\n\n");
+        printWakeups();
 
         if (signalCaptured == SIGUSR1) {        //  if signal 10 received during beacons then quit
             break;
         }
     }
 
+    reports_close( terminate == 0 );        // <ENTER> or signal 10 still collect the last cycle's reports, CTRL-C doesn't
     if (updateFiles("Shutdown")) { retval = -1; }
     ft847_close();
     terminatePortAudio();
     closeNetwork();
+    reactor_close();
     fclose(dupFile);
     printf("\n");
     return retval;
 }
 
 
-//  This function is called as sleep ends.  It waits for the top of second and then initiates a send.
-static int txWspr( int rxFreq, struct BeaconData *beaconData ) { // txFreq, char* timestamp ) {
+//  This function is called as sleep ends.  It waits for the top of second and then initiates a send.  slotTime is the even minute from
+//      the plan.  Returns 2 if the slot was missed, nothing was sent.
+static int txWspr( int rxFreq, struct BeaconData *beaconData, time_t slotTime ) {
     int iii;
     char string[16];
-    struct tm *info;
-    time_t rawtime;         // time_t is long integer
+    struct tm tm, *info;
+    struct timespec topOfMinute;
     int txFreq = beaconData->txFreqHz;
     double dtemperature = getTempData();
 
@@ -591,22 +529,38 @@ static int txWspr( int rxFreq, struct BeaconData *beaconData ) { // txFreq, char
     }
     beaconData->txFreqHzActual = txFreq;
     beaconData->temperature = dtemperature;
-    strcpy( beaconData->tone, getWavFilename(txFreq) );
+    beaconData->toneHz = getToneHz(txFreq);
+
+    //  The radio only tunes in 10 Hz steps.  Whatever is left over (-5 to +4 Hz) is added to the audio tone so the signal still lands on
+    //      txFreq + toneHz.  This lets the compensation above (and the golden list in wsprnet.c) work to 1 Hz.
+    beaconData->dialFreqHz = ft847_dialFreqHz( txFreq );
+    beaconData->toneHzSent = beaconData->toneHz + (txFreq - beaconData->dialFreqHz);
+    beaconData->requestedFreqHz = txFreq + beaconData->toneHz;
+    beaconData->achievedFreqHz = beaconData->dialFreqHz + beaconData->toneHzSent;
+    if (prepareWSPRData( beaconData->toneHzSent, txFreq )) {    // synthesize the audio now, before the top of the minute
+        return 1;
+    }
 
-    if (waitForTopOfEvenMinute( txFreq, 0 )) {
+    iii = waitForTopOfEvenMinute( beaconData->dialFreqHz, slotTime, &topOfMinute );    // returns one second early
+    if (iii) {
+        return iii;
+    }
+    if (startWSPRData( &topOfMinute )) {            // pre-roll, the tones start WSPR_START_OFFSET_MS after the top of the minute
+        printf("Error on startWSPRData()\n");
         return 1;
     }
 
     //  Put radio in Tx mode and put SDRPlay into Tx mode
-    if (ft847_FETMOXOn()) { return 1; }
-    if (sendUDPMsg( 1 )) { return 1; }
+    if (ft847_FETMOXOn()) { stopAudioData(); return 1; }
+    if (sendUDPMsg( 1 )) { stopAudioData(); return 1; }
 
-    time( &rawtime );
-    info = gmtime( &rawtime );      // UTC
+    info = gmtime_r( &topOfMinute.tv_sec, &tm );    // UTC
     sprintf(beaconData->timestamp,"%02d:%02d",info->tm_hour, info->tm_min);
-    printf("Beacon freq %d Hz at %s:%02d UTC          \n", txFreq, beaconData->timestamp, info->tm_sec);
-    fprintf(dupFile,"Beacon freq %d Hz at %s:%02d UTC          \n", txFreq, beaconData->timestamp, info->tm_sec);
-    iii = sendWSPRData( beaconData->tone, dupFile );
+    printf("Beacon freq %d Hz at %s:%02d UTC (dial %d Hz + tone %.1lf Hz = %.1lf Hz, requested %.1lf Hz)          \n", txFreq, beaconData->timestamp,
+           info->tm_sec, beaconData->dialFreqHz, beaconData->toneHzSent, beaconData->achievedFreqHz, beaconData->requestedFreqHz);
+    fprintf(dupFile,"Beacon freq %d Hz at %s:%02d UTC (dial %d Hz + tone %.1lf Hz = %.1lf Hz, requested %.1lf Hz)          \n", txFreq, beaconData->timestamp,
+           info->tm_sec, beaconData->dialFreqHz, beaconData->toneHzSent, beaconData->achievedFreqHz, beaconData->requestedFreqHz);
+    iii = sendWSPRData( dupFile );
     if (iii) {
         printf("Error on sendWSPRData()\n");
     }
@@ -630,30 +584,34 @@ static int txWspr( int rxFreq, struct BeaconData *beaconData ) { // txFreq, char
     if (ft847_FETMOXOff()) { return 1; }
 
     // set radio back to receive frequency
-    usleep(1500000);                        // sleep for 1.5 seconds in case this function is called again.  Need waitForTopOfEvenMinute() to progress past sec == 0
+    usleep(1500000);                        // sleep for 1.5 seconds before going back to the receive frequency
     if (radio_receive_freq( rxFreq )) {
         return 1;
     }
     return iii;
 }
 
-//  similar to the above but for FT8
-static int txFT8( int rxFreq, int txFreq, int target ) {
+//  similar to the above but for FT8, slotTime is 15, 30 or 45 seconds into an odd minute
+static int txFT8( int rxFreq, int txFreq, time_t slotTime ) {
     int iii;
     char string[16];
-    struct tm *info;
-    time_t rawtime;         // time_t is long integer
+    struct tm tm, *info;
+    struct timespec topOfSlot;
 
-    if (waitForTopOfEvenMinute( txFreq, target )) {
+    iii = waitForTopOfEvenMinute( txFreq, slotTime, &topOfSlot );
+    if (iii) {
+        return iii;
+    }
+    if (startFT8Data( &topOfSlot, txFreq )) {
+        printf("Error on startFT8Data()\n");
         return 1;
     }
 
     //  Put radio in Tx mode and put SDRPlay into Tx mode
-    if (ft847_FETMOXOn()) { return 1; }
-    if (sendUDPMsg( 1 )) { return 1; }
+    if (ft847_FETMOXOn()) { stopAudioData(); return 1; }
+    if (sendUDPMsg( 1 )) { stopAudioData(); return 1; }
 
-    time( &rawtime );
-    info = gmtime( &rawtime );      // UTC
+    info = gmtime_r( &topOfSlot.tv_sec, &tm );      // UTC
     sprintf(string,"%02d:%02d",info->tm_hour, info->tm_min);
     printf("FT8 freq %d Hz at %s:%02d UTC                            \n", txFreq, string, info->tm_sec);
     fprintf(dupFile,"FT8 freq %d Hz at %s:%02d UTC                            \n", txFreq, string, info->tm_sec);
@@ -725,23 +683,24 @@ static int radio_receive_freq( int rxFreq ) {
 }
 
 
-//  This returns the name of the wav file to send.  It starts at 1470 Hz and works its way up to 1530 Hz.
-static char *getWavFilename( int txFreq ) {
-    static char returnValue[10];
-    static int tone = 1470;
+//  This returns the audio tone to send.  It starts at 1470 Hz and works its way up to 1530 Hz.  It used to pick one of the wav files
+//      1470.wav - 1530.wav.  The audio is now synthesized (wspr.c) so any tone works, but I kept the same rotation.
+#define TONE_MIN_HZ     1470
+#define TONE_MAX_HZ     1530
+#define TONE_STEP_HZ    10
+#define TONE_FIXED_HZ   1500
+static double getToneHz( int txFreq ) {
+    static int tone = TONE_MIN_HZ;
 
     //  If 2m or 6m then fix tone.  Otherwise rotate through options.
     if (txFreq > 50000000) {
-        strcpy(returnValue,"1500.wav");
-    } else {
-        tone += 10;
-        if (tone > 1530) {
-            tone = 1470;
-        }
-        sprintf(returnValue,"%d.wav",tone);
+        return (double)TONE_FIXED_HZ;
     }
-
-    return returnValue;
+    tone += TONE_STEP_HZ;
+    if (tone > TONE_MAX_HZ) {
+        tone = TONE_MIN_HZ;
+    }
+    return (double)tone;
 }
 
 
@@ -753,152 +712,152 @@ static char *getWavFilename( int txFreq ) {
 //  Later I added code to check blackout.txt in order to see if it needs to delay things for a satellite pass.
 //  Later I modified it to check if ENTER key is pressed and halt countdown if so.
 //  Later checked for a UDP message indicating transmit.  If received it delays things for one minute.  Specifically, with each
-//      transmit UDP message it resets delayUDPTimer (local variable) to 60.
+//      transmit UDP message it sets delayUntil (local variable) to 60 seconds from then.
 //  Later I modified the check for ENTER key to also check for 'X' prior to ENTER.  If so returns non-zero which causes the
 //      beacon block to quit and still do doCurl().
 //  Later I added the target parameter, set to 0, 15, 30, or 45.  This was to send out FT8 15 second bursts.  It will exit on 
 //      top of even minute if target == 0 and on odd minutes if target == 15, 30, or 45.  This makes it convenient to do so 
 //      in the interval between WSPR beacons.
-static int waitForTopOfEvenMinute( int txFreq, int target ) {
-    /*  struct tm {
-            int tm_sec;         // seconds
-            int tm_min;         // minutes
-            int tm_hour;        // hours
-            int tm_mday;        // day of the month
-            int tm_mon;         // month
-            int tm_year;        // year
-            int tm_wday;        // day of the week
-            int tm_yday;        // day in the year
-            int tm_isdst;       // daylight saving time
-        }   */
-    struct tm *info;
-    time_t rawtime;         // time_t is long integer
-    int curSec = 0;          // debug for display
+//  Later I made the exit exact.  It stops one second before the target.  If topOfMinute is NULL it then sleeps with clock_nanosleep()
+//      to the absolute CLOCK_REALTIME time of the target and returns.  Otherwise it returns right away, one second early, with the time
+//      of the target in topOfMinute.  The caller uses that second to pre-roll the audio (startWSPRData(), startFT8Data()).
+//  Later the 10 ms polling loop was replaced by reactor_wait().  The target is worked out ahead of time and it sleeps
+//      until the frequency change, the exit, a UDP message, a key, or the next REACTOR_TICK_SEC refresh of the display.  About six
+//      wakeups a minute instead of 100 a second.
+//  Later the target became the absolute time of the slot from the plan (planner.c) and blackout.txt moved to the planning.  If the slot
+//      can't be made, paused with ENTER or a transmission delay past the frequency change, it returns 2 instead of waiting for the next
+//      one and the slot is skipped.  The transmission delay is kept between calls so the slot after it waits it out too.
+static int waitForTopOfEvenMinute( int txFreq, time_t targetTime, struct timespec *topOfMinute ) {
+    struct tm tm, *info;
+    struct timespec now, limit, deadline;
+    static time_t delayUntil = 0;   // set by a UDP message indicating transmit, nothing happens until then
     int returnValue = 0;
     int freqChangeDone = 0;     // flag
     int NumBytesIn;
-    int delayUDPTimer = 0;
-    int threeSecBeforeTarget;
-
-    doBlackout();
-
-    if ( (target != 0) && (target != 15) && (target != 30) && (target != 45) ) {
-        printf("\nTarget not on quarter second intervals (0, 15, 30, or 45 seconds)\n");
-        return 1;
-    }
-    if (target == 0) {
-        threeSecBeforeTarget = 57;
-    } else {
-        threeSecBeforeTarget = target-3;
-    }
+    int source;
 
    //   loop until top of minute
     printf("\nWaiting for top of even minute: ");  fflush( (FILE *)NULL );
     fprintf(dupFile,"\nWaiting for top of even minute: ");  fflush( (FILE *)dupFile );
     while (1) {
-        time( &rawtime );                   // rawtime is the number of seconds in the epoch (1/1/1970).  time() also returns the same value.
-        info = localtime( &rawtime );       // info is the structure giving seconds and minutes
-
-        //  This is the usual exit from loop and from function
-        if (delayUDPTimer == 0) {                   // if not delayed due to UDP message indicating transmit.  delayUDPTimer will be zero if txFreq == 0.
-            if ((freqChangeDone) || (txFreq==0)) {  // ... and already changed frequency at 57 seconds before top of even minute OR if txFreq == 0 meaning no freq change
-                if (info->tm_sec == target) {       // ... and now top of minute
-                    // no need to check for even minute because it was checked in next if block.
-                    //int isOdd = info->tm_min % 2;   // ... and this is an even minute
-                    //if (!isOdd) {                   // ... then break with returnValue == 0 (no error)
-                        break;
-                    //}
-                }
-            }
-        }
-
-        //  If three seconds before the top of even second set the radio to txFreq (unless txFreq == 0)
-        if ( (!freqChangeDone) && (delayUDPTimer == 0) ) {      // check that it's not already been done and no delay timer running.
-            if (txFreq) {                                       // if txFreq != 0
-                if (info->tm_sec == threeSecBeforeTarget) {     // if 57 second (or 12 or 27 or 42)
-                    int isOdd = info->tm_min % 2;               // ... and this is an odd minute
-                    if (isOdd) {                                // ... write freq change
-                        if (ft847_writeFreqHz( txFreq )) {      // set radio to transmit frequency
-                            returnValue = 1;    // if error
-                            break;
-                        }
-                        freqChangeDone = 1;
-                    }
-                }
-            }
-        }
+        clock_gettime( CLOCK_REALTIME, &now );
 
         if (terminate) {                    // if signal caught.
             returnValue = 1;
             break;
         }
 
-        //  Display
-        if (curSec != info->tm_sec) {
-            curSec = info->tm_sec;
-            if (delayUDPTimer) {
-                delayUDPTimer--;
-                printf("\rOne minute delay for transmission: %02d       ",delayUDPTimer);  fflush( (FILE *)NULL );
-                fprintf(dupFile,"\rOne minute delay for transmission: %02d       ",delayUDPTimer);  fflush( (FILE *)dupFile );
-            } else {
-                printf("\rWaiting for top of even minute: %02d %02d     ",info->tm_min,curSec);  fflush( (FILE *)NULL );
-                fprintf(dupFile,"\rWaiting for top of even minute: %02d %02d     ",info->tm_min,curSec);  fflush( (FILE *)dupFile );
-            }
+        if ((delayUntil) && (now.tv_sec >= delayUntil)) {   // one minute delay for transmission is over
+            delayUntil = 0;
         }
 
-        //  Check for ENTER or for UDP message
-        if ((txFreq) && (!freqChangeDone)) {      // don't allow ENTER key or UDP message to stop beacon if frequency has already been changed or if txFreq == 0
+        if ((delayUntil) && (txFreq) && (delayUntil > targetTime-3)) {     // still transmitting when the radio has to be set
+            printf("\rTransmitting, slot skipped                  ");
+            fprintf(dupFile,"\rTransmitting, slot skipped                  ");
+            returnValue = 2;
+            break;
+        }
 
-            //  Check for ENTER key to suspend
-            ioctl(0,TIOCINQ,&NumBytesIn);
-            if (NumBytesIn > 0) {
-                int terminateButDoCurl = 0;
-                while ( NumBytesIn > 0 ) {  //  Swallow ENTER and everything before it.
-                    if ((unsigned char)toupper(getchar()) == 'X') {
-                        terminateButDoCurl = 1;
-                    }
-                    NumBytesIn--;
+        if (delayUntil == 0) {
+            //  Three seconds before the target set the radio to txFreq (unless txFreq == 0)
+            if ((txFreq) && (!freqChangeDone) && (now.tv_sec >= targetTime-3)) {
+                if (now.tv_sec > targetTime-3) {                // missed it (paused with ENTER)
+                    returnValue = 2;
+                    break;
                 }
-                if (terminateButDoCurl) {
-                    printf("Terminating beacon loop\n");
-                    fprintf(dupFile,"Terminating beacon loop\n");
-                    returnValue = 1;
+                if (ft847_writeFreqHz( txFreq )) {              // set radio to transmit frequency
+                    returnValue = 1;    // if error
                     break;
                 }
-                printf("\r Press ENTER to resume.                     ");     fflush( (FILE *)NULL );
-                getchar();
+                freqChangeDone = 1;
+                clock_gettime( CLOCK_REALTIME, &now );
             }
 
-            //  Check for data on network port
-            ioctl(sockRx,TIOCINQ,&NumBytesIn);
-            if (NumBytesIn > 0) {
-                unsigned int len_inet;
-                int iii;
-                unsigned char dgram[512];              // receive buffer
-
-                len_inet = sizeof(adr_clnt4);
-                iii = recvfrom(sockRx,
-                        dgram,          // receive buffer
-                        sizeof(dgram),  // max length (a constant her would be better).
-                        0, //MSG_DONTWAIT,
-                        (struct sockaddr *)&adr_clnt4,   // filled in by function
-                        &len_inet
-                        );
-                if (iii < 0) {
-                    printf("UDP receive socket - recvfrom() failed\n");
-                    continue;
+            //  This is the usual exit from loop and from function, one second before the target
+            if (((freqChangeDone) || (txFreq == 0)) && (now.tv_sec >= targetTime-1)) {
+                if (now.tv_sec > targetTime-1) {                // too late for this one
+                    returnValue = 2;
                 }
-                if (iii > 0) {
-                    dgram[iii] = 0;
-                    if (strcmp(UDP_TX_MESSAGE,(char *)dgram) == 0) {
-                        delayUDPTimer = 60;
-                    }
-                    //printf("%s %d\n",(char *)dgram,delayUDPTimer);
+                break;
+            }
+        }
+
+        //  Display
+        if (delayUntil) {
+            printf("\rOne minute delay for transmission: %02ld       ",(long)(delayUntil - now.tv_sec));  fflush( (FILE *)NULL );
+            fprintf(dupFile,"\rOne minute delay for transmission: %02ld       ",(long)(delayUntil - now.tv_sec));  fflush( (FILE *)dupFile );
+        } else {
+            info = localtime_r( &now.tv_sec, &tm );
+            printf("\rWaiting for top of even minute: %02d %02d     ",info->tm_min,info->tm_sec);  fflush( (FILE *)NULL );
+            fprintf(dupFile,"\rWaiting for top of even minute: %02d %02d     ",info->tm_min,info->tm_sec);  fflush( (FILE *)dupFile );
+        }
+
+        //  Sleep until the next thing to do.  ENTER or a UDP message can only stop the beacon before the frequency has been changed and
+        //      if txFreq != 0.
+        if (delayUntil) {
+            limit.tv_sec = delayUntil;
+        } else if ((txFreq) && (!freqChangeDone)) {
+            limit.tv_sec = targetTime-3;
+        } else {
+            limit.tv_sec = targetTime-1;
+        }
+        limit.tv_nsec = 0;
+        reactor_nextTick( &limit, &deadline );
+        source = reactor_wait( &deadline, ((txFreq) && (!freqChangeDone)) ? (REACTOR_MASK(REACTOR_STDIN) | REACTOR_MASK(REACTOR_UDP)) : 0 );
+        if (source == -1) {
+            returnValue = 1;
+            break;
+        }
+
+        //  Check for ENTER key to suspend
+        if (source == REACTOR_STDIN) {
+            ioctl(0,TIOCINQ,&NumBytesIn);
+            if (NumBytesIn == 0) {          // end of file, stop watching it
+                reactor_remove( REACTOR_STDIN );
+                continue;
+            }
+            int terminateButDoCurl = 0;
+            while ( NumBytesIn > 0 ) {  //  Swallow ENTER and everything before it.
+                if ((unsigned char)toupper(getchar()) == 'X') {
+                    terminateButDoCurl = 1;
                 }
+                NumBytesIn--;
+            }
+            if (terminateButDoCurl) {
+                printf("Terminating beacon loop\n");
+                fprintf(dupFile,"Terminating beacon loop\n");
+                returnValue = 1;
+                break;
             }
+            printf("\r Press ENTER to resume.                     ");     fflush( (FILE *)NULL );
+            getchar();
         }
 
-        usleep(10000);
+        //  Check for data on network port
+        if (source == REACTOR_UDP) {
+            unsigned int len_inet;
+            int iii;
+            unsigned char dgram[512];              // receive buffer
+
+            len_inet = sizeof(adr_clnt4);
+            iii = recvfrom(sockRx,
+                    dgram,          // receive buffer
+                    sizeof(dgram)-1,    // max length, leaving room for the terminating null
+                    0,
+                    (struct sockaddr *)&adr_clnt4,   // filled in by function
+                    &len_inet
+                    );
+            if (iii < 0) {
+                printf("UDP receive socket - recvfrom() failed\n");
+                continue;
+            }
+            dgram[iii] = 0;
+            if (strcmp(UDP_TX_MESSAGE,(char *)dgram) == 0) {
+                clock_gettime( CLOCK_REALTIME, &now );
+                delayUntil = now.tv_sec + 60;
+            }
+            //printf("%s %ld\n",(char *)dgram,(long)delayUntil);
+        }
     }
 
     //  Convenient place to turn screen off at midnight and on at 6:00.
@@ -910,17 +869,174 @@ static int waitForTopOfEvenMinute( int txFreq, int target ) {
     }
     */
 
+    //  It broke out in the second before the target so the target starts at targetTime, exactly.
+    if (returnValue == 0) {
+        deadline.tv_sec = targetTime;
+        deadline.tv_nsec = 0;
+        if (topOfMinute != (struct timespec *)NULL) {
+            *topOfMinute = deadline;
+        } else {
+            while (clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, &deadline, NULL )) {     // non-zero if interrupted by a signal
+                if (terminate) {
+                    returnValue = 1;
+                    break;
+                }
+            }
+        }
+    }
+
     printf("\r");
     fprintf(dupFile,"\r");
-    //printf("Current local time and date: %ld %d %d %d   %s ", rawtime, info->tm_hour, info->tm_min, info->tm_sec, asctime(info));
     return returnValue;
 }
 
 
+//  Receives between beacon cycles until PLAN_SETUP_MS before the first slot of the next one, counting the minutes on the screen.  This
+//      used to be the top of the main loop, one pass per minute.  <ENTER> quits, '*'+<ENTER> reads WSPRConfig and changes the Rx freq,
+//      '-'+<ENTER> starts the next cycle as soon as it can.  If the FT847 transmits (UDP_TX_MESSAGE) within three minutes of the setup
+//      the schedule (anchorMs) moves two minutes later.
+//  Returns 0 when it is time to set up the cycle at *cycleStartMs, 1 to quit, -1 on error or a signal.
+static int waitForCycle( struct PlanConfig *config, long long *anchorMs, long long notBeforeMs, long long *cycleStartMs, int *rxFreqHz,
+                         struct BeaconData *beaconData ) {
+    struct timespec deadline;
+    long long nowMs, setupMs, minuteMs, wakeMs;
+    int minCounter = 0;
+    int NumBytesIn;
+    int source;
+
+    *cycleStartMs = planner_cycleStartMs( config, *anchorMs, notBeforeMs );
+    if (*cycleStartMs < 0) {
+        return -1;
+    }
+    setupMs = planner_firstSlotMs( config, *cycleStartMs ) - PLAN_SETUP_MS;
+    nowMs = planner_nowMs();
+    printf("Wait %lld min (<ENT>, *<ENT>, -<ENT>): ",(setupMs - nowMs + 59999)/60000);  fflush( (FILE *)NULL );
+    fprintf(dupFile,"Wait %lld min (<ENT>, *<ENT>, -<ENT>): ",(setupMs - nowMs + 59999)/60000);  fflush( (FILE *)dupFile );
+    minuteMs = nowMs + 60000;
+
+    while (1) {
+        nowMs = planner_nowMs();
+        if (nowMs >= setupMs) {
+            return 0;
+        }
+        if (nowMs >= minuteMs) {
+            minCounter++;
+            printf("%0d ",minCounter);  fflush( (FILE *)NULL );
+            fprintf(dupFile,"%0d ",minCounter);  fflush( (FILE *)dupFile );
+            minuteMs += 60000;
+        }
+
+        //  The minute is an absolute deadline so UDP messages and keystrokes in the middle of it don't move it.
+        wakeMs = (minuteMs < setupMs) ? minuteMs : setupMs;
+        deadline.tv_sec = wakeMs/1000;
+        deadline.tv_nsec = (wakeMs%1000)*1000000;
+        source = reactor_wait( &deadline, REACTOR_MASK(REACTOR_STDIN) | REACTOR_MASK(REACTOR_UDP) );
+        if ((source == -1) || (source == REACTOR_SIGNAL)) {
+            if (source == -1) { printf("Error in reactor_wait()\n"); } else { printf("Captured signal %d\n",signalCaptured); }
+            return -1;
+        }
+
+        if (source == REACTOR_UDP) {        //  if data on Ethernet port
+            unsigned int len_inet;
+            int iii;
+            unsigned char dgram[512];              // receive buffer
+
+            len_inet = sizeof(adr_clnt4);
+            iii = recvfrom(sockRx,
+                    dgram,          // receive buffer
+                    sizeof(dgram)-1,    // max length, leaving room for the terminating null
+                    0,              // no flags
+                    (struct sockaddr *)&adr_clnt4,   // filled in by function
+                    &len_inet
+                    );
+            if (iii < 0) {
+                printf("UDP receive socket - recvfrom() failed\n");
+                continue;
+            }
+            dgram[iii] = 0;
+
+            //  If transmitting then make sure that we don't transmit in the next two minutes.
+            if ((strcmp(UDP_TX_MESSAGE,(char *)dgram) == 0) && (planner_nowMs() > setupMs - 3*60000)) {
+                *anchorMs += 120000;
+                *cycleStartMs = planner_cycleStartMs( config, *anchorMs, notBeforeMs );
+                setupMs = planner_firstSlotMs( config, *cycleStartMs ) - PLAN_SETUP_MS;
+                printf("+2 ");  fflush( (FILE *)NULL );
+                fprintf(dupFile,"+2 ");  fflush( (FILE *)dupFile );
+            }
+        } else if (source == REACTOR_STDIN) {     //  If keyboard data.  Note I'm not putting the keyboard in raw mode so
+            //  The keyboard was hit.               //    nothing will happen unless I hit ENTER.
+            ioctl(0,TIOCINQ,&NumBytesIn);
+            if (NumBytesIn == 0) {              // end of file (CTRL-D, or stdin isn't a terminal).  Stop watching it or it never sleeps.
+                reactor_remove( REACTOR_STDIN );
+                continue;
+            }
+            int iii = getchar();
+            if (NumBytesIn == 1) {      // if <ENTER>.  Since not in raw mode then if only one character it has to be <ENTER>
+                return 1;
+            } else if (NumBytesIn == 2) {
+                getchar();                  // get the <ENTER>.
+                if (45 == iii) {            // if '-' then cut the wait time short
+                    *anchorMs = planner_nowMs() + PLAN_SETUP_MS;
+                    if (*anchorMs < notBeforeMs) {
+                        *anchorMs = notBeforeMs;
+                    }
+                } else if (42 == iii) {     // if '*' then read the config file and change Rx freq
+                    if (readConfigFile( rxFreqHz, beaconData ) || (radio_receive_freq( *rxFreqHz ))) {
+                        return -1;
+                    }
+                    planConfigure( config, beaconData, 0 );     // the interval may have changed
+                }
+                *cycleStartMs = planner_cycleStartMs( config, *anchorMs, notBeforeMs );
+                if (*cycleStartMs < 0) {
+                    return -1;
+                }
+                setupMs = planner_firstSlotMs( config, *cycleStartMs ) - PLAN_SETUP_MS;
+            } else {
+                printf("Unknown command\n");
+                return -1;
+            }
+        }
+    }
+}
+
+
+//  A slot planned while the box was too hot.  Waits until HEAT_RECHECK_SEC before it and checks the temperature again.  Signal 12 ends
+//      the wait and sends it anyway if the radio is still on.  Returns 0 to send the slot, 1 to skip it, -1 on error.
+#define HEAT_RECHECK_SEC    10
+static int waitForHeldSlot( long long slotMs ) {
+    struct timespec now, limit, deadline;
+
+    limit.tv_sec = (time_t)(slotMs/1000) - HEAT_RECHECK_SEC;
+    limit.tv_nsec = 0;
+    while (terminate == 0) {
+        if ((signalCaptured == SIGUSR2) && (heatPowerOff == 0)) {       // abort heat wait
+            signalCaptured = 0;
+            return 0;
+        }
+        clock_gettime( CLOCK_REALTIME, &now );
+        if (now.tv_sec >= limit.tv_sec) {
+            break;
+        }
+        printf("\rTemperature too high, slot held for %ld sec  ",(long)(limit.tv_sec - now.tv_sec));  fflush( (FILE *)NULL );
+        fprintf(dupFile,"\rTemperature too high, slot held for %ld sec  ",(long)(limit.tv_sec - now.tv_sec));  fflush( (FILE *)dupFile );
+        reactor_nextTick( &limit, &deadline );
+        if (reactor_wait( &deadline, 0 ) == -1) {
+            return -1;
+        }
+    }
+    if (terminate) {
+        return 1;
+    }
+    printf("\n");
+    fprintf(dupFile,"\n");
+    return heatCheck();
+}
+
+
 //  Handles all the logging events.  It is meant to be self-contained.  That is, fptr is openned and closed here.
 static int updateFiles( char *eventName ) {
     time_t rawtime;
-    struct tm *info;
+    struct tm tm, *info;
     char timestamp[64];
     double currentTemperature;
 
@@ -928,7 +1044,7 @@ static int updateFiles( char *eventName ) {
     const char* LOG_FILENAME = "log_twspr.txt";
 
     time( &rawtime );   // rawtime is of time_t, number of seconds since the epoch
-    info = localtime( &rawtime );
+    info = localtime_r( &rawtime, &tm );
     strftime( timestamp, 64, "%a %b %d %Y %H:%M:%S", info );
 
     logFile = (FILE *)fopen(LOG_FILENAME,"at");
@@ -954,6 +1070,8 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData ) {
     char *cc, string[64];
     int convResult = 0;
     int numBeacons = 0;
+    int audioRate, audioChannels;
+    char locator[8];
 
     //  If file is missing then it is not an error.  Just continue to use the current values.
     //  If file is present then new values will be assigned to all parameters.  However it is only an error if rxFreqHz is zero.
@@ -969,6 +1087,21 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData ) {
     //      The tokens (rxFreqHz or txFreqHz) must start on the first character of the line.
     //      The frequency must be in Hz and can be be as short as 7 digits (<10 MHz) or as long as 10 digits (144 or 432 MHz)
     //      Lines without this format can be present but will be ignored.
+    //
+    //      Drive levels (see txgain.c) are optional, one line per mode and band.  A frequency of 0 is the level for the other bands.
+    //          txGainDb  WSPR  50293000  -27.0
+    //          txGainDb  FT8   0         -10.1
+    //
+    //      The sound device's rate and channels are optional too (see wav_output3.c), 44100 Hz stereo if not given:
+    //          audioFmt  48000  2
+    //
+    //      So is the schedule (see planner.c), minutes from one beacon cycle to the next and from one beacon to the next (even, 2 is
+    //          back to back).  BEACON_INTERVAL and BEACON_SPACING if not given.  A change takes effect with the next cycle.
+    //          schedule  28  4
+    //
+    //      And the home grid square, 4 or 6 characters, that the azimuths and distances to the reporters are from (see gridcache.c).
+    //          MY_LOCATOR if not given.  Any number of spaces after the token.  It goes to the reports thread with the next ReportJob.
+    //          locator   DM12qu
 
     fptr = fopen(CONFIG_FILENAME,"rt");
     if (fptr == (FILE *)NULL) {
@@ -979,20 +1112,29 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData ) {
     for (int iii = 0; iii < MAX_NUMBER_OF_BEACONS; iii++ ) {        // no going back.  Must get something assigned.
         beaconData[iii].txFreqHz = 0;
         beaconData[iii].timestamp[0] = 0;
-        beaconData[iii].tone[0] = 0;
+        beaconData[iii].toneHz = 0.0;
         beaconData[iii].txFreqHzActual = 0;
+        beaconData[iii].dialFreqHz = 0;
+        beaconData[iii].toneHzSent = 0.0;
+        beaconData[iii].requestedFreqHz = 0.0;
+        beaconData[iii].achievedFreqHz = 0.0;
         beaconData[iii].temperature = 0.0;
     }
+    txgain_clear();
+    audioRate = AUDIO_DEVICE_RATE;          // set once after the loop, so the audio slots are only mapped again if it changed
+    audioChannels = AUDIO_DEVICE_CHANNELS;
+    planInterval = BEACON_INTERVAL;
+    planSpacing = BEACON_SPACING;
+    strcpy( locator, MY_LOCATOR );
 
     while (!feof(fptr)) {
-        if (numBeacons == MAX_NUMBER_OF_BEACONS) {
-            break;
-        }
-
         cc = fgets( string, 64, fptr );         // read one line of the file
         if (cc == (char *)NULL) {
             break;
         }
+        if (sscanf( string, "locator %7s", locator ) == 1) {     // before the length check, "locator   DM12" is only 15 characters
+            continue;
+        }
         if (strlen(string) < 16) {      // token (rx/tx1/tx2/tx3/tx4FreqHz) always 8 characters + at least one space + at least 7 characters for the freq.
             continue;
         }
@@ -1006,6 +1148,10 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData ) {
         } else if (!strcmp(string,"txFreqHz")) {
             int convResult = readConfigFileHelp( &string[10] );
             if ( convResult < 0) {  continue;  }    //  error - read the next line, if any.
+            if (numBeacons == MAX_NUMBER_OF_BEACONS) {      // the lines after the last beacon are still read
+                printf("%s - txFreqHz %d dropped, no more than %d beacons\n",CONFIG_FILENAME,convResult,MAX_NUMBER_OF_BEACONS);
+                continue;
+            }
             if ( readConfigFileWSPRFreq( convResult ) == 0 ) {
                 // Special consideration for 2m beacon, skip it if temperature > 70 deg.
                 double currentTemperature = getTempData();
@@ -1013,11 +1159,46 @@ static int readConfigFile( int *rxFreqHz, struct BeaconData *beaconData ) {
                     beaconData[numBeacons++].txFreqHz = convResult;
                 }
             }
+        } else if (!strcmp(string,"txGainDb")) {
+            char mode[8];
+            int freqHz;
+            double gainDb;
+            if (sscanf( &string[10], "%7s %d %lf", mode, &freqHz, &gainDb ) != 3) {  continue;  }    //  error - read the next line, if any.
+            if (!strcmp(mode,"WSPR")) {
+                txgain_set( TXGAIN_WSPR, freqHz, gainDb );
+            } else if (!strcmp(mode,"FT8")) {
+                txgain_set( TXGAIN_FT8, freqHz, gainDb );
+            }
+        } else if (!strcmp(string,"audioFmt")) {
+            int rate, channels;
+            if (sscanf( &string[10], "%d %d", &rate, &channels ) != 2) {  continue;  }    //  error - read the next line, if any.
+            audioRate = rate;
+            audioChannels = channels;
+        } else if (!strcmp(string,"schedule")) {
+            int interval, spacing;
+            if (sscanf( &string[10], "%d %d", &interval, &spacing ) != 2) {  continue;  }    //  error - read the next line, if any.
+            if ((interval < 1) || (spacing < 2) || (spacing % 2)) {
+                printf("%s - schedule %d %d ignored, the spacing has to be even and at least 2\n",CONFIG_FILENAME,interval,spacing);
+                continue;
+            }
+            planInterval = interval;
+            planSpacing = spacing;
         }
     }
 
     clearerr(fptr);
     fclose(fptr);
+    if (setAudioFormat( audioRate, audioChannels ) == -1) {
+        setAudioFormat( AUDIO_DEVICE_RATE, AUDIO_DEVICE_CHANNELS );
+    }
+    strcpy( homeLocator, locator );         // checked by gridcache_setHome() in the reports thread, a bad one is MY_LOCATOR
+    if (numBeacons > planInterval/planSpacing) {        // the schedule may come after the beacons, so they're only trimmed to it here
+        printf("%s - only %d beacons fit in %d minutes %d apart, the last %d dropped\n",CONFIG_FILENAME,planInterval/planSpacing,
+            planInterval,planSpacing,numBeacons - planInterval/planSpacing);
+        while (numBeacons > planInterval/planSpacing) {
+            beaconData[--numBeacons].txFreqHz = 0;
+        }
+    }
     printf("\n\nNumber of beacons %d\n",numBeacons);
     fprintf(dupFile,"\n\nNumber of beacons %d\n",numBeacons);
     if (*rxFreqHz == 0) {
@@ -1102,6 +1283,9 @@ static int findttyUSB( void ) {
     struct stat statbuf;
     int return_value = 0;
 
+#ifdef SIMULATION
+    return 0;                   // no FT847, sim.c fakes it
+#endif
     printf("\n");
 
     //  start by getting the current directory so when function is over can return to it.
@@ -1212,6 +1396,14 @@ static int installSignalHandlers( int useMyHandlers ) {
       printf("\nError installing signal handler.\n");
       return 1;
     }
+
+    //  SSL_write() in httpclient.c can write to a connection wsprnet.org or pskreporter.info has closed.  That should return an error, not
+    //      kill this program.
+    psa.sa_handler = SIG_IGN;
+    if ( sigaction( SIGPIPE, &psa, NULL ) == -1 )  {    //  signal 13
+      printf("\nError installing signal handler.\n");
+      return 1;
+    }
     return 0;
 }
 
@@ -1355,7 +1547,7 @@ static int getMyIPAddress( char *myIPAddress ){
     static int socktemp;                  // socket for receiving data from UDPRepeater4.py
     struct sockaddr_in inet_adr;          // for receiving messages, only used here.
     int iii;
-    socklen_t structlength;               // unsigned int
+    socklen_t structlength = sizeof(inet_adr);      // unsigned int, in and out
 
     /* The equivalent Python code
     sss = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -1450,143 +1642,215 @@ static int blackoutUpdateFile( void ) {
 
 
 
+/*
+    blackout.txt format example - "2022-11-02 17:55:00, 2022-11-02 17:55:02"
+
+    The timestamp format is "%Y-%m-%d %H:%M:%S", for example "2022-10-02 16:46:00".
+        The '-' and the ':' are required, with a space between date and time.
+      Always local time, not UTC.
+    The first timestamp is start time, then a comma, then stop time.
+    The program check the first character of each line for a '#', indicating a
+        comment.  Every other line is a blackout window, they are all read before
+        each beacon cycle is planned and any beacon that overlaps one is skipped.
+        If the stop time has passed it will rewrite this file, eliminating that line.
+
+*/
+
 //
-//    blackoutCheck() - Returns non-zero on error.  Otherwise it returns time_t blackoutEndTime, which is set to 0 if no blackout.
+//  readBlackouts() - reads every blackout window in blackout.txt into config (planner.h).  If removeExpired the lines whose stop time has
+//      passed, or whose start isn't before the stop, are taken out of the file with blackoutUpdateFile().  Returns the number of windows or
+//      -1 on error.  No blackout.txt is not an error.
 //
-static int blackoutCheck( time_t *blackoutEndTime ) {
+static int readBlackouts( struct PlanConfig *config, int removeExpired ) {
     FILE *fptr;
     struct tm tmStart, tmEnd;
     time_t epochStart, epochEnd, epochCurrent;
-    int iii;
     char string[256];
+    char expired[PLAN_MAX_BLACKOUTS][256];
+    int iii, numExpired = 0;
 
-    *blackoutEndTime = 0;               // default return value.  Calling routine will do nothing in this case.
-
-    //
-    //  Step 1 - read the file and interpret the results.  The output of this section is epochStart, epochEnd
-    //
-
+    config->numBlackouts = 0;
     fptr = fopen( BLACKOUT_FILENAME, "rt" );
     if (fptr == (FILE *)NULL) {
         printf("No blackout.txt file\n");
         return 0;       // not an error.
     }
 
-    //  Loop through file, looking for the first non-comment.  Read into string[].
-    while (1){
-        char* ccc = fgets(string, 256, fptr);
-        if (feof(fptr)) {
-            fclose(fptr);
-            return 0;
+    time( &epochCurrent );
+    while (fgets(string, 256, fptr)) {
+        if ((string[0] == '#') || (strlen(string) < 5)) {      // a not so elegant way to avoid operating on blank lines.
+            continue;
         }
-        if (ccc == (char *)NULL) {
-            printf("Error reading from %s\n", BLACKOUT_FILENAME);
-            fclose(fptr);
-            return -1;
+
+        //  Now read timestamps into tmStart and tmEnd.
+        iii = sscanf(string, "%d-%d-%d %d:%d:%d, %d-%d-%d %d:%d:%d",
+               &tmStart.tm_year, &tmStart.tm_mon, &tmStart.tm_mday, &tmStart.tm_hour, &tmStart.tm_min, &tmStart.tm_sec,
+               &tmEnd.tm_year, &tmEnd.tm_mon, &tmEnd.tm_mday, &tmEnd.tm_hour, &tmEnd.tm_min, &tmEnd.tm_sec );
+        if ( (iii != 12)
+                || (tmStart.tm_mon < 1) || (tmStart.tm_mon > 12)  || (tmEnd.tm_mon < 1) || (tmEnd.tm_mon > 12)
+                || (tmStart.tm_year < 2022) || (tmEnd.tm_year < 2022)
+           ) {
+            printf("Error parsing from %s, line -  %s\n", BLACKOUT_FILENAME, string);
+            continue;
         }
-        if (string[0] != '#') {
-            if (strlen(string) < 5) {       // a not so elegant way to avoid operating on blank lines.
-                continue;
+        tmStart.tm_mon--;  tmEnd.tm_mon--;                  // months are numbered 0-11
+        tmStart.tm_year -= 1900;  tmEnd.tm_year -= 1900;    // 2022 is 122 in tm_year
+        tmStart.tm_isdst = tmEnd.tm_isdst = -1;             // tm_isdst cannot be left uninitialized.  A negative number tells mktime() to figure it out.
+
+        //  Get epoch time for each
+        epochStart = mktime( &tmStart );
+        epochEnd = mktime( &tmEnd );
+        if ((epochStart >= epochEnd) || (epochCurrent >= epochEnd)) {
+            if (epochStart >= epochEnd) {
+                printf("Error - start time after or same as end time, start %ld end %ld\n", epochStart, epochEnd);
             } else {
-                break;
+                printf("Blackout period over - current %ld end %ld\n", epochCurrent, epochEnd);
             }
+            if (numExpired < PLAN_MAX_BLACKOUTS) {
+                strcpy( expired[numExpired++], string );        // store copy of line, it is deleted once the file is closed
+            }
+            continue;
         }
-    }
-    fclose(fptr);
 
-    //  Now read timestamps into tmStart and tmEnd.
-    iii = sscanf(string, "%d-%d-%d %d:%d:%d, %d-%d-%d %d:%d:%d",
-           &tmStart.tm_year, &tmStart.tm_mon, &tmStart.tm_mday, &tmStart.tm_hour, &tmStart.tm_min, &tmStart.tm_sec,
-           &tmEnd.tm_year, &tmEnd.tm_mon, &tmEnd.tm_mday, &tmEnd.tm_hour, &tmEnd.tm_min, &tmEnd.tm_sec );
-    if ( (iii != 12)
-            || (tmStart.tm_mon < 1) || (tmStart.tm_mon > 12)  || (tmEnd.tm_mon < 1) || (tmEnd.tm_mon > 12)
-            || (tmStart.tm_year < 2022) || (tmEnd.tm_year < 2022) || (tmStart.tm_year > 2024) || (tmEnd.tm_year > 2024)
-       ) {
-        printf("Error parsing from %s, line -  %s\n", BLACKOUT_FILENAME, string);
+        if (config->numBlackouts == PLAN_MAX_BLACKOUTS) {
+            printf("More than %d windows in %s, the rest are ignored\n", PLAN_MAX_BLACKOUTS, BLACKOUT_FILENAME);
+            break;
+        }
+        config->blackoutStartMs[ config->numBlackouts ] = (long long)epochStart*1000;
+        config->blackoutEndMs[ config->numBlackouts ] = (long long)epochEnd*1000;
+        config->numBlackouts++;
+    }
+    if (ferror(fptr)) {
+        printf("Error reading from %s\n", BLACKOUT_FILENAME);
         fclose(fptr);
         return -1;
     }
-    tmStart.tm_mon--;  tmEnd.tm_mon--;                  // months are numbered 0-11
-    tmStart.tm_year -= 1900;  tmEnd.tm_year -= 1900;    // 2022 is 122 in tm_year
-    tmStart.tm_isdst = tmEnd.tm_isdst = -1;             // tm_isdst cannot be left uninitialized.  A negative number tells mktime() to figure it out.
-
-    //  store copy of line in case it later needs to be deleted.
-    strcpy(lineToRemove,string);
-
-    //  Get epoch time for each
-    epochStart = mktime( &tmStart );
-    epochEnd = mktime( &tmEnd );
-    if (epochStart >= epochEnd) {
-        char tempx[256];
-        strcpy(tempx,string);
-        tempx[ strlen(tempx)-1 ] = 0;    // remove LF at end
-        printf("Error - start time after or same as end time %s, start %ld end %ld\n", tempx, epochStart, epochEnd);
-        blackoutUpdateFile();
-        return -1;
+    fclose(fptr);
+
+    if (removeExpired) {
+        for (iii = 0; iii < numExpired; iii++) {
+            strcpy( lineToRemove, expired[iii] );
+            blackoutUpdateFile();
+        }
     }
+    return config->numBlackouts;
+}
 
-    //
-    //  Step 2 - get current time and compare
-    //
 
-    //  Get current time in time_t format (epoch)
-    time( &epochCurrent );
+//  Checks the box temperature before a cycle is planned and again before each slot held because of it.  Above TEMPERATURE_POWER_OFF the
+//      FT847 is powered off and it isn't powered back on until the box is below TEMPERATURE_HYSTERESIS_BOTTOM.  This used to be a loop
+//      in front of the beacon block that waited two minutes at a time.  Returns 1 if it is too hot to transmit, 0 if not, -1 on error.
+static int heatCheck( void ) {
+    double currentTemperature = getTempData();
 
-    if (epochCurrent >= epochEnd) {         // if current time is past end time just delete the line
-        printf("Blackout period over - current %ld end %ld\n", epochCurrent, epochEnd);
-        blackoutUpdateFile();
-        return 0;
+    // decide whether to turn FT847 power off.  Turn off > 90 but don't turn back on until < 86.
+    if (heatPowerOff) {                                                 // if FT847 is powered OFF ...
+        if (currentTemperature < TEMPERATURE_HYSTERESIS_BOTTOM) {       //   and the box has cooled 4 degrees ...
+            heatPowerOff = 0;                                           //   clear flag and power the FT847 back up.
+            if ( powerOnOffFT847(1) ) { return -1; }                    // Power On - assume gpio23 is already set up
+            updateFiles("HeatWait");                                    // Insert another HeatWait message into log
+            sendUDPEmailMsg( "Box below 86 deg, radio on\nBox temperature below 86 degrees, radio powered on\n" );
+        }
+    } else if (currentTemperature > TEMPERATURE_POWER_OFF) {            // if FT847 is powered ON and the box is above 90 degrees
+        heatPowerOff = 1;                                               //    set flag and power the FT847 off
+        if ( powerOnOffFT847(0) ) { return -1; }                        //  Power OFF
+        updateFiles("HeatOff ");
     }
 
-    //  If four minutes after current time is greater than start time then there is no time to do the next WSPR message.
-    //      Set blackoutEndTime to the epochEnd value.
-    //  If four minutes from now is less than start time then blackoutEndTime will remain at zero (set at top of function).
-    if (epochCurrent+240 >= epochStart) {
-        *blackoutEndTime = epochEnd;
+    if (currentTemperature < TEMPERATURE_BEACON_MAX) {  //  This will capture errors also.  getTempData() returns -1.0 on error and +1.0 if process not running.
+        heatInLog = 0;
+        return 0;
+    }
+    if ((heatPowerOff == 0) && (heatInLog == 0)) {      // if (85 < temperature < 90) AND (FT847 powered on), just check if a log file entry needs to be made.
+        updateFiles("HeatWait");
+        heatInLog = 1;
     }
 
-    return 0;
+    // print message on the screen
+    if (heatPowerOff) {
+        printf("Temperature too high: %3.3lf F.  Beacons held with power OFF\n",currentTemperature);
+        fprintf(dupFile,"Temperature too high: %3.3lf F.  Beacons held with power OFF\n",currentTemperature);
+    } else {
+        printf("Temperature too high: %3.3lf F.  Beacons held, Sig 12 abort\n",currentTemperature);
+        fprintf(dupFile,"Temperature too high: %3.3lf F.  Beacons held, Sig 12 abort\n",currentTemperature);
+    }
+    fflush(stdout);   fflush(dupFile);
+    return 1;
 }
 
 
-/*
-    blackout.txt format example - "2022-11-02 17:55:00, 2022-11-02 17:55:02"
+//  Fills in what planner.c needs from WSPRConfig: the schedule, the beacons and the FT8 burst in front of them.  The blackouts are added
+//      by readBlackouts().
+static void planConfigure( struct PlanConfig *config, const struct BeaconData *beaconData, int heatHold ) {
+    memset( config, 0, sizeof(struct PlanConfig) );
+    config->intervalMin = planInterval;
+    config->spacingMin = planSpacing;
+    for (int iii = 0; iii < MAX_NUMBER_OF_BEACONS; iii++) {
+        if (beaconData[iii].txFreqHz == 0) {        // all unused beaconData[] entries are zero and are all at end of array
+            break;
+        }
+        config->txFreqHz[ config->numBeacons++ ] = beaconData[iii].txFreqHz;
+    }
+    config->ft8FreqHz = FT8_50MHZ;              // only one FT8 burst per beacon block
+    config->ft8Target = 15;
+    config->heatHold = heatHold;
+}
 
-    The timestamp format is "%Y-%m-%d %H:%M:%S", for example "2022-10-02 16:46:00".
-        The '-' and the ':' are required, with a space between date and time.
-      Always local time, not UTC.
-    The first timestamp is start time, then a comma, then stop time.
-    The program check the first character of each line for a '#', indicating a
-        comment.  It will then stop after reading the first timestamp set.  If the
-        stop time has passed it will rewrite this file, eliminating that line.
 
-*/
+//  "./twsprRPI -n" - prints the slots for the next 24 hours, the way the main loop would run them if it was started now and nothing
+//      changed, then quits.  It reads WSPRConfig, blackout.txt (nothing is removed) and the temperature and touches nothing else so it
+//      can be run next to the copy that is beaconing.
+#define DRY_RUN_MAX_SLOTS   4000
+static int dryRun( void ) {
+    static struct PlanSlot slots[ DRY_RUN_MAX_SLOTS ];
+    struct PlanConfig config;
+    struct BeaconData beaconData[ MAX_NUMBER_OF_BEACONS ];
+    int rxFreqHz = WSPR_DEFAULT_10M;
+    long long nowMs, anchorMs;
+    int numSlots;
 
-//
-//  doBlackout() - handles all the blackout checking, file, line deletion, etc.  Calls the two functions above.
-//
-static int doBlackout( void ) {
-    time_t blackoutEndTime;
-
-    int iii = blackoutCheck( &blackoutEndTime );
-    if (iii == 0) {
-        if (blackoutEndTime) {
-            time_t rawtime;
-
-            printf("\n");
-            while (1) {
-                time( &rawtime );
-                if (rawtime >= blackoutEndTime) {
-                    break;
-                }
-                printf("Blackout for %ld sec - %ld, %ld\r",blackoutEndTime-rawtime,rawtime,blackoutEndTime);  fflush( stdout );
-                sleep(1);
-            }
-            printf("Blackout complete - %ld, %ld        \n",rawtime,blackoutEndTime);
-            blackoutUpdateFile();
-        }
+    dupFile = (FILE *)fopen("/dev/null","wt");          // readConfigFile() prints to it, duplicate.txt belongs to the running copy
+    if (dupFile == (FILE *)NULL) {
+        return 1;
     }
-    return iii;
+    memset( beaconData, 0, sizeof(beaconData) );
+    if (readConfigFile( &rxFreqHz, beaconData )) {
+        printf("Nothing to plan, no rxFreqHz in %s\n",CONFIG_FILENAME);
+        fclose(dupFile);
+        return 1;
+    }
+    planConfigure( &config, beaconData, (getTempData() >= TEMPERATURE_BEACON_MAX) );
+    readBlackouts( &config, 0 );
+
+    nowMs = planner_nowMs();
+#ifdef NO_WAIT_FIRST_BURST
+    anchorMs = nowMs + PLAN_SETUP_MS;
+#else
+    anchorMs = nowMs + config.intervalMin*60000LL;
+#endif
+    numSlots = planner_plan( &config, anchorMs, nowMs, nowMs + 24*3600*1000LL, slots, DRY_RUN_MAX_SLOTS );
+    fclose(dupFile);
+    if (numSlots < 0) {
+        return 1;
+    }
+    printf("Rx %d, a cycle every %d min, beacons %d min apart, %d blackout windows\n",rxFreqHz,config.intervalMin,config.spacingMin,
+           config.numBlackouts);
+    planner_print( stdout, slots, numSlots, nowMs );
+    return 0;
+}
+
+
+//  Prints how many times the program woke up (reactor_wait() returned) since the last call, once per beacon block.
+static void printWakeups( void ) {
+    long bySource[REACTOR_NUM_SOURCES];
+    long total = reactor_wakeups( bySource );
+
+    printf("Wakeups this cycle: %ld (timer %ld, keyboard %ld, UDP %ld, audio %ld, signal %ld)\n",total,bySource[REACTOR_TIMEOUT],
+           bySource[REACTOR_STDIN],bySource[REACTOR_UDP],bySource[REACTOR_AUDIO],bySource[REACTOR_SIGNAL]);
+    fprintf(dupFile,"Wakeups this cycle: %ld (timer %ld, keyboard %ld, UDP %ld, audio %ld, signal %ld)\n",total,bySource[REACTOR_TIMEOUT],
+           bySource[REACTOR_STDIN],bySource[REACTOR_UDP],bySource[REACTOR_AUDIO],bySource[REACTOR_SIGNAL]);
+    fflush( (FILE *)dupFile );
+    reactor_resetWakeups();
 }
 
 /*
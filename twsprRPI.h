@@ -1,9 +1,13 @@
 #ifndef _COMPONENT_H_
 #define _COMPONENT_H_
 
-#define BEACON_INTERVAL     (28)                    // because of the funky way I did the timing (see comments above main loop) this is the interval between beacons.
-                                                    // SHOULD always be divisible by 4.
-#define MAX_NUMBER_OF_BEACONS   (BEACON_INTERVAL/4) // this is the max number of beacons that will fit in BEACON_INTERVAL
+#include "planner.h"
+
+#define BEACON_INTERVAL     (28)                    // minutes from the start of one beacon cycle to the start of the next, any number (see planner.c)
+#define BEACON_SPACING      (4)                     // minutes from the start of one beacon to the start of the next, even.  2 is back to back.
+                                                    //      Both can be changed in WSPRConfig with "schedule  <interval>  <spacing>".
+#define MAX_NUMBER_OF_BEACONS   PLAN_MAX_BEACONS    // this is the max number of beacons that will be read from WSPRConfig.  Only
+                                                    //      interval/spacing of them fit in a cycle, the rest are dropped.
 
 #define WSPR_30M            (10138700)
 #define WSPR_17M            (18104600)
@@ -13,11 +17,24 @@
 #define WSPR_6M             (50293000)
 #define WSPR_2M             (144489000)
 
+#define MY_CALLSIGN         "NQ6B"                  // what goes into the WSPR message (wspr.c)
+#define MY_GRID             "DM12"                  // only 4 characters fit in a type 1 WSPR message
+#define MY_LOCATOR          "DM12qu"                // the azimuths and distances to the reporters are from here (gridcache.c)
+#define MY_POWER_DBM        (37)
+#define MY_FT8_MESSAGE      "TST NQ6B DM12"         // free text or a standard message, see ft8_pack() in ft8.c
+
+#define WSPR_START_OFFSET_MS    (1000)              // the first tone leaves the sound card this long after the top of the even minute
+#define FT8_START_OFFSET_MS     (500)               // ... and this long after the top of the 15 second FT8 slot
+
 struct BeaconData {
     char timestamp[16]; // the UTC time-of-day that the beacon begins
     int txFreqHz;       // the frequency read from the configuration file
-    int txFreqHzActual; // the frequency actually set in the radio, after compensation
-    char tone[16];      // "1500.wav", converted to double later
+    int txFreqHzActual; // the frequency after temperature compensation, to 1 Hz
+    int dialFreqHz;     // the frequency actually set in the radio, txFreqHzActual rounded to the radio's 10 Hz step
+    double toneHz;      // audio tone, center of the four WSPR tones (was the wav file name, "1500.wav")
+    double toneHzSent;  // toneHz plus the part of txFreqHzActual the radio couldn't be set to, the tone actually synthesized
+    double requestedFreqHz; // txFreqHzActual + toneHz, where the signal should be on the radio's dial
+    double achievedFreqHz;  // dialFreqHz + toneHzSent, where it was sent
     double temperature; // the temperature at the time the beacon begins
 };
 
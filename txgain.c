@@ -0,0 +1,151 @@
+/*
+        gcc -g -Wall txgain.c -lm
+
+        This sets the drive level of the transmitter.  It replaces pulseaudio.c, which waited for aplay to show up as a pulseaudio sink input,
+        scraped "pactl list sink-inputs" for its stream number and then ran "pactl set-sink-input-volume".  That happened about 0.5 sec into
+        the burst and depended on the layout of pactl's output.  Now the samples are scaled before they go to the sound card, so the level
+        is right from the first sample.  The sink input itself should stay at 100%.
+
+        The levels are in dB and can be set per mode and per band with txGainDb lines in WSPRConfig (see readConfigFile() in twsprRPI.c):
+            txGainDb  WSPR  50293000  -27.0
+            txGainDb  FT8   0         -10.1
+        The frequency picks the band, the level applies to every transmit frequency in the same MHz.  0 sets the level for bands without a
+        line of their own.
+
+        The built-in defaults are the old pactl settings.  Pulseaudio's volume is cubic, so VOLUME_LOW 24600 (WSPR) is (24600/65536)^3 =
+        0.0529 = -25.5 dB and VOLUME_HIGH 44500 (FT8) is (44500/65536)^3 = 0.313 = -10.1 dB.
+
+        To test uncomment MAIN_HERE at the bottom.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "txgain.h"
+
+#define PULSE_VOLUME_NORM   65536.0
+#define VOLUME_LOW          24600       // the old pactl settings, scale is from 0 to 65535, 0% to 100%
+#define VOLUME_HIGH         44500
+#define MAX_GAIN_ENTRIES    32
+
+void txgain_clear( void );
+int txgain_set( int mode, int freqHz, double gainDb );
+double txgain_getDb( int mode, int txFreqHz );
+void txgain_apply( short *samples, long count, double gainDb );
+
+static double pulseVolumeToDb( int volume );
+
+struct GainEntry {
+    int mode;           // TXGAIN_WSPR or TXGAIN_FT8
+    int bandMHz;        // 0 is the default for the mode
+    double gainDb;
+};
+
+static struct GainEntry gainEntries[MAX_GAIN_ENTRIES];
+static int numGainEntries = 0;
+
+
+//  Forget all the levels read from WSPRConfig and go back to the defaults.
+void txgain_clear( void ) {
+    numGainEntries = 0;
+}
+
+
+//  Set the level for mode on the band freqHz is in (or the default if freqHz is 0).  Returns -1 on a bad mode or a full table.
+int txgain_set( int mode, int freqHz, double gainDb ) {
+    int bandMHz = freqHz/1000000;
+    int iii;
+
+    if ((mode != TXGAIN_WSPR) && (mode != TXGAIN_FT8)) {
+        return -1;
+    }
+    if (gainDb > 0.0) {
+        gainDb = 0.0;           // full scale is as loud as it gets
+    }
+    for (iii = 0; iii < numGainEntries; iii++) {
+        if ((gainEntries[iii].mode == mode) && (gainEntries[iii].bandMHz == bandMHz)) {
+            break;
+        }
+    }
+    if (iii == MAX_GAIN_ENTRIES) {
+        printf("txgain_set() - too many levels\n");
+        return -1;
+    }
+    if (iii == numGainEntries) {
+        numGainEntries++;
+    }
+    gainEntries[iii].mode = mode;
+    gainEntries[iii].bandMHz = bandMHz;
+    gainEntries[iii].gainDb = gainDb;
+    return 0;
+}
+
+
+//  Returns the level in dB for mode on txFreqHz.  The band's own entry wins, then the mode's default, then the old pactl setting.
+double txgain_getDb( int mode, int txFreqHz ) {
+    int bandMHz = txFreqHz/1000000;
+    int defaultEntry = -1;
+
+    for (int iii = 0; iii < numGainEntries; iii++) {
+        if (gainEntries[iii].mode != mode) {
+            continue;
+        }
+        if (gainEntries[iii].bandMHz == bandMHz) {
+            return gainEntries[iii].gainDb;
+        }
+        if (gainEntries[iii].bandMHz == 0) {
+            defaultEntry = iii;
+        }
+    }
+    if (defaultEntry >= 0) {
+        return gainEntries[defaultEntry].gainDb;
+    }
+    return pulseVolumeToDb( (mode == TXGAIN_FT8) ? VOLUME_HIGH : VOLUME_LOW );
+}
+
+
+//  Scales count samples in place.  Interleaved stereo is fine, each sample is scaled the same.
+void txgain_apply( short *samples, long count, double gainDb ) {
+    double gain = pow( 10.0, gainDb/20.0 );
+    double value;
+
+    if (gain >= 1.0) {
+        return;
+    }
+    for (long iii = 0; iii < count; iii++) {
+        value = lround( samples[iii]*gain );
+        samples[iii] = (short)((value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value));
+    }
+}
+
+
+//  pulseaudio software volume is the cube of volume/PA_VOLUME_NORM.
+static double pulseVolumeToDb( int volume ) {
+    return 60.0*log10( volume/PULSE_VOLUME_NORM );
+}
+
+
+
+//  Prints the defaults and checks a few lookups.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+int main() {
+    short samples[4] = { 32767, -32768, 1000, -1000 };
+    int errors = 0;
+
+    printf("default WSPR %.2lf dB, FT8 %.2lf dB\n", txgain_getDb( TXGAIN_WSPR, 28124640 ), txgain_getDb( TXGAIN_FT8, 28074000 ));
+    txgain_set( TXGAIN_WSPR, 0, -20.0 );
+    txgain_set( TXGAIN_WSPR, 50293000, -27.0 );
+    txgain_set( TXGAIN_WSPR, 50293000, -26.0 );        // replaces the line above
+    if (txgain_getDb( TXGAIN_WSPR, 50293160 ) != -26.0) { errors++; }
+    if (txgain_getDb( TXGAIN_WSPR, 28124640 ) != -20.0) { errors++; }
+    if (fabs( txgain_getDb( TXGAIN_FT8, 50313000 ) + 10.09 ) > 0.01) { errors++; }
+    txgain_apply( samples, 4, 20.0*log10( 0.5 ) );
+    if ((abs( samples[0] - 16384 ) > 1) || (samples[1] != -16384) || (samples[2] != 500) || (samples[3] != -500)) { errors++; }
+    txgain_clear();
+    if (fabs( txgain_getDb( TXGAIN_WSPR, 50293160 ) + 25.53 ) > 0.01) { errors++; }
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _TXGAIN_H_
+#define _TXGAIN_H_
+
+#define TXGAIN_WSPR     0
+#define TXGAIN_FT8      1
+
+extern void txgain_clear( void );
+extern int txgain_set( int mode, int freqHz, double gainDb );
+extern double txgain_getDb( int mode, int txFreqHz );
+extern void txgain_apply( short *samples, long count, double gainDb );
+
+#endif
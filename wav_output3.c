@@ -2,12 +2,33 @@
       wav_output3.c - This file was created to invoke aplay to send wav files to the sound cards.  It became necessary after I discovered wav_output2.c
         and portaudio caused spurious emissions about -20 dB down from the main lobe when run on my RPi.  aplay does not do that.  See Ham Radio Notes.docx, 3/30/2023.
 
+      aplay has since been replaced by alsaplay.c, which writes the same samples to the same ALSA device ("pulse") from inside this process.
+        The device is opened once in initializePortAudio() and the end of each burst is reported by an eventfd instead of polling pidof()/kill().
+
       Below are the notes from portaudio version:
 
           The WSPR is 110.6 seconds long.  It starts a bit more than one second after the top-of-minute (https://swharden.com/software/FSKview/wspr/),
           so the first group of samples sent out are zero.  110.6 sec at 12000 samples per second is 1,327,200 samples (out of 1,440,000).
 
           gcc -g -Wall -o wav_output3 wav_output3.c
+
+      The WSPR audio is no longer read from 1470.wav - 1530.wav.  It is synthesized in memory (wspr.c).  So is the FT8 audio (ft8.c), which
+        used to be one of the three TST_NQ6B_DM12_*.wav files.
+
+      Each burst is started in two steps.  startWSPRData()/startFT8Data() is called about a second before the top of the minute (or FT8 slot)
+        and alsaplay.c pre-rolls silence so the first tone leaves the sound card WSPR_START_OFFSET_MS (FT8_START_OFFSET_MS) after it.  Then the
+        radio is keyed and sendWSPRData()/sendFT8Data() waits for the end of the burst.  The samples are scaled to the drive level (txgain.c)
+        before they are started, pulseaudio's volume is no longer touched.  The start error alsaplay.c measures is appended to
+        START_ERROR_FILENAME with a running histogram, one line per burst.
+
+      The 12 kHz mono audio is converted to the device's own rate and channels (resample.c) when it is made, so pulseaudio doesn't resample
+        it on the fly while the radio is keyed.  The default is AUDIO_DEVICE_RATE stereo, pulseaudio's default-sample-rate on the Pi.  It
+        can be changed with an audioFmt line in WSPRConfig (see readConfigFile() in twsprRPI.c), "audioFmt  12000  1" sends it unconverted.
+        The converted audio goes into audiocache.c's slots, mapped and locked once at startup, and is checked there before the radio is
+        keyed.  alsaplay.c plays it straight from the slot.
+
+      While a burst plays the program sleeps in reactor_wait() (reactor.c) on the alsaplay.c completion event, waking every
+        REACTOR_TICK_SEC seconds to update the display.
 */
 
 #include <stdio.h>
@@ -18,138 +39,302 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/types.h>
-#include <signal.h>
 #include "twsprRPI.h"
+#include "wspr.h"
+#include "ft8.h"
+#include "alsaplay.h"
 #include "getTempData.h"
-#include "pulseaudio.h"
+#include "txgain.h"
+#include "resample.h"
+#include "audiocache.h"
+#include "reactor.h"
+#include "wav_output3.h"
 
-int initializePortAudio( void );
+int initializePortAudio( const char *device );
 void terminatePortAudio( void );
-int sendWSPRData( char *filename, FILE* dupFile );
+int setAudioFormat( int rate, int channels );
+int prepareWSPRData( double toneHz, int txFreqHz );
+int startWSPRData( const struct timespec *topOfMinute );
+int sendWSPRData( FILE* dupFile );
+int startFT8Data( const struct timespec *topOfSlot, int txFreqHz );
 int sendFT8Data( FILE* dupFile );
+void stopAudioData( void );
 pid_t pidof(const char* name);
 
-int initializePortAudio( void ) {
-    // empty process, just satisfying the linker
-    return 0;
+static int toDeviceFormat( int slot, const short *samples, int numFrames, int rate );
+static int startAligned( int slot, const struct timespec *top, int offsetMs );
+static int waitForPlayback( char *what, char *detail, int checkTemperature, double *currentTemperature, FILE* dupFile );
+static double logStartError( int mode );
+
+static short synthSamples[WSPR_BUFFER_SAMPLES];    // 12 kHz mono from wspr.c or ft8.c, before toDeviceFormat()
+static double wsprToneHz = 0.0;
+static double wsprGainDb = 0.0;
+
+static int deviceRate = AUDIO_DEVICE_RATE;
+static int deviceChannels = AUDIO_DEVICE_CHANNELS;
+
+#define START_ERROR_FILENAME    "log_start_error.txt"
+#define START_ERROR_WSPR        0
+#define START_ERROR_FT8         1
+#define NUM_START_ERROR_BINS    12
+static const double startErrorBinMs[NUM_START_ERROR_BINS-1] = { -20.0, -10.0, -5.0, -2.0, -1.0, 0.0, 1.0, 2.0, 5.0, 10.0, 20.0 };  // bin edges
+static int startErrorHistogram[2][NUM_START_ERROR_BINS];
+
+//  Opens the sound device, adds its completion event to the reactor and maps the audio slots once for the life of the program.  The
+//      name dates back to wav_output2.c and portaudio.
+int initializePortAudio( const char *device ) {
+    if (alsaplay_open( device )) {
+        return -1;
+    }
+    if (reactor_add( REACTOR_AUDIO, alsaplay_eventFd() )) {
+        return -1;
+    }
+    return audiocache_open( deviceRate, deviceChannels );
 }
 
 
 void terminatePortAudio( void ) {
-    // empty process, just satisfying the linker
+    reactor_remove( REACTOR_AUDIO );
+    alsaplay_close();
+    audiocache_close();
+}
+
+
+//  The rate and channels the audio is converted to before it is sent.  Takes effect from the next prepareWSPRData()/startFT8Data().
+//      The audio slots are mapped again if the format changes.  Returns -1 (and leaves the format alone) if resample.c can't convert
+//      12 kHz to that rate.  The simulation build checks the format and then always sends 12 kHz mono.
+int setAudioFormat( int rate, int channels ) {
+    struct Resampler *rs;
+
+    if ((channels < 1) || (channels > 2)) {
+        printf("setAudioFormat() - %d channels not supported\n",channels);
+        return -1;
+    }
+    rs = resample_create( WSPR_SAMPLE_RATE, rate );
+    if (rs == (struct Resampler *)NULL) {
+        return -1;
+    }
+    resample_free( rs );
+#ifdef SIMULATION
+    rate = WSPR_SAMPLE_RATE;            // sim.c's alsaplay.c throws the audio away, converting it was most of a simulated day
+    channels = 1;
+#endif
+    deviceRate = rate;
+    deviceChannels = channels;
+    return audiocache_open( deviceRate, deviceChannels );
 }
 
 
-int sendWSPRData(char *filename, FILE* dupFile )
+//  Synthesize the beacon audio at the drive level for txFreqHz (txgain.c) and convert it to the device format in the WSPR slot.  Called
+//      before waiting for the top of the even minute so the cost is not in the Tx window, and so bad audio is caught before the radio is
+//      keyed.
+int prepareWSPRData( double toneHz, int txFreqHz ) {
+    unsigned char symbols[WSPR_NUM_SYMBOLS];
+    int numSamples;
+
+    audiocache_invalidate( AUDIOCACHE_WSPR );
+    if (wspr_encode( MY_CALLSIGN, MY_GRID, MY_POWER_DBM, symbols )) {
+        printf("prepareWSPRData() - unable to encode \"%s %s %d\"\n",MY_CALLSIGN,MY_GRID,MY_POWER_DBM);
+        return -1;
+    }
+    numSamples = wspr_synthesize( symbols, toneHz, synthSamples, WSPR_BUFFER_SAMPLES, WSPR_LEAD_IN_SAMPLES );
+    wsprToneHz = toneHz;
+    wsprGainDb = txgain_getDb( TXGAIN_WSPR, txFreqHz );
+    txgain_apply( synthSamples, numSamples, wsprGainDb );
+    return toDeviceFormat( AUDIOCACHE_WSPR, synthSamples, numSamples, WSPR_SAMPLE_RATE );
+}
+
+
+//  Starts the audio made in prepareWSPRData() so the first tone comes out WSPR_START_OFFSET_MS after topOfMinute.  Call it about a
+//      second early, see waitForTopOfEvenMinute().  sendWSPRData() then waits for it to finish.
+int startWSPRData( const struct timespec *topOfMinute ) {
+    return startAligned( AUDIOCACHE_WSPR, topOfMinute, WSPR_START_OFFSET_MS );
+}
+
+
+int sendWSPRData( FILE* dupFile )
 {
-    struct tm *info;
-    time_t rawtime;         // time_t is long integer
-    int curSec = 0;          // debug for display
-    char command[256];
-    pid_t thepid;
+    char detail[64];
+    double currentTemperature = 0.0;
+    double startErrorMs;
+    int iii;
+
+    sprintf(detail,"tone %.1lf Hz, %.1lf dB",wsprToneHz,wsprGainDb);
+    iii = waitForPlayback( "beacon", detail, 1, &currentTemperature, dupFile );
+    startErrorMs = logStartError( START_ERROR_WSPR );
+
+    printf("\rDone sending beacon (%.1lf Hz, %3.3lf F, start %+.1lf ms)                      \n",wsprToneHz,currentTemperature,startErrorMs);
+    fprintf(dupFile,"\rDone sending beacon (%.1lf Hz, %3.3lf F, start %+.1lf ms)                      \n",wsprToneHz,currentTemperature,startErrorMs);
+    return iii;
+}
+
+#define NUM_FT8_TONES  3
+static const double ft8ToneList[NUM_FT8_TONES] = { 900.0, 1400.0, 2040.0 };    // the frequencies of the old TST_NQ6B_DM12_*.wav files
+static int ft8ToneSelection = 0;
+static char ft8Detail[96];
+
+//  Synthesizes MY_FT8_MESSAGE (ft8.c) at the next audio frequency in the list, scales it to the drive level for txFreqHz, converts it to
+//      the device format in the FT8 slot and starts it so the signal comes out FT8_START_OFFSET_MS after topOfSlot.  Same timing as
+//      startWSPRData().  It's called before the radio is keyed, so bad audio never goes out.
+int startFT8Data( const struct timespec *topOfSlot, int txFreqHz ) {
+    unsigned char tones[FT8_NUM_SYMBOLS];
+    double toneHz = ft8ToneList[ ft8ToneSelection ];
+    double gainDb;
+    int numSamples;
+
+    ft8ToneSelection++;
+    if (ft8ToneSelection >= NUM_FT8_TONES ) { ft8ToneSelection = 0; }
+
+    audiocache_invalidate( AUDIOCACHE_FT8 );
+    if (ft8_encode( MY_FT8_MESSAGE, tones )) {
+        printf("startFT8Data() - unable to encode \"%s\"\n",MY_FT8_MESSAGE);
+        return -1;
+    }
+    numSamples = ft8_synthesize( tones, toneHz, FT8_SAMPLE_RATE, synthSamples, FT8_NUM_SAMPLES );
+    gainDb = txgain_getDb( TXGAIN_FT8, txFreqHz );
+    txgain_apply( synthSamples, numSamples, gainDb );
+    if (toDeviceFormat( AUDIOCACHE_FT8, synthSamples, numSamples, FT8_SAMPLE_RATE )) {
+        return -1;
+    }
+    sprintf(ft8Detail,"%s, %.0lf Hz, %.1lf dB",MY_FT8_MESSAGE,toneHz,gainDb);
+    return startAligned( AUDIOCACHE_FT8, topOfSlot, FT8_START_OFFSET_MS );
+}
+
+
+int sendFT8Data( FILE* dupFile ) {
     double currentTemperature;
+    double startErrorMs;
+    int iii;
 
-    //  Invoke aplay with the desired wav file
-    strcpy(command,"aplay --device pulse ");
-    strcat(command,filename);
-    strcat(command," &");
-    system(command);
-
-    //  wait 0.5 sec, try getting the pid.  If process not started then wait two seconds and try again.  If that fails then quit.
-    usleep(500000);
-    pulseAudioVolume( 0 );
-    thepid = pidof("aplay");
-    if (thepid == -1) {
-        usleep(2000000);
-        thepid = pidof("aplay");
-        if (thepid == -1) {
-            return -1;
+    iii = waitForPlayback( "FT8", ft8Detail, 0, &currentTemperature, dupFile );
+    audiocache_invalidate( AUDIOCACHE_FT8 );
+    startErrorMs = logStartError( START_ERROR_FT8 );
+    currentTemperature = getTempData();
+
+    printf("\rDone sending FT8 (%s, %3.3lf F, start %+.1lf ms)                      \n",ft8Detail,currentTemperature,startErrorMs);
+    fprintf(dupFile,"\rDone sending FT8 (%s, %3.3lf F, start %+.1lf ms)                      \n",ft8Detail,currentTemperature,startErrorMs);
+    return iii;
+}
+
+
+//  Cuts off a burst that was started but won't be sent, for example if keying the radio failed.
+void stopAudioData( void ) {
+    alsaplay_stop();
+    while (alsaplay_wait( 1000 ) == 0) { }
+    audiocache_invalidate( AUDIOCACHE_FT8 );
+}
+
+
+//  Converts mono samples[] at rate to deviceRate and deviceChannels in slot and checks the result (audiocache_commit()).  Returns -1 if
+//      it can't be converted or doesn't pass.
+static int toDeviceFormat( int slot, const short *samples, int numFrames, int rate ) {
+    long capacity, outFrames;
+    short *buffer = audiocache_buffer( slot, &capacity );
+
+    if (buffer == (short *)NULL) {
+        return -1;
+    }
+    if ((rate == deviceRate) && (deviceChannels == 1)) {
+        outFrames = (numFrames <= capacity) ? numFrames : -1;
+        if (outFrames > 0) {
+            memcpy( buffer, samples, numFrames*sizeof(short) );
         }
+    } else {
+        outFrames = resample_convertInto( samples, numFrames, rate, 1, buffer, capacity, deviceRate, deviceChannels );
+    }
+    if (outFrames < 0) {
+        printf("Unable to convert %d Hz audio to %d Hz, %d channels\n",rate,deviceRate,deviceChannels);
+        return -1;
+    }
+    return audiocache_commit( slot, outFrames, (struct AudioView *)NULL );
+}
+
+
+//  Starts the audio in slot, in place.
+static int startAligned( int slot, const struct timespec *top, int offsetMs ) {
+    struct timespec startTime = *top;
+    struct AudioView view;
+
+    if (audiocache_view( slot, &view )) {
+        return -1;
+    }
+    startTime.tv_sec += offsetMs/1000;
+    startTime.tv_nsec += (offsetMs%1000)*1000000L;
+    if (startTime.tv_nsec >= 1000000000L) {
+        startTime.tv_sec++;
+        startTime.tv_nsec -= 1000000000L;
     }
-    //printf("PID is %d\n",thepid);
+    return alsaplay_start( view.samples, view.numFrames, view.rate, view.channels, &startTime );
+}
 
-    //  aplay will quit on its own when two minute wav file is complete.  This loop waits for it.
-    while (kill(thepid,0) == 0) {           // see if pid is valid.  Invoking kill() with a signal of 0 does not check a signal but verifies the pid.
-        time( &rawtime );                   // rawtime is the number of seconds in the epoch (1/1/1970).  time() also returns the same value.
-        info = localtime( &rawtime );       // info is the structure giving seconds and minutes
-        if (curSec != info->tm_sec) {
-            curSec = info->tm_sec;
-            printf("\rSending beacon %02d %02d (pid %d, file %s) ",info->tm_min,curSec,thepid,filename);  fflush( (FILE *)NULL );
-            fprintf(dupFile,"\rSending beacon %02d %02d (pid %d, file %s) ",info->tm_min,curSec,thepid,filename);  fflush( (FILE *)dupFile );
+
+//  Sleeps on the alsaplay completion event, waking every REACTOR_TICK_SEC seconds to update the display.  Returns 0 when the burst is
+//      done, -1 on a playback error.  If the program is terminating the burst is cut off.
+static int waitForPlayback( char *what, char *detail, int checkTemperature, double *currentTemperature, FILE* dupFile ) {
+    struct timespec now, deadline;
+    struct tm tm, *info;
+    int result;
+
+    while (1) {
+        clock_gettime( CLOCK_REALTIME, &now );
+        info = localtime_r( &now.tv_sec, &tm );
+        printf("\rSending %s %02d %02d (%s) ",what,info->tm_min,info->tm_sec,detail);  fflush( (FILE *)NULL );
+        fprintf(dupFile,"\rSending %s %02d %02d (%s) ",what,info->tm_min,info->tm_sec,detail);  fflush( (FILE *)dupFile );
+        if ((checkTemperature) && (info->tm_sec == 30)) {   // at 30 seconds get the temperature.  Do it then because ds18b20 process writes a new value to the log
+            *currentTemperature = getTempData();            //      file at the top of each minute.  30 is a multiple of REACTOR_TICK_SEC.
         }
-        if (curSec == 30) {                         // at 30 seconds get the temperature.  Do it then because ds18b20 process writes a new value to the log
-            currentTemperature = getTempData();     //      file at the top of each minute.
+
+        reactor_nextTick( (struct timespec *)NULL, &deadline );
+        result = reactor_wait( &deadline, REACTOR_MASK(REACTOR_AUDIO) );
+        if (result == REACTOR_AUDIO) {
+            result = alsaplay_wait( 0 );                    // collects the completion event
+            if (result == 1) {
+                return 0;
+            } else if (result == -1) {
+                return -1;
+            }
+        } else if (result == -1) {
+            return -1;
         }
         if (terminate) {    // from twspr.c
-            break;
+            alsaplay_stop();
+            while (alsaplay_wait( 1000 ) == 0) { }
+            return 0;
         }
-        usleep(10000);
     }
-
-    printf("\rDone sending beacon (%s, %3.3lf F)                      \n",filename,currentTemperature);
-    fprintf(dupFile,"\rDone sending beacon (%s, %3.3lf F)                      \n",filename,currentTemperature);
-    return 0;
 }
 
-#define NUM_FT8_AUDIO_FILES  3
-static char ft8AudioFileList[NUM_FT8_AUDIO_FILES][64] = { "TST_NQ6B_DM12_900Hz.wav", "TST_NQ6B_DM12_1400Hz.wav", "TST_NQ6B_DM12_2040Hz.wav" };
-static int ft8AudioFileSelection = 0;
 
-int sendFT8Data( FILE* dupFile ) {
-    struct tm *info;
-    time_t rawtime;         // time_t is long integer
-    int curSec = 0;          // debug for display
-    char command[256];
-    pid_t thepid;
-    double currentTemperature;
-    char ft8AudioFile[256];
-
-    strcpy(ft8AudioFile, ft8AudioFileList[ ft8AudioFileSelection] );
-    ft8AudioFileSelection++;
-    if (ft8AudioFileSelection >= NUM_FT8_AUDIO_FILES ) { ft8AudioFileSelection = 0; }
-
-    //  Invoke aplay with the desired wav file
-    strcpy(command,"aplay --device pulse ");
-    strcat(command,ft8AudioFile);
-    strcat(command," &");
-    system(command);
-
-    //  Get the PID for while() loop below.  This block also verifies that aplay successfully started.
-    //      Wait 0.5 sec, try getting the pid.  If process not started then wait two seconds and try again.  If that fails then quit.
-    usleep(500000);
-    pulseAudioVolume( 1 );
-    thepid = pidof("aplay");
-    if (thepid == -1) {
-        usleep(2000000);
-        thepid = pidof("aplay");
-        if (thepid == -1) {
-            //printf("\n\nFailed to get PID\n\n");
-            return -1;
-        }
+//  Adds the start error of the burst that just ended to the histogram and appends a line to START_ERROR_FILENAME:
+//      "WSPR  <epoch>  <error ms>  <count per bin>".  The bins are split at startErrorBinMs[].  Returns the error in ms (0 if none).
+static double logStartError( int mode ) {
+    FILE *fptr;
+    double errorSec, errorMs;
+    int bin;
+
+    if (alsaplay_startError( &errorSec )) {
+        return 0.0;             // stopped before the signal started
     }
-    //printf("PID is %d\n",thepid);
-
-    //  aplay will quit on its own when 12 second wav file is complete.  This loop waits for it.
-    while (kill(thepid,0) == 0) {           // see if pid is valid.  Invoking kill() with a signal of 0 does not check a signal but verifies the pid.
-        time( &rawtime );                   // rawtime is the number of seconds in the epoch (1/1/1970).  time() also returns the same value.
-        info = localtime( &rawtime );       // info is the structure giving seconds and minutes
-        if (curSec != info->tm_sec) {
-            curSec = info->tm_sec;
-            printf("\rSending FT8 %02d %02d (pid %d, file %s) ",info->tm_min,curSec,thepid,ft8AudioFile);
-            fprintf(dupFile,"\rSending FT8 %02d %02d (pid %d, file %s) ",info->tm_min,curSec,thepid,ft8AudioFile);
-            fflush( (FILE *)NULL );
-        }
-        if (terminate) {
+    errorMs = errorSec*1000.0;
+    for (bin = 0; bin < NUM_START_ERROR_BINS-1; bin++) {
+        if (errorMs < startErrorBinMs[bin]) {
             break;
         }
-        usleep(10000);
     }
-    currentTemperature = getTempData();     
-    //printf("\r");
+    startErrorHistogram[mode][bin]++;
 
-    printf("\rDone sending FT8 (%s, %3.3lf F)                      \n",ft8AudioFile,currentTemperature);
-    fprintf(dupFile,"\rDone sending FT8 (%s, %3.3lf F)                      \n",ft8AudioFile,currentTemperature);
-    return 0;
+    fptr = fopen(START_ERROR_FILENAME,"at");
+    if (fptr == (FILE *)NULL) {
+        printf("Unable to open %s for append.\n",START_ERROR_FILENAME);
+        return errorMs;
+    }
+    fprintf(fptr,"%s  %ld  %+8.3lf ms  ",(mode == START_ERROR_WSPR) ? "WSPR" : "FT8 ",(long)time(NULL),errorMs);
+    for (bin = 0; bin < NUM_START_ERROR_BINS; bin++) {
+        fprintf(fptr," %4d",startErrorHistogram[mode][bin]);
+    }
+    fprintf(fptr,"\n");
+    fclose(fptr);
+    return errorMs;
 }
 
 
@@ -201,8 +386,13 @@ pid_t pidof(const char* name)
 /*
 int terminate = 0;
 int main(void) {
-    if (initializePortAudio() == -1) { return -1; }
-    int iii = sendWSPRData( "1500.wav", 1.0 );
+    struct timespec top;
+    if (initializePortAudio( "null" ) == -1) { return -1; }
+    if (prepareWSPRData( 1500.0, WSPR_15M )) { return -1; }
+    clock_gettime( CLOCK_REALTIME, &top );
+    top.tv_sec += 1;
+    if (startWSPRData( &top )) { return -1; }
+    int iii = sendWSPRData( stdout );
     if (iii) {
         printf("Error on sendWSPRData()\n");
     } else {
@@ -1,10 +1,18 @@
 #ifndef _WAV_OUTPUT3_H_
 #define _WAV_OUTPUT3_H_
 
-extern int initializePortAudio( void );
+#define AUDIO_DEVICE_RATE       44100   // the audio is converted to this before it is sent unless WSPRConfig says otherwise (audioFmt)
+#define AUDIO_DEVICE_CHANNELS   2
+
+extern int initializePortAudio( const char *device );
 extern void terminatePortAudio( void );
-extern int sendWSPRData( char *filename, FILE* dupFile );
+extern int setAudioFormat( int rate, int channels );
+extern int prepareWSPRData( double toneHz, int txFreqHz );
+extern int startWSPRData( const struct timespec *topOfMinute );
+extern int sendWSPRData( FILE* dupFile );
+extern int startFT8Data( const struct timespec *topOfSlot, int txFreqHz );
 extern int sendFT8Data( FILE* dupFile );
+extern void stopAudioData( void );
 extern pid_t pidof(const char* name);
 
 #endif
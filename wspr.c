@@ -0,0 +1,264 @@
+/*
+    wspr.c - generates the WSPR beacon audio in memory.  It replaces the seven 1470.wav - 1530.wav files that were made offline with wspr0.
+
+        wspr_encode() packs callsign, 4 character grid and power (dBm) into 50 bits, runs them through the K=32, r=1/2 convolutional
+            encoder, interleaves the 162 bits and merges them with the sync vector.  The result is 162 channel symbols, 0-3.
+        wspr_synthesize() turns the symbols into phase-continuous 4-FSK at 12000 samples per second.  Tone spacing is 12000/8192 Hz
+            (1.4648 Hz) and the tone frequency passed in is the center of the four tones, the same convention as the wav file names.
+
+    The encoding follows the WSPR protocol description by G4JNT and the wspr0/WSJT-X sources.
+
+    To run the golden test stand-alone:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o wspr wspr.c -lm
+        - run it from the directory containing 1500.wav.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "wspr.h"
+
+#define AMPLITUDE   32767.0         // full scale, same as the wspr0 files
+
+int wspr_encode( const char *callsign, const char *grid, int powerdBm, unsigned char *symbols );
+int wspr_synthesize( const unsigned char *symbols, double toneHz, short *samples, int numSamples, int leadInSamples );
+short *wspr_generate( const char *callsign, const char *grid, int powerdBm, double toneHz, int *numSamples );
+
+static int charValue( char ccc );
+static int parity( unsigned int value );
+
+const unsigned char wspr_syncVector[ WSPR_NUM_SYMBOLS ] = {       // also used by wsprdecode.c
+    1,1,0,0,0,0,0,0,1,0,0,0,1,1,1,0,0,0,1,0,0,1,0,1,1,1,1,0,0,0,0,0,0,0,1,0,0,1,0,1,0,0,0,0,0,0,1,0,
+    1,1,0,0,1,1,0,1,0,0,0,1,1,0,1,0,0,0,0,1,1,0,1,0,1,0,1,0,1,0,0,1,0,0,1,0,1,1,0,0,0,1,1,0,1,0,1,0,
+    0,0,1,0,0,0,0,0,1,0,0,1,0,0,1,1,1,0,1,1,0,0,1,1,0,1,0,0,0,1,1,1,0,0,0,0,0,1,0,1,0,0,1,1,0,0,0,0,
+    0,0,0,1,1,0,1,0,1,1,0,0,0,1,1,0,0,0 };
+
+
+//  Fills symbols[] (WSPR_NUM_SYMBOLS long) with the channel symbols for a type 1 message, "NQ6B DM12 37".  Returns 0 on success, -1 if the
+//      callsign, grid or power can't be encoded.  The inputs are not modified.
+int wspr_encode( const char *callsign, const char *grid, int powerdBm, unsigned char *symbols ) {
+    char call[7];
+    unsigned int nCall, nGrid;
+    unsigned char packed[11];
+    unsigned char convBits[ WSPR_NUM_SYMBOLS ];
+    unsigned int reg;
+    int iii, jjj, len, numBits;
+
+    //  The third character of the callsign must be a digit.  If it's not ("K1ABC") then pad with a leading space (" K1ABC").  Pad to 6 characters.
+    len = strlen(callsign);
+    if ((len < 3) || (len > 6)) { return -1; }
+    memset(call, ' ', 6);
+    call[6] = 0;
+    if (isdigit((unsigned char)callsign[2])) {
+        memcpy(call, callsign, len);
+    } else {
+        if (len > 5) { return -1; }
+        memcpy(&call[1], callsign, len);
+    }
+    for (iii = 0; iii < 6; iii++) { call[iii] = toupper((unsigned char)call[iii]); }
+    if (!isdigit((unsigned char)call[2])) { return -1; }
+    for (iii = 3; iii < 6; iii++) {
+        if ((call[iii] != ' ') && !isupper((unsigned char)call[iii])) { return -1; }   // last three are letters or space
+    }
+
+    nCall = charValue(call[0]);
+    nCall = nCall*36 + charValue(call[1]);
+    nCall = nCall*10 + charValue(call[2]);
+    nCall = nCall*27 + charValue(call[3]) - 10;
+    nCall = nCall*27 + charValue(call[4]) - 10;
+    nCall = nCall*27 + charValue(call[5]) - 10;
+
+    //  Grid and power.  Only the 4 character grid square goes in a type 1 message.
+    if ((strlen(grid) < 4) || (powerdBm < 0) || (powerdBm > 60)) { return -1; }
+    if ((toupper((unsigned char)grid[0]) < 'A') || (toupper((unsigned char)grid[0]) > 'R')) { return -1; }
+    if ((toupper((unsigned char)grid[1]) < 'A') || (toupper((unsigned char)grid[1]) > 'R')) { return -1; }
+    if (!isdigit((unsigned char)grid[2]) || !isdigit((unsigned char)grid[3])) { return -1; }
+    nGrid = (179 - 10*(toupper((unsigned char)grid[0])-'A') - (grid[2]-'0'))*180 + 10*(toupper((unsigned char)grid[1])-'A') + (grid[3]-'0');
+    nGrid = nGrid*128 + powerdBm + 64;
+
+    //  28 bits of callsign and 22 bits of grid/power, MSB first, followed by zeros to flush the encoder.
+    memset(packed, 0, sizeof(packed));
+    packed[0] = (nCall >> 20) & 0xff;
+    packed[1] = (nCall >> 12) & 0xff;
+    packed[2] = (nCall >> 4) & 0xff;
+    packed[3] = ((nCall & 0x0f) << 4) | ((nGrid >> 18) & 0x0f);
+    packed[4] = (nGrid >> 10) & 0xff;
+    packed[5] = (nGrid >> 2) & 0xff;
+    packed[6] = (nGrid & 0x03) << 6;
+
+    //  Convolutional encoder, 81 bits in (50 data + 31 tail), 162 bits out.
+    reg = 0;
+    numBits = 0;
+    for (iii = 0; iii < 81; iii++) {
+        reg = (reg << 1) | ((packed[iii/8] >> (7 - (iii%8))) & 1);
+        convBits[numBits++] = parity(reg & WSPR_POLY1);
+        convBits[numBits++] = parity(reg & WSPR_POLY2);
+    }
+
+    //  Interleave by bit-reversed address and merge with the sync vector.  The data bit is the MSB of the symbol.
+    jjj = 0;
+    for (iii = 0; iii < 256; iii++) {
+        int rev = 0;
+        for (int kkk = 0; kkk < 8; kkk++) {
+            if (iii & (1 << kkk)) { rev |= 0x80 >> kkk; }
+        }
+        if (rev < WSPR_NUM_SYMBOLS) {
+            symbols[rev] = wspr_syncVector[rev] + 2*convBits[jjj++];
+        }
+    }
+    return 0;
+}
+
+
+//  Writes leadInSamples of silence followed by the 162 symbols into samples[].  The phase is carried from one symbol to the next so there are
+//      no discontinuities (a discontinuity is a spur).  Anything in samples[] past the end of the message is zeroed.  Returns the number of
+//      samples written, including the lead in, or -1 if samples[] is too short.
+int wspr_synthesize( const unsigned char *symbols, double toneHz, short *samples, int numSamples, int leadInSamples ) {
+    double phase = 0.0;
+    int iii, jjj, nnn;
+
+    if (numSamples < leadInSamples + WSPR_NUM_SYMBOLS*WSPR_SAMPLES_PER_SYMBOL) {
+        return -1;
+    }
+
+    memset(samples, 0, numSamples*sizeof(short));
+    nnn = leadInSamples;
+    for (iii = 0; iii < WSPR_NUM_SYMBOLS; iii++) {
+        double dphase = 2.0*M_PI*(toneHz + ((double)symbols[iii] - 1.5)*WSPR_TONE_SPACING)/WSPR_SAMPLE_RATE;
+        for (jjj = 0; jjj < WSPR_SAMPLES_PER_SYMBOL; jjj++) {
+            samples[nnn++] = (short)lrint(AMPLITUDE*sin(phase));
+            phase += dphase;
+        }
+        phase = fmod(phase, 2.0*M_PI);          // keep the phase small so sin() doesn't lose precision over 110 seconds
+    }
+    return nnn;
+}
+
+
+//  Convenience function - encode and synthesize into a newly allocated buffer of WSPR_BUFFER_SAMPLES.  Caller frees it.  Returns NULL on error.
+short *wspr_generate( const char *callsign, const char *grid, int powerdBm, double toneHz, int *numSamples ) {
+    unsigned char symbols[ WSPR_NUM_SYMBOLS ];
+    short *samples;
+
+    if (wspr_encode( callsign, grid, powerdBm, symbols )) {
+        printf("wspr_generate() - unable to encode \"%s %s %d\"\n", callsign, grid, powerdBm);
+        return (short *)NULL;
+    }
+    samples = (short *)malloc( WSPR_BUFFER_SAMPLES*sizeof(short) );
+    if (samples == (short *)NULL) {
+        printf("wspr_generate() - Error in malloc()\n");
+        return (short *)NULL;
+    }
+    *numSamples = wspr_synthesize( symbols, toneHz, samples, WSPR_BUFFER_SAMPLES, WSPR_LEAD_IN_SAMPLES );
+    return samples;
+}
+
+
+//  0-9 are 0-9, A-Z are 10-35 and space is 36
+static int charValue( char ccc ) {
+    if (isdigit((unsigned char)ccc)) { return ccc - '0'; }
+    if (isupper((unsigned char)ccc)) { return ccc - 'A' + 10; }
+    return 36;
+}
+
+
+static int parity( unsigned int value ) {
+    value ^= value >> 16;
+    value ^= value >> 8;
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+
+
+//  Golden test - synthesize "NQ6B DM12 37" at 1500 Hz and compare it against 1500.wav from wspr0.
+//      The wspr0 file has 15806 samples of silence, one stray symbol on tone 3, then the 162 symbols beginning at sample 23998, and
+//      tone 0 from the end of the message to the end of the file.  wspr0 also computed its symbol boundaries in single precision so some
+//      of them land one sample late.  So this is not a sample-for-sample compare.  For each symbol it correlates both signals against
+//      the four tones and checks that:
+//          - both pick the same tone,
+//          - the amplitudes agree within 1%,
+//          - the phase difference between the two is the same for every symbol to within 0.01 radian (phase continuity).
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#define GOLDEN_FILE         "1500.wav"
+#define GOLDEN_MSG_START    23998
+#define GOLDEN_EDGE         8           // skip this many samples at each end of a symbol, that's where wspr0 boundaries wander
+
+static void correlate( const short *samples, double freq, double *re, double *im ) {
+    *re = *im = 0.0;
+    for (int nnn = GOLDEN_EDGE; nnn < WSPR_SAMPLES_PER_SYMBOL-GOLDEN_EDGE; nnn++) {
+        double phase = 2.0*M_PI*freq*nnn/WSPR_SAMPLE_RATE;
+        *re += samples[nnn]*cos(phase);
+        *im -= samples[nnn]*sin(phase);
+    }
+}
+
+int main() {
+    FILE *fptr;
+    short *golden, *synth;
+    unsigned char symbols[ WSPR_NUM_SYMBOLS ];
+    long fileSize;
+    int numSamples, errors = 0;
+    double firstPhase = 0.0, worstPhase = 0.0, worstAmp = 0.0;
+
+    fptr = fopen(GOLDEN_FILE,"rb");
+    if (fptr == (FILE *)NULL) { printf("Unable to open %s\n",GOLDEN_FILE); return 1; }
+    fseek(fptr, 0, SEEK_END);
+    fileSize = ftell(fptr);
+    fseek(fptr, 44, SEEK_SET);                      // wspr0 writes a plain 44 byte header
+    golden = (short *)malloc(fileSize);
+    if (fread(golden, 1, fileSize-44, fptr) != fileSize-44) { printf("Error reading %s\n",GOLDEN_FILE); return 1; }
+    fclose(fptr);
+
+    if (wspr_encode( "NQ6B", "DM12", 37, symbols )) { printf("Encode failed\n"); return 1; }
+    synth = wspr_generate( "NQ6B", "DM12", 37, 1500.0, &numSamples );
+    if (synth == (short *)NULL) { return 1; }
+    if (numSamples != WSPR_BUFFER_SAMPLES) { printf("Wrong length %d\n",numSamples); errors++; }
+    for (int nnn = 0; nnn < WSPR_LEAD_IN_SAMPLES; nnn++) {
+        if (synth[nnn] != 0) { printf("Lead in not silent at %d\n",nnn); errors++; break; }
+    }
+
+    for (int iii = 0; iii < WSPR_NUM_SYMBOLS; iii++) {
+        const short *gg = &golden[ GOLDEN_MSG_START + iii*WSPR_SAMPLES_PER_SYMBOL ];
+        const short *ss = &synth[ WSPR_LEAD_IN_SAMPLES + iii*WSPR_SAMPLES_PER_SYMBOL ];
+        double gPower[4], sPower[4], gRe = 0, gIm = 0, sRe = 0, sIm = 0;
+        int gTone = 0, sTone = 0;
+
+        for (int ttt = 0; ttt < 4; ttt++) {
+            double freq = 1500.0 + (ttt - 1.5)*WSPR_TONE_SPACING, re, im;
+            correlate( gg, freq, &re, &im );   gPower[ttt] = re*re + im*im;
+            if (ttt == symbols[iii]) { gRe = re; gIm = im; }
+            correlate( ss, freq, &re, &im );   sPower[ttt] = re*re + im*im;
+            if (ttt == symbols[iii]) { sRe = re; sIm = im; }
+            if (gPower[ttt] > gPower[gTone]) { gTone = ttt; }
+            if (sPower[ttt] > sPower[sTone]) { sTone = ttt; }
+        }
+        if ((gTone != symbols[iii]) || (sTone != symbols[iii])) {
+            printf("Symbol %d: expected %d, golden %d, synthesized %d\n", iii, symbols[iii], gTone, sTone);
+            errors++;
+        }
+
+        double amp = sqrt(sPower[sTone]/gPower[gTone]);
+        double phase = atan2(sIm, sRe) - atan2(gIm, gRe);
+        if (iii == 0) { firstPhase = phase; }
+        phase = remainder(phase - firstPhase, 2.0*M_PI);
+        if (fabs(amp-1.0) > worstAmp) { worstAmp = fabs(amp-1.0); }
+        if (fabs(phase) > worstPhase) { worstPhase = fabs(phase); }
+    }
+    if (worstAmp > 0.01) { printf("Amplitude error %.4lf\n",worstAmp); errors++; }
+    if (worstPhase > 0.01) { printf("Phase error %.4lf rad\n",worstPhase); errors++; }
+
+    printf("%s: %d symbols, worst amplitude error %.5lf, worst phase error %.5lf rad - %s\n", GOLDEN_FILE, WSPR_NUM_SYMBOLS,
+           worstAmp, worstPhase, errors ? "FAIL" : "PASS");
+    free(golden);
+    free(synth);
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _WSPR_H_
+#define _WSPR_H_
+
+#define WSPR_SAMPLE_RATE        12000
+#define WSPR_NUM_SYMBOLS        162
+#define WSPR_SAMPLES_PER_SYMBOL 8192                                        // 0.6827 sec per symbol, 110.6 sec for the whole message
+#define WSPR_TONE_SPACING       ((double)WSPR_SAMPLE_RATE/WSPR_SAMPLES_PER_SYMBOL)  // 1.4648 Hz
+#define WSPR_LEAD_IN_SAMPLES    WSPR_SAMPLE_RATE                            // one second of silence, signal starts a bit more than one second after top-of-minute
+#define WSPR_BUFFER_SAMPLES     (WSPR_LEAD_IN_SAMPLES + WSPR_NUM_SYMBOLS*WSPR_SAMPLES_PER_SYMBOL)
+#define WSPR_POLY1              0xF2D05351                                  // convolutional code polynomials, K=32, r=1/2
+#define WSPR_POLY2              0xE4613C47
+
+extern const unsigned char wspr_syncVector[ WSPR_NUM_SYMBOLS ];
+
+extern int wspr_encode( const char *callsign, const char *grid, int powerdBm, unsigned char *symbols );
+extern int wspr_synthesize( const unsigned char *symbols, double toneHz, short *samples, int numSamples, int leadInSamples );
+extern short *wspr_generate( const char *callsign, const char *grid, int powerdBm, double toneHz, int *numSamples );
+
+#endif
@@ -0,0 +1,730 @@
+/*
+    wsprdecode.c - decodes WSPR-2 from a 12 kHz recording of the receiver's audio.  Up to now the only way to find out what was heard was to
+        wait for the spots to show up on wsprnet.org (doCurl() in wsprnet.c).  This does the same job as wsprd from WSJT-X, in the same order,
+        but without the second pass (signal subtraction) and only for type 1 messages ("K1ABC FN42 37").  Type 2 and 3 messages (compound
+        and hashed callsigns) are thrown away.
+
+        1. Down convert.  One big FFT of the recording (2^21 points), keep the bins within 187.5 Hz of WSPRDECODE_CENTER_HZ and inverse
+           FFT them.  That is complex baseband at 375 samples per second, 256 samples per symbol.
+        2. Candidates.  512 point FFTs every half symbol (a spectrogram with 0.73 Hz bins, two bins per tone) averaged over the whole two
+           minutes and summed over 7 bins.  The noise is the 30th percentile of that across the 300 Hz searched.  Every local peak more
+           than -35 dB (in 2500 Hz) is a candidate.
+        3. Coarse sync.  For each candidate try every start time (half symbol steps), +/-1.5 Hz and -4 to +4 Hz of drift over the
+           message against the sync vector in the spectrogram.
+        4. Fine sync.  Correlate the baseband against the four tones of every symbol and refine start time, frequency and drift.
+        5. Soft symbols.  The data bit of each symbol is tone 2 or 3 against tone 0 or 1, so the difference of their amplitudes, scaled
+           to -127..127 and deinterleaved.
+        6. Fano (sequential) decoder for the K=32, r=1/2 convolutional code, with a metric table made from the soft symbols' own
+           spread.  50 data bits and 31 tail bits that must be zero.
+        7. Unpack and keep the best of any duplicates.
+
+        Steps 3-7 are independent for each candidate and are spread over threadpool.c's workers.  Call threadpool_open() first to use
+        more than the calling thread.
+
+    To run the regression test and benchmark on 1470.wav - 1530.wav:
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o wsprdecode wsprdecode.c wspr.c fft.c threadpool.c -lm -pthread
+        - run it from the directory containing the wav files.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wspr.h"
+#include "fft.h"
+#include "threadpool.h"
+#include "wsprdecode.h"
+
+#define DECIMATION          32
+#define BASE_RATE           ((double)WSPR_SAMPLE_RATE/DECIMATION)      // 375 Hz
+#define BIG_FFT_SIZE        (1 << 21)                                   // > 120 seconds at 12 kHz
+#define BASE_FFT_SIZE       (BIG_FFT_SIZE/DECIMATION)
+#define BASE_SPS            (WSPR_SAMPLES_PER_SYMBOL/DECIMATION)        // 256
+#define SPEC_FFT_SIZE       (2*BASE_SPS)                                // 0.73 Hz bins, half the tone spacing
+#define SPEC_STEP           (BASE_SPS/2)
+#define SPEC_BIN_HZ         (BASE_RATE/SPEC_FFT_SIZE)
+#define SEARCH_BINS         205                                         // +/-150 Hz
+#define NOISE_PERCENTILE    0.30
+#define SNR_OFFSET_DB       26.9                                        // 7 bins of 0.73 Hz to 2500 Hz
+#define MIN_SNR_RATIO       0.158                                       // -8 dB in the 7 bin sum, -35 dB in 2500 Hz
+#define MAX_CANDIDATES      200
+#define MIN_COARSE_SYNC     0.10
+#define MIN_FINE_SYNC       0.12
+#define MAX_DRIFT_HZ        4
+#define START_SEC           1.0                                         // dt = 0 is a signal starting here
+
+#define FANO_BITS           81                                          // 50 data + 31 tail
+#define FANO_DATA_BITS      50
+#define FANO_DELTA          40
+#define FANO_MAX_CYCLES     10000                                       // per bit
+#define METRIC_SCALE        10.0
+#define METRIC_BIAS         0.5                                         // the code rate
+#define SOFT_SCALE          50.0                                        // rms of the soft symbols
+
+struct Candidate {
+    int bin;                // spectrogram bin of the center of the four tones, SPEC_FFT_SIZE/2 is WSPRDECODE_CENTER_HZ
+    double snr;
+    int lag;                // spectrogram column of symbol 0
+    double freq;            // Hz from WSPRDECODE_CENTER_HZ
+    double drift;
+    double sync;
+};
+
+struct DecodeJob {
+    const struct Complex *base;         // baseband, read only while the job runs
+    int numBase;
+    const float *spectrogram;           // [column][SPEC_FFT_SIZE], 0 Hz in the middle
+    int numColumns;
+    struct Candidate *candidates;
+    struct WsprDecode *results;         // one per candidate
+    int *decoded;                       // 1 if results[] is good
+};
+
+int wsprdecode_decode( const short *samples, int numSamples, struct WsprDecode *decodes, int maxDecodes );
+
+static struct Complex *downconvert( const short *samples, int numSamples, int *numBase );
+static float *makeSpectrogram( const struct Complex *base, int numBase, int *numColumns );
+static int findCandidates( const float *spectrogram, int numColumns, struct Candidate *candidates );
+static void decodeCandidate( void *arg, int index );
+static void coarseSync( const float *spectrogram, int numColumns, struct Candidate *cand );
+static double demodulate( const struct Complex *base, int numBase, int start, double freq, double drift, double amps[][4] );
+static int fanoDecode( const signed char *soft, unsigned char *bits, int *cycles );
+static int unpack( const unsigned char *bits, struct WsprDecode *decode );
+static int compareFloat( const void *aaa, const void *bbb );
+static int compareCandidate( const void *aaa, const void *bbb );
+static int parity( unsigned int value );
+
+
+//  Decodes numSamples (at most WSPRDECODE_MAX_SAMPLES) of 12 kHz audio starting at the even minute.  Fills decodes[] and returns the
+//      number found, strongest first, or -1 on error.
+int wsprdecode_decode( const short *samples, int numSamples, struct WsprDecode *decodes, int maxDecodes ) {
+    struct Candidate *candidates;
+    struct Complex *base;
+    struct DecodeJob job;
+    float *spectrogram;
+    int numBase, numColumns, numCandidates, numDecodes = 0;
+
+    if (numSamples > WSPRDECODE_MAX_SAMPLES) {
+        numSamples = WSPRDECODE_MAX_SAMPLES;
+    }
+    base = downconvert( samples, numSamples, &numBase );
+    if (base == (struct Complex *)NULL) {
+        return -1;
+    }
+    spectrogram = makeSpectrogram( base, numBase, &numColumns );
+    candidates = (struct Candidate *)malloc( MAX_CANDIDATES*sizeof(struct Candidate) );
+    job.results = (struct WsprDecode *)malloc( MAX_CANDIDATES*sizeof(struct WsprDecode) );
+    job.decoded = (int *)calloc( MAX_CANDIDATES, sizeof(int) );
+    if ((spectrogram == (float *)NULL) || (candidates == (struct Candidate *)NULL) || (job.results == (struct WsprDecode *)NULL) ||
+        (job.decoded == (int *)NULL)) {
+        printf("wsprdecode_decode() - Error in malloc()\n");
+        free( base );
+        free( spectrogram );
+        free( candidates );
+        free( job.results );
+        free( job.decoded );
+        return -1;
+    }
+    numCandidates = findCandidates( spectrogram, numColumns, candidates );
+
+    job.base = base;
+    job.numBase = numBase;
+    job.spectrogram = spectrogram;
+    job.numColumns = numColumns;
+    job.candidates = candidates;
+    threadpool_run( decodeCandidate, &job, numCandidates );
+
+    //  Candidates are in order of strength, so the first of any duplicates is the one to keep.
+    for (int iii = 0; iii < numCandidates; iii++) {
+        int dup = 0;
+        if (!job.decoded[iii]) {
+            continue;
+        }
+        for (int jjj = 0; jjj < numDecodes; jjj++) {
+            if (!strcmp( decodes[jjj].callsign, job.results[iii].callsign ) && !strcmp( decodes[jjj].grid, job.results[iii].grid ) &&
+                (decodes[jjj].powerDbm == job.results[iii].powerDbm)) {
+                dup = 1;
+                break;
+            }
+        }
+        if (!dup && (numDecodes < maxDecodes)) {
+            decodes[numDecodes++] = job.results[iii];
+        }
+    }
+
+    free( base );
+    free( spectrogram );
+    free( candidates );
+    free( job.results );
+    free( job.decoded );
+    return numDecodes;
+}
+
+
+//  Complex baseband at BASE_RATE, WSPRDECODE_CENTER_HZ at 0 Hz.  Caller frees.
+static struct Complex *downconvert( const short *samples, int numSamples, int *numBase ) {
+    static struct FFTPlan *bigPlan = (struct FFTPlan *)NULL;       // kept, they take a while to make
+    static struct FFTPlan *basePlan = (struct FFTPlan *)NULL;
+    int centerBin = (int)lround( WSPRDECODE_CENTER_HZ*BIG_FFT_SIZE/WSPR_SAMPLE_RATE );
+    struct Complex *big, *base;
+
+    if (bigPlan == (struct FFTPlan *)NULL) {
+        bigPlan = fft_plan( BIG_FFT_SIZE );
+        basePlan = fft_plan( BASE_FFT_SIZE );
+        if ((bigPlan == (struct FFTPlan *)NULL) || (basePlan == (struct FFTPlan *)NULL)) {
+            return (struct Complex *)NULL;
+        }
+    }
+    big = (struct Complex *)calloc( BIG_FFT_SIZE, sizeof(struct Complex) );
+    base = (struct Complex *)malloc( BASE_FFT_SIZE*sizeof(struct Complex) );
+    if ((big == (struct Complex *)NULL) || (base == (struct Complex *)NULL)) {
+        printf("wsprdecode_decode() - Error in malloc()\n");
+        free( big );
+        free( base );
+        return (struct Complex *)NULL;
+    }
+    for (int iii = 0; iii < numSamples; iii++) {
+        big[iii].re = samples[iii]/32768.0;
+    }
+    fft_forward( bigPlan, big );
+    for (int iii = 0; iii < BASE_FFT_SIZE; iii++) {
+        int bin = (iii < BASE_FFT_SIZE/2) ? centerBin + iii : centerBin + iii - BASE_FFT_SIZE;
+        base[iii].re = big[bin].re/BASE_FFT_SIZE;
+        base[iii].im = big[bin].im/BASE_FFT_SIZE;
+    }
+    free( big );
+    fft_inverse( basePlan, base );
+    *numBase = numSamples/DECIMATION;
+    return base;
+}
+
+
+//  Power in SPEC_FFT_SIZE bins every SPEC_STEP samples, with a sine window.  Bins are rotated so 0 Hz is SPEC_FFT_SIZE/2.
+static float *makeSpectrogram( const struct Complex *base, int numBase, int *numColumns ) {
+    struct FFTPlan *plan = fft_plan( SPEC_FFT_SIZE );
+    struct Complex buf[SPEC_FFT_SIZE];
+    double window[SPEC_FFT_SIZE];
+    float *spectrogram;
+    int columns = (numBase - SPEC_FFT_SIZE)/SPEC_STEP + 1;
+
+    *numColumns = 0;
+    if ((plan == (struct FFTPlan *)NULL) || (columns < 2*WSPR_NUM_SYMBOLS)) {
+        fft_freePlan( plan );
+        return (float *)NULL;
+    }
+    spectrogram = (float *)malloc( columns*SPEC_FFT_SIZE*sizeof(float) );
+    if (spectrogram == (float *)NULL) {
+        fft_freePlan( plan );
+        return (float *)NULL;
+    }
+    for (int iii = 0; iii < SPEC_FFT_SIZE; iii++) {
+        window[iii] = sin( M_PI*iii/(SPEC_FFT_SIZE - 1) );
+    }
+    for (int col = 0; col < columns; col++) {
+        for (int iii = 0; iii < SPEC_FFT_SIZE; iii++) {
+            buf[iii].re = base[col*SPEC_STEP + iii].re*window[iii];
+            buf[iii].im = base[col*SPEC_STEP + iii].im*window[iii];
+        }
+        fft_forward( plan, buf );
+        for (int iii = 0; iii < SPEC_FFT_SIZE; iii++) {
+            int bin = (iii + SPEC_FFT_SIZE/2) % SPEC_FFT_SIZE;
+            spectrogram[col*SPEC_FFT_SIZE + bin] = buf[iii].re*buf[iii].re + buf[iii].im*buf[iii].im;
+        }
+    }
+    fft_freePlan( plan );
+    *numColumns = columns;
+    return spectrogram;
+}
+
+
+//  Peaks in the average spectrum, strongest first.  Returns how many.
+static int findCandidates( const float *spectrogram, int numColumns, struct Candidate *candidates ) {
+    double average[SPEC_FFT_SIZE], smooth[SPEC_FFT_SIZE];
+    float sorted[2*SEARCH_BINS+1];
+    double noise;
+    int lo = SPEC_FFT_SIZE/2 - SEARCH_BINS, hi = SPEC_FFT_SIZE/2 + SEARCH_BINS;
+    int numCandidates = 0;
+
+    for (int bin = 0; bin < SPEC_FFT_SIZE; bin++) {
+        average[bin] = 0.0;
+        for (int col = 0; col < numColumns; col++) {
+            average[bin] += spectrogram[col*SPEC_FFT_SIZE + bin];
+        }
+        average[bin] /= numColumns;
+    }
+    for (int bin = lo; bin <= hi; bin++) {
+        smooth[bin] = 0.0;
+        for (int jjj = -3; jjj <= 3; jjj++) {
+            smooth[bin] += average[bin + jjj];
+        }
+        sorted[bin - lo] = smooth[bin];
+    }
+    qsort( sorted, hi - lo + 1, sizeof(float), compareFloat );
+    noise = sorted[ (int)(NOISE_PERCENTILE*(hi - lo)) ];
+    if (noise <= 0.0) {
+        return 0;               // silence
+    }
+
+    for (int bin = lo+1; bin < hi; bin++) {
+        double ratio = smooth[bin]/noise - 1.0;
+        if ((smooth[bin] > smooth[bin-1]) && (smooth[bin] >= smooth[bin+1]) && (ratio > MIN_SNR_RATIO) && (numCandidates < MAX_CANDIDATES)) {
+            candidates[numCandidates].bin = bin;
+            candidates[numCandidates].snr = 10.0*log10( ratio ) - SNR_OFFSET_DB;
+            numCandidates++;
+        }
+    }
+    qsort( candidates, numCandidates, sizeof(struct Candidate), compareCandidate );
+    return numCandidates;
+}
+
+
+//  threadpool_run() callback, steps 3 to 7 for candidates[index].
+static void decodeCandidate( void *arg, int index ) {
+    struct DecodeJob *job = (struct DecodeJob *)arg;
+    struct Candidate *cand = &job->candidates[index];
+    double amps[WSPR_NUM_SYMBOLS][4];
+    double fsymb[WSPR_NUM_SYMBOLS];
+    signed char soft[WSPR_NUM_SYMBOLS];
+    unsigned char bits[FANO_BITS];
+    double sync, best, sumSquares = 0.0;
+    int start, bestStart, cycles, jjj;
+
+    job->decoded[index] = 0;
+    coarseSync( job->spectrogram, job->numColumns, cand );
+    if (cand->sync < MIN_COARSE_SYNC) {
+        return;
+    }
+
+    //  Fine sync.  Start time first (the coarse one is good to half a symbol), then frequency, drift and start time again.
+    bestStart = cand->lag*SPEC_STEP;
+    best = -1.0;
+    for (start = cand->lag*SPEC_STEP - SPEC_STEP; start <= cand->lag*SPEC_STEP + SPEC_STEP; start += 16) {
+        sync = demodulate( job->base, job->numBase, start, cand->freq, cand->drift, amps );
+        if (sync > best) { best = sync; bestStart = start; }
+    }
+    for (double df = -0.4, freq = cand->freq; df <= 0.401; df += 0.05) {
+        sync = demodulate( job->base, job->numBase, bestStart, freq + df, cand->drift, amps );
+        if (sync > best) { best = sync; cand->freq = freq + df; }
+    }
+    for (double dd = -0.5, drift = cand->drift; dd <= 0.501; dd += 0.25) {
+        sync = demodulate( job->base, job->numBase, bestStart, cand->freq, drift + dd, amps );
+        if (sync > best) { best = sync; cand->drift = drift + dd; }
+    }
+    for (start = bestStart - 16, jjj = bestStart + 16; start <= jjj; start += 2) {
+        sync = demodulate( job->base, job->numBase, start, cand->freq, cand->drift, amps );
+        if (sync > best) { best = sync; bestStart = start; }
+    }
+    cand->sync = demodulate( job->base, job->numBase, bestStart, cand->freq, cand->drift, amps );
+    if (cand->sync < MIN_FINE_SYNC) {
+        return;
+    }
+
+    //  Soft symbols.  The sync bit picks which pair of tones carries the data bit.
+    for (int kkk = 0; kkk < WSPR_NUM_SYMBOLS; kkk++) {
+        fsymb[kkk] = wspr_syncVector[kkk] ? (amps[kkk][3] - amps[kkk][1]) : (amps[kkk][2] - amps[kkk][0]);
+        sumSquares += fsymb[kkk]*fsymb[kkk];
+    }
+    if (sumSquares <= 0.0) {
+        return;
+    }
+    jjj = 0;
+    for (int iii = 0; iii < 256; iii++) {         // deinterleave, same bit-reversed addresses as wspr_encode()
+        int rev = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (iii & (1 << bit)) { rev |= 0x80 >> bit; }
+        }
+        if (rev < WSPR_NUM_SYMBOLS) {
+            double value = SOFT_SCALE*fsymb[rev]/sqrt( sumSquares/WSPR_NUM_SYMBOLS );
+            soft[jjj++] = (signed char)((value > 127.0) ? 127 : ((value < -127.0) ? -127 : lround( value )));
+        }
+    }
+
+    if (fanoDecode( soft, bits, &cycles )) {
+        return;
+    }
+    if (unpack( bits, &job->results[index] )) {
+        return;
+    }
+    job->results[index].freqHz = WSPRDECODE_CENTER_HZ + cand->freq;
+    job->results[index].snr = cand->snr;
+    job->results[index].dt = bestStart/BASE_RATE - START_SEC;
+    job->results[index].drift = cand->drift;
+    job->results[index].sync = cand->sync;
+    job->results[index].cycles = cycles;
+    job->decoded[index] = 1;
+}
+
+
+//  Best start column, frequency and drift for cand from the spectrogram.  The sync metric is the sum of (tones 1+3) - (tones 0+2) with
+//      the sign of the sync vector, over the sum of all four.  It's 1 for a perfect signal and about 0 for noise.
+static void coarseSync( const float *spectrogram, int numColumns, struct Candidate *cand ) {
+    int bestBin = cand->bin, bestLag = 0, bestDrift = 0;
+    double best = -1.0;
+    int minLag = -(int)(START_SEC*BASE_RATE/SPEC_STEP) - 2;
+    int maxLag = numColumns - 2*WSPR_NUM_SYMBOLS + 1;
+
+    for (int drift = -MAX_DRIFT_HZ; drift <= MAX_DRIFT_HZ; drift++) {
+        for (int bin = cand->bin - 2; bin <= cand->bin + 2; bin++) {
+            for (int lag = minLag; lag <= maxLag; lag++) {
+                double ss = 0.0, total = 0.0;
+                for (int kkk = 0; kkk < WSPR_NUM_SYMBOLS; kkk++) {
+                    int col = lag + 2*kkk;
+                    int center = bin + (int)lround( drift*(kkk - WSPR_NUM_SYMBOLS/2.0)/WSPR_NUM_SYMBOLS/SPEC_BIN_HZ );
+                    const float *ps;
+                    if ((col < 0) || (col >= numColumns) || (center < 3) || (center >= SPEC_FFT_SIZE - 3)) {
+                        continue;
+                    }
+                    ps = &spectrogram[col*SPEC_FFT_SIZE + center];
+                    ss += (2*wspr_syncVector[kkk] - 1)*((ps[-1] + ps[3]) - (ps[-3] + ps[1]));
+                    total += ps[-3] + ps[-1] + ps[1] + ps[3];
+                }
+                if ((total > 0.0) && (ss/total > best)) {
+                    best = ss/total;
+                    bestBin = bin;
+                    bestLag = lag;
+                    bestDrift = drift;
+                }
+            }
+        }
+    }
+    cand->lag = bestLag;
+    cand->freq = (bestBin - SPEC_FFT_SIZE/2)*SPEC_BIN_HZ;
+    cand->drift = bestDrift;
+    cand->sync = best;
+}
+
+
+//  Amplitude of each of the four tones of each symbol for a signal starting at base[start].  Returns the sync metric (as in coarseSync()
+//      but with amplitudes).  Symbols that fall outside the recording are zero.
+static double demodulate( const struct Complex *base, int numBase, int start, double freq, double drift, double amps[][4] ) {
+    double ss = 0.0, total = 0.0;
+
+    for (int kkk = 0; kkk < WSPR_NUM_SYMBOLS; kkk++) {
+        const struct Complex *xx = &base[start + kkk*BASE_SPS];
+        double fk = freq + drift*(kkk - WSPR_NUM_SYMBOLS/2.0)/WSPR_NUM_SYMBOLS;
+
+        if ((start + kkk*BASE_SPS < 0) || (start + (kkk+1)*BASE_SPS > numBase)) {
+            amps[kkk][0] = amps[kkk][1] = amps[kkk][2] = amps[kkk][3] = 0.0;
+            continue;
+        }
+        for (int tone = 0; tone < 4; tone++) {
+            double dphi = -2.0*M_PI*(fk + (tone - 1.5)*WSPR_TONE_SPACING)/BASE_RATE;
+            double wr = cos( dphi ), wi = sin( dphi );
+            double pr = 1.0, pi = 0.0, re = 0.0, im = 0.0, temp;
+            for (int nnn = 0; nnn < BASE_SPS; nnn++) {         // phasor recursion, 256 steps is too few to drift
+                re += xx[nnn].re*pr - xx[nnn].im*pi;
+                im += xx[nnn].re*pi + xx[nnn].im*pr;
+                temp = pr*wr - pi*wi;
+                pi = pr*wi + pi*wr;
+                pr = temp;
+            }
+            amps[kkk][tone] = sqrt( re*re + im*im );
+        }
+        ss += (2*wspr_syncVector[kkk] - 1)*((amps[kkk][1] + amps[kkk][3]) - (amps[kkk][0] + amps[kkk][2]));
+        total += amps[kkk][0] + amps[kkk][1] + amps[kkk][2] + amps[kkk][3];
+    }
+    return (total > 0.0) ? ss/total : 0.0;
+}
+
+
+//  Sequential decoder (Fano algorithm, after Phil Karn's fano.c).  soft[] is the 162 deinterleaved soft symbols, positive for a 1.  Fills
+//      bits[] with the 81 decoded bits and *cycles with the cycles per bit.  Returns 0, or -1 if it gave up.
+static int fanoDecode( const signed char *soft, unsigned char *bits, int *cycles ) {
+    struct FanoNode {
+        unsigned int state;     // encoder shift register, the bit for this node is the LSB once chosen
+        long gamma;             // path metric up to this node
+        int metrics[4];         // branch metric for each of the four encoder outputs
+        int tm[2];              // the two branch metrics, best first
+        int iii;                // which branch is being tried
+    } nodes[FANO_BITS + 1];
+    struct FanoNode *np;
+    int metric[2][256];
+    double mu = 0.0, var = 0.0;
+    long threshold = 0, ngamma;
+    long maxCycles = (long)FANO_MAX_CYCLES*FANO_BITS;
+    long count;
+
+    //  Metric table.  The soft symbols are +/-mu plus Gaussian noise.  The metric is log2 of the likelihood of the bit over the average of
+    //      both, less the code rate, so a path on the right track gains a little each bit and a wrong one falls fast.
+    for (int iii = 0; iii < WSPR_NUM_SYMBOLS; iii++) {
+        mu += abs( soft[iii] );
+        var += soft[iii]*soft[iii];
+    }
+    mu /= WSPR_NUM_SYMBOLS;
+    var = var/WSPR_NUM_SYMBOLS - mu*mu;
+    if (var < 1.0 + 0.01*mu*mu) {
+        var = 1.0 + 0.01*mu*mu;
+    }
+    for (int value = -128; value < 128; value++) {
+        double llr = 2.0*mu*value/var;
+        for (int bit = 0; bit < 2; bit++) {
+            double xx = bit ? -llr : llr;
+            double lg = (xx > 30.0) ? xx/M_LN2 : log2( 1.0 + exp( xx ) );
+            double mm = METRIC_SCALE*(1.0 - lg - METRIC_BIAS);
+            metric[bit][value + 128] = (mm < -1000.0) ? -1000 : (int)lround( mm );
+        }
+    }
+
+    for (int iii = 0; iii < FANO_BITS; iii++) {
+        int s0 = soft[2*iii] + 128, s1 = soft[2*iii+1] + 128;
+        nodes[iii].metrics[0] = metric[0][s0] + metric[0][s1];
+        nodes[iii].metrics[1] = metric[0][s0] + metric[1][s1];
+        nodes[iii].metrics[2] = metric[1][s0] + metric[0][s1];
+        nodes[iii].metrics[3] = metric[1][s0] + metric[1][s1];
+    }
+
+    //  Both polynomials have the LSB set, so a 1 in gives the complement of what a 0 in gives.
+#define ENCODE(state)   ((parity( (state) & WSPR_POLY1 ) << 1) | parity( (state) & WSPR_POLY2 ))
+    np = nodes;
+    np->state = 0;
+    np->gamma = 0;
+    {
+        int lsym = ENCODE( np->state );
+        int m0 = np->metrics[lsym], m1 = np->metrics[3 ^ lsym];
+        if (m0 > m1) { np->tm[0] = m0; np->tm[1] = m1; }
+        else { np->tm[0] = m1; np->tm[1] = m0; np->state++; }
+    }
+    np->iii = 0;
+
+    for (count = 1; count <= maxCycles; count++) {
+        ngamma = np->gamma + np->tm[np->iii];
+        if (ngamma >= threshold) {
+            //  Move forward.  On the first visit to this node tighten the threshold.
+            if (np->gamma < threshold + FANO_DELTA) {
+                while (ngamma >= threshold + FANO_DELTA) {
+                    threshold += FANO_DELTA;
+                }
+            }
+            np[1].gamma = ngamma;
+            np[1].state = np->state << 1;
+            if (++np == &nodes[FANO_BITS]) {
+                break;
+            }
+            {
+                int lsym = ENCODE( np->state );
+                if (np - nodes >= FANO_DATA_BITS) {
+                    np->tm[0] = np->metrics[lsym];     // tail, only a 0 is allowed
+                } else {
+                    int m0 = np->metrics[lsym], m1 = np->metrics[3 ^ lsym];
+                    if (m0 > m1) { np->tm[0] = m0; np->tm[1] = m1; }
+                    else { np->tm[0] = m1; np->tm[1] = m0; np->state++; }
+                }
+            }
+            np->iii = 0;
+            continue;
+        }
+        //  Threshold violated, look back.
+        for (;;) {
+            if ((np == nodes) || (np[-1].gamma < threshold)) {
+                //  Can't back up, loosen the threshold and start again from the best branch here.
+                threshold -= FANO_DELTA;
+                if (np->iii != 0) {
+                    np->iii = 0;
+                    np->state ^= 1;
+                }
+                break;
+            }
+            if ((--np - nodes < FANO_DATA_BITS) && (np->iii != 1)) {
+                np->iii++;              // try the other branch
+                np->state ^= 1;
+                break;
+            }
+        }
+    }
+#undef ENCODE
+
+    *cycles = count/FANO_BITS + 1;
+    if (count > maxCycles) {
+        return -1;
+    }
+    for (int iii = 0; iii < FANO_BITS; iii++) {
+        bits[iii] = nodes[iii].state & 1;
+    }
+    return 0;
+}
+
+
+//  50 bits to callsign, grid and power, the reverse of wspr_encode().  Returns -1 if it isn't a type 1 message.
+static int unpack( const unsigned char *bits, struct WsprDecode *decode ) {
+    static const char *firstChars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ ";
+    unsigned int nCall = 0, nGrid = 0, nnn;
+    int power, start;
+
+    for (int iii = 0; iii < 28; iii++) { nCall = (nCall << 1) | bits[iii]; }
+    for (int iii = 28; iii < 50; iii++) { nGrid = (nGrid << 1) | bits[iii]; }
+
+    if (nCall >= 37*36*10*27*27*27) {
+        return -1;
+    }
+    for (int iii = 5; iii >= 3; iii--) {
+        nnn = nCall % 27;
+        decode->callsign[iii] = (nnn == 26) ? ' ' : 'A' + nnn;
+        nCall /= 27;
+    }
+    decode->callsign[2] = '0' + nCall % 10;
+    nCall /= 10;
+    decode->callsign[1] = firstChars[ nCall % 36 ];
+    decode->callsign[0] = firstChars[ nCall / 36 ];
+    decode->callsign[6] = 0;
+    for (int iii = 3; iii < 5; iii++) {
+        if ((decode->callsign[iii] == ' ') && (decode->callsign[iii+1] != ' ')) { return -1; }
+    }
+    start = (decode->callsign[0] == ' ') ? 1 : 0;              // " K1ABC" -> "K1ABC"
+    memmove( decode->callsign, &decode->callsign[start], 7 - start );
+    for (int iii = strlen(decode->callsign) - 1; (iii >= 0) && (decode->callsign[iii] == ' '); iii--) {
+        decode->callsign[iii] = 0;
+    }
+
+    //  Powers that don't end in 0, 3 or 7 mean type 2 or 3.
+    power = (nGrid & 0x7F) - 64;
+    nGrid >>= 7;
+    if ((power < 0) || (power > 60) || ((power % 10 != 0) && (power % 10 != 3) && (power % 10 != 7)) || (nGrid >= 180*180)) {
+        return -1;
+    }
+    decode->powerDbm = power;
+    decode->grid[0] = 'A' + (179 - nGrid/180)/10;
+    decode->grid[2] = '0' + (179 - nGrid/180)%10;
+    decode->grid[1] = 'A' + (nGrid%180)/10;
+    decode->grid[3] = '0' + (nGrid%180)%10;
+    decode->grid[4] = 0;
+    if ((decode->grid[0] > 'R') || (decode->grid[1] > 'R')) {
+        return -1;
+    }
+    return 0;
+}
+
+
+static int compareFloat( const void *aaa, const void *bbb ) {
+    float fa = *(const float *)aaa, fb = *(const float *)bbb;
+    return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+}
+
+
+static int compareCandidate( const void *aaa, const void *bbb ) {
+    double sa = ((const struct Candidate *)aaa)->snr, sb = ((const struct Candidate *)bbb)->snr;
+    return (sa > sb) ? -1 : ((sa < sb) ? 1 : 0);
+}
+
+
+static int parity( unsigned int value ) {
+    value ^= value >> 16;
+    value ^= value >> 8;
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+
+
+//  Regression test and benchmark.  Each of 1470.wav - 1530.wav must decode to "NQ6B DM12 37" at its own frequency with DT +1.0 (wspr0
+//      starts the message 2 seconds in).  Then 1500.wav is turned down and buried in Gaussian noise at known SNRs to see where it stops
+//      decoding and how close the SNR estimate is.
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+
+#include <time.h>
+
+#define NUM_CORPUS_FILES    7
+
+static short *readCorpus( const char *filename, int *numSamples ) {
+    FILE *fptr;
+    long fileSize;
+    short *samples;
+
+    fptr = fopen(filename,"rb");
+    if (fptr == (FILE *)NULL) { printf("Unable to open %s\n",filename); return (short *)NULL; }
+    fseek(fptr, 0, SEEK_END);
+    fileSize = ftell(fptr);
+    fseek(fptr, 44, SEEK_SET);                      // wspr0 writes a plain 44 byte header
+    samples = (short *)malloc(fileSize);
+    if (fread(samples, 1, fileSize-44, fptr) != fileSize-44) { printf("Error reading %s\n",filename); fclose(fptr); free(samples); return (short *)NULL; }
+    fclose(fptr);
+    *numSamples = (fileSize-44)/2;
+    return samples;
+}
+
+static double gaussian( void ) {
+    double u1 = (rand() + 1.0)/(RAND_MAX + 2.0), u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    return sqrt( -2.0*log( u1 ) )*cos( 2.0*M_PI*u2 );
+}
+
+static double elapsed( const struct timespec *t0 ) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec)/1e9;
+}
+
+int main() {
+    struct WsprDecode decodes[WSPRDECODE_MAX_DECODES];
+    struct timespec t0;
+    short *samples, *noisy;
+    int numSamples, numDecodes, errors = 0, totalDecodes = 0;
+    double seconds = 0.0;
+
+    threadpool_open( 0 );
+    printf("%d threads\n", threadpool_numThreads());
+    for (int fff = 0; fff < NUM_CORPUS_FILES; fff++) {
+        char filename[16];
+        double toneHz = 1470.0 + 10.0*fff;
+        int found = 0;
+
+        sprintf(filename,"%d.wav",(int)toneHz);
+        samples = readCorpus( filename, &numSamples );
+        if (samples == (short *)NULL) { return 1; }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        numDecodes = wsprdecode_decode( samples, numSamples, decodes, WSPRDECODE_MAX_DECODES );
+        seconds += elapsed(&t0);
+        for (int iii = 0; iii < numDecodes; iii++) {
+            printf("%s: %-6s %s %2d  %7.2lf Hz  snr %+5.1lf  dt %+5.2lf  drift %+5.2lf  sync %.2lf  cycles %d\n", filename, decodes[iii].callsign,
+                   decodes[iii].grid, decodes[iii].powerDbm, decodes[iii].freqHz, decodes[iii].snr, decodes[iii].dt, decodes[iii].drift,
+                   decodes[iii].sync, decodes[iii].cycles);
+            if (!strcmp( decodes[iii].callsign, "NQ6B" ) && !strcmp( decodes[iii].grid, "DM12" ) && (decodes[iii].powerDbm == 37) &&
+                (fabs( decodes[iii].freqHz - toneHz ) < 0.2) && (fabs( decodes[iii].dt - 1.0 ) < 0.05) && (fabs( decodes[iii].drift ) < 0.3)) {
+                found++;
+            }
+        }
+        if ((numDecodes != 1) || (found != 1)) { printf("%s: FAIL\n",filename); errors++; }
+        totalDecodes += numDecodes;
+        free(samples);
+    }
+    printf("%d decodes in %.2lf sec, %.1lf decodes/sec, %.0lf ms per two minute recording\n", totalDecodes, seconds, totalDecodes/seconds,
+           seconds*1e3/NUM_CORPUS_FILES);
+
+    //  Noise.  The signal is scaled to an amplitude of 100 (power 5000).  Noise over the full 6 kHz with a power of N gives
+    //      SNR = 5000/(N*2500/6000) in 2500 Hz.
+    samples = readCorpus( "1500.wav", &numSamples );
+    noisy = (short *)malloc( numSamples*sizeof(short) );
+    srand( 12345 );
+    for (int snr = -20; snr >= -30; snr -= 2) {
+        double sigma = sqrt( 5000.0/pow( 10.0, snr/10.0 )*6000.0/2500.0 );
+        int found = 0;
+        for (int iii = 0; iii < numSamples; iii++) {
+            double value = samples[iii]*100.0/32767.0 + sigma*gaussian();
+            noisy[iii] = (short)((value > 32767.0) ? 32767 : ((value < -32768.0) ? -32768 : lround( value )));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        numDecodes = wsprdecode_decode( noisy, numSamples, decodes, WSPRDECODE_MAX_DECODES );
+        for (int iii = 0; iii < numDecodes; iii++) {
+            if (!strcmp( decodes[iii].callsign, "NQ6B" ) && !strcmp( decodes[iii].grid, "DM12" ) && (decodes[iii].powerDbm == 37)) {
+                printf("SNR %+d dB: decoded, estimate %+5.1lf dB, %.2lf Hz, sync %.2lf, cycles %d, %.0lf ms\n", snr, decodes[iii].snr,
+                       decodes[iii].freqHz, decodes[iii].sync, decodes[iii].cycles, elapsed(&t0)*1e3);
+                found = 1;
+            } else {
+                printf("SNR %+d dB: false decode %s %s %d\n", snr, decodes[iii].callsign, decodes[iii].grid, decodes[iii].powerDbm);
+                errors++;
+            }
+        }
+        if (!found) {
+            printf("SNR %+d dB: no decode, %.0lf ms\n", snr, elapsed(&t0)*1e3);
+            if (snr >= -24) { errors++; }           // wsprd gets to about -28
+        }
+    }
+    free(samples);
+    free(noisy);
+    threadpool_close();
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _WSPRDECODE_H_
+#define _WSPRDECODE_H_
+
+#define WSPRDECODE_MAX_DECODES  64
+#define WSPRDECODE_CENTER_HZ    1500.0      // audio frequency of the middle of the 200 Hz WSPR sub-band
+#define WSPRDECODE_MAX_SAMPLES  (120*12000)
+
+struct WsprDecode {
+    char callsign[8];
+    char grid[8];
+    int powerDbm;
+    double freqHz;      // audio frequency of the center of the four tones, add the dial frequency for the RF frequency
+    double snr;         // dB in 2500 Hz, same as WSJT-X
+    double dt;          // seconds, 0 is a signal starting 1 second after the start of the recording (the even minute)
+    double drift;       // Hz over the whole message
+    double sync;        // 0 to 1
+    int cycles;         // Fano decoder cycles per bit, how hard it was to decode
+};
+
+extern int wsprdecode_decode( const short *samples, int numSamples, struct WsprDecode *decodes, int maxDecodes );
+
+#endif
@@ -1,9 +1,9 @@
 /*
     To run standalone:
         - uncomment MAIN_HERE directive at the bottom of file.
-            gcc -g -Wall wsprnet.c azdist.c geodist.c grid2deg.c -lm
-        - I usually want to remove the curl command below and just read the latest x.txt file, created from twsprRPI.
-        - I'll have to change the three parameters in call to doCurl() at the bottom of the file, date1/2/3 to whatever times are in the x.txt file.
+            gcc -g -Wall wsprnet.c httpclient.c htmlscan.c spottable.c gridcache.c spotstore.c geodist.c grid2deg.c -lm -lz -lssl -lcrypto -pthread
+        - It queries wsprnet.org itself (httpclient.c), there is no x.txt any more.
+        - I'll have to change the three parameters in call to doCurl() at the bottom of the file, date1/2/3 to whatever times wsprnet.org has.
         - The call to sendUDPEmailMsg() must be commented out.  There is a commented out print statement below it that can be restored to print its message.
 */
 #include <stdio.h>
@@ -16,13 +16,20 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <math.h>
+#include <stdint.h>
 #include "twsprRPI.h"
+#include "reports.h"
+#include "htmlscan.h"
+#include "spottable.h"
+#include "httpclient.h"
+#include "gridcache.h"
+#include "spotstore.h"
 
-#define START_OF_LINE1  "<tr id=\"evenrow\">"
-#define START_OF_LINE2  "<tr id=\"oddrow\">"
-#define MAX_ENTRIES     500
+#define LIMIT_MIN       50              // rows asked of wsprnet.org, see doCurl()
+#define LIMIT_MAX       600             //      (it always asked for 600)
+#define LIMIT_MARGIN    40              //      room for the late spots
 
-#define RAW_LOG_NAME    "raw_reports_log.txt"
+#define WSPRNET_URL     "http://www.wsprnet.org/olddb"
 
 
 #define PURPLE    "\033[95m"
@@ -36,52 +43,74 @@
 #define UNDERLINE "\033[4m"
 #define END       "\033[0m"
 
-extern void azdist_(char* MyGrid, char* HisGrid,            // would normally be in a .h file but this is the only place that calls it.
-                    int* nAz, int* nDmiles, int* nDkm);
-
-
-struct Entry {
-    char timestamp[64];
-    char freq[64];
-    char snr[64];
-    char drift[64];
-    char reporter[64];
-    char reporterLocation[64];
-    char distance[64];
-    char azimuth[64];
-    char distance2[64];
-};
-typedef struct Entry Entry;
-
 char *goldenCalls[] = { "KK6PR",     "KP4MD",  "W7PAU",  "KA7OEI-1", "AC0G",
                         "KPH",       "KV0S",   "WA2TP",  "W2ACR",    "KA7OEI/Q",
                         "AI6VN/KH6", "K6RFT",  "KV4TT",  "W3ENR",    "K1RA-PI",
                         "W7WKR-K2",  "KV6X",   "N3IZN/SDR", "AA6RF" };
 #define NUM_OF_GOLDEN_CALLS 19   // do this because "size_t n = sizeof(a) / sizeof(int);" won't work since each element is a different size.
 
-int doCurl( struct BeaconData *beaconData, char* termPTSNum );
-
-static int processEntries( Entry **entries, int *numEntries, char* termPTSNum, char *thedate, int minBeacon );
-static int parseHTMLLine( char *string, struct BeaconData *beaconData, int numBeacons, Entry **entry, int *numEntries, char *thedate, int *numberOfDuplicates );
-static char* parseHTMLTag( char *string, char *field );
-static void doOneGrid( char *his, int *nAz, int *nDmiles );
+static Entry **entries;                 // this cycle's spots (spottable.c), kept between the re-queries
+static int numEntries = 0;
+static int numShown = 0;                // entries[] already printed, logged and alerted
+static char thedate[64];
+static int rowsNeeded = 0;              // rows in the beacons' time range the last time, the next limit is based on it
+
+int wsprnet_start( void );
+int doCurl( struct BeaconData *beaconData, char* termPTSNum, int requery, int request, struct ReportTiming *timing );
+
+static int firstLimit( void );
+static int startQuery( int limit );
+static int processEntries( Entry **entries, int numEntries, int firstNew, char* termPTSNum, int minBeacon, int *newGolden );
+static int parseHTMLRow( const struct HtmlRow *row, struct BeaconData *beaconData, int numBeacons, char *thedate, int *numberOfDuplicates );
+static void formatFreq( int64_t freqHz, char *string );
+static time_t spotTime( time_t now, int minute );
+static int clampInt( int value, int min, int max );
 static int getIndexBasedOnFreq( int ifreq );
 static void resetGoldenList( void );
 static int goldenListNotEmpty( void );
-static void insertInGoldenList( char *freq );
-static void processGoldenList( int txFreqHz, char* tone, int txFreqHzActual, double temperature, FILE *fptr, char* thedate, int *headerNotPrinted  );
+static void insertInGoldenList( int64_t freqHz );
+static void setGoldenListLogged( int clear );
+static void processGoldenList( int txFreqHz, double toneHz, int txFreqHzActual, double temperature, FILE *fptr, char* thedate, int *headerNotPrinted  );
+
+//  Starts the query for the spots, doCurl() waits for it.  reports.c starts it together with pskreporter.info's so both are fetched at
+//      the same time.  Returns the request, see http_start().
+int wsprnet_start( void ) {
+    return startQuery( firstLimit() );
+}
+
 
-int doCurl( struct BeaconData *beaconData, char* termPTSNum ) {
+//  Waits for the spots from wsprnet.org (request, from wsprnet_start()), prints and logs them.  Called by the reports thread (reports.c),
+//      timing gets how long the fetch and the rest took.  It can be NULL.
+//  requery 0 starts the cycle's list of spots.  Later calls (reports.c re-queries a few minutes apart, for the reporters that upload late)
+//      fetch again, merge into the list and only print, log and alert the spots that are new.  The rows come newest first and the
+//      beacons are the newest of mine, so only enough rows to get past the first beacon are needed: the count in the beacons' time range
+//      last time plus LIMIT_MARGIN, instead of 600 every time.  If every row fetched is still in range the limit is doubled and it
+//      fetches again, on the same connection if wsprnet.org kept it open.
+int doCurl( struct BeaconData *beaconData, char* termPTSNum, int requery, int request, struct ReportTiming *timing ) {
     FILE *fptr;
-    char *cc, string[4096];
+    struct HttpResponse response;
+    struct HtmlScan scan;
+    struct HtmlRow row;
     int returnValue = 0;
-    Entry *entries[MAX_ENTRIES];
-    int numEntries = 0;
-    char thedate[64];
     int numBeacons;
     int numberOfDuplicates;
     int iii;
     int minBeacon;      // the lowest beacon frequency
+    int limit, rows, rowsInRange, reachedOlder, firstNew, newGolden;
+    struct ReportTiming unused;
+    struct timespec t1, t2;
+
+    if (timing == (struct ReportTiming *)NULL) {
+        timing = &unused;
+    }
+    memset( timing, 0, sizeof(*timing) );
+
+    if (requery == 0) {             // a new cycle, forget the last one's spots
+        spottable_reset();
+        setGoldenListLogged( 1 );
+        numEntries = numShown = 0;
+        thedate[0] = 0;
+    }
 
     //  Remove the seconds from the timestamp string.  It should already be removed, just in case.
     minBeacon = INT_MAX;
@@ -99,199 +128,199 @@ int doCurl( struct BeaconData *beaconData, char* termPTSNum ) {
     numBeacons = iii;
     numberOfDuplicates = 0;
 
-    system("curl -s -d \"mode=html&band=all&limit=600&findcall=nq6b&findreporter=&sort=date\" http://www.wsprnet.org/olddb -o x.txt");
-
-    fptr = fopen("x.txt","rt");
-    if (fptr == (FILE *)NULL) {
-        return -1;
-    }
-    //printf("\n");
-    while (!feof(fptr)) {
-        cc = fgets( string, 4096, fptr );         // read one line of the file
-        if (cc == (char *)NULL) {
-            break;
+    limit = firstLimit();           // what wsprnet_start() asked for
+    while (1) {
+        http_finish( request, &response );
+        clock_gettime( CLOCK_MONOTONIC, &t1 );
+        timing->fetchSec += response.seconds;
+        timing->bytes += response.bytes;
+        timing->fetchError = response.error;
+        timing->httpStatus = response.status;
+        if (response.error != HTTP_OK) {
+            http_free( &response );
+            return -1;
         }
-        //if ((strncmp( string, START_OF_LINE1, strlen(START_OF_LINE1) ) == 0) || (strncmp( string, START_OF_LINE2, strlen(START_OF_LINE2) ) == 0))  {
-        if (strstr( string, START_OF_LINE1) || strstr( string, START_OF_LINE2) )  {
-            //printf("%s",string);
-            if (parseHTMLLine( string, beaconData, numBeacons, entries, &numEntries, thedate, &numberOfDuplicates ) ) {
-                //returnValue = -1;
+
+        rows = rowsInRange = reachedOlder = 0;
+        htmlscan_begin( &scan, response.body, response.length );
+        while (htmlscan_nextRow( &scan, &row )) {
+            rows++;
+            if (parseHTMLRow( &row, beaconData, numBeacons, thedate, &numberOfDuplicates ) ) {
+                reachedOlder = 1;       // (or a row it couldn't parse, it stopped there either way)
                 break;
             }
+            rowsInRange++;
         }
-    }
-
-    //  The output of the above curl statement and file read is entries[], a list of all the station that heard this beacon, with duplicates removed.
-    //      Now display them.
-    processEntries( entries, &numEntries, termPTSNum, thedate, minBeacon );
+        entries = spottable_entries( &numEntries );
+        timing->rows += rows;
+        http_free( &response );
+        clock_gettime( CLOCK_MONOTONIC, &t2 );
+        timing->parseSec += (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec)*1e-9;
 
-    for (iii = 0; iii < numEntries; iii++) {
-        if (entries[iii] != (Entry *)NULL) {
-            free( entries[iii] );
+        if (reachedOlder || (rows < limit) || (limit >= LIMIT_MAX)) {
+            break;
         }
+        limit = (2*limit < LIMIT_MAX) ? 2*limit : LIMIT_MAX;      // all of them in range, there are more
+        request = startQuery( limit );
+    }
+    rowsNeeded = rowsInRange;
+
+    //  The output of the above query is entries[], a list of all the station that heard this beacon, with duplicates removed.
+    //      Now display the ones not shown yet.
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+    firstNew = numShown;
+    if ((requery) && (numEntries > firstNew)) {
+        printf("\n%d late spots\n",numEntries - firstNew);
     }
-    fclose(fptr);
+    processEntries( entries, numEntries, firstNew, termPTSNum, minBeacon, &newGolden );
+    numShown = numEntries;
 
-    printf("Num entries %d                                \n",numEntries);
-    printf("Num duplicates %d                             \n",numberOfDuplicates);   
+    timing->numSpots = numEntries;
+    timing->newSpots = numEntries - firstNew;
+    printf("Num entries %d (%d new)                       \n",numEntries,numEntries - firstNew);
+    printf("Num duplicates %d                             \n",numberOfDuplicates);
 
-    if (goldenListNotEmpty()) {
+    if ((newGolden) && (goldenListNotEmpty())) {
         int headerNotPrinted = 1;
         fptr = fopen("log_golden.txt","at");
         if (fptr == (FILE *)NULL) {
             return -1;
         }
         for (iii = 0; iii < numBeacons; iii++) {
-            processGoldenList( beaconData[iii].txFreqHz, beaconData[iii].tone, beaconData[iii].txFreqHzActual, beaconData[iii].temperature, fptr, thedate, &headerNotPrinted );
+            processGoldenList( beaconData[iii].txFreqHz, beaconData[iii].toneHz, beaconData[iii].txFreqHzActual, beaconData[iii].temperature, fptr, thedate, &headerNotPrinted );
         }
+        setGoldenListLogged( 0 );
         fclose(fptr);
     }
 
+    clock_gettime( CLOCK_MONOTONIC, &t2 );
+    timing->parseSec += (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec)*1e-9;
     return returnValue;
 }
 
 
-static int processEntries( Entry **entries, int *numEntries, char* termPTSNum, char *thedate, int minBeacon ) {
+//  The rows to ask for first: as many as were in the beacons' time range last time, and some room.
+static int firstLimit( void ) {
+    int limit = (rowsNeeded == 0) ? LIMIT_MAX : rowsNeeded + LIMIT_MARGIN;
+
+    return clampInt( limit, LIMIT_MIN, LIMIT_MAX );
+}
+
+
+static int startQuery( int limit ) {
+    char postBody[128];
+
+    snprintf( postBody, sizeof(postBody), "mode=html&band=all&limit=%d&findcall=nq6b&findreporter=&sort=date", limit );
+    return http_start( WSPRNET_URL, postBody, REPORTS_FETCH_MAX_SEC*1000 );
+}
+
+
+//  Prints, stores (spotstore.c) and alerts entries[firstNew] on, the ones before were done by an earlier call.  The golden list is built
+//      from all of them, *newGolden is the number of golden calls among the new ones.
+static int processEntries( Entry **entries, int numEntries, int firstNew, char* termPTSNum, int minBeacon, int *newGolden ) {
     int num28MHz = 0;
-    FILE *fptr, *remoteTerminal;
-    int firstGolden = 0;
-    double remoteTerminalFreq;
+    FILE *remoteTerminal;
+    int64_t remoteTerminalHz;
+    time_t now = time( NULL );
+    uint32_t goldenIds[NUM_OF_GOLDEN_CALLS];
 
+    *newGolden = 0;
     resetGoldenList();              // clear out golden list here, before checking if entries are blank (wsprnet.org is down).  Otherwise golden list from previous burst will be repeated
-    if (*numEntries == 0) {
+    if (numEntries == firstNew) {
         printf("\n");
         return 0;
     }
 
     remoteTerminal = (FILE *)NULL;
-    remoteTerminalFreq = 0.0;
+    remoteTerminalHz = 0;
     if (termPTSNum[0] != 0) {
         char filename[64];
 
         sprintf(filename,"/dev/pts/%s",termPTSNum);
         remoteTerminal = fopen(filename,"at");      //  Error is ok because remoteTerminal will be checked against NULL
 
-        remoteTerminalFreq = (double)minBeacon;         // convert minBeacon to double because it is compared against a double (24924000 becomes 24924000.0)
-        remoteTerminalFreq /= 1000000;                  // convert from kHz to mHz (24924000.0 becomes 24.924000)
-        remoteTerminalFreq = floor(remoteTerminalFreq); // remove everything after decimal (24.924000 becomes 24.000000)
-        remoteTerminalFreq += 1.0;                      // add one because the comparison below is for all freqs below this value (24.000000 becomes 25.000000)
-    }
-
-    fptr = fopen(RAW_LOG_NAME,"at");
-    if (fptr == (FILE *)NULL) {
-        printf("\n");
-        return 0;
+        remoteTerminalHz = (minBeacon/1000000 + 1) * (int64_t)1000000;     // the comparison below is for all freqs below the next MHz (24924000 becomes 25000000)
     }
 
     //  Run through the list once and count how many 28 MHz stations are there.  I need to know this in advance for use in the second loop below.
     //      so that I can know to print in red when less than 10 entries.
-    for (int iii = 0; iii < *numEntries; iii++) {
-        if (entries[iii] != (Entry *)NULL) {
-            double entryFreq;
-            sscanf(  entries[iii]->freq, "%lf", &entryFreq );
-
-            // I want to collect all the 28 MHz reports and average the frequency value.  I also need the number of 28 MHz stations for use within the loop.
-            if (entryFreq > 28.0) {
-                if (entryFreq < 29.0) {     // if 10m entry
-                    num28MHz++;
-                }
-            }
+    for (int iii = 0; iii < numEntries; iii++) {
+        if ((entries[iii]->freqHz > 28000000) && (entries[iii]->freqHz < 29000000)) {     // if 10m entry
+            num28MHz++;
         }
     }
 
     //  Loop through and print things out.
-    for (int iii = 0; iii < *numEntries; iii++) {
-        if (entries[iii] != (Entry *)NULL) {
-            int tempInt;
-            double entryFreq;
-            FILE *terminal;         // either stdout or /dev/pts/?
-
-            {
-                char *ccc;              // I started getting bizzare frequencies from WSPRNet.org.  Find these and eliminate them.
-                char string[64];
-
-                strcpy(string, entries[iii]->freq);
-                ccc = strchr(string,'.');                   // search for decimal point in string and remove it
-                if (ccc == (char *)NULL) { continue; }
-                strcpy( ccc, &ccc[1] );
-                sscanf(string,"%d",&tempInt);               // convert string to int, representing frequency in Hz
-                if (readConfigFileWSPRFreq(tempInt-1500)) { continue; }    // readConfigFileWSPRFreq() returns -1 if not a supported WSPR freq.  Have to add 1500 Hz for tone offset.
+    for (int iii = firstNew; iii < numEntries; iii++) {
+        Entry *entry = entries[iii];
+        const char *reporter = spottable_string( entry->reporter );
+        const char *grid = spottable_string( entry->reporterLocation );
+        char freq[32];
+        FILE *terminal;         // either stdout or /dev/pts/?
+
+        //  I started getting bizzare frequencies from WSPRNet.org.  Find these and eliminate them.
+        if (readConfigFileWSPRFreq((int)entry->freqHz - 1500)) { continue; }    // readConfigFileWSPRFreq() returns -1 if not a supported WSPR freq.  Have to add 1500 Hz for tone offset.
+        formatFreq( entry->freqHz, freq );
+
+        //  Set terminal to stdout unless ( 21 MHz AND a /dev/pts/XX number was input on the command line )
+        terminal = stdout;
+        if (entry->freqHz < remoteTerminalHz) { //  if entry is on the lowest beacon frequency band ...
+            if (remoteTerminal) {               //  ... and if user imput a PTS number on the command line
+                terminal = remoteTerminal;      //  ... then write to that terminal.
             }
+        }
 
-            //  Get the frequency as a double for use below, checking for 21 MHz and 28 MHz.
-            sscanf(  entries[iii]->freq, "%lf", &entryFreq );
-
-            //  Set terminal to stdout unless ( 21 MHz AND a /dev/pts/XX number was input on the command line )
-            terminal = stdout;
-            if (entryFreq < remoteTerminalFreq) {   //  if entry is on the lowest beacon frequency band ...
-                if (remoteTerminal) {               //  ... and if user imput a PTS number on the command line
-                    terminal = remoteTerminal;      //  ... then write to that terminal.
-                }
+        //  This block of code just determines what color to print the line with.
+        if (entry->distance > 3000) {                           // if distance > 3000 then print green
+            fprintf(terminal,GREEN);
+        } else if (entry->snr >= 0) {                           // if snr >= 0 then print blue
+            fprintf(terminal,BLUE);
+        } else if ((num28MHz < 10) && (entry->freqHz > 28000000) && (entry->freqHz < 29000000)) {
+            // 28 MHz - highlight in red things that are not LOS but don't bother until the band begins to shut down.
+            if ( (strncmp(grid,"DM12",4)) && (strncmp(grid,"DM13",4)) && (strncmp(grid,"DM14",4)) ) {     // if 4-digit grid square not DM12, DM13, or DM14 then print red
+                fprintf(terminal,RED);
             }
+        }
 
-            //  This block of code just determines what color to print the line with.
-            sscanf( entries[iii]->distance, "%d", &tempInt );
-            if (tempInt > 3000) {                                   // if distance > 3000 then print green
-                fprintf(terminal,GREEN);
-            } else {
-                sscanf( entries[iii]->snr, "%d", &tempInt );
-                if (tempInt >= 0) {                                 // if snr >= 0 then print blue
-                    fprintf(terminal,BLUE);
-                } else {
-                    if (num28MHz < 10) {                // 28 MHz - highlight in red things that are not LOS but don't bother until the band begins to shut down.
-                        if (entryFreq > 28.0) {
-                            if (entryFreq < 29.0) {     // if 10m entry
-                                char grid[64];
-                                strcpy( grid, entries[iii]->reporterLocation );     // if 4-digit grid square not DM12, DM13, or DM14 then print red
-                                grid[4] = 0;        // 4 digit grid square
-                                if ( (strcmp(grid,"DM12")) && (strcmp(grid,"DM13")) && (strcmp(grid,"DM14")) && (strcmp(grid,"DM13")) ) {
-                                    fprintf(terminal,RED);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        //  print the line
+        fprintf(terminal,"   %02d:%02d %10s  %3d %2d  %10s   %6s  %5d mi  %03d deg\n",
+               entry->minute/60, entry->minute%60, freq, entry->snr, entry->drift,
+               reporter, grid, entry->distance, entry->azimuth);
+
+        //  reset the color
+        fprintf(terminal,END);
+
+        //  keep it (raw_reports_log.txt was this line, spotquery.c prints it again)
+        {
+            struct Spot spot;
+
+            memset( &spot, 0, sizeof(spot) );
+            spot.time = spotTime( now, entry->minute );
+            spot.freqHz = (uint32_t)entry->freqHz;
+            spot.snr = entry->snr;
+            spot.drift = entry->drift;
+            spot.reporter = reporter;
+            spot.grid = grid;
+            spot.distance = entry->distance2;
+            spot.azimuth = entry->azimuth;
+            spot.source = SPOT_WSPRNET;
+            spotstore_add( &spot );
+        }
 
-            //  print the line
-            fprintf(terminal,"   %s %10s  %3s %2s  %10s   %6s  %5s mi  %3s deg\n",
-                   entries[iii]->timestamp, entries[iii]->freq, entries[iii]->snr, entries[iii]->drift,
-                   entries[iii]->reporter, entries[iii]->reporterLocation, entries[iii]->distance,
-                   entries[iii]->azimuth); //, entries[iii]->distance2);
-
-            //  reset the color
-            fprintf(terminal,END);
-
-            //  print the line to a file
-            fprintf(fptr,"   %s %10s  %3s %2s  %10s   %6s  %5s mi  %3s deg  (%s mi)\n",
-                   entries[iii]->timestamp, entries[iii]->freq, entries[iii]->snr, entries[iii]->drift,
-                   entries[iii]->reporter, entries[iii]->reporterLocation, entries[iii]->distance,
-                   entries[iii]->azimuth, entries[iii]->distance2);
-
-            //  Potentially send Email if on 6 or 2m
-            {
-                double dfreq;
-
-                //  Make sure the frequency is 50 MHz or greater.
-                tempInt = sscanf( entries[iii]->freq, "%lf", &dfreq );      // should return 1, one successful conversion
-                if ( (tempInt == 1) && (dfreq >= 50.0) ) {
-                    //  ... and make sure that the grid square is not DM12 or DM13
-                    if (
-                            ( strstr(entries[iii]->reporterLocation,"DM12") == (char *)NULL ) &&
-                            ( strstr(entries[iii]->reporterLocation,"DM13") == (char *)NULL ) &&
-                            ( strstr(entries[iii]->reporterLocation,"DM14") == (char *)NULL )
-                       ) {
-                        char message[1024],string[1024];        // super long strings because I'm too lazy to compute the actual lengths and do a calloc().
-
-                        sprintf(message,"WSPR %s %s\n", entries[iii]->freq, entries[iii]->reporterLocation);
-                        sprintf(string,"   %s %10s  %3s  %10s   %6s  %5s mi  %3s deg\n", entries[iii]->timestamp, entries[iii]->freq,
-                                            entries[iii]->snr, entries[iii]->reporter, entries[iii]->reporterLocation, entries[iii]->distance, entries[iii]->azimuth);
-                        strcat(message,string);
-                        sendUDPEmailMsg( message );
-                        //printf("%s\n",message);
-                    }
-                }
-            }
+        //  Potentially send Email if on 6 or 2m, and the grid square is not DM12, DM13 or DM14
+        if ( (entry->freqHz >= 50000000) &&
+                ( strstr(grid,"DM12") == (char *)NULL ) &&
+                ( strstr(grid,"DM13") == (char *)NULL ) &&
+                ( strstr(grid,"DM14") == (char *)NULL )
+           ) {
+            char message[1024],string[1024];        // super long strings because I'm too lazy to compute the actual lengths and do a calloc().
+
+            sprintf(message,"WSPR %s %s\n", freq, grid);
+            sprintf(string,"   %02d:%02d %10s  %3d  %10s   %6s  %5d mi  %03d deg\n", entry->minute/60, entry->minute%60, freq,
+                                entry->snr, reporter, grid, entry->distance, entry->azimuth);
+            strcat(message,string);
+            sendUDPEmailMsg( message );
+            //printf("%s\n",message);
         }
     }
 
@@ -301,82 +330,81 @@ static int processEntries( Entry **entries, int *numEntries, char* termPTSNum, c
     }
 
     //  Print out the "golden callsigns".  The ones that, from observation, seem to be GPS controlled because they are almost always reporting the same frequency.
-    for (int iii = 0; iii < *numEntries; iii++) {
-        if (entries[iii] != (Entry *)NULL) {
-            double entryFreq;
-            sscanf(  entries[iii]->freq, "%lf", &entryFreq );
-            if (entryFreq > 24.0) {        // only print out golden freqs on 12m and above
-                int thisIsGoldenCall = 0;
-
-                for (int jjj = 0; jjj < NUM_OF_GOLDEN_CALLS; jjj++) {
-                    int sss = strcmp(entries[iii]->reporter, goldenCalls[jjj]);
-                    if (sss == 0) {
-                        thisIsGoldenCall = 1;
-                        break;
-                    }
-                }
-
-                if (thisIsGoldenCall) {
-                    insertInGoldenList( entries[iii]->freq );
+    for (int jjj = 0; jjj < NUM_OF_GOLDEN_CALLS; jjj++) {
+        goldenIds[jjj] = spottable_intern( goldenCalls[jjj], strlen(goldenCalls[jjj]) );
+    }
+    for (int iii = 0; iii < numEntries; iii++) {
+        Entry *entry = entries[iii];
 
-                    if (firstGolden == 0) {         // print separator line if this is the first.
-                        firstGolden = 1;
-                        fprintf(fptr,"\n");
-                    }
+        if (entry->freqHz > 24000000) {        // only print out golden freqs on 12m and above
+            int thisIsGoldenCall = 0;
 
-                    //  print the golden call line to log file
-                    fprintf(fptr,"  g %s %10s  %3s %2s  %10s   %6s  %5s mi  %3s deg (%s mi)\n",
-                           entries[iii]->timestamp, entries[iii]->freq, entries[iii]->snr, entries[iii]->drift,
-                           entries[iii]->reporter, entries[iii]->reporterLocation, entries[iii]->distance,
-                           entries[iii]->azimuth, entries[iii]->distance2);
+            for (int jjj = 0; jjj < NUM_OF_GOLDEN_CALLS; jjj++) {
+                if (entry->reporter == goldenIds[jjj]) {
+                    thisIsGoldenCall = 1;
+                    break;
+                }
+            }
 
+            if (thisIsGoldenCall) {
+                insertInGoldenList( entry->freqHz );
+                if (iii >= firstNew) {          // not counted already
+                    (*newGolden)++;
                 }
             }
         }
     }
 
-    fprintf(fptr," ------- %s above \n",thedate);
-    fclose(fptr);
-
+    if (spotstore_flush() == -1) {
+        printf("Couldn't store the spots\n");
+    }
     return 0;
 }
 
 
-static int parseHTMLLine( char *string, struct BeaconData *beaconData, int numBeacons, Entry **entry, int *numEntries, char *thedate, int *numberOfDuplicates ) {
+static int parseHTMLRow( const struct HtmlRow *row, struct BeaconData *beaconData, int numBeacons, char *thedate, int *numberOfDuplicates ) {
     /*
-       <td align=left>&nbsp;2022-01-18 23:22&nbsp;</td>
-       <td align=left>&nbsp;NQ6B&nbsp;</td>
-       <td align=right>&nbsp;50.294526&nbsp;</td>
-       <td align=right>&nbsp;-16&nbsp;</td>
-       <td align=right>&nbsp;-1&nbsp;</td>
-       <td align=left>&nbsp;DM12mr&nbsp;</td>
-       <td align=right>&nbsp;+37&nbsp;</td>
-       <td align=right>&nbsp;5.012&nbsp;</td>
-       <td align=left>&nbsp;N3IZN/SDR&nbsp;</td>
-       <td align=left>&nbsp;DM13ji&nbsp;</td>
-       <td align=right>&nbsp;73&nbsp;</td>
-       <td align=right>&nbsp;45&nbsp;</td>
-       <td align=right>&nbsp;WSPR-2&nbsp;</td>
+       The cells of a row, see htmlscan.c.  They point into the response, the ones kept in entries[] are read into numbers.
+        0  2022-01-18 23:22
+        1  NQ6B
+        2  50.294526
+        3  -16
+        4  -1
+        5  DM12mr
+        6  +37
+        7  5.012
+        8  N3IZN/SDR
+        9  DM13ji
+        10 73
+        11 45
+        12 WSPR-2
     */
-    char *cc,*cc1;
-    char field[128];
-    char timestamp[64],freq[64],snr[64],drift[64], reporter[64], reporterLocation[64], distance[64],azimuth[64],distance2[64];
+    const struct HtmlView *reporter = &row->cell[8];
+    struct HtmlView timestamp;
+    const char *cc;
+    Entry *spot;
+    long long freqHz;
+    int snr, drift, distance;
+    int added;
     int done;
 
-    //  Find beginning of first <td> tag
-    cc = strstr(string,"<td align=");
-    if (cc == (char *)NULL) { return 0; }       // don't return -1 (error).  Just let it continue through the rest of the HTML code.
+    if (row->numCells == 0) { return 0; }       // don't return -1 (error).  Just let it continue through the rest of the HTML code.
+    if (row->numCells < 13) { return -1; }
 
-    //  Get timestamp
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    cc1 = strchr(field,' ');           if (cc1 == (char *)NULL) { return -1; }     // find space, which separates the date from the time.  I only want the time.
-    strcpy(timestamp,&cc1[1]);
-    *cc1 = 0;   strcpy(thedate, field);     // retrieve date for below.
+    //  Get timestamp.  A space separates the date from the time.  I only want the time.
+    cc = memchr( row->cell[0].text, ' ', row->cell[0].length );
+    if (cc == (const char *)NULL) { return -1; }
+    timestamp.text = &cc[1];
+    timestamp.length = row->cell[0].length - (int)(timestamp.text - row->cell[0].text);
+    {
+        struct HtmlView date = { row->cell[0].text, (int)(cc - row->cell[0].text) };
+        htmlscan_copy( &date, thedate, 64 );        // retrieve date for below.
+    }
 
     //  Since they are in chronological order the first line that doesn't match any of the timestamps is the last one needed.
     done = 1;
     for (int jjj = 0; jjj < numBeacons; jjj++) {
-        if (strcmp(timestamp,beaconData[jjj].timestamp) == 0) {
+        if (htmlscan_equals( &timestamp, beaconData[jjj].timestamp )) {
             done = 0;
             break;
         }
@@ -384,107 +412,40 @@ static int parseHTMLLine( char *string, struct BeaconData *beaconData, int numBe
     if (done) {
         return -1;
     }
-    //if (strcmp(timestamp,date1) && strcmp(timestamp,date2) && strcmp(timestamp,date3) && strcmp(timestamp,date4)) {
-    //    return -1;
-    //}
-
-    //  Next field is my call, ignore it.
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-
-    //  Next is frequency
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(freq,field);
-
-    //  Next is SNR
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(snr,field);
 
-    //  Next is drift
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(drift,field);
-
-    //  Next three are my grid, dBm and Watts, ignore.
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-
-    //  Next is reporting callsign
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(reporter,field);
-
-    //  Next is reporting callsign location
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(reporterLocation,field);
-
-    //  Next is distance in km and miles.  Ignore km
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    cc = parseHTMLTag( cc, field );    if (cc == (char *)-1) { return -1; }
-    strcpy(distance,field);
-
-    //  get azimuth
-    {
-        int nAz,nDist2;
-
-        doOneGrid( reporterLocation, &nAz, &nDist2 );
-        sprintf(azimuth,"%03d",nAz);
-        sprintf(distance2,"%4d",nDist2);
+    //  The numbers, read once.  A row whose frequency or SNR isn't a number is skipped.
+    if ((htmlscan_decimal( &row->cell[2], 6, &freqHz )) || (htmlscan_int( &row->cell[3], &snr ))) {
+        return 0;
     }
+    if (htmlscan_int( &row->cell[4], &drift )) { drift = 0; }
+    if (htmlscan_int( &row->cell[11], &distance )) { distance = 0; }      // miles, cell 10 is km
 
-
-    if (*numEntries < MAX_ENTRIES) {
-
-        int iii;
-
-        //  Loop through the entries.  If the frequency and reporter for any entry match the current line then update snr and quit
-        for (iii = 0; iii < *numEntries; iii++) {
-
-            //  Freqs are not exactly the same.  I really only want to know what band it is on so copy freqencies and truncate at the decimal point.
-            //printf("%s %s %s %s\n",entry[iii]->freq, freq, entry[iii]->reporter, reporter);
-            char freqEntry[20];             // freq already recorded in entries[]
-            char freqNew[20];               // current freq parsed from HTML
-            char *cc;
-            strcpy(freqEntry,entry[iii]->freq);
-            strcpy(freqNew,freq);
-            cc = strchr(freqEntry,'.');     // get MHz (28, 50, 144) from this entries[]
-            *cc = 0;
-            cc = strchr(freqNew,'.');       // get MHz from freq parsed from HTML
-            *cc = 0;
-
-            if ( strcmp( freqEntry, freqNew ) == 0 ) {                  // if this element of entries[] is the same band as this HTML line
-                if ( strcmp(entry[iii]->reporter, reporter) == 0 ) {    // ... and the same reporting station
-                    int snrEntry, snrCur;                               // ... then check to see if the SNR in the HTML line is greater than in entries[]
-                    sscanf( entry[iii]->snr, "%d", &snrEntry );  //  convert entry into an integer
-                    sscanf( snr, "%d", &snrCur  );               //  convert current snr value to an integer
-                    if ( snrEntry < snrCur ) {
-                        strcpy(entry[iii]->snr,snr);
-                    }
-                    //printf("d   %s %10s  %3s %2s  %10s   %6s %5s\n",timestamp, freq, snr, drift, reporter, reporterLocation, distance);
-                    (*numberOfDuplicates)++;
-                    break;
-                }
-            }
-        }
-
-        //  If no match was found in the above loop then add new entry.
-        if (iii == *numEntries) {
-            entry[*numEntries] = malloc( sizeof( Entry ) );
-            if (entry[*numEntries] == (Entry *)NULL) {
-                printf("Error in malloc()\n");
-                return -1;
-            }
-
-            strcpy( entry[*numEntries]->timestamp,timestamp);
-            strcpy( entry[*numEntries]->freq,freq);
-            strcpy( entry[*numEntries]->snr,snr);
-            strcpy( entry[*numEntries]->drift,drift);
-            strcpy( entry[*numEntries]->reporter,reporter);
-            strcpy( entry[*numEntries]->reporterLocation,reporterLocation);
-            strcpy( entry[*numEntries]->distance,distance);
-            strcpy( entry[*numEntries]->azimuth,azimuth);
-            strcpy( entry[*numEntries]->distance2,distance2);
-
-            (*numEntries)++;
+    //  Freqs are not exactly the same.  I really only want to know what band it is on, spottable.c compares the MHz.
+    //      The same band and reporting station as an earlier row is a duplicate, keep the greater SNR.
+    spot = spottable_insert( freqHz, spottable_intern( reporter->text, reporter->length ), &added );
+    if (spot == (Entry *)NULL) {
+        return -1;
+    }
+    if (added) {
+        struct GridPath path;
+        char grid[16];
+
+        spot->minute = ((timestamp.text[0]-'0')*10 + (timestamp.text[1]-'0'))*60 + (timestamp.text[3]-'0')*10 + (timestamp.text[4]-'0');     // matched a beacon's "HH:MM"
+        spot->snr = clampInt( snr, INT8_MIN, INT8_MAX );
+        spot->drift = clampInt( drift, INT8_MIN, INT8_MAX );
+        spot->distance = clampInt( distance, 0, UINT16_MAX );
+        spot->reporterLocation = spottable_intern( row->cell[9].text, row->cell[9].length );
+
+        //  get azimuth, 0 if the grid square isn't one
+        htmlscan_copy( &row->cell[9], grid, sizeof(grid) );
+        gridcache_lookup( grid, &path );
+        spot->azimuth = clampInt( path.azimuth, 0, UINT16_MAX );
+        spot->distance2 = clampInt( path.miles, 0, UINT16_MAX );
+    } else {
+        if (spot->snr < snr) {
+            spot->snr = clampInt( snr, INT8_MIN, INT8_MAX );
         }
+        (*numberOfDuplicates)++;
     }
 
     /*
@@ -501,46 +462,22 @@ static int parseHTMLLine( char *string, struct BeaconData *beaconData, int numBe
 
 
 
-/*
-    parseHTMLTag() - pulls the field out of a <td></td> tag.  Returns a char* pointer to the beginning of the next tag.
-        *string - pointer to the beginning of an tag somewhere in the string returned from curl call
-        field[] - a string to store the tag value.
-*/
-static char* parseHTMLTag( char *string, char *field ) {
-    //  All the HTML tags that I'm concerned with are <td>.  When the function is called string should point to the beginning of one.
-    //  It will return a pointer to the next one and field[] will contain the contents of the HTML field.  Upon error it returns (char *)-1;
-    char *returnValue;
-    char *fieldBegin;
-    char *cc;
-
-    //  Find end of this tag and use it as the return value in preparation for the next call
-    cc = strstr(string,"</td>");
-    if (cc == (char *)NULL) { return (char *)-1; }
-    returnValue = &cc[5];       //  point to end of </td>
-
-    //  Find the first &nbsp; and use it to find the beginning of the field contents
-    cc = strstr(string,"&nbsp;");
-    if (cc == (char *)NULL) { return (char *)-1; }
-    fieldBegin = &cc[6];        // point to end of &nbsp
-
-    //  Find the second &nbsp; and use it to mark the end of the field contents
-    cc = strstr(fieldBegin,"&nbsp;");
-    if (cc == (char *)NULL) { return (char *)-1; }
-    *cc = 0;                    // null-terminate
-
-    strcpy(field,fieldBegin);
-    return returnValue;
+//  The time of a spot from its UTC minute of the day, the last one up to now.  They are all from the last half hour or so.
+static time_t spotTime( time_t now, int minute ) {
+    time_t spot = now - now%86400 + minute*60;
+
+    return (spot > now + 60) ? spot - 86400 : spot;
 }
 
 
-static void doOneGrid( char *his, int *nAz, int *nDmiles ) {
-    int nDkm;
-    char mine[] = "DM12qu";
+//  freqHz in MHz the way wsprnet.org shows it, "28.126084"
+static void formatFreq( int64_t freqHz, char *string ) {
+    sprintf(string,"%d.%06d",(int)(freqHz/1000000),(int)(freqHz%1000000));
+}
+
 
-    azdist_( mine, his, nAz,        //  Azimuth
-                        nDmiles,    //  Distance in miles
-                        &nDkm       //  Distance in km
-                        );
+static int clampInt( int value, int min, int max ) {
+    return (value < min) ? min : ((value > max) ? max : value);
 }
 
 /*
@@ -566,6 +503,7 @@ static void doOneGrid( char *his, int *nAz, int *nDmiles ) {
 
 static int goldenList[ NUMBER_OF_GOLDEN_INDICES ][NUM_OF_GOLDEN_CALLS][2];
 static int numberItemsGoldenList[ NUMBER_OF_GOLDEN_INDICES ];
+static int numberLoggedGoldenList[ NUMBER_OF_GOLDEN_INDICES ];     // numberItemsGoldenList[] when log_golden.txt was written this cycle
 
 static int getIndexBasedOnFreq( int ifreq ) {
     if (ifreq > 144000000) {
@@ -606,15 +544,18 @@ static int goldenListNotEmpty( void ) {
     return 0;
 }
 
-// call this from processEntries() above, in the loop where golden freqs are printed
-static void insertInGoldenList( char *freq ) {
-    int ifreq,index;
-    char *ccc;
+//  call this from doCurl() above, with clear set for a new cycle and not set after log_golden.txt is written.  A re-query builds the golden
+//      list again from all the spots, processGoldenList() only writes a band again if it has golden calls it didn't have then.
+static void setGoldenListLogged( int clear ) {
+    for (int jjj = 0; jjj < NUMBER_OF_GOLDEN_INDICES; jjj++) {
+        numberLoggedGoldenList[jjj] = (clear) ? 0 : numberItemsGoldenList[jjj];
+    }
+}
 
-    ccc = strchr(freq,'.');
-    if (ccc == (char *)NULL) { return; }
-    strcpy( ccc, &ccc[1] );
-    sscanf(freq,"%d",&ifreq);
+// call this from processEntries() above, in the loop where golden freqs are printed
+static void insertInGoldenList( int64_t freqHz ) {
+    int ifreq = (int)freqHz;
+    int index;
 
     index = getIndexBasedOnFreq( ifreq );
     if (index == -1) { return; }
@@ -630,7 +571,7 @@ static void insertInGoldenList( char *freq ) {
 
 
 //  called from doCurl(), once for each band.
-static void processGoldenList( int txFreqHz, char* tone, int txFreqHzActual, double temperature, FILE *fptr, char* thedate, int *headerNotPrinted  ) {
+static void processGoldenList( int txFreqHz, double toneHz, int txFreqHzActual, double temperature, FILE *fptr, char* thedate, int *headerNotPrinted  ) {
     int index, wsprFreq, minNumGolden;
 
     index = getIndexBasedOnFreq( txFreqHz );
@@ -654,9 +595,12 @@ static void processGoldenList( int txFreqHz, char* tone, int txFreqHzActual, dou
             break;
     }
 
+    if (numberItemsGoldenList[index] == numberLoggedGoldenList[index]) {      // already written, no late golden calls on this band
+        return;
+    }
     if (numberItemsGoldenList[index] >= minNumGolden) {        // 5 stations for HF, 1 for 6m and 2m
         int trueFreq, trueSum;
-        int expectedFreq, error, error10;
+        int expectedFreq, error;
 
         //  Loop through each station and find the differences in frequency between it and all the other stations.  Insert the sum of all differences in [SUM_INDEX]
         for (int iii = 0; iii < numberItemsGoldenList[index]; iii++) {
@@ -676,27 +620,17 @@ static void processGoldenList( int txFreqHz, char* tone, int txFreqHzActual, dou
             }
         }
 
-        //printf(" trueFreq %d  trueSum %d  txFreqHz %d  tone %s  txFreqHzActual %d  temperature %lf\n",trueFreq, trueSum, txFreqHz, tone, txFreqHzActual, temperature );
+        //printf(" trueFreq %d  trueSum %d  txFreqHz %d  tone %.1lf  txFreqHzActual %d  temperature %lf\n",trueFreq, trueSum, txFreqHz, toneHz, txFreqHzActual, temperature );
 
         //  Now have true frequency.  Display the difference between true frequency and what it should have been, based on wsprFreq+tone.
         //      Display the error.  Display what the actual transmitted frequency should have been for zero error.
         //      Display number of golden calls hear on this band.  Write data to a log file.
-        tone[4] = 0;                            // change "1500.wav" to "1500"
-        sscanf( tone, "%d", &expectedFreq );    // convert tone to integer
+        expectedFreq = (int)lround(toneHz);     // tone is a double, 1500.0
         expectedFreq += wsprFreq;               // expected freq is where the signal should have been, wspr base freq plus tone frequency shows
 
-        //  The radio can only be set to intervals on 10Hz.  Set error to be intervals of 10 Hz.
+        //  The radio can only be set to intervals on 10Hz.  This used to round the error to 10 Hz.  txWspr() now puts the part of the
+        //      frequency the radio can't do into the audio tone, so the better frequency is good to 1 Hz.
         error = expectedFreq-trueFreq;
-        error10 = (error / 10)*10;
-        if (abs(error % 10) < 5) {
-            error = error10;
-        } else {
-            if (error < 0) {
-                error = error10-10;
-            } else {
-                error = error10+10;
-            }
-        }
 
         //printf(" temperature %3.3lf  expectedFreq %d  actualFreq %d error %d (%d) suggested %d (%d calls)\n",temperature,expectedFreq,trueFreq,
         //        error, expectedFreq-trueFreq, txFreqHzActual+(error), numberItemsGoldenList[index] );
@@ -715,7 +649,6 @@ static void processGoldenList( int txFreqHz, char* tone, int txFreqHzActual, dou
 
 
 
-// uncomment curl() call and, if using a different curl results, change fopen (two lines below curl) back to x.txt
 //#define MAIN_HERE 1
 #ifdef MAIN_HERE
 
@@ -733,7 +666,7 @@ int main() {
     strcpy(beaconData[2].timestamp,"19:18:00");
     beaconData[2].txFreqHz = 50293160;
 
-    return doCurl( beaconData, "3" );
+    return doCurl( beaconData, "3", 0, wsprnet_start(), (struct ReportTiming *)NULL );
 }
 
 
@@ -0,0 +1,501 @@
+/*
+    xmlscan.c - reads pskreporter.info's query response as it comes, one element at a time (SAX style).  doCurlFT8() used to read y.txt
+        with fgets() into a 4096 byte line, strstr() each line for "  <receptionReport receiverCallsign=" and then strstr() for
+        receiverLocator=, frequency=, flowStartSeconds=, mode= and sNR= in that order, each after the one before.  An element with its
+        attributes in another order, or wrapped onto a second line, or a line cut at 4096 bytes, stopped the parse there and the reports
+        after it were lost.
+
+        xmlscan_feed() takes the response in pieces of any size (all of it at once is one piece) and calls onElement() for every start
+        tag and empty element tag, <name attr="value" ...> and <name ... />, with the name and the attributes in the order they came.
+        Line breaks, spaces around the '=', either quote and a '>' inside a value are fine.  End tags, text, <?...?> and <!...> are skipped
+        (a comment with a '>' in it isn't, pskreporter.info doesn't send comments).  A tag cut by the end of a piece is held in the
+        XmlScan until the rest comes, the others are views (pointer and length) into the piece, good until onElement() returns.
+        xmlscan_attribute() finds an attribute by name, xmlscan_copy() decodes &amp; and the other entities as it copies, xmlscan_long()
+        reads a number.
+
+    To test and benchmark (a made up 20,000 report response, fed whole and in small pieces, against the old fgets()/strstr() parse):
+        - uncomment MAIN_HERE directive at the bottom of the file.
+            gcc -g -Wall -O2 -o xmlscan xmlscan.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xmlscan.h"
+
+#define CHAR_SPACE      1
+#define CHAR_ENDS_NAME  2           // a space, '=', '/' or '>'
+
+void xmlscan_begin( struct XmlScan *scan, XmlElementFn onElement, void *context );
+void xmlscan_feed( struct XmlScan *scan, const char *data, size_t length );
+const struct XmlView *xmlscan_attribute( const struct XmlElement *element, const char *name );
+int xmlscan_attributes( const struct XmlElement *element, const char *const *names, int numNames, const struct XmlView **values );
+int xmlscan_equals( const struct XmlView *view, const char *string );
+int xmlscan_copy( const struct XmlView *view, char *string, int size );
+int xmlscan_long( const struct XmlView *view, long long *value );
+
+static const char *holdTag( struct XmlScan *scan, const char *cc, const char *end );
+static const char *scanTag( const char *cc, const char *end, struct XmlElement *element );
+static void passOn( struct XmlScan *scan, const struct XmlElement *element );
+
+#define IS_SPACE(cc)    (charClass[ (unsigned char)(cc) ] & CHAR_SPACE)
+#define ENDS_NAME(cc)   (charClass[ (unsigned char)(cc) ] & CHAR_ENDS_NAME)
+
+static const unsigned char charClass[256] = { [' '] = CHAR_SPACE | CHAR_ENDS_NAME, ['\n'] = CHAR_SPACE | CHAR_ENDS_NAME,
+                                             ['\r'] = CHAR_SPACE | CHAR_ENDS_NAME, ['\t'] = CHAR_SPACE | CHAR_ENDS_NAME,
+                                             ['='] = CHAR_ENDS_NAME, ['/'] = CHAR_ENDS_NAME, ['>'] = CHAR_ENDS_NAME };
+
+
+void xmlscan_begin( struct XmlScan *scan, XmlElementFn onElement, void *context ) {
+    scan->onElement = onElement;
+    scan->context = context;
+    scan->inTag = 0;
+    scan->tagLength = 0;
+    scan->elements = 0;
+}
+
+
+//  The next piece of the response.  onElement() is called for each element that ends in it.
+void xmlscan_feed( struct XmlScan *scan, const char *data, size_t length ) {
+    const char *cc = data;
+    const char *end = data + length;
+    const char *close;
+    struct XmlElement element;
+
+    if (scan->inTag) {                  // the rest of the tag cut by the last piece
+        cc = holdTag( scan, cc, end );
+        if (cc == (const char *)NULL) {
+            return;
+        }
+    }
+    while (1) {
+        cc = memchr( cc, '<', end - cc );
+        if (cc == (const char *)NULL) {
+            return;
+        }
+        cc++;
+        close = scanTag( cc, end, &element );
+        if (close == (const char *)NULL) {          // cut, keep it for the next piece
+            scan->inTag = 1;
+            scan->tagLength = 0;
+            cc = holdTag( scan, cc, end );
+            if (cc == (const char *)NULL) {
+                return;
+            }
+            continue;
+        }
+        passOn( scan, &element );
+        cc = close + 1;
+    }
+}
+
+
+//  The attribute called name, NULL if the element hasn't got one.
+const struct XmlView *xmlscan_attribute( const struct XmlElement *element, const char *name ) {
+    for (int iii = 0; iii < element->numAttrs; iii++) {
+        if (xmlscan_equals( &element->attrName[iii], name )) {
+            return &element->attrValue[iii];
+        }
+    }
+    return (const struct XmlView *)NULL;
+}
+
+
+//  Several attributes in one pass over the element, the names are told apart by their lengths first.  values[iii] is names[iii]'s value,
+//      NULL if the element hasn't got it.  Returns how many were found.
+int xmlscan_attributes( const struct XmlElement *element, const char *const *names, int numNames, const struct XmlView **values ) {
+    int lengths[XMLSCAN_MAX_ATTRS];
+    int found = 0;
+
+    for (int jjj = 0; jjj < numNames; jjj++) {
+        lengths[jjj] = strlen( names[jjj] );
+        values[jjj] = (const struct XmlView *)NULL;
+    }
+    for (int iii = 0; iii < element->numAttrs; iii++) {
+        const struct XmlView *name = &element->attrName[iii];
+
+        for (int jjj = 0; jjj < numNames; jjj++) {
+            if ((name->length == lengths[jjj]) && (values[jjj] == (const struct XmlView *)NULL)
+                    && (memcmp( name->text, names[jjj], lengths[jjj] ) == 0)) {
+                values[jjj] = &element->attrValue[iii];
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+
+//  1 if the view is exactly string.
+int xmlscan_equals( const struct XmlView *view, const char *string ) {
+    return (strncmp( view->text, string, view->length ) == 0) && (string[ view->length ] == 0);
+}
+
+
+//  Copies the view into string[size] and null terminates it, with &amp; &lt; &gt; &quot; &apos; and &#nn; (below 128) decoded.
+//      Returns the length, or -1 if it didn't fit (what fit is copied).
+int xmlscan_copy( const struct XmlView *view, char *string, int size ) {
+    static const char *entities[] = { "&amp;", "&lt;", "&gt;", "&quot;", "&apos;" };
+    static const char characters[] = "&<>\"'";
+    const char *cc = view->text;
+    const char *end = view->text + view->length;
+    int length = 0;
+
+    if (memchr( cc, '&', view->length ) == NULL) {         // nearly always, nothing to decode
+        length = (view->length < size) ? view->length : size - 1;
+        memcpy( string, cc, length );
+        string[length] = 0;
+        return (length == view->length) ? length : -1;
+    }
+    while (cc < end) {
+        char out = *cc++;
+
+        if (out == '&') {
+            int iii;
+            for (iii = 0; iii < 5; iii++) {
+                int entityLength = strlen( entities[iii] );
+                if ((end - cc >= entityLength - 1) && (strncmp( cc, &entities[iii][1], entityLength - 1 ) == 0)) {
+                    out = characters[iii];
+                    cc += entityLength - 1;
+                    break;
+                }
+            }
+            if ((iii == 5) && (cc < end) && (*cc == '#')) {
+                const char *semicolon = memchr( cc, ';', end - cc );
+                char *after;
+                long code = (cc + 1 < end) && (cc[1] == 'x') ? strtol( cc + 2, &after, 16 ) : strtol( cc + 1, &after, 10 );
+                if ((semicolon != (const char *)NULL) && (after == semicolon) && (code > 0) && (code < 128)) {
+                    out = (char)code;
+                    cc = semicolon + 1;
+                }
+            }
+        }
+        if (length == size - 1) {
+            string[length] = 0;
+            return -1;
+        }
+        string[length++] = out;
+    }
+    string[length] = 0;
+    return length;
+}
+
+
+//  An optionally signed decimal integer, the whole view.  Returns 0 or -1.
+int xmlscan_long( const struct XmlView *view, long long *value ) {
+    int iii = 0;
+    long long sign = 1, result = 0;
+
+    if ((view->length > 0) && ((view->text[0] == '-') || (view->text[0] == '+'))) {
+        sign = (view->text[0] == '-') ? -1 : 1;
+        iii = 1;
+    }
+    if ((iii == view->length) || (view->length - iii > 18)) {
+        return -1;
+    }
+    for ( ; iii < view->length; iii++) {
+        if ((view->text[iii] < '0') || (view->text[iii] > '9')) {
+            return -1;
+        }
+        result = result*10 + (view->text[iii] - '0');
+    }
+    *value = sign*result;
+    return 0;
+}
+
+
+//  Adds to the tag cut by the end of a piece, up to its '>' if that is in [cc, end), and passes it on when it is whole.  Returns where the
+//      piece goes on after the tag, or NULL if all of it was taken.  A tag that doesn't fit in XMLSCAN_MAX_TAG is skipped to the next '>'.
+static const char *holdTag( struct XmlScan *scan, const char *cc, const char *end ) {
+    struct XmlElement element;
+    const char *close;
+    int held = scan->tagLength;
+    int num = (end - cc < XMLSCAN_MAX_TAG - held) ? end - cc : XMLSCAN_MAX_TAG - held;
+
+    if (held < 0) {
+        close = memchr( cc, '>', end - cc );
+        if (close == (const char *)NULL) {
+            return (const char *)NULL;
+        }
+        scan->inTag = 0;
+        return close + 1;
+    }
+    memcpy( &scan->tag[held], cc, num );
+    close = scanTag( scan->tag, &scan->tag[held + num], &element );
+    if (close == (const char *)NULL) {
+        scan->tagLength = (held + num < XMLSCAN_MAX_TAG) ? held + num : -1;
+        return (scan->tagLength < 0) ? holdTag( scan, cc + num, end ) : (const char *)NULL;
+    }
+    scan->inTag = 0;
+    passOn( scan, &element );
+    return cc + (close - &scan->tag[held]) + 1;
+}
+
+
+//  Reads the tag that starts at cc, after its '<'.  Returns the '>' that ends it with *element filled in, or NULL if end comes first.
+//      Attributes without a quoted value are left out.
+static const char *scanTag( const char *cc, const char *end, struct XmlElement *element ) {
+    element->name.text = cc;
+    while ((cc < end) && (!ENDS_NAME( *cc ))) {
+        cc++;
+    }
+    element->name.length = cc - element->name.text;
+    element->numAttrs = 0;
+
+    while (1) {
+        const char *name, *nameEnd, *value;
+        char quote;
+
+        while ((cc < end) && (IS_SPACE( *cc ))) {
+            cc++;
+        }
+        if (cc >= end) {
+            return (const char *)NULL;
+        }
+        if (*cc == '>') {
+            return cc;
+        }
+        name = cc;
+        while ((cc < end) && (!ENDS_NAME( *cc ))) {
+            cc++;
+        }
+        nameEnd = cc;
+        while ((cc < end) && (IS_SPACE( *cc ))) {
+            cc++;
+        }
+        if (cc >= end) {
+            return (const char *)NULL;
+        }
+        if (*cc != '=') {
+            if (name == nameEnd) {
+                cc++;                       // the '/' of "/>", or a stray character
+            }
+            continue;
+        }
+        cc++;
+        while ((cc < end) && (IS_SPACE( *cc ))) {
+            cc++;
+        }
+        if (cc >= end) {
+            return (const char *)NULL;
+        }
+        if ((*cc != '"') && (*cc != '\'')) {
+            continue;
+        }
+        quote = *cc++;
+        value = cc;
+        cc = memchr( cc, quote, end - cc );
+        if (cc == (const char *)NULL) {
+            return (const char *)NULL;
+        }
+        if (element->numAttrs < XMLSCAN_MAX_ATTRS) {
+            element->attrName[ element->numAttrs ].text = name;
+            element->attrName[ element->numAttrs ].length = nameEnd - name;
+            element->attrValue[ element->numAttrs ].text = value;
+            element->attrValue[ element->numAttrs ].length = cc - value;
+            element->numAttrs++;
+        }
+        cc++;
+    }
+}
+
+
+//  To onElement(), unless it's an end tag, <?...?> or <!...>.
+static void passOn( struct XmlScan *scan, const struct XmlElement *element ) {
+    char first = (element->name.length > 0) ? element->name.text[0] : '/';
+
+    if ((first == '/') || (first == '?') || (first == '!')) {
+        return;
+    }
+    scan->elements++;
+    scan->onElement( element, scan->context );
+}
+
+
+
+
+
+//#define MAIN_HERE 1
+#ifdef MAIN_HERE
+#include <time.h>
+
+#define OLD_START_OF_LINE   "  <receptionReport receiverCallsign="
+
+static const char *sample =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<receptionReports currentSeconds=\"1702800110\">\n"
+    "  <lastSequenceNumber value=\"42033658637\"/>\n"
+    "  <maxFlowStartSeconds value=\"1702800105\"/>\n"
+    "  <receptionReport receiverCallsign=\"N3IZN/SDR\" receiverLocator=\"DM13JI\" senderCallsign=\"NQ6B\" senderLocator=\"DM12QU\" "
+        "frequency=\"50313623\" flowStartSeconds=\"1702799654\" mode=\"FT8\" isSender=\"1\" receiverDXCC=\"United States\" "
+        "receiverDXCCCode=\"K\" senderLotwUpload=\"2023-12-07\" senderEqslAuthGuar=\"A\" sNR=\"-14\" />\n"
+    "  <receptionReport sNR=\"-5\" mode=\"FT8\" receiverCallsign=\"NQ6B\" frequency=\"50313649\"\n"
+    "        receiverLocator=\"DM12QU\" flowStartSeconds=\"1702799651\" />\n"
+    "  <receptionReport receiverCallsign = 'KF6JSD' receiverLocator='DM12QU' frequency='50313627' flowStartSeconds='1702799651' "
+        "mode='FT8' receiverDXCC='Trinidad &amp; Tobago &#x3E; &lt;x&gt;' sNR='28'/>\n"
+    "  <senderSearch callsign=\"NQ6B\" recentFlowStartSeconds=\"1702799654\"  />\n"
+    "</receptionReports>\n";
+
+static char trace[65536];
+static int traceLength;
+
+//  Writes down every element and attribute, so a parse can be compared with another
+static void onElement( const struct XmlElement *element, void *context ) {
+    char value[256];
+
+    traceLength += sprintf( &trace[traceLength], "%.*s", element->name.length, element->name.text );
+    for (int iii = 0; iii < element->numAttrs; iii++) {
+        xmlscan_copy( &element->attrValue[iii], value, sizeof(value) );
+        traceLength += sprintf( &trace[traceLength], " %.*s=[%s]", element->attrName[iii].length, element->attrName[iii].text, value );
+    }
+    traceLength += sprintf( &trace[traceLength], "\n" );
+}
+
+//  The old way: strstr() each line for the start of a report, then for each attribute in turn, and copy it
+static char *oldItem( char *string, char *quotedString ) {
+    char *cc = strchr( &string[1], '\"' );
+    if (cc == (char *)NULL) { return (char *)-1; }
+    *cc = 0;
+    strcpy( quotedString, &string[1] );
+    *cc = '\"';
+    return cc + 1;
+}
+
+static int oldLine( char *string ) {
+    char call[64], grid[64], freq[64], seconds[64], mode[64], snr[64];
+    char *cc;
+
+    cc = oldItem( string, call );           if (cc == (char *)-1) { return -1; }
+    cc = strstr( cc, "receiverLocator=" );  if (cc == (char *)NULL) { return -1; }
+    cc = oldItem( &cc[ strlen("receiverLocator=") ], grid );
+    cc = strstr( cc, "frequency=" );        if (cc == (char *)NULL) { return -1; }
+    cc = oldItem( &cc[ strlen("frequency=") ], freq );
+    cc = strstr( cc, "flowStartSeconds=" ); if (cc == (char *)NULL) { return -1; }
+    cc = oldItem( &cc[ strlen("flowStartSeconds=") ], seconds );
+    cc = strstr( cc, "mode=" );             if (cc == (char *)NULL) { return -1; }
+    cc = oldItem( &cc[ strlen("mode=") ], mode );
+    cc = strstr( cc, "sNR=" );              if (cc == (char *)NULL) { return -1; }
+    cc = oldItem( &cc[ strlen("sNR=") ], snr );
+    return 0;
+}
+
+static int oldParse( char *text, size_t length ) {
+    char string[4096];
+    FILE *fptr = fmemopen( text, length, "r" );
+    int reports = 0;
+
+    while (fgets( string, sizeof(string), fptr ) != (char *)NULL) {
+        if (strstr( string, OLD_START_OF_LINE )) {
+            if (oldLine( &string[ strlen(OLD_START_OF_LINE) ] )) {
+                break;
+            }
+            reports++;
+        }
+    }
+    fclose( fptr );
+    return reports;
+}
+
+static int newReports;
+
+//  What pskreporter.c does with a report: the six attributes it uses found in one pass, read or copied
+static void countReport( const struct XmlElement *element, void *context ) {
+    static const char *names[] = { "receiverCallsign", "receiverLocator", "frequency", "flowStartSeconds", "mode", "sNR" };
+    const struct XmlView *values[6];
+    char call[64], grid[64], mode[16];
+    long long freq, seconds, snr;
+
+    if ((!xmlscan_equals( &element->name, "receptionReport" )) || (xmlscan_attributes( element, names, 6, values ) != 6)) {
+        return;
+    }
+    if ((xmlscan_copy( values[0], call, sizeof(call) ) > 0) && (xmlscan_copy( values[1], grid, sizeof(grid) ) >= 0)
+            && (xmlscan_long( values[2], &freq ) == 0) && (xmlscan_long( values[3], &seconds ) == 0)
+            && (xmlscan_copy( values[4], mode, sizeof(mode) ) >= 0) && (xmlscan_long( values[5], &snr ) == 0)) {
+        newReports++;
+    }
+}
+
+//  A made up response of numReports, one per line as pskreporter.info sends them, every reorder-th one with its attributes in another
+//      order (0 for none)
+static size_t makeResponse( char *text, int numReports, int reorder ) {
+    size_t length = sprintf( text, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<receptionReports currentSeconds=\"1702800110\">\n"
+                                   "  <lastSequenceNumber value=\"42033658637\"/>\n" );
+    for (int iii = 0; iii < numReports; iii++) {
+        if ((reorder) && (iii % reorder == reorder - 1)) {
+            length += sprintf( &text[length], "  <receptionReport receiverCallsign=\"K%dABC\" receiverLocator=\"FN42AA\" sNR=\"%d\" "
+                               "senderCallsign=\"NQ6B\" frequency=\"%d\" flowStartSeconds=\"%d\" mode=\"FT8\" isSender=\"1\" />\n",
+                               iii, -(iii % 25), 50313000 + iii % 3000, 1702790000 + iii );
+        } else {
+            length += sprintf( &text[length], "  <receptionReport receiverCallsign=\"K%dABC\" receiverLocator=\"FN42AA\" "
+                               "senderCallsign=\"NQ6B\" senderLocator=\"DM12QU\" frequency=\"%d\" flowStartSeconds=\"%d\" mode=\"FT8\" "
+                               "isSender=\"1\" receiverDXCC=\"United States\" receiverDXCCCode=\"K\" senderLotwUpload=\"2023-12-07\" "
+                               "senderEqslAuthGuar=\"A\" sNR=\"%d\" />\n", iii, 50313000 + iii % 3000, 1702790000 + iii, -(iii % 25) );
+        }
+    }
+    length += sprintf( &text[length], "</receptionReports>\n" );
+    return length;
+}
+
+static double secondsSince( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)*1e-9;
+}
+
+int main() {
+    struct XmlScan scan;
+    char whole[65536];
+    size_t length = strlen( sample );
+    int errors = 0, numReports = 20000, oldReports;
+    char *text = malloc( numReports*400 + 1000 );
+    struct timespec start;
+    double oldSec, newSec;
+
+    //  All of it at once
+    traceLength = 0;
+    xmlscan_begin( &scan, onElement, NULL );
+    xmlscan_feed( &scan, sample, length );
+    strcpy( whole, trace );
+    printf("%s",whole);
+
+    //  The same in pieces of every size from 1 to 64 bytes
+    for (int pieceSize = 1; pieceSize <= 64; pieceSize++) {
+        traceLength = 0;
+        xmlscan_begin( &scan, onElement, NULL );
+        for (size_t done = 0; done < length; done += pieceSize) {
+            xmlscan_feed( &scan, &sample[done], (length - done < pieceSize) ? length - done : pieceSize );
+        }
+        if (strcmp( trace, whole )) {
+            printf("pieces of %d bytes parse differently\n%s",pieceSize,trace);
+            errors++;
+        }
+    }
+    printf("fed whole and in pieces of 1 to 64 bytes: %s\n\n",errors ? "DIFFERENT" : "same");
+
+    //  Speed, and what the old way makes of reports in another order
+    for (int reorder = 0; reorder <= 100; reorder += 100) {
+        length = makeResponse( text, numReports, reorder );
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        for (int iii = 0; iii < 10; iii++) {
+            oldReports = oldParse( text, length );
+        }
+        oldSec = secondsSince( &start )/10;
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        for (int iii = 0; iii < 10; iii++) {
+            newReports = 0;
+            xmlscan_begin( &scan, countReport, NULL );
+            xmlscan_feed( &scan, text, length );
+        }
+        newSec = secondsSince( &start )/10;
+        printf("%d reports, %zu bytes%s\n",numReports,length,reorder ? ", every 100th in another order" : "");
+        printf("   old fgets()/strstr()  %6d reports  %7.3f ms  %5.2f M reports/s\n",oldReports,oldSec*1e3,oldReports/oldSec*1e-6);
+        printf("   xmlscan               %6d reports  %7.3f ms  %5.2f M reports/s\n",newReports,newSec*1e3,newReports/newSec*1e-6);
+        if (newReports != numReports) {
+            errors++;
+        }
+    }
+    free( text );
+    printf("%s\n",errors ? "FAIL" : "PASS");
+    return errors;
+}
+#endif
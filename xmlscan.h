@@ -0,0 +1,40 @@
+#ifndef _XMLSCAN_H_
+#define _XMLSCAN_H_
+
+#include <stddef.h>
+
+#define XMLSCAN_MAX_ATTRS   24          // pskreporter.info's receptionReport has 14, any more are skipped
+#define XMLSCAN_MAX_TAG     4096        // a tag split between two pieces is held this long, a longer one is skipped
+
+struct XmlView {                // points into the response (or the held tag), not null terminated, entities not decoded
+    const char *text;
+    int length;
+};
+
+struct XmlElement {             // a start tag or an empty element tag, <name attr="value" ...> or <name ... />
+    struct XmlView name;
+    int numAttrs;
+    struct XmlView attrName[XMLSCAN_MAX_ATTRS];
+    struct XmlView attrValue[XMLSCAN_MAX_ATTRS];
+};
+
+typedef void (*XmlElementFn)( const struct XmlElement *element, void *context );
+
+struct XmlScan {
+    XmlElementFn onElement;
+    void *context;
+    int inTag;                  // a tag was cut by the end of the last piece, tag[] holds what came of it
+    int tagLength;              //      -1 if it was too long and is being skipped
+    long elements;              // onElement() calls
+    char tag[XMLSCAN_MAX_TAG];
+};
+
+extern void xmlscan_begin( struct XmlScan *scan, XmlElementFn onElement, void *context );
+extern void xmlscan_feed( struct XmlScan *scan, const char *data, size_t length );
+extern const struct XmlView *xmlscan_attribute( const struct XmlElement *element, const char *name );
+extern int xmlscan_attributes( const struct XmlElement *element, const char *const *names, int numNames, const struct XmlView **values );
+extern int xmlscan_equals( const struct XmlView *view, const char *string );
+extern int xmlscan_copy( const struct XmlView *view, char *string, int size );
+extern int xmlscan_long( const struct XmlView *view, long long *value );
+
+#endif